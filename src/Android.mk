@@ -40,19 +40,32 @@ LOCAL_SRC_FILES :=              \
         gen75_picture_process.c \
         gen75_vpp_vebox.c       \
         gen75_vpp_gpe.c         \
+        gen75_vpp_plan.c        \
         i965_avc_bsd.c          \
         i965_avc_hw_scoreboard.c\
         i965_avc_ildb.c         \
+        i965_bitstream_scan.c   \
+        i965_brc.c              \
+        i965_buffer_pool.c      \
+        i965_context_pool.c     \
         i965_decoder_utils.c    \
         i965_drv_video.c        \
         i965_encoder.c          \
         i965_encoder_utils.c    \
+        i965_fence.c            \
+        i965_image_convert.c    \
         i965_gpe_utils.c        \
         i965_media.c            \
         i965_media_h264.c       \
         i965_media_mpeg2.c      \
         i965_post_processing.c  \
         i965_render.c           \
+        i965_cadence.c          \
+        i965_scene_change.c     \
+        i965_surface_cache.c    \
+        i965_tiling.c           \
+        i965_vme_cost.c         \
+        i965_worker_pool.c      \
         intel_media_common.c    \
         intel_batchbuffer.c     \
         intel_batchbuffer_dump.c\
@@ -670,7 +670,10 @@ gen6_mfc_stop(VADriverContextP ctx,
     
     vaStatus = i965_MapBuffer(ctx, pPicParameter->coded_buf, (void **)&coded_buffer_segment);
     assert(vaStatus == VA_STATUS_SUCCESS);
-    *encoded_bits_size = coded_buffer_segment->size * 8;
+
+    /* the frame may be returned as one segment per slice */
+    for (*encoded_bits_size = 0; coded_buffer_segment; coded_buffer_segment = coded_buffer_segment->next)
+        *encoded_bits_size += coded_buffer_segment->size * 8;
     i965_UnmapBuffer(ctx, pPicParameter->coded_buf);
 
     return VA_STATUS_SUCCESS;
@@ -792,8 +795,8 @@ gen6_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
     int slice_type = intel_avc_enc_slice_type_fixup(pSliceParameter->slice_type);
     int is_intra = slice_type == SLICE_TYPE_I;
 
-    if (rate_control_mode == VA_RC_CBR) {
-        qp = mfc_context->bit_rate_control_context[slice_type].QpPrimeY;
+    if (MFC_BRC_ENABLED(rate_control_mode)) {
+        qp = i965_brc_get_qp(&mfc_context->brc, slice_type);
         if (encode_state->slice_header_index[slice_index] == 0)
             pSliceParameter->slice_qp_delta = qp - pPicParameter->pic_init_qp;
     }
@@ -808,7 +811,7 @@ gen6_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
                              pPicParameter,
                              pSliceParameter,
                              encode_state, encoder_context,
-                             (rate_control_mode == VA_RC_CBR), qp, slice_batch);
+                             MFC_BRC_ENABLED(rate_control_mode), qp, slice_batch);
 
     if ( slice_index == 0) 
         intel_mfc_avc_pipeline_header_programing(ctx, encode_state, encoder_context, slice_batch);
@@ -859,8 +862,6 @@ gen6_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
                                    tail_data, 1, 8,
                                    1, 1, 1, 0, slice_batch);
     }
-
-
 }
 
 static dri_bo *
@@ -1172,8 +1173,8 @@ gen6_mfc_avc_batchbuffer_slice(VADriverContextP ctx,
     unsigned short head_size, tail_size;
     int slice_type = intel_avc_enc_slice_type_fixup(pSliceParameter->slice_type);
 
-    if (rate_control_mode == VA_RC_CBR) {
-        qp = mfc_context->bit_rate_control_context[slice_type].QpPrimeY;
+    if (MFC_BRC_ENABLED(rate_control_mode)) {
+        qp = i965_brc_get_qp(&mfc_context->brc, slice_type);
         if (encode_state->slice_header_index[slice_index] == 0)
             pSliceParameter->slice_qp_delta = qp - pPicParameter->pic_init_qp;
     }
@@ -1190,7 +1191,7 @@ gen6_mfc_avc_batchbuffer_slice(VADriverContextP ctx,
                              pSliceParameter,
                              encode_state,
                              encoder_context,
-                             (rate_control_mode == VA_RC_CBR),
+                             MFC_BRC_ENABLED(rate_control_mode),
                              qp,
                              slice_batch);
 
@@ -1351,17 +1352,18 @@ gen6_mfc_avc_encode_picture(VADriverContextP ctx,
         /*Programing bcs pipeline*/
         gen6_mfc_avc_pipeline_programing(ctx, encode_state, encoder_context);	//filling the pipeline
         gen6_mfc_run(ctx, encode_state, encoder_context);
-        if (rate_control_mode == VA_RC_CBR /*|| rate_control_mode == VA_RC_VBR*/) {
+        if (MFC_BRC_ENABLED(rate_control_mode)) {
             gen6_mfc_stop(ctx, encode_state, encoder_context, &current_frame_bits_size);
             sts = intel_mfc_brc_postpack(encode_state, mfc_context, current_frame_bits_size);
-            if (sts == BRC_NO_HRD_VIOLATION) {
+            if (sts == BRC_NO_HRD_VIOLATION || sts == BRC_MAX_PASSES_SPENT) {
+                /* past the pass limit the frame is kept, the next ones get the corrected QP */
                 intel_mfc_hrd_context_update(encode_state, mfc_context);
                 break;
             }
             else if (sts == BRC_OVERFLOW_WITH_MIN_QP || sts == BRC_UNDERFLOW_WITH_MAX_QP) {
-                if (!mfc_context->hrd.violation_noted) {
+                if (!mfc_context->brc.hrd.violation_noted) {
                     fprintf(stderr, "Unrepairable %s!\n", (sts == BRC_OVERFLOW_WITH_MIN_QP)? "overflow": "underflow");
-                    mfc_context->hrd.violation_noted = 1;
+                    mfc_context->brc.hrd.violation_noted = 1;
                 }
                 return VA_STATUS_SUCCESS;
             }
@@ -1403,6 +1405,8 @@ gen6_mfc_context_destroy(void *context)
     struct gen6_mfc_context *mfc_context = context;
     int i;
 
+    intel_mfc_brc_terminate(mfc_context);
+
     dri_bo_unreference(mfc_context->post_deblocking_output.bo);
     mfc_context->post_deblocking_output.bo = NULL;
 
@@ -34,14 +34,21 @@
 #include <intel_bufmgr.h>
 
 #include "i965_gpe_utils.h"
+#include "i965_brc.h"
+#include "i965_scene_change.h"
 
 struct encode_state;
+struct intel_encoder_context;
 
 #define MAX_MFC_REFERENCE_SURFACES      16
+#define MAX_MFC_MB_ROWS                 256
 #define NUM_MFC_DMV_BUFFERS             34
 
 #define INTRA_MB_FLAG_MASK              0x00002000
 
+/* The rate control modes driven by the i965_brc model */
+#define MFC_BRC_ENABLED(mode)           ((mode) == VA_RC_CBR || (mode) == VA_RC_VBR)
+
 /* The space required for slice header SLICE_STATE + header.
  * Is it enough? */
 #define SLICE_HEADER			80
@@ -61,15 +68,20 @@ struct encode_state;
 
 #define CMD_LEN_IN_OWORD        4
 
+/* Layout of the VME output of the gen7.5+ AVC kernels, in dwords */
+#define AVC_INTRA_RDO_OFFSET    4
+#define AVC_INTER_RDO_OFFSET    10
+#define AVC_INTER_MSG_OFFSET    8
+#define AVC_INTER_MV_OFFSET     48      /* in bytes */
+#define AVC_RDO_MASK            0xFFFF
+
+/* MMIO base of the registers of each VDBOX, the second one on GT3 parts only */
+#define VDBOX0_MMIO_BASE                        0x12000
+#define VDBOX1_MMIO_BASE                        0x1C000
+
+/* Bytes written to the bitstream buffer since the start of the frame */
+#define MFC_BITSTREAM_BYTECOUNT_FRAME_REG       (VDBOX0_MMIO_BASE + 0x8A0)
 
-typedef enum _gen6_brc_status
-{
-    BRC_NO_HRD_VIOLATION = 0,
-    BRC_UNDERFLOW = 1,
-    BRC_OVERFLOW = 2,
-    BRC_UNDERFLOW_WITH_MAX_QP = 3,
-    BRC_OVERFLOW_WITH_MIN_QP = 4,
-} gen6_brc_status;
 
 struct gen6_mfc_avc_surface_aux
 {
@@ -138,7 +150,6 @@ struct gen6_mfc_context
 
     //Bit rate tracking context
     struct {
-        unsigned int QpPrimeY;
         unsigned int MaxQpNegModifier;
         unsigned int MaxQpPosModifier;
         unsigned char MaxSizeInWord;
@@ -153,27 +164,20 @@ struct gen6_mfc_context
         unsigned int target_frame_size;
     } bit_rate_control_context[3];      //INTERNAL: for I, P, B frames
 
-    struct {
-        int mode;
-        int gop_nums[3];
-        int target_frame_size[3]; // I,P,B
-        double bits_per_frame;
-        double qpf_rounding_accumulator;
-
-        double saved_bps;
-        double saved_fps;
-        int saved_intra_period;
-        int saved_ip_period;
-        int saved_idr_period;
-    } brc;
+    struct i965_brc brc;
 
-    struct {
-        double current_buffer_fullness;
-        double target_buffer_fullness;
-        double buffer_capacity;
-        unsigned int buffer_size;
-        unsigned int violation_noted;
-    } hrd;
+    /* QP offset of each MB row, see intel_mfc_avc_row_qp_prepare() */
+    int row_qp_enabled;
+    signed char row_qp_delta[MAX_MFC_MB_ROWS];
+
+    /* QP offset of each MB, see intel_mfc_avc_qp_map_prepare() */
+    int qp_map_enabled;
+    signed char *mb_qp_delta;
+    int mb_qp_delta_size;
+
+    /* see intel_mfc_avc_scene_analyze(), I965_CODED_BUF_STATUS_* of the frame */
+    struct i965_scene_detector scene_detector;
+    unsigned int scene_status;
 
     //HRD control context
     struct {
@@ -234,10 +238,6 @@ extern
 Bool gen75_mfc_context_init(VADriverContextP ctx, struct intel_encoder_context *encoder_context);
 
 
-extern int intel_mfc_update_hrd(struct encode_state *encode_state,
-                                struct gen6_mfc_context *mfc_context,
-                                int frame_bits);
-
 extern int intel_mfc_brc_postpack(struct encode_state *encode_state,
                                   struct gen6_mfc_context *mfc_context,
                                   int frame_bits);
@@ -278,4 +278,28 @@ intel_avc_slice_insert_packed_data(VADriverContextP ctx,
                              int slice_index,
                              struct intel_batchbuffer *slice_batch);
 
+extern void
+intel_mfc_avc_row_qp_prepare(VADriverContextP ctx,
+                             struct encode_state *encode_state,
+                             struct intel_encoder_context *encoder_context);
+
+extern void
+intel_mfc_avc_qp_map_prepare(VADriverContextP ctx,
+                             struct encode_state *encode_state,
+                             struct intel_encoder_context *encoder_context);
+
+extern void
+intel_mfc_avc_scene_analyze(VADriverContextP ctx,
+                            struct encode_state *encode_state,
+                            struct intel_encoder_context *encoder_context);
+
+extern void
+intel_mfc_brc_terminate(struct gen6_mfc_context *mfc_context);
+
+extern void
+intel_mfc_store_coded_size(VADriverContextP ctx,
+                           struct intel_encoder_context *encoder_context,
+                           int slice_index,
+                           struct intel_batchbuffer *slice_batch);
+
 #endif	/* _GEN6_MFC_BCS_H_ */
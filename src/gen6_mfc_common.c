@@ -32,6 +32,7 @@
 #include <string.h>
 #include <assert.h>
 #include <math.h>
+#include <stddef.h>
 
 #include "intel_batchbuffer.h"
 #include "i965_defines.h"
@@ -43,29 +44,6 @@
 #include "gen6_vme.h"
 #include "intel_media.h"
 
-#define BRC_CLIP(x, min, max)                                   \
-    {                                                           \
-        x = ((x > (max)) ? (max) : ((x < (min)) ? (min) : x));  \
-    }
-
-#define BRC_P_B_QP_DIFF 4
-#define BRC_I_P_QP_DIFF 2
-#define BRC_I_B_QP_DIFF (BRC_I_P_QP_DIFF + BRC_P_B_QP_DIFF)
-
-#define BRC_PWEIGHT 0.6  /* weight if P slice with comparison to I slice */
-#define BRC_BWEIGHT 0.25 /* weight if B slice with comparison to I slice */
-
-#define BRC_QP_MAX_CHANGE 5 /* maximum qp modification */
-#define BRC_CY 0.1 /* weight for */
-#define BRC_CX_UNDERFLOW 5.
-#define BRC_CX_OVERFLOW -4.
-
-#define BRC_PI_0_5 1.5707963267948966192313216916398
-
-#ifndef HAVE_LOG2F
-#define log2f(x) (logf(x)/(float)M_LN2)
-#endif
-
 int intel_avc_enc_slice_type_fixup(int slice_type)
 {
     if (slice_type == SLICE_TYPE_SP ||
@@ -104,7 +82,6 @@ intel_mfc_bit_rate_control_context_init(struct encode_state *encode_state,
     mfc_context->bit_rate_control_context[SLICE_TYPE_B].target_frame_size = inter_mb_size * width_in_mbs * height_in_mbs;
 
     for(i = 0 ; i < 3; i++) {
-        mfc_context->bit_rate_control_context[i].QpPrimeY = 26;
         mfc_context->bit_rate_control_context[i].MaxQpNegModifier = 6;
         mfc_context->bit_rate_control_context[i].MaxQpPosModifier = 6;
         mfc_context->bit_rate_control_context[i].GrowInit = 6;
@@ -129,207 +106,68 @@ intel_mfc_bit_rate_control_context_init(struct encode_state *encode_state,
     mfc_context->bit_rate_control_context[SLICE_TYPE_B].MaxSizeInWord = mfc_context->bit_rate_control_context[SLICE_TYPE_B].TargetSizeInWord * 1.5;
 }
 
-static void intel_mfc_brc_init(struct encode_state *encode_state,
-                               struct intel_encoder_context* encoder_context)
+static void
+intel_mfc_brc_params(struct encode_state *encode_state,
+                     struct intel_encoder_context *encoder_context,
+                     struct i965_brc_params *params)
 {
-    struct gen6_mfc_context *mfc_context = encoder_context->mfc_context;
     VAEncSequenceParameterBufferH264 *pSequenceParameter = (VAEncSequenceParameterBufferH264 *)encode_state->seq_param_ext->buffer;
-    VAEncMiscParameterBuffer* pMiscParamHRD = (VAEncMiscParameterBuffer*)encode_state->misc_param[VAEncMiscParameterTypeHRD]->buffer;
-    VAEncMiscParameterHRD* pParameterHRD = (VAEncMiscParameterHRD*)pMiscParamHRD->data;
-    double bitrate = pSequenceParameter->bits_per_second;
-    double framerate = (double)pSequenceParameter->time_scale /(2 * (double)pSequenceParameter->num_units_in_tick);
-    int inum = 1, pnum = 0, bnum = 0; /* Gop structure: number of I, P, B frames in the Gop. */
-    int intra_period = pSequenceParameter->intra_period;
-    int ip_period = pSequenceParameter->ip_period;
-    double qp1_size = 0.1 * 8 * 3 * (pSequenceParameter->picture_width_in_mbs<<4) * (pSequenceParameter->picture_height_in_mbs<<4)/2;
-    double qp51_size = 0.001 * 8 * 3 * (pSequenceParameter->picture_width_in_mbs<<4) * (pSequenceParameter->picture_height_in_mbs<<4)/2;
-    double bpf;
-
-    if (pSequenceParameter->ip_period) {
-        pnum = (intra_period + ip_period - 1)/ip_period - 1;
-        bnum = intra_period - inum - pnum;
-    }
-
-    mfc_context->brc.mode = encoder_context->rate_control_mode;
-
-    mfc_context->brc.target_frame_size[SLICE_TYPE_I] = (int)((double)((bitrate * intra_period)/framerate) /
-                                                             (double)(inum + BRC_PWEIGHT * pnum + BRC_BWEIGHT * bnum));
-    mfc_context->brc.target_frame_size[SLICE_TYPE_P] = BRC_PWEIGHT * mfc_context->brc.target_frame_size[SLICE_TYPE_I];
-    mfc_context->brc.target_frame_size[SLICE_TYPE_B] = BRC_BWEIGHT * mfc_context->brc.target_frame_size[SLICE_TYPE_I];
-
-    mfc_context->brc.gop_nums[SLICE_TYPE_I] = inum;
-    mfc_context->brc.gop_nums[SLICE_TYPE_P] = pnum;
-    mfc_context->brc.gop_nums[SLICE_TYPE_B] = bnum;
 
-    bpf = mfc_context->brc.bits_per_frame = bitrate/framerate;
-
-    mfc_context->hrd.buffer_size = (double)pParameterHRD->buffer_size;
-    mfc_context->hrd.current_buffer_fullness =
-        (double)(pParameterHRD->initial_buffer_fullness < mfc_context->hrd.buffer_size)?
-        pParameterHRD->initial_buffer_fullness: mfc_context->hrd.buffer_size/2.;
-    mfc_context->hrd.target_buffer_fullness = (double)mfc_context->hrd.buffer_size/2.;
-    mfc_context->hrd.buffer_capacity = (double)mfc_context->hrd.buffer_size/qp1_size;
-    mfc_context->hrd.violation_noted = 0;
-
-    if ((bpf > qp51_size) && (bpf < qp1_size)) {
-        mfc_context->bit_rate_control_context[SLICE_TYPE_P].QpPrimeY = 51 - 50*(bpf - qp51_size)/(qp1_size - qp51_size);
+    memset(params, 0, sizeof(*params));
+    params->mode = encoder_context->rate_control_mode;
+    params->bits_per_second = pSequenceParameter->bits_per_second;
+    params->frame_rate = (double)pSequenceParameter->time_scale / (2 * (double)pSequenceParameter->num_units_in_tick);
+    params->intra_period = pSequenceParameter->intra_period;
+    params->ip_period = pSequenceParameter->ip_period;
+    params->idr_period = pSequenceParameter->intra_idr_period;
+    params->width_in_mbs = pSequenceParameter->picture_width_in_mbs;
+    params->height_in_mbs = pSequenceParameter->picture_height_in_mbs;
+
+    /*
+     * VBR: the rate control parameters give the peak rate, the average
+     * rate as a percentage of it and the window it is averaged over
+     */
+    if (params->mode == VA_RC_VBR &&
+        encode_state->misc_param[VAEncMiscParameterTypeRateControl]) {
+        VAEncMiscParameterBuffer *pMiscParamRC = (VAEncMiscParameterBuffer *)encode_state->misc_param[VAEncMiscParameterTypeRateControl]->buffer;
+        VAEncMiscParameterRateControl *pParameterRC = (VAEncMiscParameterRateControl *)pMiscParamRC->data;
+        double window_frames;
+
+        if (pParameterRC->bits_per_second)
+            params->max_bits_per_second = pParameterRC->bits_per_second;
+        else
+            params->max_bits_per_second = params->bits_per_second;
+
+        if (pParameterRC->target_percentage > 0 && pParameterRC->target_percentage <= 100)
+            params->bits_per_second = params->max_bits_per_second * pParameterRC->target_percentage / 100.;
+
+        window_frames = pParameterRC->window_size * params->frame_rate / 1000.;
+        if (window_frames > I965_BRC_MAX_WINDOW)
+            window_frames = I965_BRC_MAX_WINDOW;
+        params->window_frames = (unsigned int)window_frames;
     }
-    else if (bpf >= qp1_size)
-        mfc_context->bit_rate_control_context[SLICE_TYPE_P].QpPrimeY = 1;
-    else if (bpf <= qp51_size)
-        mfc_context->bit_rate_control_context[SLICE_TYPE_P].QpPrimeY = 51;
-
-    mfc_context->bit_rate_control_context[SLICE_TYPE_I].QpPrimeY = mfc_context->bit_rate_control_context[SLICE_TYPE_P].QpPrimeY;
-    mfc_context->bit_rate_control_context[SLICE_TYPE_B].QpPrimeY = mfc_context->bit_rate_control_context[SLICE_TYPE_I].QpPrimeY;
 
-    BRC_CLIP(mfc_context->bit_rate_control_context[SLICE_TYPE_I].QpPrimeY, 1, 51);
-    BRC_CLIP(mfc_context->bit_rate_control_context[SLICE_TYPE_P].QpPrimeY, 1, 51);
-    BRC_CLIP(mfc_context->bit_rate_control_context[SLICE_TYPE_B].QpPrimeY, 1, 51);
-}
-
-int intel_mfc_update_hrd(struct encode_state *encode_state,
-                         struct gen6_mfc_context *mfc_context,
-                         int frame_bits)
-{
-    double prev_bf = mfc_context->hrd.current_buffer_fullness;
+    /* the average rate of a VBR stream is kept over a second by default */
+    if (params->mode == VA_RC_VBR && !params->window_frames)
+        params->window_frames = MIN((unsigned int)(params->frame_rate + 0.5), I965_BRC_MAX_WINDOW);
 
-    mfc_context->hrd.current_buffer_fullness -= frame_bits;
+    if (encode_state->misc_param[VAEncMiscParameterTypeHRD]) {
+        VAEncMiscParameterBuffer *pMiscParamHRD = (VAEncMiscParameterBuffer *)encode_state->misc_param[VAEncMiscParameterTypeHRD]->buffer;
+        VAEncMiscParameterHRD *pParameterHRD = (VAEncMiscParameterHRD *)pMiscParamHRD->data;
 
-    if (mfc_context->hrd.buffer_size > 0 && mfc_context->hrd.current_buffer_fullness <= 0.) {
-        mfc_context->hrd.current_buffer_fullness = prev_bf;
-        return BRC_UNDERFLOW;
+        params->buffer_size = pParameterHRD->buffer_size;
+        params->initial_buffer_fullness = pParameterHRD->initial_buffer_fullness;
     }
-    
-    mfc_context->hrd.current_buffer_fullness += mfc_context->brc.bits_per_frame;
-    if (mfc_context->hrd.buffer_size > 0 && mfc_context->hrd.current_buffer_fullness > mfc_context->hrd.buffer_size) {
-        if (mfc_context->brc.mode == VA_RC_VBR)
-            mfc_context->hrd.current_buffer_fullness = mfc_context->hrd.buffer_size;
-        else {
-            mfc_context->hrd.current_buffer_fullness = prev_bf;
-            return BRC_OVERFLOW;
-        }
-    }
-    return BRC_NO_HRD_VIOLATION;
 }
 
 int intel_mfc_brc_postpack(struct encode_state *encode_state,
                            struct gen6_mfc_context *mfc_context,
                            int frame_bits)
 {
-    gen6_brc_status sts = BRC_NO_HRD_VIOLATION;
     VAEncSliceParameterBufferH264 *pSliceParameter = (VAEncSliceParameterBufferH264 *)encode_state->slice_params_ext[0]->buffer; 
     int slicetype = intel_avc_enc_slice_type_fixup(pSliceParameter->slice_type);
-    int qpi = mfc_context->bit_rate_control_context[SLICE_TYPE_I].QpPrimeY;
-    int qpp = mfc_context->bit_rate_control_context[SLICE_TYPE_P].QpPrimeY;
-    int qpb = mfc_context->bit_rate_control_context[SLICE_TYPE_B].QpPrimeY;
-    int qp; // quantizer of previously encoded slice of current type
-    int qpn; // predicted quantizer for next frame of current type in integer format
-    double qpf; // predicted quantizer for next frame of current type in float format
-    double delta_qp; // QP correction
-    int target_frame_size, frame_size_next;
-    /* Notes:
-     *  x - how far we are from HRD buffer borders
-     *  y - how far we are from target HRD buffer fullness
-     */
-    double x, y;
-    double frame_size_alpha;
-
-    qp = mfc_context->bit_rate_control_context[slicetype].QpPrimeY;
-
-    target_frame_size = mfc_context->brc.target_frame_size[slicetype];
-    if (mfc_context->hrd.buffer_capacity < 5)
-        frame_size_alpha = 0;
-    else
-        frame_size_alpha = (double)mfc_context->brc.gop_nums[slicetype];
-    if (frame_size_alpha > 30) frame_size_alpha = 30;
-    frame_size_next = target_frame_size + (double)(target_frame_size - frame_bits) /
-        (double)(frame_size_alpha + 1.);
-
-    /* frame_size_next: avoiding negative number and too small value */
-    if ((double)frame_size_next < (double)(target_frame_size * 0.25))
-        frame_size_next = (int)((double)target_frame_size * 0.25);
-
-    qpf = (double)qp * target_frame_size / frame_size_next;
-    qpn = (int)(qpf + 0.5);
-
-    if (qpn == qp) {
-        /* setting qpn we round qpf making mistakes: now we are trying to compensate this */
-        mfc_context->brc.qpf_rounding_accumulator += qpf - qpn;
-        if (mfc_context->brc.qpf_rounding_accumulator > 1.0) {
-            qpn++;
-            mfc_context->brc.qpf_rounding_accumulator = 0.;
-        } else if (mfc_context->brc.qpf_rounding_accumulator < -1.0) {
-            qpn--;
-            mfc_context->brc.qpf_rounding_accumulator = 0.;
-        }
-    }
-    /* making sure that QP is not changing too fast */
-    if ((qpn - qp) > BRC_QP_MAX_CHANGE) qpn = qp + BRC_QP_MAX_CHANGE;
-    else if ((qpn - qp) < -BRC_QP_MAX_CHANGE) qpn = qp - BRC_QP_MAX_CHANGE;
-    /* making sure that with QP predictions we did do not leave QPs range */
-    BRC_CLIP(qpn, 1, 51);
-
-    /* checking wthether HRD compliance is still met */
-    sts = intel_mfc_update_hrd(encode_state, mfc_context, frame_bits);
-
-    /* calculating QP delta as some function*/
-    x = mfc_context->hrd.target_buffer_fullness - mfc_context->hrd.current_buffer_fullness;
-    if (x > 0) {
-        x /= mfc_context->hrd.target_buffer_fullness;
-        y = mfc_context->hrd.current_buffer_fullness;
-    }
-    else {
-        x /= (mfc_context->hrd.buffer_size - mfc_context->hrd.target_buffer_fullness);
-        y = mfc_context->hrd.buffer_size - mfc_context->hrd.current_buffer_fullness;
-    }
-    if (y < 0.01) y = 0.01;
-    if (x > 1) x = 1;
-    else if (x < -1) x = -1;
-
-    delta_qp = BRC_QP_MAX_CHANGE*exp(-1/y)*sin(BRC_PI_0_5 * x);
-    qpn = (int)(qpn + delta_qp + 0.5);
-
-    /* making sure that with QP predictions we did do not leave QPs range */
-    BRC_CLIP(qpn, 1, 51);
-
-    if (sts == BRC_NO_HRD_VIOLATION) { // no HRD violation
-        /* correcting QPs of slices of other types */
-        if (slicetype == SLICE_TYPE_P) {
-            if (abs(qpn + BRC_P_B_QP_DIFF - qpb) > 2)
-                mfc_context->bit_rate_control_context[SLICE_TYPE_B].QpPrimeY += (qpn + BRC_P_B_QP_DIFF - qpb) >> 1;
-            if (abs(qpn - BRC_I_P_QP_DIFF - qpi) > 2)
-                mfc_context->bit_rate_control_context[SLICE_TYPE_I].QpPrimeY += (qpn - BRC_I_P_QP_DIFF - qpi) >> 1;
-        } else if (slicetype == SLICE_TYPE_I) {
-            if (abs(qpn + BRC_I_B_QP_DIFF - qpb) > 4)
-                mfc_context->bit_rate_control_context[SLICE_TYPE_B].QpPrimeY += (qpn + BRC_I_B_QP_DIFF - qpb) >> 2;
-            if (abs(qpn + BRC_I_P_QP_DIFF - qpp) > 2)
-                mfc_context->bit_rate_control_context[SLICE_TYPE_P].QpPrimeY += (qpn + BRC_I_P_QP_DIFF - qpp) >> 2;
-        } else { // SLICE_TYPE_B
-            if (abs(qpn - BRC_P_B_QP_DIFF - qpp) > 2)
-                mfc_context->bit_rate_control_context[SLICE_TYPE_P].QpPrimeY += (qpn - BRC_P_B_QP_DIFF - qpp) >> 1;
-            if (abs(qpn - BRC_I_B_QP_DIFF - qpi) > 4)
-                mfc_context->bit_rate_control_context[SLICE_TYPE_I].QpPrimeY += (qpn - BRC_I_B_QP_DIFF - qpi) >> 2;
-        }
-        BRC_CLIP(mfc_context->bit_rate_control_context[SLICE_TYPE_I].QpPrimeY, 1, 51);
-        BRC_CLIP(mfc_context->bit_rate_control_context[SLICE_TYPE_P].QpPrimeY, 1, 51);
-        BRC_CLIP(mfc_context->bit_rate_control_context[SLICE_TYPE_B].QpPrimeY, 1, 51);
-    } else if (sts == BRC_UNDERFLOW) { // underflow
-        if (qpn <= qp) qpn = qp + 1;
-        if (qpn > 51) {
-            qpn = 51;
-            sts = BRC_UNDERFLOW_WITH_MAX_QP; //underflow with maxQP
-        }
-    } else if (sts == BRC_OVERFLOW) {
-        if (qpn >= qp) qpn = qp - 1;
-        if (qpn < 1) { // < 0 (?) overflow with minQP
-            qpn = 1;
-            sts = BRC_OVERFLOW_WITH_MIN_QP; // bit stuffing to be done
-        }
-    }
 
-    mfc_context->bit_rate_control_context[slicetype].QpPrimeY = qpn;
-
-    return sts;
+    return i965_brc_postpack(&mfc_context->brc, slicetype, frame_bits);
 }
 
 static void intel_mfc_hrd_context_init(struct encode_state *encode_state,
@@ -385,47 +223,200 @@ int intel_mfc_interlace_check(VADriverContextP ctx,
 }
 
 /*
- * Check whether the parameters related with CBR are updated and decide whether
- * it needs to reinitialize the configuration related with CBR.
- * Currently it will check the following parameters:
- *      bits_per_second
- *      frame_rate
- *      gop_configuration(intra_period, ip_period, intra_idr_period)
+ * Build the QP offset of each MB from the rectangles and the map of the
+ * I965_ENC_MISC_PARAMETER_TYPE_QP_MAP parameter
  */
-static bool intel_mfc_brc_updated_check(struct encode_state *encode_state,
-                           struct intel_encoder_context *encoder_context)
+void
+intel_mfc_avc_qp_map_prepare(VADriverContextP ctx,
+                             struct encode_state *encode_state,
+                             struct intel_encoder_context *encoder_context)
 {
-    unsigned int rate_control_mode = encoder_context->rate_control_mode;
     struct gen6_mfc_context *mfc_context = encoder_context->mfc_context;
-    double cur_fps, cur_bitrate;
-    VAEncSequenceParameterBufferH264 *pSequenceParameter;
+    VAEncSequenceParameterBufferH264 *pSequenceParameter = (VAEncSequenceParameterBufferH264 *)encode_state->seq_param_ext->buffer;
+    int width_in_mbs = pSequenceParameter->picture_width_in_mbs;
+    int height_in_mbs = pSequenceParameter->picture_height_in_mbs;
+    int num_mbs = width_in_mbs * height_in_mbs;
+    VAEncMiscParameterBuffer *param;
+    I965EncMiscParameterQpMap *qp_map;
+    int i, x, y;
+
+    mfc_context->qp_map_enabled = 0;
+
+    if (!encode_state->qp_map_param || !encode_state->qp_map_param->buffer)
+        return;
+
+    param = (VAEncMiscParameterBuffer *)encode_state->qp_map_param->buffer;
+    qp_map = (I965EncMiscParameterQpMap *)param->data;
 
+    if (!qp_map->num_roi && qp_map->qp_map_size != num_mbs)
+        return;
 
-    if (rate_control_mode != VA_RC_CBR) {
-        return false;
+    if (mfc_context->mb_qp_delta_size < num_mbs) {
+        free(mfc_context->mb_qp_delta);
+        mfc_context->mb_qp_delta = malloc(num_mbs);
+        mfc_context->mb_qp_delta_size = mfc_context->mb_qp_delta ? num_mbs : 0;
+
+        if (!mfc_context->mb_qp_delta)
+            return;
     }
 
-    pSequenceParameter = (VAEncSequenceParameterBufferH264 *)encode_state->seq_param_ext->buffer;
+    if (qp_map->qp_map_size == num_mbs)
+        memcpy(mfc_context->mb_qp_delta, qp_map->qp_map, num_mbs);
+    else
+        memset(mfc_context->mb_qp_delta, 0, num_mbs);
 
-    cur_bitrate = pSequenceParameter->bits_per_second;
-    cur_fps = (double)pSequenceParameter->time_scale /
-                (2 * (double)pSequenceParameter->num_units_in_tick);
+    for (i = 0; i < qp_map->num_roi; i++) {
+        VARectangle *roi = &qp_map->roi[i];
+        int x0 = MAX(roi->x, 0) / 16, y0 = MAX(roi->y, 0) / 16;
+        int x1 = MIN((roi->x + roi->width + 15) / 16, width_in_mbs);
+        int y1 = MIN((roi->y + roi->height + 15) / 16, height_in_mbs);
 
-    if ((cur_bitrate == mfc_context->brc.saved_bps) &&
-        (cur_fps == mfc_context->brc.saved_fps) &&
-        (pSequenceParameter->intra_period == mfc_context->brc.saved_intra_period) &&
-        (pSequenceParameter->intra_idr_period == mfc_context->brc.saved_idr_period) &&
-        (pSequenceParameter->intra_period == mfc_context->brc.saved_intra_period)) {
-        /* the parameters related with CBR are not updaetd */
-        return false;
+        for (y = y0; y < y1; y++) {
+            for (x = x0; x < x1; x++)
+                mfc_context->mb_qp_delta[y * width_in_mbs + x] = qp_map->roi_qp_delta[i];
+        }
     }
 
-    mfc_context->brc.saved_ip_period = pSequenceParameter->ip_period;
-    mfc_context->brc.saved_intra_period = pSequenceParameter->intra_period;
-    mfc_context->brc.saved_idr_period = pSequenceParameter->intra_idr_period;
-    mfc_context->brc.saved_fps = cur_fps;
-    mfc_context->brc.saved_bps = cur_bitrate;
-    return true;
+    mfc_context->qp_map_enabled = 1;
+}
+
+/*
+ * Let the rate control pick a QP offset for each MB row from the VME
+ * distortions, so that a CBR frame fits in the HRD buffer without another
+ * PAK pass. Only the software PAK paths, which write the QP of each MB
+ * into the PAK objects, make use of the offsets. The cost of a MB with an
+ * offset from the QP map is scaled by the size change the offset brings.
+ */
+void
+intel_mfc_avc_row_qp_prepare(VADriverContextP ctx,
+                             struct encode_state *encode_state,
+                             struct intel_encoder_context *encoder_context)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct gen6_mfc_context *mfc_context = encoder_context->mfc_context;
+    struct gen6_vme_context *vme_context = encoder_context->vme_context;
+    VAEncSliceParameterBufferH264 *pSliceParameter = (VAEncSliceParameterBufferH264 *)encode_state->slice_params_ext[0]->buffer;
+    int slice_type = intel_avc_enc_slice_type_fixup(pSliceParameter->slice_type);
+    int width_in_mbs = (mfc_context->surface_state.width + 15) / 16;
+    int height_in_mbs = (mfc_context->surface_state.height + 15) / 16;
+    unsigned int row_cost[MAX_MFC_MB_ROWS];
+    unsigned char *msg_ptr;
+    int x, y;
+
+    mfc_context->row_qp_enabled = 0;
+
+    if (!MFC_BRC_ENABLED(encoder_context->rate_control_mode) ||
+        !i965->brc_row_qp ||
+        height_in_mbs > MAX_MFC_MB_ROWS ||
+        !vme_context->vme_output.bo)
+        return;
+
+    dri_bo_map(vme_context->vme_output.bo, 0);
+    msg_ptr = (unsigned char *)vme_context->vme_output.bo->virtual;
+
+    for (y = 0; y < height_in_mbs; y++) {
+        double row = 0.;
+
+        for (x = 0; x < width_in_mbs; x++) {
+            unsigned int *msg = (unsigned int *)(msg_ptr + (y * width_in_mbs + x) * vme_context->vme_output.size_block);
+            unsigned int cost = msg[AVC_INTRA_RDO_OFFSET] & AVC_RDO_MASK;
+
+            if (slice_type != SLICE_TYPE_I)
+                cost = MIN(cost, msg[AVC_INTER_RDO_OFFSET] & AVC_RDO_MASK);
+
+            if (mfc_context->qp_map_enabled)
+                row += cost * exp2(-mfc_context->mb_qp_delta[y * width_in_mbs + x] / 6.);
+            else
+                row += cost;
+        }
+
+        row_cost[y] = (unsigned int)(row + 0.5);
+    }
+
+    dri_bo_unmap(vme_context->vme_output.bo);
+
+    i965_brc_row_qp(&mfc_context->brc, slice_type, row_cost, height_in_mbs, mfc_context->row_qp_delta);
+    mfc_context->row_qp_enabled = 1;
+}
+
+/*
+ * Look for a scene change in the VME distortions of the frame before its
+ * first PAK pass, so that the rate control can budget a cut as an I frame.
+ * The decisions are returned to the application in the status of the
+ * coded buffer segment.
+ */
+void
+intel_mfc_avc_scene_analyze(VADriverContextP ctx,
+                            struct encode_state *encode_state,
+                            struct intel_encoder_context *encoder_context)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct gen6_mfc_context *mfc_context = encoder_context->mfc_context;
+    struct gen6_vme_context *vme_context = encoder_context->vme_context;
+    VAEncSequenceParameterBufferH264 *pSequenceParameter = (VAEncSequenceParameterBufferH264 *)encode_state->seq_param_ext->buffer;
+    VAEncSliceParameterBufferH264 *pSliceParameter = (VAEncSliceParameterBufferH264 *)encode_state->slice_params_ext[0]->buffer;
+    int slice_type = intel_avc_enc_slice_type_fixup(pSliceParameter->slice_type);
+    struct i965_scene_detector *detector = &mfc_context->scene_detector;
+    struct i965_scene_stats stats;
+    unsigned char *msg_ptr;
+    int i;
+
+    mfc_context->scene_status = 0;
+
+    if (!i965->scene_change || !vme_context->vme_output.bo)
+        return;
+
+    memset(&stats, 0, sizeof(stats));
+
+    if (slice_type != SLICE_TYPE_I) {
+        stats.num_mbs = pSequenceParameter->picture_width_in_mbs * pSequenceParameter->picture_height_in_mbs;
+
+        dri_bo_map(vme_context->vme_output.bo, 0);
+        msg_ptr = (unsigned char *)vme_context->vme_output.bo->virtual;
+
+        for (i = 0; i < stats.num_mbs; i++) {
+            unsigned int *msg = (unsigned int *)(msg_ptr + i * vme_context->vme_output.size_block);
+            unsigned int intra = msg[AVC_INTRA_RDO_OFFSET] & AVC_RDO_MASK;
+            unsigned int inter = msg[AVC_INTER_RDO_OFFSET] & AVC_RDO_MASK;
+
+            stats.intra_cost += intra;
+            stats.inter_cost += inter;
+
+            if (intra < inter)
+                stats.num_intra_mbs++;
+        }
+
+        dri_bo_unmap(vme_context->vme_output.bo);
+    }
+
+    if (i965_scene_detector_update(detector, slice_type, &stats)) {
+        mfc_context->scene_status |= I965_CODED_BUF_STATUS_SCENE_CHANGE;
+
+        if (MFC_BRC_ENABLED(encoder_context->rate_control_mode))
+            i965_brc_scene_change(&mfc_context->brc);
+    }
+
+    mfc_context->scene_status |= detector->num_b_frames << I965_CODED_BUF_STATUS_B_FRAMES_SHIFT;
+}
+
+void
+intel_mfc_brc_terminate(struct gen6_mfc_context *mfc_context)
+{
+    struct i965_brc *brc = &mfc_context->brc;
+
+    if (!(g_intel_debug_option_flags & VA_INTEL_DEBUG_OPTION_STATS) ||
+        !brc->stats.num_frames)
+        return;
+
+    fprintf(stderr,
+            "brc: %u frames, %u re-encodes, %u HRD violations, %u with row QP, "
+            "%u scene changes, passes %u/%u/%u/%u, %.0f bits/frame (target %.0f)\n",
+            brc->stats.num_frames, brc->stats.num_reencodes,
+            brc->stats.num_violations, brc->stats.num_row_qp_frames,
+            brc->stats.num_scene_changes,
+            brc->stats.passes[0], brc->stats.passes[1],
+            brc->stats.passes[2], brc->stats.passes[3],
+            brc->stats.total_bits / brc->stats.num_frames, brc->target_bits_per_frame);
 }
 
 void intel_mfc_brc_prepare(struct encode_state *encode_state,
@@ -434,17 +425,23 @@ void intel_mfc_brc_prepare(struct encode_state *encode_state,
     unsigned int rate_control_mode = encoder_context->rate_control_mode;
     struct gen6_mfc_context *mfc_context = encoder_context->mfc_context;
 
-    if (rate_control_mode == VA_RC_CBR) {
+    if (MFC_BRC_ENABLED(rate_control_mode)) {
+        struct i965_brc_params params;
         bool brc_updated;
         assert(encoder_context->codec != CODEC_MPEG2);
 
-        brc_updated = intel_mfc_brc_updated_check(encode_state, encoder_context);
+        /*
+         * Reinitialize the rate control when the parameters related with
+         * CBR/VBR (bits_per_second, frame rate and GOP structure) change
+         */
+        intel_mfc_brc_params(encode_state, encoder_context, &params);
+        brc_updated = i965_brc_params_changed(&mfc_context->brc, &params);
 
         /*Programing bit rate control */
         if ((mfc_context->bit_rate_control_context[SLICE_TYPE_I].MaxSizeInWord == 0) ||
              brc_updated) {
             intel_mfc_bit_rate_control_context_init(encode_state, mfc_context);
-            intel_mfc_brc_init(encode_state, encoder_context);
+            i965_brc_init(&mfc_context->brc, &params);
         }
 
         /*Programing HRD control */
@@ -750,192 +747,49 @@ VAStatus intel_mfc_avc_prepare(VADriverContextP ctx,
     coded_buffer_segment = (struct i965_coded_buffer_segment *)bo->virtual;
     coded_buffer_segment->mapped = 0;
     coded_buffer_segment->codec = encoder_context->codec;
+    coded_buffer_segment->coded_size = I965_CODED_SIZE_UNKNOWN;
+    coded_buffer_segment->status = mfc_context->scene_status;
+    coded_buffer_segment->num_slices = encode_state->num_slice_params_ext;
+    memset(coded_buffer_segment->slice_end, 0xff, sizeof(coded_buffer_segment->slice_end));
     dri_bo_unmap(bo);
 
     return vaStatus;
 }
-/*
- * The LUT uses the pair of 4-bit units: (shift, base) structure.
- * 2^K * X = value . 
- * So it is necessary to convert one cost into the nearest LUT format.
- * The derivation is:
- * 2^K *x = 2^n * (1 + deltaX)
- *    k + log2(x) = n + log2(1 + deltaX)
- *    log2(x) = n - k + log2(1 + deltaX)
- *    As X is in the range of [1, 15]
- *      4 > n - k + log2(1 + deltaX) >= 0 
- *      =>    n + log2(1 + deltaX)  >= k > n - 4  + log2(1 + deltaX)
- *    Then we can derive the corresponding K and get the nearest LUT format.
- */
-int intel_format_lutvalue(int value, int max)
-{
-    int ret;
-    int logvalue, temp1, temp2;
-
-    if (value <= 0)
-        return 0;
-
-    logvalue = (int)(log2f((float)value));
-    if (logvalue < 4) {
-        ret = value;
-    } else {
-        int error, temp_value, base, j, temp_err;
-        error = value;
-        j = logvalue - 4 + 1;
-        ret = -1;
-        for(; j <= logvalue; j++) {
-            if (j == 0) {
-                base = value >> j;
-            } else {
-                base = (value + (1 << (j - 1)) - 1) >> j;
-            }
-            if (base >= 16)
-                continue;
-
-            temp_value = base << j;
-            temp_err = abs(value - temp_value);
-            if (temp_err < error) {
-                error = temp_err;
-                ret = (j << 4) | base;
-                if (temp_err == 0)
-                    break;
-            }
-        }
-    }
-    temp1 = (ret & 0xf) << ((ret & 0xf0) >> 4);
-    temp2 = (max & 0xf) << ((max & 0xf0) >> 4);
-    if (temp1 > temp2)
-        ret = max;
-    return ret;
-	
-}
-
 
-#define		QP_MAX			52
-
-
-static float intel_lambda_qp(int qp)
+static int
+intel_vme_avc_qp(struct encode_state *encode_state,
+                 struct intel_encoder_context *encoder_context)
 {
-    float value, lambdaf;
-    value = qp;
-    value = value / 6 - 2;
-    if (value < 0)
-        value = 0;
-    lambdaf = roundf(powf(2, value));
-    return lambdaf;
-}
+    struct gen6_mfc_context *mfc_context = encoder_context->mfc_context;
+    VAEncPictureParameterBufferH264 *pic_param = (VAEncPictureParameterBufferH264 *)encode_state->pic_param_ext->buffer;
+    VAEncSliceParameterBufferH264 *slice_param = (VAEncSliceParameterBufferH264 *)encode_state->slice_params_ext[0]->buffer;
+    int slice_type = intel_avc_enc_slice_type_fixup(slice_param->slice_type);
 
+    if (encoder_context->rate_control_mode == VA_RC_CQP)
+	return pic_param->pic_init_qp + slice_param->slice_qp_delta;
+    else
+	return i965_brc_get_qp(&mfc_context->brc, slice_type);
+}
 
 void intel_vme_update_mbmv_cost(VADriverContextP ctx,
                                 struct encode_state *encode_state,
                                 struct intel_encoder_context *encoder_context)
 {
-    struct gen6_mfc_context *mfc_context = encoder_context->mfc_context;
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
     struct gen6_vme_context *vme_context = encoder_context->vme_context;
-    VAEncPictureParameterBufferH264 *pic_param = (VAEncPictureParameterBufferH264 *)encode_state->pic_param_ext->buffer;
     VAEncSliceParameterBufferH264 *slice_param = (VAEncSliceParameterBufferH264 *)encode_state->slice_params_ext[0]->buffer;
-    int qp, m_cost, j, mv_count;
+    int qp;
     uint8_t *vme_state_message = (uint8_t *)(vme_context->vme_state_message);
-    float   lambda, m_costf;
 
     int slice_type = intel_avc_enc_slice_type_fixup(slice_param->slice_type);
 
-    
-    if (encoder_context->rate_control_mode == VA_RC_CQP)
-	qp = pic_param->pic_init_qp + slice_param->slice_qp_delta;
-    else
-	qp = mfc_context->bit_rate_control_context[slice_type].QpPrimeY;
+    qp = intel_vme_avc_qp(encode_state, encoder_context);
   
     if (vme_state_message == NULL)
 	return;
  
-    assert(qp <= QP_MAX); 
-    lambda = intel_lambda_qp(qp);
-    if (slice_type == SLICE_TYPE_I) {
-	vme_state_message[MODE_INTRA_16X16] = 0;
-	m_cost = lambda * 4;
-	vme_state_message[MODE_INTRA_8X8] = intel_format_lutvalue(m_cost, 0x8f);
-	m_cost = lambda * 16; 
-	vme_state_message[MODE_INTRA_4X4] = intel_format_lutvalue(m_cost, 0x8f);
-	m_cost = lambda * 3;
-	vme_state_message[MODE_INTRA_NONPRED] = intel_format_lutvalue(m_cost, 0x6f);
-    } else {
-    	m_cost = 0;
-	vme_state_message[MODE_INTER_MV0] = intel_format_lutvalue(m_cost, 0x6f);
-	for (j = 1; j < 3; j++) {
-            m_costf = (log2f((float)(j + 1)) + 1.718f) * lambda;
-            m_cost = (int)m_costf;
-            vme_state_message[MODE_INTER_MV0 + j] = intel_format_lutvalue(m_cost, 0x6f);
-   	}
-    	mv_count = 3;
-    	for (j = 4; j <= 64; j *= 2) {
-            m_costf = (log2f((float)(j + 1)) + 1.718f) * lambda;
-            m_cost = (int)m_costf;
-            vme_state_message[MODE_INTER_MV0 + mv_count] = intel_format_lutvalue(m_cost, 0x6f);
-            mv_count++;
-	}
-
-	if (qp <= 25) {
-            vme_state_message[MODE_INTRA_16X16] = 0x4a;
-            vme_state_message[MODE_INTRA_8X8] = 0x4a;
-            vme_state_message[MODE_INTRA_4X4] = 0x4a;
-            vme_state_message[MODE_INTRA_NONPRED] = 0x4a;
-            vme_state_message[MODE_INTER_16X16] = 0x4a;
-            vme_state_message[MODE_INTER_16X8] = 0x4a;
-            vme_state_message[MODE_INTER_8X8] = 0x4a;
-            vme_state_message[MODE_INTER_8X4] = 0x4a;
-            vme_state_message[MODE_INTER_4X4] = 0x4a;
-            vme_state_message[MODE_INTER_BWD] = 0x2a;
-            return;
-	}
-	m_costf = lambda * 10;
-	vme_state_message[MODE_INTRA_16X16] = intel_format_lutvalue(m_cost, 0x8f);
-	m_cost = lambda * 14;
-	vme_state_message[MODE_INTRA_8X8] = intel_format_lutvalue(m_cost, 0x8f);
-	m_cost = lambda * 24; 
-	vme_state_message[MODE_INTRA_4X4] = intel_format_lutvalue(m_cost, 0x8f);
-	m_costf = lambda * 3.5;
-	m_cost = m_costf;
-	vme_state_message[MODE_INTRA_NONPRED] = intel_format_lutvalue(m_cost, 0x6f);
-    	if (slice_type == SLICE_TYPE_P) {
-            m_costf = lambda * 2.5;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_16X16] = intel_format_lutvalue(m_cost, 0x8f);
-            m_costf = lambda * 4;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_16X8] = intel_format_lutvalue(m_cost, 0x8f);
-            m_costf = lambda * 1.5;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_8X8] = intel_format_lutvalue(m_cost, 0x6f);
-            m_costf = lambda * 3;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_8X4] = intel_format_lutvalue(m_cost, 0x6f);
-            m_costf = lambda * 5;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_4X4] = intel_format_lutvalue(m_cost, 0x6f);
-            /* BWD is not used in P-frame */
-            vme_state_message[MODE_INTER_BWD] = 0;
-	} else {
-            m_costf = lambda * 2.5;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_16X16] = intel_format_lutvalue(m_cost, 0x8f);
-            m_costf = lambda * 5.5;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_16X8] = intel_format_lutvalue(m_cost, 0x8f);
-            m_costf = lambda * 3.5;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_8X8] = intel_format_lutvalue(m_cost, 0x6f);
-            m_costf = lambda * 5.0;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_8X4] = intel_format_lutvalue(m_cost, 0x6f);
-            m_costf = lambda * 6.5;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_4X4] = intel_format_lutvalue(m_cost, 0x6f);
-            m_costf = lambda * 1.5;
-            m_cost = m_costf;
-            vme_state_message[MODE_INTER_BWD] = intel_format_lutvalue(m_cost, 0x6f);
-	}
-    }
+    assert(qp >= 0 && qp < I965_VME_COST_QP_NUM);
+    memcpy(vme_state_message, i965->vme_cost_table.avc[slice_type][qp], I965_VME_COST_NUM);
 }
 
 
@@ -1126,87 +980,60 @@ intel_mfc_avc_ref_idx_state(VADriverContextP ctx,
                             struct encode_state *encode_state,
                             struct intel_encoder_context *encoder_context)
 {
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
     struct gen6_vme_context *vme_context = encoder_context->vme_context;
     struct intel_batchbuffer *batch = encoder_context->base.batch;
     int slice_type;
     struct object_surface *obj_surface;
-    unsigned int fref_entry, bref_entry;
-    int frame_index, i;
+    unsigned char ref_entry[2][32];
+    int num_lists, list_index, frame_index, i, j;
     VAEncSliceParameterBufferH264 *slice_param = (VAEncSliceParameterBufferH264 *)encode_state->slice_params_ext[0]->buffer;
 
-    fref_entry = 0x80808080;
-    bref_entry = 0x80808080;
+    memset(ref_entry, 0x80, sizeof(ref_entry));
     slice_type = intel_avc_enc_slice_type_fixup(slice_param->slice_type);
 
-    if (slice_type == SLICE_TYPE_P || slice_type == SLICE_TYPE_B) {
-        int ref_idx_l0 = (vme_context->ref_index_in_mb[0] & 0xff);
-
-        if (ref_idx_l0 > 3) {
-            WARN_ONCE("ref_idx_l0 is out of range\n");
-            ref_idx_l0 = 0;
-        }
-
-        obj_surface = vme_context->used_reference_objects[0];
-        frame_index = -1;
-        for (i = 0; i < 16; i++) {
-            if (obj_surface &&
-                obj_surface == encode_state->reference_objects[i]) {
-                frame_index = i;
-                break;
+    if (slice_type == SLICE_TYPE_B)
+        num_lists = 2;
+    else if (slice_type == SLICE_TYPE_P)
+        num_lists = 1;
+    else
+        num_lists = 0;
+
+    /* all the active entries, L1[0] is the co-located picture of the direct modes */
+    for (list_index = 0; list_index < num_lists; list_index++) {
+        VAPictureH264 *ref_list = vme_context->ref_list[list_index];
+
+        for (i = 0; i < vme_context->num_ref_list[list_index]; i++) {
+            obj_surface = SURFACE(ref_list[i].picture_id);
+            frame_index = -1;
+            for (j = 0; j < 16; j++) {
+                if (obj_surface &&
+                    obj_surface == encode_state->reference_objects[j]) {
+                    frame_index = j;
+                    break;
+                }
             }
-        }
-        if (frame_index == -1) {
-            WARN_ONCE("RefPicList0 is not found in DPB!\n");
-        } else {
-            int ref_idx_l0_shift = ref_idx_l0 * 8;
-            fref_entry &= ~(0xFF << ref_idx_l0_shift);
-            fref_entry += (intel_get_ref_idx_state_1(vme_context->used_references[0], frame_index) << ref_idx_l0_shift);
-        }
-    }
-
-    if (slice_type == SLICE_TYPE_B) {
-        int ref_idx_l1 = (vme_context->ref_index_in_mb[1] & 0xff);
-
-        if (ref_idx_l1 > 3) {
-            WARN_ONCE("ref_idx_l1 is out of range\n");
-            ref_idx_l1 = 0;
-        }
-
-        obj_surface = vme_context->used_reference_objects[1];
-        frame_index = -1;
-        for (i = 0; i < 16; i++) {
-            if (obj_surface &&
-                obj_surface == encode_state->reference_objects[i]) {
-                frame_index = i;
-                break;
+            if (frame_index == -1) {
+                WARN_ONCE("RefPicList%d is not found in DPB!\n", list_index);
+            } else {
+                ref_entry[list_index][i] = intel_get_ref_idx_state_1(&ref_list[i], frame_index);
             }
         }
-        if (frame_index == -1) {
-            WARN_ONCE("RefPicList1 is not found in DPB!\n");
-        } else {
-            int ref_idx_l1_shift = ref_idx_l1 * 8;
-            bref_entry &= ~(0xFF << ref_idx_l1_shift);
-            bref_entry += (intel_get_ref_idx_state_1(vme_context->used_references[1], frame_index) << ref_idx_l1_shift);
-        }
     }
 
-    BEGIN_BCS_BATCH(batch, 10);
-    OUT_BCS_BATCH(batch, MFX_AVC_REF_IDX_STATE | 8);
-    OUT_BCS_BATCH(batch, 0);                  //Select L0
-    OUT_BCS_BATCH(batch, fref_entry);         //Only 1 reference
-    for(i = 0; i < 7; i++) {
-        OUT_BCS_BATCH(batch, 0x80808080);
-    }
-    ADVANCE_BCS_BATCH(batch);
-
-    BEGIN_BCS_BATCH(batch, 10);
-    OUT_BCS_BATCH(batch, MFX_AVC_REF_IDX_STATE | 8);
-    OUT_BCS_BATCH(batch, 1);                  //Select L1
-    OUT_BCS_BATCH(batch, bref_entry);         //Only 1 reference
-    for(i = 0; i < 7; i++) {
-        OUT_BCS_BATCH(batch, 0x80808080);
+    for (list_index = 0; list_index < 2; list_index++) {
+        BEGIN_BCS_BATCH(batch, 10);
+        OUT_BCS_BATCH(batch, MFX_AVC_REF_IDX_STATE | 8);
+        OUT_BCS_BATCH(batch, list_index);         //Select L0/L1
+        for(i = 0; i < 32; i += 4) {
+            OUT_BCS_BATCH(batch,
+                          ref_entry[list_index][i + 3] << 24 |
+                          ref_entry[list_index][i + 2] << 16 |
+                          ref_entry[list_index][i + 1] << 8 |
+                          ref_entry[list_index][i]);
+        }
+        ADVANCE_BCS_BATCH(batch);
     }
-    ADVANCE_BCS_BATCH(batch);
 }
 
 
@@ -1214,6 +1041,7 @@ void intel_vme_mpeg2_state_setup(VADriverContextP ctx,
                                  struct encode_state *encode_state,
                                  struct intel_encoder_context *encoder_context)
 {
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
     struct gen6_vme_context *vme_context = encoder_context->vme_context;
     uint32_t *vme_state_message = (uint32_t *)(vme_context->vme_state_message);
     VAEncSequenceParameterBufferMPEG2 *seq_param = (VAEncSequenceParameterBufferMPEG2 *)encode_state->seq_param_ext->buffer;
@@ -1241,42 +1069,20 @@ void intel_vme_mpeg2_state_setup(VADriverContextP ctx,
 
     pic_param = (VAEncPictureParameterBufferMPEG2 *)encode_state->pic_param_ext->buffer;
     if (pic_param->picture_type != VAEncPictureTypeIntra) {
-        int qp, m_cost, j, mv_count;
-        float   lambda, m_costf;
+        const uint8_t *cost;
+        int qp, i;
         slice_param = (VAEncSliceParameterBufferMPEG2 *)
             encode_state->slice_params_ext[0]->buffer;
         qp = slice_param->quantiser_scale_code;
-        lambda = intel_lambda_qp(qp);
-        /* No Intra prediction. So it is zero */
-        vme_state_message[MODE_INTRA_8X8] = 0;
-        vme_state_message[MODE_INTRA_4X4] = 0;
-        vme_state_message[MODE_INTER_MV0] = 0;
-        for (j = 1; j < 3; j++) {
-            m_costf = (log2f((float)(j + 1)) + 1.718f) * lambda;
-            m_cost = (int)m_costf;
-            vme_state_message[MODE_INTER_MV0 + j] = intel_format_lutvalue(m_cost, 0x6f);
-        }
-        mv_count = 3;
-        for (j = 4; j <= 64; j *= 2) {
-            m_costf = (log2f((float)(j + 1)) + 1.718f) * lambda;
-            m_cost = (int)m_costf;
-            vme_state_message[MODE_INTER_MV0 + mv_count] =
-                intel_format_lutvalue(m_cost, 0x6f);
-            mv_count++;
-        }
-        m_cost = lambda;
-        /* It can only perform the 16x16 search. So mode cost can be ignored for
-         * the other mode. for example: 16x8/8x8
-         */
-        vme_state_message[MODE_INTRA_16X16] = intel_format_lutvalue(m_cost, 0x8f);
-        vme_state_message[MODE_INTER_16X16] = intel_format_lutvalue(m_cost, 0x8f);
-			
-        vme_state_message[MODE_INTER_16X8] = 0;
-        vme_state_message[MODE_INTER_8X8] = 0;
-        vme_state_message[MODE_INTER_8X4] = 0;
-        vme_state_message[MODE_INTER_4X4] = 0;
-        vme_state_message[MODE_INTER_BWD] = intel_format_lutvalue(m_cost, 0x6f);
+        assert(qp >= 0 && qp < I965_VME_COST_QP_NUM);
+        cost = i965->vme_cost_table.mpeg2[qp];
+
+        /* the MPEG-2 kernels take each cost as a dword */
+        for (i = MODE_INTRA_16X16; i <= MODE_INTER_BWD; i++)
+            vme_state_message[i] = cost[i];
 
+        for (i = MODE_INTER_MV0; i <= MODE_INTER_MV7; i++)
+            vme_state_message[i] = cost[i];
     }
     vme_state_message[MPEG2_MV_RANGE] = (mv_y << 16) | (mv_x);
 
@@ -1453,63 +1259,53 @@ intel_avc_vme_reference_state(VADriverContextP ctx,
     struct object_surface *obj_surface = NULL;
     struct i965_driver_data *i965 = i965_driver_data(ctx);
     VASurfaceID ref_surface_id;
+    VAEncSequenceParameterBufferH264 *sps_param = (VAEncSequenceParameterBufferH264 *)encode_state->seq_param_ext->buffer;
     VAEncPictureParameterBufferH264 *pic_param = (VAEncPictureParameterBufferH264 *)encode_state->pic_param_ext->buffer;
     VAEncSliceParameterBufferH264 *slice_param = (VAEncSliceParameterBufferH264 *)encode_state->slice_params_ext[0]->buffer;
-    int max_num_references;
-    VAPictureH264 *curr_pic;
-    VAPictureH264 *ref_list;
-    int ref_idx;
-
-    if (list_index == 0) {
-        max_num_references = pic_param->num_ref_idx_l0_active_minus1 + 1;
-        ref_list = slice_param->RefPicList0;
-    } else {
-        max_num_references = pic_param->num_ref_idx_l1_active_minus1 + 1;
-        ref_list = slice_param->RefPicList1;
-    }
-
-    if (max_num_references == 1) {
-        if (list_index == 0) {
-            ref_surface_id = slice_param->RefPicList0[0].picture_id;
-            vme_context->used_references[0] = &slice_param->RefPicList0[0];
-        } else {
-            ref_surface_id = slice_param->RefPicList1[0].picture_id;
-            vme_context->used_references[1] = &slice_param->RefPicList1[0];
-        }
+    uint8_t *vme_state_message = (uint8_t *)(vme_context->vme_state_message);
+    int num_references;
+    VAPictureH264 *ref_list = vme_context->ref_list[list_index];
+    int ref_idx = 0;
 
-        if (ref_surface_id != VA_INVALID_SURFACE)
-            obj_surface = SURFACE(ref_surface_id);
+    num_references = intel_avc_enc_ref_pic_list(sps_param, pic_param, slice_param, list_index, ref_list);
+    vme_context->num_ref_list[list_index] = num_references;
 
-        if (!obj_surface ||
-            !obj_surface->bo) {
-            obj_surface = encode_state->reference_objects[list_index];
-            vme_context->used_references[list_index] = &pic_param->ReferenceFrames[list_index];
-        }
+    /*
+     * The kernels search a single reference per direction, so take the
+     * temporally closest one of the list
+     */
+    if (num_references > 1) {
+        ref_idx = avc_temporal_find_surface(&pic_param->CurrPic, ref_list, num_references, list_index == 1);
 
-        ref_idx = 0;
-    } else {
-        curr_pic = &pic_param->CurrPic;
+        if (ref_idx < 0)
+            ref_idx = 0;
+    }
 
-        /* select the reference frame in temporal space */
-        ref_idx = avc_temporal_find_surface(curr_pic, ref_list, max_num_references, list_index == 1);
+    if (num_references > 0) {
         ref_surface_id = ref_list[ref_idx].picture_id;
 
         if (ref_surface_id != VA_INVALID_SURFACE) /* otherwise warning later */
             obj_surface = SURFACE(ref_surface_id);
-
-        vme_context->used_reference_objects[list_index] = obj_surface;
-        vme_context->used_references[list_index] = &ref_list[ref_idx];
     }
 
     if (obj_surface &&
         obj_surface->bo) {
-        assert(ref_idx >= 0);
         vme_context->used_reference_objects[list_index] = obj_surface;
+        vme_context->used_references[list_index] = &ref_list[ref_idx];
         vme_source_surface_state(ctx, surface_index, obj_surface, encoder_context);
         vme_context->ref_index_in_mb[list_index] = (ref_idx << 24 |
                                                     ref_idx << 16 |
                                                     ref_idx <<  8 |
                                                     ref_idx);
+
+        if (vme_state_message) {
+            uint8_t refid_cost = i965_vme_cost_refid(intel_vme_avc_qp(encode_state, encoder_context),
+                                                     ref_idx, num_references);
+
+            /* a single cost covers both directions of a B frame */
+            if (list_index == 0 || refid_cost > vme_state_message[MODE_REFID_COST])
+                vme_state_message[MODE_REFID_COST] = refid_cost;
+        }
     } else {
         vme_context->used_reference_objects[list_index] = NULL;
         vme_context->used_references[list_index] = NULL;
@@ -1618,3 +1414,68 @@ void intel_avc_slice_insert_packed_data(VADriverContextP ctx,
 
     return;
 }
+
+/*
+ * Have the PAK store the number of bytes it has written so far into the
+ * coded buffer header, at the end of slice slice_index or at the end of
+ * the frame when slice_index is negative, so that vaMapBuffer() does not
+ * need to search the bitstream for its end.
+ */
+void
+intel_mfc_store_coded_size(VADriverContextP ctx,
+                           struct intel_encoder_context *encoder_context,
+                           int slice_index,
+                           struct intel_batchbuffer *slice_batch)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct gen6_mfc_context *mfc_context = encoder_context->mfc_context;
+    dri_bo *bo = mfc_context->mfc_indirect_pak_bse_object.bo;
+    unsigned int offset, reg = MFC_BITSTREAM_BYTECOUNT_FRAME_REG;
+
+    if (!bo)
+        return;
+
+    /*
+     * The counter of the VDBOX the context runs on. Which one that is isn't
+     * known when the kernel picks it, then vaMapBuffer() has to search.
+     */
+    if (encoder_context->base.batch->bsd_ring == I915_EXEC_BSD_RING2)
+        reg += VDBOX1_MMIO_BASE - VDBOX0_MMIO_BASE;
+    else if (encoder_context->base.batch->bsd_ring == I915_EXEC_BSD_DEFAULT &&
+             i965->intel.has_bsd2)
+        return;
+
+    if (slice_index < 0)
+        offset = offsetof(struct i965_coded_buffer_segment, coded_size);
+    else if (slice_index < I965_CODED_BUFFER_MAX_SLICES)
+        offset = offsetof(struct i965_coded_buffer_segment, slice_end) + slice_index * sizeof(uint32_t);
+    else
+        return;
+
+    /* wait for the PAK objects before reading the counter */
+    BEGIN_BCS_BATCH(slice_batch, 4);
+    OUT_BCS_BATCH(slice_batch, MI_FLUSH_DW);
+    OUT_BCS_BATCH(slice_batch, 0);
+    OUT_BCS_BATCH(slice_batch, 0);
+    OUT_BCS_BATCH(slice_batch, 0);
+    ADVANCE_BCS_BATCH(slice_batch);
+
+    if (IS_GEN8(i965->intel.device_info)) {
+        BEGIN_BCS_BATCH(slice_batch, 4);
+        OUT_BCS_BATCH(slice_batch, MI_STORE_REGISTER_MEM | (4 - 2));
+        OUT_BCS_BATCH(slice_batch, reg);
+        OUT_BCS_RELOC(slice_batch, bo,
+                      I915_GEM_DOMAIN_INSTRUCTION, I915_GEM_DOMAIN_INSTRUCTION,
+                      offset);
+        OUT_BCS_BATCH(slice_batch, 0);
+        ADVANCE_BCS_BATCH(slice_batch);
+    } else {
+        BEGIN_BCS_BATCH(slice_batch, 3);
+        OUT_BCS_BATCH(slice_batch, MI_STORE_REGISTER_MEM | (3 - 2));
+        OUT_BCS_BATCH(slice_batch, reg);
+        OUT_BCS_RELOC(slice_batch, bo,
+                      I915_GEM_DOMAIN_INSTRUCTION, I915_GEM_DOMAIN_INSTRUCTION,
+                      offset);
+        ADVANCE_BCS_BATCH(slice_batch);
+    }
+}
@@ -90,6 +90,10 @@ struct gen6_vme_context
     struct object_surface *used_reference_objects[2];
     void *used_references[2];
     unsigned int ref_index_in_mb[2];
+
+    /* the L0/L1 lists of the current AVC frame, see intel_avc_enc_ref_pic_list() */
+    VAPictureH264 ref_list[2][32];
+    int num_ref_list[2];
 };
 
 #define MPEG2_PIC_WIDTH_HEIGHT	30
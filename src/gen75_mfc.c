@@ -43,12 +43,6 @@
 #include "gen6_vme.h"
 #include "intel_media.h"
 
-#define	AVC_INTRA_RDO_OFFSET	4
-#define	AVC_INTER_RDO_OFFSET	10
-#define	AVC_INTER_MSG_OFFSET	8
-#define	AVC_INTER_MV_OFFSET	48
-#define	AVC_RDO_MASK		0xFFFF
-
 #define	MFC_SOFTWARE_HASWELL	0
 
 #define SURFACE_STATE_PADDED_SIZE               MAX(SURFACE_STATE_PADDED_SIZE_GEN6, SURFACE_STATE_PADDED_SIZE_GEN7)
@@ -860,7 +854,10 @@ gen75_mfc_stop(VADriverContextP ctx,
     
     vaStatus = i965_MapBuffer(ctx, pPicParameter->coded_buf, (void **)&coded_buffer_segment);
     assert(vaStatus == VA_STATUS_SUCCESS);
-    *encoded_bits_size = coded_buffer_segment->size * 8;
+
+    /* the frame may be returned as one segment per slice */
+    for (*encoded_bits_size = 0; coded_buffer_segment; coded_buffer_segment = coded_buffer_segment->next)
+        *encoded_bits_size += coded_buffer_segment->size * 8;
     i965_UnmapBuffer(ctx, pPicParameter->coded_buf);
 
     return VA_STATUS_SUCCESS;
@@ -1170,8 +1167,8 @@ gen75_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
     int slice_type = intel_avc_enc_slice_type_fixup(pSliceParameter->slice_type);
     int is_intra = slice_type == SLICE_TYPE_I;
 
-    if (rate_control_mode == VA_RC_CBR) {
-        qp = mfc_context->bit_rate_control_context[slice_type].QpPrimeY;
+    if (MFC_BRC_ENABLED(rate_control_mode)) {
+        qp = i965_brc_get_qp(&mfc_context->brc, slice_type);
         if (encode_state->slice_header_index[slice_index] == 0)
             pSliceParameter->slice_qp_delta = qp - pPicParameter->pic_init_qp;
     }
@@ -1186,7 +1183,7 @@ gen75_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
                               pPicParameter,
                               pSliceParameter,
                               encode_state, encoder_context,
-                              (rate_control_mode == VA_RC_CBR), qp, slice_batch);
+                              MFC_BRC_ENABLED(rate_control_mode), qp, slice_batch);
 
     if ( slice_index == 0)
         intel_mfc_avc_pipeline_header_programing(ctx, encode_state, encoder_context, slice_batch);
@@ -1205,23 +1202,33 @@ gen75_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
     for (i = pSliceParameter->macroblock_address; 
          i < pSliceParameter->macroblock_address + pSliceParameter->num_macroblocks; i++) {
         int last_mb = (i == (pSliceParameter->macroblock_address + pSliceParameter->num_macroblocks - 1) );
+        int mb_qp = qp;
         x = i % width_in_mbs;
         y = i / width_in_mbs;
+
+        if (mfc_context->row_qp_enabled)
+            mb_qp += mfc_context->row_qp_delta[y];
+
+        if (mfc_context->qp_map_enabled) {
+            mb_qp += mfc_context->mb_qp_delta[i];
+            mb_qp = MIN(MAX(mb_qp, 0), 51);
+        }
+
         msg = (unsigned int *) (msg_ptr + i * vme_context->vme_output.size_block);
 
         if (is_intra) {
             assert(msg);
-            gen75_mfc_avc_pak_object_intra(ctx, x, y, last_mb, qp, msg, encoder_context, 0, 0, slice_batch);
+            gen75_mfc_avc_pak_object_intra(ctx, x, y, last_mb, mb_qp, msg, encoder_context, 0, 0, slice_batch);
         } else {
 	    int inter_rdo, intra_rdo;
 	    inter_rdo = msg[AVC_INTER_RDO_OFFSET] & AVC_RDO_MASK;
 	    intra_rdo = msg[AVC_INTRA_RDO_OFFSET] & AVC_RDO_MASK;
 	    offset = i * vme_context->vme_output.size_block + AVC_INTER_MV_OFFSET;
 	    if (intra_rdo < inter_rdo) { 
-                gen75_mfc_avc_pak_object_intra(ctx, x, y, last_mb, qp, msg, encoder_context, 0, 0, slice_batch);
+                gen75_mfc_avc_pak_object_intra(ctx, x, y, last_mb, mb_qp, msg, encoder_context, 0, 0, slice_batch);
             } else {
 		msg += AVC_INTER_MSG_OFFSET;
-                gen75_mfc_avc_pak_object_inter(ctx, x, y, last_mb, qp, msg, offset, encoder_context, 0, 0, slice_type, slice_batch);
+                gen75_mfc_avc_pak_object_inter(ctx, x, y, last_mb, mb_qp, msg, offset, encoder_context, 0, 0, slice_type, slice_batch);
             }
         }
     }
@@ -1237,6 +1244,8 @@ gen75_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
                                    tail_data, 1, 8,
                                    1, 1, 1, 0, slice_batch);
     }
+
+    intel_mfc_store_coded_size(ctx, encoder_context, slice_index, slice_batch);
 }
 
 static dri_bo *
@@ -1251,12 +1260,16 @@ gen75_mfc_avc_software_batchbuffer(VADriverContextP ctx,
     int i;
     int buffer_size;
 
+    intel_mfc_avc_qp_map_prepare(ctx, encode_state, encoder_context);
+    intel_mfc_avc_row_qp_prepare(ctx, encode_state, encoder_context);
+
     batch = mfc_context->aux_batchbuffer;
     batch_bo = batch->buffer;
     for (i = 0; i < encode_state->num_slice_params_ext; i++) {
         gen75_mfc_avc_pipeline_slice_programing(ctx, encode_state, encoder_context, i, batch);
     }
 
+    intel_mfc_store_coded_size(ctx, encoder_context, -1, batch);
     intel_batchbuffer_align(batch, 8);
     
     BEGIN_BCS_BATCH(batch, 2);
@@ -1509,8 +1522,8 @@ gen75_mfc_avc_batchbuffer_slice(VADriverContextP ctx,
     long head_offset;
     int slice_type = intel_avc_enc_slice_type_fixup(pSliceParameter->slice_type);
 
-    if (rate_control_mode == VA_RC_CBR) {
-        qp = mfc_context->bit_rate_control_context[slice_type].QpPrimeY;
+    if (MFC_BRC_ENABLED(rate_control_mode)) {
+        qp = i965_brc_get_qp(&mfc_context->brc, slice_type);
         if (encode_state->slice_header_index[slice_index] == 0)
             pSliceParameter->slice_qp_delta = qp - pPicParameter->pic_init_qp;
     }
@@ -1526,7 +1539,7 @@ gen75_mfc_avc_batchbuffer_slice(VADriverContextP ctx,
                               pSliceParameter,
                               encode_state,
                               encoder_context,
-                              (rate_control_mode == VA_RC_CBR),
+                              MFC_BRC_ENABLED(rate_control_mode),
                               qp,
                               slice_batch);
 
@@ -1593,6 +1606,7 @@ gen75_mfc_avc_batchbuffer_pipeline(VADriverContextP ctx,
     }
     {
 	struct intel_batchbuffer *slice_batch = mfc_context->aux_batchbuffer;
+	intel_mfc_store_coded_size(ctx, encoder_context, -1, slice_batch);
 	intel_batchbuffer_align(slice_batch, 8);
     	BEGIN_BCS_BATCH(slice_batch, 2);
 	OUT_BCS_BATCH(slice_batch, 0);
@@ -1682,6 +1696,8 @@ gen75_mfc_avc_encode_picture(VADriverContextP ctx,
     unsigned int rate_control_mode = encoder_context->rate_control_mode;
     int current_frame_bits_size;
     int sts;
+
+    intel_mfc_avc_scene_analyze(ctx, encode_state, encoder_context);
  
     for (;;) {
         gen75_mfc_init(ctx, encode_state, encoder_context);
@@ -1689,17 +1705,18 @@ gen75_mfc_avc_encode_picture(VADriverContextP ctx,
         /*Programing bcs pipeline*/
         gen75_mfc_avc_pipeline_programing(ctx, encode_state, encoder_context);	//filling the pipeline
         gen75_mfc_run(ctx, encode_state, encoder_context);
-        if (rate_control_mode == VA_RC_CBR /*|| rate_control_mode == VA_RC_VBR*/) {
+        if (MFC_BRC_ENABLED(rate_control_mode)) {
             gen75_mfc_stop(ctx, encode_state, encoder_context, &current_frame_bits_size);
             sts = intel_mfc_brc_postpack(encode_state, mfc_context, current_frame_bits_size);
-            if (sts == BRC_NO_HRD_VIOLATION) {
+            if (sts == BRC_NO_HRD_VIOLATION || sts == BRC_MAX_PASSES_SPENT) {
+                /* past the pass limit the frame is kept, the next ones get the corrected QP */
                 intel_mfc_hrd_context_update(encode_state, mfc_context);
                 break;
             }
             else if (sts == BRC_OVERFLOW_WITH_MIN_QP || sts == BRC_UNDERFLOW_WITH_MAX_QP) {
-                if (!mfc_context->hrd.violation_noted) {
+                if (!mfc_context->brc.hrd.violation_noted) {
                     fprintf(stderr, "Unrepairable %s!\n", (sts == BRC_OVERFLOW_WITH_MIN_QP)? "overflow": "underflow");
-                    mfc_context->hrd.violation_noted = 1;
+                    mfc_context->brc.hrd.violation_noted = 1;
                 }
                 return VA_STATUS_SUCCESS;
             }
@@ -2293,6 +2310,7 @@ gen75_mfc_mpeg2_software_slice_batchbuffer(VADriverContextP ctx,
         gen75_mfc_mpeg2_pipeline_slice_group(ctx, encode_state, encoder_context, i, next_slice_group_param, batch);
     }
 
+    intel_mfc_store_coded_size(ctx, encoder_context, -1, batch);
     intel_batchbuffer_align(batch, 8);
     
     BEGIN_BCS_BATCH(batch, 2);
@@ -2425,6 +2443,9 @@ intel_mfc_mpeg2_prepare(VADriverContextP ctx,
     coded_buffer_segment = (struct i965_coded_buffer_segment *)bo->virtual;
     coded_buffer_segment->mapped = 0;
     coded_buffer_segment->codec = encoder_context->codec;
+    coded_buffer_segment->coded_size = I965_CODED_SIZE_UNKNOWN;
+    coded_buffer_segment->status = 0;
+    coded_buffer_segment->num_slices = 0;
     dri_bo_unmap(bo);
 
     return vaStatus;
@@ -2450,6 +2471,8 @@ gen75_mfc_context_destroy(void *context)
     struct gen6_mfc_context *mfc_context = context;
     int i;
 
+    intel_mfc_brc_terminate(mfc_context);
+
     dri_bo_unreference(mfc_context->post_deblocking_output.bo);
     mfc_context->post_deblocking_output.bo = NULL;
 
@@ -2497,6 +2520,7 @@ gen75_mfc_context_destroy(void *context)
 
     mfc_context->aux_batchbuffer = NULL;
 
+    free(mfc_context->mb_qp_delta);
     free(mfc_context);
 }
 
@@ -2534,6 +2558,8 @@ Bool gen75_mfc_context_init(VADriverContextP ctx, struct intel_encoder_context *
 {
     struct gen6_mfc_context *mfc_context = calloc(1, sizeof(struct gen6_mfc_context));
 
+    i965_scene_detector_init(&mfc_context->scene_detector);
+
     mfc_context->gpe_context.surface_state_binding_table.length = (SURFACE_STATE_PADDED_SIZE + sizeof(unsigned int)) * MAX_MEDIA_SURFACES_GEN6;
 
     mfc_context->gpe_context.idrt.max_entries = MAX_GPE_KERNELS;
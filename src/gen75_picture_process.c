@@ -37,6 +37,7 @@
 #include "i965_drv_video.h"
 #include "i965_post_processing.h"
 #include "gen75_picture_process.h"
+#include "i965_surface_cache.h"
 
 extern struct hw_context *
 i965_proc_context_init(VADriverContextP ctx,
@@ -65,7 +66,9 @@ gen75_vpp_fmt_cvt(VADriverContextP ctx,
 
 static VAStatus 
 gen75_vpp_vebox(VADriverContextP ctx, 
-                struct intel_video_process_context* proc_ctx)
+                struct intel_video_process_context* proc_ctx,
+                struct object_surface *obj_src_surf,
+                struct object_surface *obj_dst_surf)
 {
      VAStatus va_status = VA_STATUS_SUCCESS;
      VAProcPipelineParameterBuffer* pipeline_param = proc_ctx->pipeline_param; 
@@ -77,8 +80,9 @@ gen75_vpp_vebox(VADriverContextP ctx,
      }
 
      proc_ctx->vpp_vebox_ctx->pipeline_param  = pipeline_param;
-     proc_ctx->vpp_vebox_ctx->surface_input_object = proc_ctx->surface_pipeline_input_object;
-     proc_ctx->vpp_vebox_ctx->surface_output_object  = proc_ctx->surface_render_output_object;
+     proc_ctx->vpp_vebox_ctx->surface_input_object = obj_src_surf;
+     proc_ctx->vpp_vebox_ctx->surface_output_object  = obj_dst_surf;
+     proc_ctx->vpp_vebox_ctx->surface_second_output_object = proc_ctx->surface_second_output_object;
 
      if (IS_HASWELL(i965->intel.device_info))
          va_status = gen75_vebox_process_picture(ctx, proc_ctx->vpp_vebox_ctx);
@@ -90,7 +94,9 @@ gen75_vpp_vebox(VADriverContextP ctx,
 
 static VAStatus 
 gen75_vpp_gpe(VADriverContextP ctx, 
-              struct intel_video_process_context* proc_ctx)
+              struct intel_video_process_context* proc_ctx,
+              struct object_surface *obj_src_surf,
+              struct object_surface *obj_dst_surf)
 {
      VAStatus va_status = VA_STATUS_SUCCESS;
 
@@ -99,14 +105,220 @@ gen75_vpp_gpe(VADriverContextP ctx,
      }
    
      proc_ctx->vpp_gpe_ctx->pipeline_param = proc_ctx->pipeline_param;
-     proc_ctx->vpp_gpe_ctx->surface_pipeline_input_object = proc_ctx->surface_pipeline_input_object;
-     proc_ctx->vpp_gpe_ctx->surface_output_object = proc_ctx->surface_render_output_object;
+     proc_ctx->vpp_gpe_ctx->surface_pipeline_input_object = obj_src_surf;
+     proc_ctx->vpp_gpe_ctx->surface_output_object = obj_dst_surf;
 
      va_status = vpp_gpe_process_picture(ctx, proc_ctx->vpp_gpe_ctx);
  
      return va_status;     
 }
 
+/* CSC and scaling in a single pass, from the pipeline region of the source to the output region */
+static VAStatus
+gen75_vpp_pp(VADriverContextP ctx,
+             struct intel_video_process_context *proc_ctx,
+             struct object_surface *obj_src_surf,
+             struct object_surface *obj_dst_surf)
+{
+    VAProcPipelineParameterBuffer *pipeline_param = proc_ctx->pipeline_param;
+    struct i965_surface src_surface, dst_surface;
+    VARectangle src_rect, dst_rect;
+
+    src_rect.x = 0;
+    src_rect.y = 0;
+    src_rect.width = obj_src_surf->orig_width;
+    src_rect.height = obj_src_surf->orig_height;
+
+    dst_rect.x = 0;
+    dst_rect.y = 0;
+    dst_rect.width = obj_dst_surf->orig_width;
+    dst_rect.height = obj_dst_surf->orig_height;
+
+    /* the intermediate surfaces keep the full input frame, so crop when leaving them */
+    if (obj_src_surf != proc_ctx->surface_pipeline_input_object &&
+        pipeline_param->surface_region)
+        src_rect = *pipeline_param->surface_region;
+
+    if (obj_dst_surf == proc_ctx->surface_render_output_object &&
+        pipeline_param->output_region)
+        dst_rect = *pipeline_param->output_region;
+
+    src_surface.base = (struct object_base *)obj_src_surf;
+    src_surface.type = I965_SURFACE_TYPE_SURFACE;
+    src_surface.flags = I965_SURFACE_FLAG_FRAME;
+
+    dst_surface.base = (struct object_base *)obj_dst_surf;
+    dst_surface.type = I965_SURFACE_TYPE_SURFACE;
+    dst_surface.flags = I965_SURFACE_FLAG_FRAME;
+
+    return i965_image_processing(ctx,
+                                 &src_surface,
+                                 &src_rect,
+                                 &dst_surface,
+                                 &dst_rect);
+}
+
+/* Makes sure the ping-pong surface is an NV12 surface of the given size */
+static VAStatus
+gen75_vpp_plan_surface(VADriverContextP ctx,
+                       struct intel_video_process_context *proc_ctx,
+                       int index,
+                       int width,
+                       int height)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct object_surface *obj_surface = proc_ctx->plan_surface_objects[index];
+    VAStatus status;
+
+    if (obj_surface &&
+        obj_surface->orig_width == width &&
+        obj_surface->orig_height == height)
+        return VA_STATUS_SUCCESS;
+
+    if (obj_surface) {
+        i965_surface_cache_put(ctx, &proc_ctx->plan_surfaces[index], 1);
+        proc_ctx->plan_surfaces[index] = VA_INVALID_ID;
+        proc_ctx->plan_surface_objects[index] = NULL;
+    }
+
+    status = i965_surface_cache_get(ctx,
+                                    width,
+                                    height,
+                                    VA_FOURCC_NV12,
+                                    SUBSAMPLE_YUV420,
+                                    1,
+                                    &proc_ctx->plan_surfaces[index]);
+
+    if (status != VA_STATUS_SUCCESS)
+        return status;
+
+    proc_ctx->plan_surface_objects[index] = SURFACE(proc_ctx->plan_surfaces[index]);
+    assert(proc_ctx->plan_surface_objects[index]);
+
+    return VA_STATUS_SUCCESS;
+}
+
+/* Checks the second output of the field rate deinterlacing against the render target */
+static VAStatus
+gen75_vpp_second_output(VADriverContextP ctx,
+                        struct intel_video_process_context *proc_ctx,
+                        struct object_buffer *obj_buf)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct object_surface *obj_dst_surf = proc_ctx->surface_render_output_object;
+    I965ProcFilterParameterBufferDeinterlacing *di_param;
+    struct object_surface *obj_surface;
+    unsigned int dst_tiling, tiling, swizzle;
+
+    if (obj_buf->size_element * obj_buf->num_elements < sizeof(*di_param))
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+    di_param = (I965ProcFilterParameterBufferDeinterlacing *)obj_buf->buffer_store->buffer;
+
+    /* only the motion adaptive passes output the frames of both fields */
+    if (di_param->base.algorithm != VAProcDeinterlacingMotionAdaptive &&
+        di_param->base.algorithm != VAProcDeinterlacingMotionCompensated)
+        return VA_STATUS_ERROR_UNIMPLEMENTED;
+
+    obj_surface = SURFACE(di_param->second_output);
+
+    if (!obj_surface || obj_surface == obj_dst_surf)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    dri_bo_get_tiling(obj_dst_surf->bo, &dst_tiling, &swizzle);
+
+    if (!obj_surface->bo)
+        i965_check_alloc_surface_bo(ctx, obj_surface, !!dst_tiling,
+                                    obj_dst_surf->fourcc, obj_dst_surf->subsampling);
+
+    if (!obj_surface->bo)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    dri_bo_get_tiling(obj_surface->bo, &tiling, &swizzle);
+
+    /* the VEBOX writes both frames after the surface state of one of them */
+    if (obj_surface->fourcc != obj_dst_surf->fourcc ||
+        obj_surface->orig_width != obj_dst_surf->orig_width ||
+        obj_surface->orig_height != obj_dst_surf->orig_height ||
+        obj_surface->width != obj_dst_surf->width ||
+        obj_surface->height != obj_dst_surf->height ||
+        tiling != dst_tiling)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    proc_ctx->surface_second_output_object = obj_surface;
+
+    return VA_STATUS_SUCCESS;
+}
+
+static struct object_surface *
+gen75_vpp_plan_object(struct intel_video_process_context *proc_ctx,
+                      enum vpp_plan_surface surface)
+{
+    switch (surface) {
+    case VPP_PLAN_SURFACE_INPUT:
+        return proc_ctx->surface_pipeline_input_object;
+
+    case VPP_PLAN_SURFACE_OUTPUT:
+        return proc_ctx->surface_render_output_object;
+
+    case VPP_PLAN_SURFACE_TMP0:
+        return proc_ctx->plan_surface_objects[0];
+
+    case VPP_PLAN_SURFACE_TMP1:
+    default:
+        return proc_ctx->plan_surface_objects[1];
+    }
+}
+
+/*
+ * The ladder outputs are scaled from the filtered picture at the input
+ * size, which the last PP stage reads, or from the render target when no
+ * PP stage scaled it
+ */
+static VAStatus
+gen75_vpp_output_ladder(VADriverContextP ctx,
+                        struct intel_video_process_context *proc_ctx,
+                        struct vpp_plan *plan,
+                        I965ProcOutputLadder *ladder)
+{
+    VAProcPipelineParameterBuffer *pipeline_param = proc_ctx->pipeline_param;
+    struct vpp_plan_stage *stage = &plan->stages[plan->num_stages - 1];
+    struct object_surface *obj_src_surf;
+    VARectangle src_rect;
+
+    if (stage->type == VPP_PLAN_STAGE_PP) {
+        obj_src_surf = gen75_vpp_plan_object(proc_ctx, stage->src);
+
+        if (pipeline_param->surface_region) {
+            src_rect = *pipeline_param->surface_region;
+        } else {
+            src_rect.x = 0;
+            src_rect.y = 0;
+            src_rect.width = obj_src_surf->orig_width;
+            src_rect.height = obj_src_surf->orig_height;
+        }
+    } else {
+        obj_src_surf = proc_ctx->surface_render_output_object;
+
+        if (pipeline_param->output_region) {
+            src_rect = *pipeline_param->output_region;
+        } else {
+            src_rect.x = 0;
+            src_rect.y = 0;
+            src_rect.width = obj_src_surf->orig_width;
+            src_rect.height = obj_src_surf->orig_height;
+        }
+    }
+
+    if (proc_ctx->vpp_fmt_cvt_ctx == NULL)
+        proc_ctx->vpp_fmt_cvt_ctx = i965_proc_context_init(ctx, NULL);
+
+    return i965_proc_picture_ladder(ctx, proc_ctx->vpp_fmt_cvt_ctx,
+                                    pipeline_param,
+                                    obj_src_surf, &src_rect,
+                                    ladder);
+}
+
 VAStatus 
 gen75_proc_picture(VADriverContextP ctx,
                    VAProfile profile,
@@ -121,6 +333,9 @@ gen75_proc_picture(VADriverContextP ctx,
              (VAProcPipelineParameterBuffer *)proc_st->pipeline_param->buffer;
     struct object_surface *obj_dst_surf = NULL;
     struct object_surface *obj_src_surf = NULL;
+    struct vpp_plan_params plan_params;
+    struct vpp_plan plan;
+    unsigned int i;
     VAStatus status;
 
     proc_ctx->pipeline_param = pipeline_param;
@@ -164,67 +379,142 @@ gen75_proc_picture(VADriverContextP ctx,
 
     proc_ctx->surface_render_output_object = obj_dst_surf;
     proc_ctx->surface_pipeline_input_object = obj_src_surf;
+    proc_ctx->surface_second_output_object = NULL;
     assert(pipeline_param->num_filters <= 4);
 
-    VABufferID *filter_id = (VABufferID*) pipeline_param->filters;
- 
-    if(pipeline_param->num_filters == 0 || pipeline_param->filters == NULL ){
-        /* implicity surface format coversion and scaling */
-        gen75_vpp_fmt_cvt(ctx, profile, codec_state, hw_context);
-    }else if(pipeline_param->num_filters == 1) {
-       struct object_buffer * obj_buf = BUFFER((*filter_id) + 0);
-
-       assert(obj_buf && obj_buf->buffer_store && obj_buf->buffer_store->buffer);
-       
-       if (!obj_buf ||
-           !obj_buf->buffer_store ||
-           !obj_buf->buffer_store->buffer) {
-           status = VA_STATUS_ERROR_INVALID_FILTER_CHAIN;
-           goto error;
-       }
-
-       VAProcFilterParameterBuffer* filter =
-           (VAProcFilterParameterBuffer*)obj_buf-> buffer_store->buffer;
-
-       if (filter->type == VAProcFilterNoiseReduction         ||
-           filter->type == VAProcFilterDeinterlacing          ||
-           filter->type == VAProcFilterSkinToneEnhancement    ||
-           filter->type == VAProcFilterColorBalance){
-           gen75_vpp_vebox(ctx, proc_ctx);
-       }else if(filter->type == VAProcFilterSharpening){
-           if (obj_src_surf->fourcc != VA_FOURCC_NV12 ||
-               obj_dst_surf->fourcc != VA_FOURCC_NV12) {
-               status = VA_STATUS_ERROR_UNIMPLEMENTED;
-               goto error;
-           }
-
-           gen75_vpp_gpe(ctx, proc_ctx);
-       } 
-    }else if (pipeline_param->num_filters >= 2) {
-         unsigned int i = 0;
-         for (i = 0; i < pipeline_param->num_filters; i++){
-             struct object_buffer * obj_buf = BUFFER(pipeline_param->filters[i]);
-
-             if (!obj_buf ||
-                 !obj_buf->buffer_store ||
-                 !obj_buf->buffer_store->buffer) {
-                 status = VA_STATUS_ERROR_INVALID_FILTER_CHAIN;
-                 goto error;
-             }
-
-             VAProcFilterParameterBuffer* filter =
-                 (VAProcFilterParameterBuffer*)obj_buf-> buffer_store->buffer;
-
-             if (filter->type != VAProcFilterNoiseReduction       &&
-                 filter->type != VAProcFilterDeinterlacing        &&
-                 filter->type != VAProcFilterSkinToneEnhancement  &&
-                 filter->type != VAProcFilterColorBalance) {
-                 printf("Do not support multiply filters outside vebox pipeline \n");
-                 assert(0);
-             }
-         }
-         gen75_vpp_vebox(ctx, proc_ctx);
-    }     
+    plan_params.filters = 0;
+
+    for (i = 0; i < pipeline_param->num_filters; i++) {
+        struct object_buffer *obj_buf = BUFFER(pipeline_param->filters[i]);
+        VAProcFilterParameterBuffer *filter;
+
+        if (!obj_buf ||
+            !obj_buf->buffer_store ||
+            !obj_buf->buffer_store->buffer) {
+            status = VA_STATUS_ERROR_INVALID_FILTER_CHAIN;
+            goto error;
+        }
+
+        filter = (VAProcFilterParameterBuffer *)obj_buf->buffer_store->buffer;
+
+        switch (filter->type) {
+        case VAProcFilterNoiseReduction:
+            plan_params.filters |= VPP_PLAN_FILTER_DN;
+            break;
+
+        case VAProcFilterDeinterlacing:
+            plan_params.filters |= VPP_PLAN_FILTER_DI;
+
+            if (((VAProcFilterParameterBufferDeinterlacing *)filter)->flags & I965_DEINTERLACING_FIELD_RATE) {
+                status = gen75_vpp_second_output(ctx, proc_ctx, obj_buf);
+
+                if (status != VA_STATUS_SUCCESS)
+                    goto error;
+            }
+
+            break;
+
+        case VAProcFilterSkinToneEnhancement:
+            plan_params.filters |= VPP_PLAN_FILTER_STE;
+            break;
+
+        case VAProcFilterColorBalance:
+            plan_params.filters |= VPP_PLAN_FILTER_COLOR_BALANCE;
+            break;
+
+        case VAProcFilterSharpening:
+            plan_params.filters |= VPP_PLAN_FILTER_SHARPENING;
+            break;
+
+        default:
+            status = VA_STATUS_ERROR_UNSUPPORTED_FILTER;
+            goto error;
+        }
+    }
+
+    plan_params.src_fourcc = obj_src_surf->fourcc;
+    plan_params.dst_fourcc = obj_dst_surf->fourcc;
+    plan_params.src_width = obj_src_surf->orig_width;
+    plan_params.src_height = obj_src_surf->orig_height;
+    plan_params.dst_width = obj_dst_surf->orig_width;
+    plan_params.dst_height = obj_dst_surf->orig_height;
+
+    status = vpp_plan_build(&plan_params, &plan);
+
+    if (status != VA_STATUS_SUCCESS)
+        goto error;
+
+    if ((g_intel_debug_option_flags & VA_INTEL_DEBUG_OPTION_VPP) &&
+        vpp_plan_compare(&plan, &proc_ctx->plan)) {
+        char str[128];
+
+        vpp_plan_to_string(&plan, str, sizeof(str));
+        fprintf(stderr, "VPP plan %dx%d %.4s -> %dx%d %.4s: %s\n",
+                plan_params.src_width, plan_params.src_height, (char *)&plan_params.src_fourcc,
+                plan_params.dst_width, plan_params.dst_height, (char *)&plan_params.dst_fourcc,
+                str);
+    }
+
+    proc_ctx->plan = plan;
+
+    /* both fields are only written by a VEBOX pass straight to the render target */
+    if (proc_ctx->surface_second_output_object &&
+        !(plan.num_stages == 1 &&
+          plan.stages[0].type == VPP_PLAN_STAGE_VEBOX &&
+          plan.stages[0].src == VPP_PLAN_SURFACE_INPUT &&
+          plan.stages[0].dst == VPP_PLAN_SURFACE_OUTPUT)) {
+        status = VA_STATUS_ERROR_UNIMPLEMENTED;
+        goto error;
+    }
+
+    for (i = 0; i < plan.num_tmp_surfaces; i++) {
+        status = gen75_vpp_plan_surface(ctx, proc_ctx, i,
+                                        obj_src_surf->orig_width,
+                                        obj_src_surf->orig_height);
+
+        if (status != VA_STATUS_SUCCESS)
+            goto error;
+    }
+
+    for (i = 0; i < plan.num_stages; i++) {
+        struct vpp_plan_stage *stage = &plan.stages[i];
+        struct object_surface *obj_stage_src = gen75_vpp_plan_object(proc_ctx, stage->src);
+        struct object_surface *obj_stage_dst = gen75_vpp_plan_object(proc_ctx, stage->dst);
+
+        switch (stage->type) {
+        case VPP_PLAN_STAGE_VEBOX:
+            status = gen75_vpp_vebox(ctx, proc_ctx, obj_stage_src, obj_stage_dst);
+            break;
+
+        case VPP_PLAN_STAGE_GPE:
+            status = gen75_vpp_gpe(ctx, proc_ctx, obj_stage_src, obj_stage_dst);
+            break;
+
+        case VPP_PLAN_STAGE_PP:
+        default:
+            if (stage->src == VPP_PLAN_SURFACE_INPUT &&
+                stage->dst == VPP_PLAN_SURFACE_OUTPUT) {
+                /* implicity surface format coversion and scaling */
+                status = gen75_vpp_fmt_cvt(ctx, profile, codec_state, hw_context);
+            } else
+                status = gen75_vpp_pp(ctx, proc_ctx, obj_stage_src, obj_stage_dst);
+
+            break;
+        }
+
+        if (status != VA_STATUS_SUCCESS)
+            goto error;
+    }
+
+    /* i965_proc_picture() already produced the ladder when it ran the whole plan */
+    if (proc_st->output_ladder &&
+        !(plan.num_stages == 1 && plan.stages[0].type == VPP_PLAN_STAGE_PP)) {
+        status = gen75_vpp_output_ladder(ctx, proc_ctx, &plan,
+                                         (I965ProcOutputLadder *)proc_st->output_ladder->buffer);
+
+        if (status != VA_STATUS_SUCCESS)
+            goto error;
+    }
 
     return VA_STATUS_SUCCESS;
 
@@ -239,6 +529,8 @@ gen75_proc_context_destroy(void *hw_context)
                       (struct intel_video_process_context *)hw_context;
     VADriverContextP ctx = (VADriverContextP)(proc_ctx->driver_context);
 
+    i965_surface_cache_put(ctx, proc_ctx->plan_surfaces, 2);
+
     if(proc_ctx->vpp_fmt_cvt_ctx){
         proc_ctx->vpp_fmt_cvt_ctx->destroy(proc_ctx->vpp_fmt_cvt_ctx);
         proc_ctx->vpp_fmt_cvt_ctx = NULL;
@@ -270,6 +562,9 @@ gen75_proc_context_init(VADriverContextP ctx,
     proc_context->vpp_vebox_ctx    = NULL;
     proc_context->vpp_gpe_ctx      = NULL;
     proc_context->vpp_fmt_cvt_ctx  = NULL;
+
+    proc_context->plan_surfaces[0] = VA_INVALID_ID;
+    proc_context->plan_surfaces[1] = VA_INVALID_ID;
  
     proc_context->driver_context = ctx;
 
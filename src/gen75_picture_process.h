@@ -32,6 +32,7 @@
 #include "i965_drv_video.h"
 #include "gen75_vpp_vebox.h"
 #include "gen75_vpp_gpe.h"
+#include "gen75_vpp_plan.h"
 
 struct intel_video_process_context
 {
@@ -46,6 +47,13 @@ struct intel_video_process_context
 
     struct object_surface *surface_render_output_object;
     struct object_surface *surface_pipeline_input_object;
+    /* the frame of the first field in the field rate deinterlacing, or NULL */
+    struct object_surface *surface_second_output_object;
+
+    /* the ping-pong surfaces between the stages of the filter plan */
+    VASurfaceID plan_surfaces[2];
+    struct object_surface *plan_surface_objects[2];
+    struct vpp_plan plan;
 };
 
 struct hw_context *
@@ -435,7 +435,7 @@ static void gen75_vme_state_setup_fixup(VADriverContextP ctx,
     if (encoder_context->rate_control_mode == VA_RC_CQP)
         vme_state_message[0] = intra_mb_mode_cost_table[pic_param->pic_init_qp + slice_param->slice_qp_delta];
     else
-        vme_state_message[0] = intra_mb_mode_cost_table[mfc_context->bit_rate_control_context[SLICE_TYPE_I].QpPrimeY];
+        vme_state_message[0] = intra_mb_mode_cost_table[i965_brc_get_qp(&mfc_context->brc, SLICE_TYPE_I)];
 }
 
 static VAStatus gen75_vme_vme_state_setup(VADriverContextP ctx,
@@ -661,22 +661,20 @@ vpp_gpe_process_sharpening(VADriverContextP ctx,
      }
 
      if(vpp_gpe_ctx->surface_tmp == VA_INVALID_ID){
-        va_status = i965_CreateSurfaces(ctx,
-                                       vpp_gpe_ctx->in_frame_w,
-                                       vpp_gpe_ctx->in_frame_h,
-                                       VA_RT_FORMAT_YUV420,
-                                       1,
-                                       &vpp_gpe_ctx->surface_tmp);
+        va_status = i965_surface_cache_get(ctx,
+                                           vpp_gpe_ctx->in_frame_w,
+                                           vpp_gpe_ctx->in_frame_h,
+                                           VA_FOURCC_NV12,
+                                           SUBSAMPLE_YUV420,
+                                           1,
+                                           &vpp_gpe_ctx->surface_tmp);
        assert(va_status == VA_STATUS_SUCCESS);
     
        struct object_surface * obj_surf = SURFACE(vpp_gpe_ctx->surface_tmp);
        assert(obj_surf);
 
-       if (obj_surf) {
-           i965_check_alloc_surface_bo(ctx, obj_surf, 1, VA_FOURCC_NV12,
-                                       SUBSAMPLE_YUV420);
+       if (obj_surf)
            vpp_gpe_ctx->surface_tmp_object = obj_surf;
-       }
     }                
 
     assert(sharpening_intensity >= 0.0 && sharpening_intensity <= 1.0);
@@ -857,7 +855,7 @@ vpp_gpe_context_destroy(VADriverContextP ctx,
 
     if(vpp_gpe_ctx->surface_tmp != VA_INVALID_ID){
         assert(vpp_gpe_ctx->surface_tmp_object != NULL);
-        i965_DestroySurfaces(ctx, &vpp_gpe_ctx->surface_tmp, 1);
+        i965_surface_cache_put(ctx, &vpp_gpe_ctx->surface_tmp, 1);
         vpp_gpe_ctx->surface_tmp = VA_INVALID_ID;
         vpp_gpe_ctx->surface_tmp_object = NULL;
     }   
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gen75_vpp_plan.h"
+#include "i965_fourcc.h"
+
+/* The formats the VEBOX writes without a post conversion */
+static int
+vpp_plan_vebox_output_format(unsigned int fourcc)
+{
+    return (fourcc == VA_FOURCC_NV12 ||
+            fourcc == VA_FOURCC_YUY2 ||
+            fourcc == VA_FOURCC_AYUV);
+}
+
+/* The formats the VEBOX path takes as input, the planar ones and RGBA through its pre conversion */
+static int
+vpp_plan_vebox_input_format(unsigned int fourcc)
+{
+    return (vpp_plan_vebox_output_format(fourcc) ||
+            fourcc == VA_FOURCC_YV12 ||
+            fourcc == VA_FOURCC_I420 ||
+            fourcc == VA_FOURCC_IMC1 ||
+            fourcc == VA_FOURCC_IMC3 ||
+            fourcc == VA_FOURCC_RGBA);
+}
+
+static enum vpp_plan_surface
+vpp_plan_add_stage(struct vpp_plan *plan,
+                   enum vpp_plan_stage_type type,
+                   enum vpp_plan_surface src,
+                   int last)
+{
+    struct vpp_plan_stage *stage = &plan->stages[plan->num_stages++];
+    enum vpp_plan_surface dst;
+
+    if (last)
+        dst = VPP_PLAN_SURFACE_OUTPUT;
+    else if (src == VPP_PLAN_SURFACE_TMP0)
+        dst = VPP_PLAN_SURFACE_TMP1;
+    else
+        dst = VPP_PLAN_SURFACE_TMP0;
+
+    stage->type = type;
+    stage->src = src;
+    stage->dst = dst;
+
+    if (dst == VPP_PLAN_SURFACE_TMP1)
+        plan->num_tmp_surfaces = 2;
+    else if (dst == VPP_PLAN_SURFACE_TMP0 && plan->num_tmp_surfaces == 0)
+        plan->num_tmp_surfaces = 1;
+
+    return dst;
+}
+
+VAStatus
+vpp_plan_build(const struct vpp_plan_params *params, struct vpp_plan *plan)
+{
+    enum vpp_plan_surface cur = VPP_PLAN_SURFACE_INPUT;
+    unsigned int cur_fourcc = params->src_fourcc;
+    int scaled, dst_nv12;
+
+    memset(plan, 0, sizeof(*plan));
+
+    if (params->filters & ~(VPP_PLAN_FILTERS_VEBOX | VPP_PLAN_FILTERS_GPE))
+        return VA_STATUS_ERROR_UNSUPPORTED_FILTER;
+
+    if (params->src_width <= 0 || params->src_height <= 0 ||
+        params->dst_width <= 0 || params->dst_height <= 0)
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+    scaled = (params->src_width != params->dst_width ||
+              params->src_height != params->dst_height);
+    dst_nv12 = (params->dst_fourcc == VA_FOURCC_NV12);
+
+    /* a single PP pass converts and scales at once */
+    if (!params->filters) {
+        vpp_plan_add_stage(plan, VPP_PLAN_STAGE_PP, cur, 1);
+
+        return VA_STATUS_SUCCESS;
+    }
+
+    if (params->filters & VPP_PLAN_FILTERS_VEBOX) {
+        int last;
+
+        if (!vpp_plan_vebox_input_format(params->src_fourcc))
+            return VA_STATUS_ERROR_UNSUPPORTED_RT_FORMAT;
+
+        /*
+         * Scaling inside the VEBOX path costs an AVS pass plus a copy, so
+         * the VEBOX writes the output directly only when neither is needed
+         */
+        last = (!(params->filters & VPP_PLAN_FILTERS_GPE) &&
+                !scaled &&
+                vpp_plan_vebox_output_format(params->dst_fourcc));
+        cur = vpp_plan_add_stage(plan, VPP_PLAN_STAGE_VEBOX, cur, last);
+
+        if (last)
+            return VA_STATUS_SUCCESS;
+
+        cur_fourcc = VA_FOURCC_NV12;
+    }
+
+    if (params->filters & VPP_PLAN_FILTERS_GPE) {
+        int last = (!scaled && dst_nv12);
+
+        /* the sharpening kernel only reads NV12 */
+        if (cur_fourcc != VA_FOURCC_NV12)
+            cur = vpp_plan_add_stage(plan, VPP_PLAN_STAGE_PP, cur, 0);
+
+        cur = vpp_plan_add_stage(plan, VPP_PLAN_STAGE_GPE, cur, last);
+
+        if (last)
+            return VA_STATUS_SUCCESS;
+    }
+
+    /* fused CSC and scaling to the output */
+    vpp_plan_add_stage(plan, VPP_PLAN_STAGE_PP, cur, 1);
+
+    return VA_STATUS_SUCCESS;
+}
+
+int
+vpp_plan_compare(const struct vpp_plan *a, const struct vpp_plan *b)
+{
+    int i;
+
+    if (a->num_stages != b->num_stages)
+        return 1;
+
+    for (i = 0; i < a->num_stages; i++) {
+        if (a->stages[i].type != b->stages[i].type ||
+            a->stages[i].src != b->stages[i].src ||
+            a->stages[i].dst != b->stages[i].dst)
+            return 1;
+    }
+
+    return 0;
+}
+
+int
+vpp_plan_to_string(const struct vpp_plan *plan, char *str, int size)
+{
+    static const char *stage_names[] = { "VEBOX", "GPE", "PP" };
+    static const char *surface_names[] = { "in", "out", "tmp0", "tmp1" };
+    int i, len = 0;
+
+    if (size <= 0)
+        return 0;
+
+    str[0] = '\0';
+
+    for (i = 0; i < plan->num_stages; i++) {
+        const struct vpp_plan_stage *stage = &plan->stages[i];
+
+        len += snprintf(str + len, size - len, "%s%s(%s->%s)",
+                        i ? " " : "",
+                        stage_names[stage->type],
+                        surface_names[stage->src],
+                        surface_names[stage->dst]);
+
+        /* snprintf returns the untruncated length */
+        if (len >= size)
+            return size - 1;
+    }
+
+    return len;
+}
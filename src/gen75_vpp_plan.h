@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef GEN75_VPP_PLAN_H
+#define GEN75_VPP_PLAN_H
+
+#include <va/va.h>
+
+/* The filters of a VAProcPipelineParameterBuffer, grouped by the unit running them */
+#define VPP_PLAN_FILTER_DN              (1 << 0)
+#define VPP_PLAN_FILTER_DI              (1 << 1)
+#define VPP_PLAN_FILTER_STE             (1 << 2)
+#define VPP_PLAN_FILTER_COLOR_BALANCE   (1 << 3)
+#define VPP_PLAN_FILTER_SHARPENING      (1 << 4)
+
+#define VPP_PLAN_FILTERS_VEBOX          (VPP_PLAN_FILTER_DN |           \
+                                         VPP_PLAN_FILTER_DI |           \
+                                         VPP_PLAN_FILTER_STE |          \
+                                         VPP_PLAN_FILTER_COLOR_BALANCE)
+#define VPP_PLAN_FILTERS_GPE            VPP_PLAN_FILTER_SHARPENING
+
+#define VPP_PLAN_MAX_STAGES             3
+
+enum vpp_plan_stage_type
+{
+    VPP_PLAN_STAGE_VEBOX = 0,   /* DN/DI/STE/color balance on the VEBOX */
+    VPP_PLAN_STAGE_GPE,         /* sharpening kernel on the GPE */
+    VPP_PLAN_STAGE_PP,          /* post processing kernel, CSC and scaling in one pass */
+};
+
+enum vpp_plan_surface
+{
+    VPP_PLAN_SURFACE_INPUT = 0,
+    VPP_PLAN_SURFACE_OUTPUT,
+    VPP_PLAN_SURFACE_TMP0,      /* NV12 at the input size */
+    VPP_PLAN_SURFACE_TMP1,      /* NV12 at the input size */
+};
+
+struct vpp_plan_stage
+{
+    enum vpp_plan_stage_type type;
+    enum vpp_plan_surface src;
+    enum vpp_plan_surface dst;
+};
+
+struct vpp_plan_params
+{
+    unsigned int filters;       /* VPP_PLAN_FILTER_xxx */
+    unsigned int src_fourcc;
+    unsigned int dst_fourcc;
+    int src_width;
+    int src_height;
+    int dst_width;
+    int dst_height;
+};
+
+struct vpp_plan
+{
+    int num_stages;
+    struct vpp_plan_stage stages[VPP_PLAN_MAX_STAGES];
+    int num_tmp_surfaces;       /* the ping-pong surfaces the stages need, 0 - 2 */
+};
+
+/*
+ * Works out the shortest sequence of VEBOX, GPE and PP stages running the
+ * requested filters and taking the input to the format and size of the
+ * output. Intermediate results stay in NV12 at the input size and alternate
+ * between the two temporary surfaces; scaling and color conversion are left
+ * to the last stage so they are done in a single PP pass. The planner has no
+ * hardware dependency.
+ */
+VAStatus
+vpp_plan_build(const struct vpp_plan_params *params, struct vpp_plan *plan);
+
+/* Compares two plans, 0 if they run the same stages on the same surfaces */
+int
+vpp_plan_compare(const struct vpp_plan *a, const struct vpp_plan *b);
+
+/*
+ * Prints the plan in a single line, e.g. "VEBOX(in->tmp0) PP(tmp0->out)",
+ * truncated to size - 1 characters. Returns the length of str.
+ */
+int
+vpp_plan_to_string(const struct vpp_plan *plan, char *str, int size);
+
+#endif /* GEN75_VPP_PLAN_H */
@@ -203,9 +203,9 @@ void hsw_veb_dndi_table(VADriverContextP ctx, struct intel_vebox_context *proc_c
                     32 << 23  |  // dnmh_history_init[5:0]
                     10 << 19  |  // neighborPixel th
                     0  << 18  |  // reserved
-                    0  << 16  |  // FMD for 2nd field of previous frame
+                    proc_ctx->cadence_fields.prev_second_field << 16 |  // FMD for 2nd field of previous frame
                     25 << 10  |  // MC pixel consistency th
-                    0  << 8   |  // FMD for 1st field for current frame
+                    proc_ctx->cadence_fields.first_field << 8 |  // FMD for 1st field for current frame
                     10 << 4   |  // SAD THB
                     5 );         // SAD THA
 
@@ -624,6 +624,69 @@ void hsw_veb_iecp_aoi_table(VADriverContextP ctx, struct intel_vebox_context *pr
    }
 }
 
+static void
+hsw_veb_cadence_update(VADriverContextP ctx, struct intel_vebox_context *proc_ctx)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    VAProcFilterParameterBufferDeinterlacing *di_param =
+        (VAProcFilterParameterBufferDeinterlacing *)proc_ctx->filter_di;
+    struct object_surface *obj_surf;
+    struct i965_cadence_stats stats;
+    unsigned int *frame_stats;
+    unsigned int offset;
+    int locked;
+
+    memset(&proc_ctx->cadence_fields, 0, sizeof(proc_ctx->cadence_fields));
+
+    if (!i965->cadence_detect ||
+        !(proc_ctx->filters_mask & VPP_DNDI_DI) ||
+        !di_param ||
+        (di_param->algorithm != VAProcDeinterlacingMotionAdaptive &&
+         di_param->algorithm != VAProcDeinterlacingMotionCompensated))
+        return;
+
+    if (proc_ctx->frame_order == -1) {
+        i965_cadence_detector_init(&proc_ctx->cadence);
+        return;
+    }
+
+    /*
+     * The statistics of the previous pass, which has completed by now, so
+     * the fields of this frame are paired after the cadence of the earlier
+     * frames
+     */
+    obj_surf = proc_ctx->frame_store[FRAME_OUT_STATISTIC].obj_surface;
+    offset = ALIGN(proc_ctx->width_input, 64) / 16 * ALIGN(proc_ctx->height_input, 4) / 4 * VEB_STAT_BLOCK_SIZE +
+        VEB_STAT_PER_FRAME_SIZE;
+
+    if (!obj_surf || !obj_surf->bo ||
+        offset + VEB_STAT_PER_FRAME_SIZE > obj_surf->bo->size)
+        return;
+
+    dri_bo_map(obj_surf->bo, 0);
+    frame_stats = (unsigned int *)((unsigned char *)obj_surf->bo->virtual + offset);
+
+    if (di_param->flags & VA_DEINTERLACING_BOTTOM_FIELD_FIRST) {
+        stats.first_diff = frame_stats[VEB_STAT_FMD_BOTTOM_DIFF];
+        stats.second_diff = frame_stats[VEB_STAT_FMD_TOP_DIFF];
+    } else {
+        stats.first_diff = frame_stats[VEB_STAT_FMD_TOP_DIFF];
+        stats.second_diff = frame_stats[VEB_STAT_FMD_BOTTOM_DIFF];
+    }
+
+    dri_bo_unmap(obj_surf->bo);
+
+    locked = proc_ctx->cadence.locked;
+    i965_cadence_detector_update(&proc_ctx->cadence, &stats);
+    i965_cadence_detector_fields(&proc_ctx->cadence, &proc_ctx->cadence_fields);
+
+    if ((g_intel_debug_option_flags & VA_INTEL_DEBUG_OPTION_VPP) &&
+        locked != proc_ctx->cadence.locked)
+        fprintf(stderr, "VPP cadence: 3:2 pulldown %s at frame %u\n",
+                proc_ctx->cadence.locked ? "locked" : "lost",
+                proc_ctx->cadence.num_frames);
+}
+
 void hsw_veb_state_table_setup(VADriverContextP ctx, struct intel_vebox_context *proc_ctx)
 {
     if(proc_ctx->filters_mask & 0x000000ff) {
@@ -1068,6 +1131,15 @@ hsw_veb_surface_reference(VADriverContextP ctx,
                 proc_ctx->frame_store[FRAME_OUT_CURRENT].is_internal_surface = 0;
                 proc_ctx->frame_store[FRAME_OUT_CURRENT].obj_surface = obj_surf;
                 proc_ctx->current_output = FRAME_OUT_CURRENT;
+            } else if (proc_ctx->field_rate) {
+                /* both frames of the pass are written to the outputs */
+                proc_ctx->frame_store[FRAME_OUT_PREVIOUS].surface_id = VA_INVALID_ID;
+                proc_ctx->frame_store[FRAME_OUT_PREVIOUS].is_internal_surface = 0;
+                proc_ctx->frame_store[FRAME_OUT_PREVIOUS].obj_surface = proc_ctx->surface_output_object;
+                proc_ctx->frame_store[FRAME_OUT_CURRENT].surface_id = VA_INVALID_ID;
+                proc_ctx->frame_store[FRAME_OUT_CURRENT].is_internal_surface = 0;
+                proc_ctx->frame_store[FRAME_OUT_CURRENT].obj_surface = proc_ctx->surface_second_output_object;
+                proc_ctx->current_output = FRAME_OUT_PREVIOUS;
             } else if (proc_ctx->frame_order == 0) {
                 proc_ctx->frame_store[FRAME_OUT_PREVIOUS].surface_id = VA_INVALID_ID;
                 proc_ctx->frame_store[FRAME_OUT_PREVIOUS].is_internal_surface = 0;
@@ -1163,20 +1235,19 @@ int hsw_veb_pre_format_convert(VADriverContextP ctx,
     
      if (proc_ctx->format_convert_flags & PRE_FORMAT_CONVERT) {
          if(proc_ctx->surface_input_vebox_object == NULL){
-             va_status = i965_CreateSurfaces(ctx,
-                                            proc_ctx->width_input,
-                                            proc_ctx->height_input,
-                                            VA_RT_FORMAT_YUV420,
-                                            1,
-                                            &(proc_ctx->surface_input_vebox));
+             va_status = i965_surface_cache_get(ctx,
+                                                proc_ctx->width_input,
+                                                proc_ctx->height_input,
+                                                VA_FOURCC_NV12,
+                                                SUBSAMPLE_YUV420,
+                                                1,
+                                                &(proc_ctx->surface_input_vebox));
              assert(va_status == VA_STATUS_SUCCESS);
              obj_surf_input_vebox = SURFACE(proc_ctx->surface_input_vebox);
              assert(obj_surf_input_vebox);
 
-             if (obj_surf_input_vebox) {
+             if (obj_surf_input_vebox)
                  proc_ctx->surface_input_vebox_object = obj_surf_input_vebox;
-                 i965_check_alloc_surface_bo(ctx, obj_surf_input_vebox, 1, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
-             }
          }
        
          vpp_surface_convert(ctx, proc_ctx->surface_input_vebox_object, proc_ctx->surface_input_object);
@@ -1202,39 +1273,37 @@ int hsw_veb_pre_format_convert(VADriverContextP ctx,
      if(proc_ctx->format_convert_flags & POST_FORMAT_CONVERT ||
         proc_ctx->format_convert_flags & POST_SCALING_CONVERT){
        if(proc_ctx->surface_output_vebox_object == NULL){
-             va_status = i965_CreateSurfaces(ctx,
-                                            proc_ctx->width_input,
-                                            proc_ctx->height_input,
-                                            VA_RT_FORMAT_YUV420,
-                                            1,
-                                            &(proc_ctx->surface_output_vebox));
+             va_status = i965_surface_cache_get(ctx,
+                                                proc_ctx->width_input,
+                                                proc_ctx->height_input,
+                                                VA_FOURCC_NV12,
+                                                SUBSAMPLE_YUV420,
+                                                1,
+                                                &(proc_ctx->surface_output_vebox));
              assert(va_status == VA_STATUS_SUCCESS);
              obj_surf_output_vebox = SURFACE(proc_ctx->surface_output_vebox);
              assert(obj_surf_output_vebox);
 
-             if (obj_surf_output_vebox) {
+             if (obj_surf_output_vebox)
                  proc_ctx->surface_output_vebox_object = obj_surf_output_vebox;
-                 i965_check_alloc_surface_bo(ctx, obj_surf_output_vebox, 1, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
-             }
        }
      }   
 
      if(proc_ctx->format_convert_flags & POST_SCALING_CONVERT){
        if(proc_ctx->surface_output_scaled_object == NULL){
-             va_status = i965_CreateSurfaces(ctx,
-                                            proc_ctx->width_output,
-                                            proc_ctx->height_output,
-                                            VA_RT_FORMAT_YUV420,
-                                            1,
-                                            &(proc_ctx->surface_output_scaled));
+             va_status = i965_surface_cache_get(ctx,
+                                                proc_ctx->width_output,
+                                                proc_ctx->height_output,
+                                                VA_FOURCC_NV12,
+                                                SUBSAMPLE_YUV420,
+                                                1,
+                                                &(proc_ctx->surface_output_scaled));
              assert(va_status == VA_STATUS_SUCCESS);
              obj_surf_output_vebox = SURFACE(proc_ctx->surface_output_scaled);
              assert(obj_surf_output_vebox);
 
-             if (obj_surf_output_vebox) {
+             if (obj_surf_output_vebox)
                  proc_ctx->surface_output_scaled_object = obj_surf_output_vebox;
-                 i965_check_alloc_surface_bo(ctx, obj_surf_output_vebox, 1, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
-             }
        }
      } 
     
@@ -1287,6 +1356,37 @@ int hsw_veb_post_format_convert(VADriverContextP ctx,
     return 0;
 }
 
+/* Restarts the stream when the field rate deinterlacing is turned on or off */
+static void
+hsw_veb_field_rate_begin(struct intel_vebox_context *proc_ctx)
+{
+    int field_rate = (proc_ctx->surface_second_output_object != NULL);
+
+    if (field_rate != proc_ctx->field_rate) {
+        proc_ctx->field_rate = field_rate;
+        proc_ctx->frame_order = -1;
+    }
+}
+
+/* Moves to the next call, each call of the field rate deinterlacing is a new frame */
+static void
+hsw_veb_field_rate_end(VADriverContextP ctx,
+                       struct intel_vebox_context *proc_ctx)
+{
+    if (!proc_ctx->field_rate) {
+        proc_ctx->frame_order = (proc_ctx->frame_order + 1) % 2;
+        return;
+    }
+
+    /* the first frame has no previous second field, both outputs get the first field */
+    if (proc_ctx->frame_order == -1)
+        vpp_surface_convert(ctx,
+                            proc_ctx->surface_output_object,
+                            proc_ctx->surface_second_output_object);
+
+    proc_ctx->frame_order = 0;
+}
+
 VAStatus gen75_vebox_process_picture(VADriverContextP ctx,
                          struct intel_vebox_context *proc_ctx)
 {
@@ -1323,6 +1423,7 @@ VAStatus gen75_vebox_process_picture(VADriverContextP ctx,
          }
     }
 
+    hsw_veb_field_rate_begin(proc_ctx);
     hsw_veb_pre_format_convert(ctx, proc_ctx);
     hsw_veb_surface_reference(ctx, proc_ctx);
 
@@ -1334,6 +1435,8 @@ VAStatus gen75_vebox_process_picture(VADriverContextP ctx,
         assert(proc_ctx->frame_order == 1);
         /* directly copy the saved frame in the second call */
     } else {
+        hsw_veb_cadence_update(ctx, proc_ctx);
+
         intel_batchbuffer_start_atomic_veb(proc_ctx->batch, 0x1000);
         intel_batchbuffer_emit_mi_flush(proc_ctx->batch);
         hsw_veb_surface_state(ctx, proc_ctx, INPUT_SURFACE); 
@@ -1349,7 +1452,7 @@ VAStatus gen75_vebox_process_picture(VADriverContextP ctx,
     hsw_veb_post_format_convert(ctx, proc_ctx);
     // hsw_veb_surface_unreference(ctx, proc_ctx);
 
-    proc_ctx->frame_order = (proc_ctx->frame_order + 1) % 2;
+    hsw_veb_field_rate_end(ctx, proc_ctx);
      
     return VA_STATUS_SUCCESS;
 
@@ -1363,19 +1466,19 @@ void gen75_vebox_context_destroy(VADriverContextP ctx,
     int i;
 
     if(proc_ctx->surface_input_vebox != VA_INVALID_ID){
-       i965_DestroySurfaces(ctx, &proc_ctx->surface_input_vebox, 1);
+       i965_surface_cache_put(ctx, &proc_ctx->surface_input_vebox, 1);
        proc_ctx->surface_input_vebox = VA_INVALID_ID;
        proc_ctx->surface_input_vebox_object = NULL;
      }
 
     if(proc_ctx->surface_output_vebox != VA_INVALID_ID){
-       i965_DestroySurfaces(ctx, &proc_ctx->surface_output_vebox, 1);
+       i965_surface_cache_put(ctx, &proc_ctx->surface_output_vebox, 1);
        proc_ctx->surface_output_vebox = VA_INVALID_ID;
        proc_ctx->surface_output_vebox_object = NULL;
      }
 
     if(proc_ctx->surface_output_scaled != VA_INVALID_ID){
-       i965_DestroySurfaces(ctx, &proc_ctx->surface_output_scaled, 1);
+       i965_surface_cache_put(ctx, &proc_ctx->surface_output_scaled, 1);
        proc_ctx->surface_output_scaled = VA_INVALID_ID;
        proc_ctx->surface_output_scaled_object = NULL;
      }
@@ -1439,6 +1542,7 @@ struct intel_vebox_context * gen75_vebox_context_init(VADriverContextP ctx)
     proc_context->surface_output_vebox_object = NULL;
     proc_context->surface_output_scaled = VA_INVALID_ID;
     proc_context->surface_output_scaled_object = NULL;
+    proc_context->surface_second_output_object = NULL;
     proc_context->filters_mask          = 0;
     proc_context->format_convert_flags  = 0;
 
@@ -1623,6 +1727,7 @@ VAStatus gen8_vebox_process_picture(VADriverContextP ctx,
          }
     }
 
+    hsw_veb_field_rate_begin(proc_ctx);
     hsw_veb_pre_format_convert(ctx, proc_ctx);
     hsw_veb_surface_reference(ctx, proc_ctx);
 
@@ -1634,6 +1739,8 @@ VAStatus gen8_vebox_process_picture(VADriverContextP ctx,
         assert(proc_ctx->frame_order == 1);
         /* directly copy the saved frame in the second call */
     } else {
+        hsw_veb_cadence_update(ctx, proc_ctx);
+
         intel_batchbuffer_start_atomic_veb(proc_ctx->batch, 0x1000);
         intel_batchbuffer_emit_mi_flush(proc_ctx->batch);
         hsw_veb_surface_state(ctx, proc_ctx, INPUT_SURFACE); 
@@ -1649,7 +1756,7 @@ VAStatus gen8_vebox_process_picture(VADriverContextP ctx,
     hsw_veb_post_format_convert(ctx, proc_ctx);
     // hsw_veb_surface_unreference(ctx, proc_ctx);
 
-    proc_ctx->frame_order = (proc_ctx->frame_order + 1) % 2;
+    hsw_veb_field_rate_end(ctx, proc_ctx);
      
     return VA_STATUS_SUCCESS;
 
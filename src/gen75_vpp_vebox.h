@@ -37,6 +37,7 @@
 #include "i965_drv_video.h"
 
 #include "i965_post_processing.h"
+#include "i965_cadence.h"
 
 #define INPUT_SURFACE  0
 #define OUTPUT_SURFACE 1
@@ -56,6 +57,16 @@
 #define POST_SCALING_CONVERT    0x04
 #define POST_COPY_CONVERT       0x08
 
+/*
+ * The statistics surface starts with the per block statistics of each 16x4
+ * block, followed by the per frame statistics of the previous and the
+ * current frame
+ */
+#define VEB_STAT_BLOCK_SIZE         16
+#define VEB_STAT_PER_FRAME_SIZE     (32 * 4)
+#define VEB_STAT_FMD_TOP_DIFF       0
+#define VEB_STAT_FMD_BOTTOM_DIFF    1
+
 enum {
     FRAME_IN_CURRENT = 0,
     FRAME_IN_PREVIOUS,
@@ -110,6 +121,8 @@ struct intel_vebox_context
     struct object_surface *surface_output_vebox_object;
     VASurfaceID surface_output_scaled;
     struct object_surface *surface_output_scaled_object;
+    /* the frame of the first field in the field rate deinterlacing */
+    struct object_surface *surface_second_output_object;
 
     unsigned int fourcc_input;
     unsigned int fourcc_output;
@@ -140,6 +153,10 @@ struct intel_vebox_context
 
     unsigned int  filter_iecp_amp_num_elements;
     unsigned char format_convert_flags;
+
+    struct i965_cadence_detector cadence;
+    struct i965_cadence_fields cadence_fields;
+    int field_rate;
 };
 
 VAStatus gen75_vebox_process_picture(VADriverContextP ctx,
@@ -945,6 +945,7 @@ gen7_mfc_mpeg2_software_slice_batchbuffer(VADriverContextP ctx,
         gen7_mfc_mpeg2_pipeline_slice_group(ctx, encode_state, encoder_context, i, next_slice_group_param, batch);
     }
 
+    intel_mfc_store_coded_size(ctx, encoder_context, -1, batch);
     intel_batchbuffer_align(batch, 8);
     
     BEGIN_BCS_BATCH(batch, 2);
@@ -1077,6 +1078,9 @@ gen7_mfc_mpeg2_prepare(VADriverContextP ctx,
     coded_buffer_segment = (struct i965_coded_buffer_segment *)bo->virtual;
     coded_buffer_segment->mapped = 0;
     coded_buffer_segment->codec = encoder_context->codec;
+    coded_buffer_segment->coded_size = I965_CODED_SIZE_UNKNOWN;
+    coded_buffer_segment->status = 0;
+    coded_buffer_segment->num_slices = 0;
     dri_bo_unmap(bo);
 
     return vaStatus;
@@ -1687,28 +1687,6 @@ gen7_mfd_vc1_directmode_state(VADriverContextP ctx,
     ADVANCE_BCS_BATCH(batch);
 }
 
-static int
-gen7_mfd_vc1_get_macroblock_bit_offset(uint8_t *buf, int in_slice_data_bit_offset, int profile)
-{
-    int out_slice_data_bit_offset;
-    int slice_header_size = in_slice_data_bit_offset / 8;
-    int i, j;
-
-    if (profile != 3)
-        out_slice_data_bit_offset = in_slice_data_bit_offset;
-    else {
-        for (i = 0, j = 0; i < slice_header_size; i++, j++) {
-            if (!buf[j] && !buf[j + 1] && buf[j + 2] == 3 && buf[j + 3] < 4) {
-                i++, j += 2;
-            }
-        }
-
-        out_slice_data_bit_offset = 8 * j + in_slice_data_bit_offset % 8;
-    }
-
-    return out_slice_data_bit_offset;
-}
-
 static void
 gen7_mfd_vc1_bsd_object(VADriverContextP ctx,
                         VAPictureParameterBufferVC1 *pic_param,
@@ -1724,9 +1702,10 @@ gen7_mfd_vc1_bsd_object(VADriverContextP ctx,
 
     dri_bo_map(slice_data_bo, 0);
     slice_data = (uint8_t *)(slice_data_bo->virtual + slice_param->slice_data_offset);
-    macroblock_offset = gen7_mfd_vc1_get_macroblock_bit_offset(slice_data, 
-                                                               slice_param->macroblock_offset,
-                                                               pic_param->sequence_fields.bits.profile);
+    macroblock_offset = vc1_get_macroblock_bit_offset(slice_data,
+                                                      slice_param->slice_data_size,
+                                                      slice_param->macroblock_offset,
+                                                      pic_param->sequence_fields.bits.profile);
     dri_bo_unmap(slice_data_bo);
 
     if (next_slice_param)
@@ -2130,21 +2109,21 @@ gen7_jpeg_wa_init(VADriverContextP ctx,
     struct object_surface *obj_surface;
 
     if (gen7_mfd_context->jpeg_wa_surface_id != VA_INVALID_SURFACE)
-        i965_DestroySurfaces(ctx,
-                             &gen7_mfd_context->jpeg_wa_surface_id,
-                             1);
-
-    status = i965_CreateSurfaces(ctx,
-                                 gen7_jpeg_wa_clip.width,
-                                 gen7_jpeg_wa_clip.height,
-                                 VA_RT_FORMAT_YUV420,
-                                 1,
-                                 &gen7_mfd_context->jpeg_wa_surface_id);
+        i965_surface_cache_put(ctx,
+                               &gen7_mfd_context->jpeg_wa_surface_id,
+                               1);
+
+    status = i965_surface_cache_get(ctx,
+                                    gen7_jpeg_wa_clip.width,
+                                    gen7_jpeg_wa_clip.height,
+                                    VA_FOURCC_NV12,
+                                    SUBSAMPLE_YUV420,
+                                    1,
+                                    &gen7_mfd_context->jpeg_wa_surface_id);
     assert(status == VA_STATUS_SUCCESS);
 
     obj_surface = SURFACE(gen7_mfd_context->jpeg_wa_surface_id);
     assert(obj_surface);
-    i965_check_alloc_surface_bo(ctx, obj_surface, 1, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
     gen7_mfd_context->jpeg_wa_surface_object = obj_surface;
 
     if (!gen7_mfd_context->jpeg_wa_slice_data_bo) {
@@ -41,6 +41,7 @@
 #include "i965_encoder_utils.h"
 #include "gen6_mfc.h"
 #include "gen6_vme.h"
+#include "gen8_mfc_pak.h"
 #include "intel_media.h"
 
 #define SURFACE_STATE_PADDED_SIZE               SURFACE_STATE_PADDED_SIZE_GEN8
@@ -78,16 +79,6 @@ static struct i965_kernel gen8_mfc_kernels[] = {
     },
 };
 
-#define		INTER_MODE_MASK		0x03
-#define		INTER_8X8		0x03
-#define		INTER_16X8		0x01
-#define		INTER_8X16		0x02
-#define		SUBMB_SHAPE_MASK	0x00FF00
-
-#define		INTER_MV8		(4 << 20)
-#define		INTER_MV32		(6 << 20)
-
-
 static void
 gen8_mfc_pipe_mode_select(VADriverContextP ctx,
                           int standard_select,
@@ -717,7 +708,10 @@ gen8_mfc_stop(VADriverContextP ctx,
     
     vaStatus = i965_MapBuffer(ctx, pPicParameter->coded_buf, (void **)&coded_buffer_segment);
     assert(vaStatus == VA_STATUS_SUCCESS);
-    *encoded_bits_size = coded_buffer_segment->size * 8;
+
+    /* the frame may be returned as one segment per slice */
+    for (*encoded_bits_size = 0; coded_buffer_segment; coded_buffer_segment = coded_buffer_segment->next)
+        *encoded_bits_size += coded_buffer_segment->size * 8;
     i965_UnmapBuffer(ctx, pPicParameter->coded_buf);
 
     return VA_STATUS_SUCCESS;
@@ -854,188 +848,30 @@ gen8_mfc_avc_slice_state(VADriverContextP ctx,
 
 #ifdef MFC_SOFTWARE_HASWELL
 
-static int
-gen8_mfc_avc_pak_object_intra(VADriverContextP ctx, int x, int y, int end_mb,
-                              int qp,unsigned int *msg,
-                              struct intel_encoder_context *encoder_context,
-                              unsigned char target_mb_size, unsigned char max_mb_size,
-                              struct intel_batchbuffer *batch)
-{
-    int len_in_dwords = 12;
-    unsigned int intra_msg;
-#define		INTRA_MSG_FLAG		(1 << 13)
-#define		INTRA_MBTYPE_MASK	(0x1F0000)
-    if (batch == NULL)
-        batch = encoder_context->base.batch;
-
-    BEGIN_BCS_BATCH(batch, len_in_dwords);
-
-    intra_msg = msg[0] & 0xC0FF;
-    intra_msg |= INTRA_MSG_FLAG;
-    intra_msg |= ((msg[0] & INTRA_MBTYPE_MASK) >> 8);
-    OUT_BCS_BATCH(batch, MFC_AVC_PAK_OBJECT | (len_in_dwords - 2));
-    OUT_BCS_BATCH(batch, 0);
-    OUT_BCS_BATCH(batch, 0);
-    OUT_BCS_BATCH(batch, 
-                  (0 << 24) |		/* PackedMvNum, Debug*/
-                  (0 << 20) | 		/* No motion vector */
-                  (1 << 19) |		/* CbpDcY */
-                  (1 << 18) |		/* CbpDcU */
-                  (1 << 17) |		/* CbpDcV */
-                  intra_msg);
-
-    OUT_BCS_BATCH(batch, (0xFFFF << 16) | (y << 8) | x);		/* Code Block Pattern for Y*/
-    OUT_BCS_BATCH(batch, 0x000F000F);							/* Code Block Pattern */		
-    OUT_BCS_BATCH(batch, (0 << 27) | (end_mb << 26) | qp);	/* Last MB */
-
-    /*Stuff for Intra MB*/
-    OUT_BCS_BATCH(batch, msg[1]);			/* We using Intra16x16 no 4x4 predmode*/	
-    OUT_BCS_BATCH(batch, msg[2]);	
-    OUT_BCS_BATCH(batch, msg[3]&0xFF);	
-    
-    /*MaxSizeInWord and TargetSzieInWord*/
-    OUT_BCS_BATCH(batch, (max_mb_size << 24) |
-                  (target_mb_size << 16) );
-
-    OUT_BCS_BATCH(batch, 0);
-
-    ADVANCE_BCS_BATCH(batch);
-
-    return len_in_dwords;
-}
-
-static int
-gen8_mfc_avc_pak_object_inter(VADriverContextP ctx, int x, int y, int end_mb, int qp,
-                              unsigned int *msg, unsigned int offset,
-                              struct intel_encoder_context *encoder_context,
-                              unsigned char target_mb_size,unsigned char max_mb_size, int slice_type,
-                              struct intel_batchbuffer *batch)
-{
-    struct gen6_vme_context *vme_context = encoder_context->vme_context;
-    int len_in_dwords = 12;
-    unsigned int inter_msg = 0;
-    if (batch == NULL)
-        batch = encoder_context->base.batch;
-    {
-#define MSG_MV_OFFSET	4
-	unsigned int *mv_ptr;
-	mv_ptr = msg + MSG_MV_OFFSET;
-	/* MV of VME output is based on 16 sub-blocks. So it is necessary
-         * to convert them to be compatible with the format of AVC_PAK
-         * command.
-         */
-	if ((msg[0] & INTER_MODE_MASK) == INTER_8X16) {
-            /* MV[0] and MV[2] are replicated */
-            mv_ptr[4] = mv_ptr[0];
-            mv_ptr[5] = mv_ptr[1];
-            mv_ptr[2] = mv_ptr[8];
-            mv_ptr[3] = mv_ptr[9];
-            mv_ptr[6] = mv_ptr[8];
-            mv_ptr[7] = mv_ptr[9];
-	} else if ((msg[0] & INTER_MODE_MASK) == INTER_16X8) {
-            /* MV[0] and MV[1] are replicated */
-            mv_ptr[2] = mv_ptr[0];
-            mv_ptr[3] = mv_ptr[1];
-            mv_ptr[4] = mv_ptr[16];
-            mv_ptr[5] = mv_ptr[17];
-            mv_ptr[6] = mv_ptr[24];
-            mv_ptr[7] = mv_ptr[25];
-	} else if (((msg[0] & INTER_MODE_MASK) == INTER_8X8) &&
-                   !(msg[1] & SUBMB_SHAPE_MASK)) {
-            /* Don't touch MV[0] or MV[1] */
-            mv_ptr[2] = mv_ptr[8];
-            mv_ptr[3] = mv_ptr[9];
-            mv_ptr[4] = mv_ptr[16];
-            mv_ptr[5] = mv_ptr[17];
-            mv_ptr[6] = mv_ptr[24];
-            mv_ptr[7] = mv_ptr[25];
-	}
-    }
-
-    BEGIN_BCS_BATCH(batch, len_in_dwords);
-
-    OUT_BCS_BATCH(batch, MFC_AVC_PAK_OBJECT | (len_in_dwords - 2));
-
-    inter_msg = 32;
-    /* MV quantity */
-    if ((msg[0] & INTER_MODE_MASK) == INTER_8X8) {
-        if (msg[1] & SUBMB_SHAPE_MASK)
-            inter_msg = 128;
-    }
-    OUT_BCS_BATCH(batch, inter_msg);         /* 32 MV*/
-    OUT_BCS_BATCH(batch, offset);
-    inter_msg = msg[0] & (0x1F00FFFF);
-    inter_msg |= INTER_MV8;
-    inter_msg |= ((1 << 19) | (1 << 18) | (1 << 17));
-    if (((msg[0] & INTER_MODE_MASK) == INTER_8X8) &&
-        (msg[1] & SUBMB_SHAPE_MASK)) {
-        inter_msg |= INTER_MV32;
-    }
-
-    OUT_BCS_BATCH(batch, inter_msg);
-
-    OUT_BCS_BATCH(batch, (0xFFFF<<16) | (y << 8) | x);        /* Code Block Pattern for Y*/
-    OUT_BCS_BATCH(batch, 0x000F000F);                         /* Code Block Pattern */  
-#if 0 
-    if ( slice_type == SLICE_TYPE_B) {
-        OUT_BCS_BATCH(batch, (0xF<<28) | (end_mb << 26) | qp);	/* Last MB */
-    } else {
-        OUT_BCS_BATCH(batch, (end_mb << 26) | qp);	/* Last MB */
-    }
-#else
-    OUT_BCS_BATCH(batch, (end_mb << 26) | qp);	/* Last MB */
-#endif
-
-    inter_msg = msg[1] >> 8;
-    /*Stuff for Inter MB*/
-    OUT_BCS_BATCH(batch, inter_msg);        
-    OUT_BCS_BATCH(batch, vme_context->ref_index_in_mb[0]);
-    OUT_BCS_BATCH(batch, vme_context->ref_index_in_mb[1]);
-
-    /*MaxSizeInWord and TargetSzieInWord*/
-    OUT_BCS_BATCH(batch, (max_mb_size << 24) |
-                  (target_mb_size << 16) );
-
-    OUT_BCS_BATCH(batch, 0x0);    
-
-    ADVANCE_BCS_BATCH(batch);
-
-    return len_in_dwords;
-}
-
-#define		AVC_INTRA_RDO_OFFSET	4
-#define		AVC_INTER_RDO_OFFSET	10
-#define		AVC_INTER_MSG_OFFSET	8	
-#define		AVC_INTER_MV_OFFSET		48
-#define		AVC_RDO_MASK		0xFFFF
-
 static void 
 gen8_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
                                        struct encode_state *encode_state,
                                        struct intel_encoder_context *encoder_context,
                                        int slice_index,
-                                       struct intel_batchbuffer *slice_batch)
+                                       struct intel_batchbuffer *slice_batch,
+                                       struct gen8_mfc_avc_pak_slice *pak_slice)
 {
     struct gen6_mfc_context *mfc_context = encoder_context->mfc_context;
-    struct gen6_vme_context *vme_context = encoder_context->vme_context;
     VAEncSequenceParameterBufferH264 *pSequenceParameter = (VAEncSequenceParameterBufferH264 *)encode_state->seq_param_ext->buffer;
     VAEncPictureParameterBufferH264 *pPicParameter = (VAEncPictureParameterBufferH264 *)encode_state->pic_param_ext->buffer;
     VAEncSliceParameterBufferH264 *pSliceParameter = (VAEncSliceParameterBufferH264 *)encode_state->slice_params_ext[slice_index]->buffer; 
-    unsigned int *msg = NULL, offset = 0;
-    unsigned char *msg_ptr = NULL;
     int width_in_mbs = (mfc_context->surface_state.width + 15) / 16;
     int height_in_mbs = (mfc_context->surface_state.height + 15) / 16;
     int last_slice = (pSliceParameter->macroblock_address + pSliceParameter->num_macroblocks) == (width_in_mbs * height_in_mbs);
-    int i,x,y;
+    int size;
     int qp = pPicParameter->pic_init_qp + pSliceParameter->slice_qp_delta;
     unsigned int rate_control_mode = encoder_context->rate_control_mode;
     unsigned int tail_data[] = { 0x0, 0x0 };
     int slice_type = intel_avc_enc_slice_type_fixup(pSliceParameter->slice_type);
-    int is_intra = slice_type == SLICE_TYPE_I;
 
 
-    if (rate_control_mode == VA_RC_CBR) {
-        qp = mfc_context->bit_rate_control_context[slice_type].QpPrimeY;
+    if (MFC_BRC_ENABLED(rate_control_mode)) {
+        qp = i965_brc_get_qp(&mfc_context->brc, slice_type);
         if (encode_state->slice_header_index[slice_index] == 0)
             pSliceParameter->slice_qp_delta = qp - pPicParameter->pic_init_qp;
     }
@@ -1050,47 +886,22 @@ gen8_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
                              pPicParameter,
                              pSliceParameter,
                              encode_state, encoder_context,
-                             (rate_control_mode == VA_RC_CBR), qp, slice_batch);
+                             MFC_BRC_ENABLED(rate_control_mode), qp, slice_batch);
 
     if ( slice_index == 0)
         intel_mfc_avc_pipeline_header_programing(ctx, encode_state, encoder_context, slice_batch);
 
     intel_avc_slice_insert_packed_data(ctx, encode_state, encoder_context, slice_index, slice_batch);
 
-    dri_bo_map(vme_context->vme_output.bo , 1);
-    msg_ptr = (unsigned char *)vme_context->vme_output.bo->virtual;
-
-    if (is_intra) {
-        msg = (unsigned int *) (msg_ptr + pSliceParameter->macroblock_address * vme_context->vme_output.size_block);
-    } else {
-        msg = (unsigned int *) (msg_ptr + pSliceParameter->macroblock_address * vme_context->vme_output.size_block);
-    }
-   
-    for (i = pSliceParameter->macroblock_address; 
-         i < pSliceParameter->macroblock_address + pSliceParameter->num_macroblocks; i++) {
-        int last_mb = (i == (pSliceParameter->macroblock_address + pSliceParameter->num_macroblocks - 1) );
-        x = i % width_in_mbs;
-        y = i / width_in_mbs;
-        msg = (unsigned int *) (msg_ptr + i * vme_context->vme_output.size_block);
-
-        if (is_intra) {
-            assert(msg);
-            gen8_mfc_avc_pak_object_intra(ctx, x, y, last_mb, qp, msg, encoder_context, 0, 0, slice_batch);
-        } else {
-	    int inter_rdo, intra_rdo;
-	    inter_rdo = msg[AVC_INTER_RDO_OFFSET] & AVC_RDO_MASK;
-	    intra_rdo = msg[AVC_INTRA_RDO_OFFSET] & AVC_RDO_MASK;
-	    offset = i * vme_context->vme_output.size_block + AVC_INTER_MV_OFFSET;
-	    if (intra_rdo < inter_rdo) { 
-                gen8_mfc_avc_pak_object_intra(ctx, x, y, last_mb, qp, msg, encoder_context, 0, 0, slice_batch);
-            } else {
-		msg += AVC_INTER_MSG_OFFSET;
-                gen8_mfc_avc_pak_object_inter(ctx, x, y, last_mb, qp, msg, offset, encoder_context, 0, 0, pSliceParameter->slice_type, slice_batch);
-            }
-        }
-    }
-   
-    dri_bo_unmap(vme_context->vme_output.bo);
+    /* leave room for the PAK objects */
+    size = pSliceParameter->num_macroblocks * PAK_OBJECT_IN_DWS * 4;
+    intel_batchbuffer_require_space(slice_batch, size);
+    pak_slice->command = (unsigned int *)slice_batch->ptr;
+    pak_slice->first_mb = pSliceParameter->macroblock_address;
+    pak_slice->num_mbs = pSliceParameter->num_macroblocks;
+    pak_slice->qp = qp;
+    pak_slice->slice_type = slice_type;
+    slice_batch->ptr += size;
 
     if ( last_slice ) {    
         mfc_context->insert_object(ctx, encoder_context,
@@ -1101,6 +912,8 @@ gen8_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
                                    tail_data, 1, 8,
                                    1, 1, 1, 0, slice_batch);
     }
+
+    intel_mfc_store_coded_size(ctx, encoder_context, slice_index, slice_batch);
 }
 
 static dri_bo *
@@ -1109,17 +922,47 @@ gen8_mfc_avc_software_batchbuffer(VADriverContextP ctx,
                                   struct intel_encoder_context *encoder_context)
 {
     struct gen6_mfc_context *mfc_context = encoder_context->mfc_context;
+    struct gen6_vme_context *vme_context = encoder_context->vme_context;
     struct i965_driver_data *i965 = i965_driver_data(ctx);
     struct intel_batchbuffer *batch;
+    struct gen8_mfc_avc_pak_job job;
     dri_bo *batch_bo;
+    int width_in_mbs = (mfc_context->surface_state.width + 15) / 16;
+    int height_in_mbs = (mfc_context->surface_state.height + 15) / 16;
     int i;
 
+    intel_mfc_avc_qp_map_prepare(ctx, encode_state, encoder_context);
+    intel_mfc_avc_row_qp_prepare(ctx, encode_state, encoder_context);
+
+    job.msg_size = vme_context->vme_output.size_block;
+    job.ref_index_in_mb[0] = vme_context->ref_index_in_mb[0];
+    job.ref_index_in_mb[1] = vme_context->ref_index_in_mb[1];
+    job.row_qp_delta = mfc_context->row_qp_enabled ? mfc_context->row_qp_delta : NULL;
+    job.mb_qp_delta = mfc_context->qp_map_enabled ? mfc_context->mb_qp_delta : NULL;
+    job.width_in_mbs = width_in_mbs;
+    job.num_slices = encode_state->num_slice_params_ext;
+    job.slices = calloc(job.num_slices, sizeof(*job.slices));
+    assert(job.slices);
+
+    /*
+     * The slice batches are built in order with the PAK objects left out,
+     * then the PAK objects of the whole frame are generated in MB bands,
+     * each at its fixed place, on the worker pool
+     */
     batch = mfc_context->aux_batchbuffer;
     batch_bo = batch->buffer;
     for (i = 0; i < encode_state->num_slice_params_ext; i++) {
-        gen8_mfc_avc_pipeline_slice_programing(ctx, encode_state, encoder_context, i, batch);
+        gen8_mfc_avc_pipeline_slice_programing(ctx, encode_state, encoder_context, i, batch,
+                                               &job.slices[i]);
     }
 
+    dri_bo_map(vme_context->vme_output.bo , 1);
+    job.msg_ptr = (unsigned char *)vme_context->vme_output.bo->virtual;
+    gen8_mfc_avc_pak_objects(&i965->copy_pool, &job, width_in_mbs * height_in_mbs);
+    dri_bo_unmap(vme_context->vme_output.bo);
+    free(job.slices);
+
+    intel_mfc_store_coded_size(ctx, encoder_context, -1, batch);
     intel_batchbuffer_align(batch, 8);
     
     BEGIN_BCS_BATCH(batch, 2);
@@ -1404,8 +1247,8 @@ gen8_mfc_avc_batchbuffer_slice(VADriverContextP ctx,
     unsigned short head_size, tail_size;
     int slice_type = intel_avc_enc_slice_type_fixup(pSliceParameter->slice_type);
 
-    if (rate_control_mode == VA_RC_CBR) {
-        qp = mfc_context->bit_rate_control_context[slice_type].QpPrimeY;
+    if (MFC_BRC_ENABLED(rate_control_mode)) {
+        qp = i965_brc_get_qp(&mfc_context->brc, slice_type);
         if (encode_state->slice_header_index[slice_index] == 0)
             pSliceParameter->slice_qp_delta = qp - pPicParameter->pic_init_qp;
     }
@@ -1422,7 +1265,7 @@ gen8_mfc_avc_batchbuffer_slice(VADriverContextP ctx,
                              pSliceParameter,
                              encode_state,
                              encoder_context,
-                             (rate_control_mode == VA_RC_CBR),
+                             MFC_BRC_ENABLED(rate_control_mode),
                              qp,
                              slice_batch);
 
@@ -1577,6 +1420,8 @@ gen8_mfc_avc_encode_picture(VADriverContextP ctx,
     unsigned int rate_control_mode = encoder_context->rate_control_mode;
     int current_frame_bits_size;
     int sts;
+
+    intel_mfc_avc_scene_analyze(ctx, encode_state, encoder_context);
  
     for (;;) {
         gen8_mfc_init(ctx, encode_state, encoder_context);
@@ -1584,17 +1429,18 @@ gen8_mfc_avc_encode_picture(VADriverContextP ctx,
         /*Programing bcs pipeline*/
         gen8_mfc_avc_pipeline_programing(ctx, encode_state, encoder_context);	//filling the pipeline
         gen8_mfc_run(ctx, encode_state, encoder_context);
-        if (rate_control_mode == VA_RC_CBR /*|| rate_control_mode == VA_RC_VBR*/) {
+        if (MFC_BRC_ENABLED(rate_control_mode)) {
             gen8_mfc_stop(ctx, encode_state, encoder_context, &current_frame_bits_size);
             sts = intel_mfc_brc_postpack(encode_state, mfc_context, current_frame_bits_size);
-            if (sts == BRC_NO_HRD_VIOLATION) {
+            if (sts == BRC_NO_HRD_VIOLATION || sts == BRC_MAX_PASSES_SPENT) {
+                /* past the pass limit the frame is kept, the next ones get the corrected QP */
                 intel_mfc_hrd_context_update(encode_state, mfc_context);
                 break;
             }
             else if (sts == BRC_OVERFLOW_WITH_MIN_QP || sts == BRC_UNDERFLOW_WITH_MAX_QP) {
-                if (!mfc_context->hrd.violation_noted) {
+                if (!mfc_context->brc.hrd.violation_noted) {
                     fprintf(stderr, "Unrepairable %s!\n", (sts == BRC_OVERFLOW_WITH_MIN_QP)? "overflow": "underflow");
-                    mfc_context->hrd.violation_noted = 1;
+                    mfc_context->brc.hrd.violation_noted = 1;
                 }
                 return VA_STATUS_SUCCESS;
             }
@@ -2191,6 +2037,7 @@ gen8_mfc_mpeg2_software_slice_batchbuffer(VADriverContextP ctx,
         gen8_mfc_mpeg2_pipeline_slice_group(ctx, encode_state, encoder_context, i, next_slice_group_param, batch);
     }
 
+    intel_mfc_store_coded_size(ctx, encoder_context, -1, batch);
     intel_batchbuffer_align(batch, 8);
     
     BEGIN_BCS_BATCH(batch, 2);
@@ -2325,6 +2172,9 @@ intel_mfc_mpeg2_prepare(VADriverContextP ctx,
     coded_buffer_segment = (struct i965_coded_buffer_segment *)bo->virtual;
     coded_buffer_segment->mapped = 0;
     coded_buffer_segment->codec = encoder_context->codec;
+    coded_buffer_segment->coded_size = I965_CODED_SIZE_UNKNOWN;
+    coded_buffer_segment->status = 0;
+    coded_buffer_segment->num_slices = 0;
     dri_bo_unmap(bo);
 
     return vaStatus;
@@ -2350,6 +2200,8 @@ gen8_mfc_context_destroy(void *context)
     struct gen6_mfc_context *mfc_context = context;
     int i;
 
+    intel_mfc_brc_terminate(mfc_context);
+
     dri_bo_unreference(mfc_context->post_deblocking_output.bo);
     mfc_context->post_deblocking_output.bo = NULL;
 
@@ -2398,6 +2250,7 @@ gen8_mfc_context_destroy(void *context)
 
     mfc_context->aux_batchbuffer = NULL;
 
+    free(mfc_context->mb_qp_delta);
     free(mfc_context);
 }
 
@@ -2435,6 +2288,8 @@ Bool gen8_mfc_context_init(VADriverContextP ctx, struct intel_encoder_context *e
 {
     struct gen6_mfc_context *mfc_context = calloc(1, sizeof(struct gen6_mfc_context));
 
+    i965_scene_detector_init(&mfc_context->scene_detector);
+
     mfc_context->gpe_context.surface_state_binding_table.length = (SURFACE_STATE_PADDED_SIZE + sizeof(unsigned int)) * MAX_MEDIA_SURFACES_GEN6;
 
     mfc_context->gpe_context.idrt.max_entries = MAX_GPE_KERNELS;
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The software generated AVC PAK objects of gen8, from the VME output.
+ * This is plain CPU work so it can run on the worker pool.
+ */
+
+#include "sysdeps.h"
+#include "i965_defines.h"
+#include "gen6_mfc.h"
+#include "gen8_mfc_pak.h"
+
+#define		INTER_MODE_MASK		0x03
+#define		INTER_8X8		0x03
+#define		INTER_16X8		0x01
+#define		INTER_8X16		0x02
+#define		SUBMB_SHAPE_MASK	0x00FF00
+
+#define		INTER_MV8		(4 << 20)
+#define		INTER_MV32		(6 << 20)
+
+static int
+gen8_mfc_avc_pak_object_intra(unsigned int *command, int x, int y, int end_mb,
+                              int qp,unsigned int *msg,
+                              unsigned char target_mb_size, unsigned char max_mb_size)
+{
+    int len_in_dwords = PAK_OBJECT_IN_DWS;
+    unsigned int intra_msg;
+#define		INTRA_MSG_FLAG		(1 << 13)
+#define		INTRA_MBTYPE_MASK	(0x1F0000)
+
+    intra_msg = msg[0] & 0xC0FF;
+    intra_msg |= INTRA_MSG_FLAG;
+    intra_msg |= ((msg[0] & INTRA_MBTYPE_MASK) >> 8);
+    *command++ = MFC_AVC_PAK_OBJECT | (len_in_dwords - 2);
+    *command++ = 0;
+    *command++ = 0;
+    *command++ = 
+        (0 << 24) |		/* PackedMvNum, Debug*/
+        (0 << 20) | 		/* No motion vector */
+        (1 << 19) |		/* CbpDcY */
+        (1 << 18) |		/* CbpDcU */
+        (1 << 17) |		/* CbpDcV */
+        intra_msg;
+
+    *command++ = (0xFFFF << 16) | (y << 8) | x;		/* Code Block Pattern for Y*/
+    *command++ = 0x000F000F;					/* Code Block Pattern */		
+    *command++ = (0 << 27) | (end_mb << 26) | qp;	/* Last MB */
+
+    /*Stuff for Intra MB*/
+    *command++ = msg[1];			/* We using Intra16x16 no 4x4 predmode*/	
+    *command++ = msg[2];	
+    *command++ = msg[3]&0xFF;	
+    
+    /*MaxSizeInWord and TargetSzieInWord*/
+    *command++ = (max_mb_size << 24) |
+        (target_mb_size << 16);
+
+    *command++ = 0;
+
+    return len_in_dwords;
+}
+
+static int
+gen8_mfc_avc_pak_object_inter(unsigned int *command, int x, int y, int end_mb, int qp,
+                              unsigned int *msg, unsigned int offset,
+                              const unsigned int *ref_index_in_mb,
+                              unsigned char target_mb_size,unsigned char max_mb_size, int slice_type)
+{
+    int len_in_dwords = PAK_OBJECT_IN_DWS;
+    unsigned int inter_msg = 0;
+    {
+#define MSG_MV_OFFSET	4
+	unsigned int *mv_ptr;
+	mv_ptr = msg + MSG_MV_OFFSET;
+	/* MV of VME output is based on 16 sub-blocks. So it is necessary
+         * to convert them to be compatible with the format of AVC_PAK
+         * command.
+         */
+	if ((msg[0] & INTER_MODE_MASK) == INTER_8X16) {
+            /* MV[0] and MV[2] are replicated */
+            mv_ptr[4] = mv_ptr[0];
+            mv_ptr[5] = mv_ptr[1];
+            mv_ptr[2] = mv_ptr[8];
+            mv_ptr[3] = mv_ptr[9];
+            mv_ptr[6] = mv_ptr[8];
+            mv_ptr[7] = mv_ptr[9];
+	} else if ((msg[0] & INTER_MODE_MASK) == INTER_16X8) {
+            /* MV[0] and MV[1] are replicated */
+            mv_ptr[2] = mv_ptr[0];
+            mv_ptr[3] = mv_ptr[1];
+            mv_ptr[4] = mv_ptr[16];
+            mv_ptr[5] = mv_ptr[17];
+            mv_ptr[6] = mv_ptr[24];
+            mv_ptr[7] = mv_ptr[25];
+	} else if (((msg[0] & INTER_MODE_MASK) == INTER_8X8) &&
+                   !(msg[1] & SUBMB_SHAPE_MASK)) {
+            /* Don't touch MV[0] or MV[1] */
+            mv_ptr[2] = mv_ptr[8];
+            mv_ptr[3] = mv_ptr[9];
+            mv_ptr[4] = mv_ptr[16];
+            mv_ptr[5] = mv_ptr[17];
+            mv_ptr[6] = mv_ptr[24];
+            mv_ptr[7] = mv_ptr[25];
+	}
+    }
+
+    *command++ = MFC_AVC_PAK_OBJECT | (len_in_dwords - 2);
+
+    inter_msg = 32;
+    /* MV quantity */
+    if ((msg[0] & INTER_MODE_MASK) == INTER_8X8) {
+        if (msg[1] & SUBMB_SHAPE_MASK)
+            inter_msg = 128;
+    }
+    *command++ = inter_msg;         /* 32 MV*/
+    *command++ = offset;
+    inter_msg = msg[0] & (0x1F00FFFF);
+    inter_msg |= INTER_MV8;
+    inter_msg |= ((1 << 19) | (1 << 18) | (1 << 17));
+    if (((msg[0] & INTER_MODE_MASK) == INTER_8X8) &&
+        (msg[1] & SUBMB_SHAPE_MASK)) {
+        inter_msg |= INTER_MV32;
+    }
+
+    *command++ = inter_msg;
+
+    *command++ = (0xFFFF<<16) | (y << 8) | x;        /* Code Block Pattern for Y*/
+    *command++ = 0x000F000F;                         /* Code Block Pattern */  
+#if 0 
+    if ( slice_type == SLICE_TYPE_B) {
+        *command++ = (0xF<<28) | (end_mb << 26) | qp;	/* Last MB */
+    } else {
+        *command++ = (end_mb << 26) | qp;	/* Last MB */
+    }
+#else
+    *command++ = (end_mb << 26) | qp;	/* Last MB */
+#endif
+
+    inter_msg = msg[1] >> 8;
+    /*Stuff for Inter MB*/
+    *command++ = inter_msg;        
+    *command++ = ref_index_in_mb[0];
+    *command++ = ref_index_in_mb[1];
+
+    /*MaxSizeInWord and TargetSzieInWord*/
+    *command++ = (max_mb_size << 24) |
+        (target_mb_size << 16);
+
+    *command++ = 0x0;    
+
+    return len_in_dwords;
+}
+
+/* MBs per band of the PAK objects generated by the worker pool */
+#define		PAK_OBJECT_BAND_MBS	2048
+
+static void
+gen8_mfc_avc_pak_object(struct gen8_mfc_avc_pak_job *job,
+                        struct gen8_mfc_avc_pak_slice *slice,
+                        int i)
+{
+    unsigned int *command = slice->command + (i - slice->first_mb) * PAK_OBJECT_IN_DWS;
+    unsigned int *msg, offset;
+    int last_mb = (i == slice->first_mb + slice->num_mbs - 1);
+    int x = i % job->width_in_mbs;
+    int y = i / job->width_in_mbs;
+    int mb_qp = slice->qp;
+
+    if (job->row_qp_delta)
+        mb_qp += job->row_qp_delta[y];
+
+    if (job->mb_qp_delta) {
+        mb_qp += job->mb_qp_delta[i];
+        mb_qp = MIN(MAX(mb_qp, 0), 51);
+    }
+
+    msg = (unsigned int *) (job->msg_ptr + i * job->msg_size);
+
+    if (slice->slice_type == SLICE_TYPE_I) {
+        gen8_mfc_avc_pak_object_intra(command, x, y, last_mb, mb_qp, msg, 0, 0);
+    } else {
+        int inter_rdo, intra_rdo;
+        inter_rdo = msg[AVC_INTER_RDO_OFFSET] & AVC_RDO_MASK;
+        intra_rdo = msg[AVC_INTRA_RDO_OFFSET] & AVC_RDO_MASK;
+        offset = i * job->msg_size + AVC_INTER_MV_OFFSET;
+        if (intra_rdo < inter_rdo) { 
+            gen8_mfc_avc_pak_object_intra(command, x, y, last_mb, mb_qp, msg, 0, 0);
+        } else {
+            msg += AVC_INTER_MSG_OFFSET;
+            gen8_mfc_avc_pak_object_inter(command, x, y, last_mb, mb_qp, msg, offset, job->ref_index_in_mb, 0, 0, slice->slice_type);
+        }
+    }
+}
+
+/* Generates the PAK objects of MBs [first, last) of the frame */
+static void
+gen8_mfc_avc_pak_band(void *data, unsigned int first, unsigned int last)
+{
+    struct gen8_mfc_avc_pak_job *job = data;
+    int i, mb;
+
+    for (i = 0; i < job->num_slices; i++) {
+        struct gen8_mfc_avc_pak_slice *slice = &job->slices[i];
+        int end_mb = MIN(last, slice->first_mb + slice->num_mbs);
+
+        for (mb = MAX(first, slice->first_mb); mb < end_mb; mb++)
+            gen8_mfc_avc_pak_object(job, slice, mb);
+    }
+}
+
+void
+gen8_mfc_avc_pak_objects(struct i965_worker_pool *pool,
+                         struct gen8_mfc_avc_pak_job *job,
+                         int num_mbs)
+{
+    i965_worker_pool_run_bands(pool, gen8_mfc_avc_pak_band, job,
+                               num_mbs, num_mbs / PAK_OBJECT_BAND_MBS);
+}
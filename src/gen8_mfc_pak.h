@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GEN8_MFC_PAK_H
+#define GEN8_MFC_PAK_H
+
+#include "i965_worker_pool.h"
+
+/*
+ * The PAK objects are written straight to the slice batch, at a place
+ * reserved for them, so the ones of different MBs can be generated
+ * concurrently
+ */
+#define		PAK_OBJECT_IN_DWS	12
+
+/* The PAK objects of a slice, filled in once all the slice batches are built */
+struct gen8_mfc_avc_pak_slice
+{
+    unsigned int *command;
+    int first_mb;
+    int num_mbs;
+    int qp;
+    int slice_type;
+};
+
+/* The PAK objects of a frame and the VME output they are generated from */
+struct gen8_mfc_avc_pak_job
+{
+    unsigned char *msg_ptr;
+    unsigned int msg_size;                      /* VME output bytes per MB */
+    unsigned int ref_index_in_mb[2];
+    const signed char *row_qp_delta;            /* per MB row, or NULL */
+    const signed char *mb_qp_delta;             /* per MB, or NULL */
+    int width_in_mbs;
+    int num_slices;
+    struct gen8_mfc_avc_pak_slice *slices;
+};
+
+/* Generates the PAK objects of the num_mbs MBs of the frame in bands on pool */
+void
+gen8_mfc_avc_pak_objects(struct i965_worker_pool *pool,
+                         struct gen8_mfc_avc_pak_job *job,
+                         int num_mbs);
+
+#endif /* GEN8_MFC_PAK_H */
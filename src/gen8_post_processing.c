@@ -1279,6 +1279,20 @@ gen8_pp_object_walker(VADriverContextP ctx,
 
     dri_bo_unmap(command_buffer);
 
+    if (pp_context->batched) {
+        /* MI_BATCH_BUFFER_END of a second level batch returns to the batch */
+        BEGIN_BATCH(batch, 3);
+        OUT_BATCH(batch, MI_BATCH_BUFFER_START | (1 << 22) | (1 << 8) | (1 << 0));
+        OUT_RELOC(batch, command_buffer,
+                  I915_GEM_DOMAIN_COMMAND, 0, 0);
+        OUT_BATCH(batch, 0);
+        ADVANCE_BATCH(batch);
+
+        dri_bo_unreference(command_buffer);
+
+        return;
+    }
+
     BEGIN_BATCH(batch, 3);
     OUT_BATCH(batch, MI_BATCH_BUFFER_START | (1 << 8) | (1 << 0));
     OUT_RELOC(batch, command_buffer,
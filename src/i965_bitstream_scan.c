@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "i965_bitstream_scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define I965_SCAN_X86           1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define I965_SCAN_NEON          1
+#include <arm_neon.h>
+#endif
+
+typedef size_t (*i965_scan_func)(const uint8_t *buf, size_t size, uint8_t third);
+
+/* Finds 00 00 third in [start, size) without vector loads */
+static size_t
+scan_c(const uint8_t *buf, size_t start, size_t size, uint8_t third)
+{
+    size_t i;
+
+    for (i = start; i + 2 < size; i++) {
+        /* buf[i + 1] must be 0 for a match, skip two bytes when it is not */
+        if (buf[i + 1]) {
+            i++;
+            continue;
+        }
+
+        if (!buf[i] && buf[i + 2] == third)
+            return i;
+    }
+
+    return size;
+}
+
+static size_t
+scan_scalar(const uint8_t *buf, size_t size, uint8_t third)
+{
+    return scan_c(buf, 0, size, third);
+}
+
+static size_t
+scan_default(const uint8_t *buf, size_t size, uint8_t third)
+{
+    size_t i = 0;
+
+#if defined(I965_SCAN_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t t = vdupq_n_u8(third);
+
+    for (; i + 18 <= size; i += 16) {
+        uint8x16_t a = vld1q_u8(buf + i);
+        uint8x16_t b = vld1q_u8(buf + i + 1);
+        uint8x16_t c = vld1q_u8(buf + i + 2);
+        uint8x16_t m = vandq_u8(vandq_u8(vceqq_u8(a, zero), vceqq_u8(b, zero)), vceqq_u8(c, t));
+
+        if (vmaxvq_u8(m))
+            return scan_c(buf, i, i + 18, third);
+    }
+#elif defined(I965_SCAN_X86) && defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i t = _mm_set1_epi8(third);
+
+    for (; i + 18 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(buf + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(buf + i + 1));
+        __m128i c = _mm_loadu_si128((const __m128i *)(buf + i + 2));
+        int m = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(a, zero),
+                                                              _mm_cmpeq_epi8(b, zero)),
+                                                _mm_cmpeq_epi8(c, t)));
+
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+#endif
+
+    return scan_c(buf, i, size, third);
+}
+
+#ifdef I965_SCAN_X86
+
+__attribute__((target("avx2"))) static size_t
+scan_avx2(const uint8_t *buf, size_t size, uint8_t third)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i t = _mm256_set1_epi8(third);
+    size_t i = 0;
+
+    for (; i + 34 <= size; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(buf + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(buf + i + 1));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(buf + i + 2));
+        unsigned int m = _mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(a, zero),
+                                                                                _mm256_cmpeq_epi8(b, zero)),
+                                                               _mm256_cmpeq_epi8(c, t)));
+
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+
+    return scan_c(buf, i, size, third);
+}
+
+#endif
+
+static i965_scan_func i965_scan = NULL;
+
+static size_t
+i965_bitstream_scan(const uint8_t *buf, size_t size, uint8_t third)
+{
+    /* Racing threads all store the same value */
+    if (!i965_scan) {
+#ifdef I965_SCAN_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+            i965_scan = scan_avx2;
+        else
+#endif
+            i965_scan = scan_default;
+    }
+
+    return i965_scan(buf, size, third);
+}
+
+int
+i965_bitstream_scan_set_kernel(int kernel)
+{
+    switch (kernel) {
+    case I965_BITSTREAM_SCAN_C:
+        i965_scan = scan_scalar;
+        return 1;
+
+#if defined(I965_SCAN_NEON) || (defined(I965_SCAN_X86) && defined(__SSE2__))
+    case I965_BITSTREAM_SCAN_SSE2:
+        i965_scan = scan_default;
+        return 1;
+#endif
+
+#ifdef I965_SCAN_X86
+    case I965_BITSTREAM_SCAN_AVX2:
+        __builtin_cpu_init();
+
+        if (!__builtin_cpu_supports("avx2"))
+            return 0;
+
+        i965_scan = scan_avx2;
+        return 1;
+#endif
+
+    default:
+        return 0;
+    }
+}
+
+size_t
+i965_bitstream_find_start_code(const uint8_t *buf, size_t size)
+{
+    return i965_bitstream_scan(buf, size, 0x01);
+}
+
+size_t
+i965_bitstream_find_epb(const uint8_t *buf, size_t size)
+{
+    return i965_bitstream_scan(buf, size, 0x03);
+}
+
+size_t
+i965_bitstream_find_pattern(const uint8_t *buf, size_t size,
+                            const uint8_t *pattern, size_t pattern_size)
+{
+    size_t pos = 0;
+
+    assert(pattern_size >= 3 && !pattern[0] && !pattern[1]);
+
+    while (pos + pattern_size <= size) {
+        size_t q = pos + i965_bitstream_scan(buf + pos, size - pos, pattern[2]);
+
+        if (q + pattern_size > size)
+            break;
+
+        if (!memcmp(buf + q + 3, pattern + 3, pattern_size - 3))
+            return q;
+
+        pos = q + 1;
+    }
+
+    return size;
+}
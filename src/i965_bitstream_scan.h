@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_BITSTREAM_SCAN_H
+#define I965_BITSTREAM_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Byte pattern searches over CPU-visible bitstreams. Both return the
+ * offset of the first byte of the pattern, or size if the whole pattern
+ * does not occur in the buffer.
+ */
+
+#define I965_BITSTREAM_SCAN_C           0
+#define I965_BITSTREAM_SCAN_SSE2        1       /* NEON on aarch64 */
+#define I965_BITSTREAM_SCAN_AVX2        2
+
+/*
+ * Forces the search kernel, for the tests and benchmarks. By default the
+ * best one the CPU supports is used. Returns 0 if the CPU lacks it.
+ */
+int
+i965_bitstream_scan_set_kernel(int kernel);
+
+/* 00 00 01 */
+size_t
+i965_bitstream_find_start_code(const uint8_t *buf, size_t size);
+
+/* 00 00 03, the emulation prevention sequence of H.264 and VC-1 */
+size_t
+i965_bitstream_find_epb(const uint8_t *buf, size_t size);
+
+/*
+ * Any pattern of at least 3 bytes starting with 00 00, such as the
+ * delimiters the encoders leave after the coded data
+ */
+size_t
+i965_bitstream_find_pattern(const uint8_t *buf, size_t size,
+                            const uint8_t *pattern, size_t pattern_size);
+
+#endif /* I965_BITSTREAM_SCAN_H */
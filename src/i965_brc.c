@@ -0,0 +1,550 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <va/va.h>
+
+#include "i965_defines.h"
+#include "i965_brc.h"
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define BRC_CLIP(x, min, max)                                   \
+    {                                                           \
+        x = ((x > (max)) ? (max) : ((x < (min)) ? (min) : x));  \
+    }
+
+#define BRC_P_B_QP_DIFF 4
+#define BRC_I_P_QP_DIFF 2
+#define BRC_I_B_QP_DIFF (BRC_I_P_QP_DIFF + BRC_P_B_QP_DIFF)
+
+#define BRC_PWEIGHT 0.6  /* weight if P slice with comparison to I slice */
+#define BRC_BWEIGHT 0.25 /* weight if B slice with comparison to I slice */
+
+#define BRC_QP_MAX_CHANGE 5 /* maximum qp modification */
+
+#define BRC_PI_0_5 1.5707963267948966192313216916398
+
+/* margin kept from the HRD buffer borders when a frame is coded again */
+#define BRC_REENCODE_MARGIN 0.1
+
+/*
+ * VBR frame budgets grow with the VME cost to this power, less than
+ * linearly so that complex frames are coded at a somewhat higher QP
+ */
+#define BRC_VBR_COMPLEXITY_EXP 0.6
+
+void
+i965_brc_init(struct i965_brc *brc, const struct i965_brc_params *params)
+{
+    double bitrate = params->bits_per_second;
+    double max_bitrate = params->max_bits_per_second;
+    double framerate = params->frame_rate;
+    int inum = 1, pnum = 0, bnum = 0; /* Gop structure: number of I, P, B frames in the Gop. */
+    int intra_period = params->intra_period;
+    int ip_period = params->ip_period;
+    double qp1_size = 0.1 * 8 * 3 * (params->width_in_mbs << 4) * (params->height_in_mbs << 4) / 2;
+    double qp51_size = 0.001 * 8 * 3 * (params->width_in_mbs << 4) * (params->height_in_mbs << 4) / 2;
+    double bpf, cost_model[3];
+    int qp;
+
+    /* what has been learnt about the content survives a new bitrate */
+    memcpy(cost_model, brc->cost_model, sizeof(cost_model));
+
+    if (!brc->initialized)
+        memset(cost_model, 0, sizeof(cost_model));
+
+    memset(brc, 0, sizeof(*brc));
+    memcpy(brc->cost_model, cost_model, sizeof(cost_model));
+    brc->params = *params;
+    brc->initialized = 1;
+
+    if (ip_period) {
+        pnum = (intra_period + ip_period - 1) / ip_period - 1;
+        bnum = intra_period - inum - pnum;
+    }
+
+    brc->target_frame_size[SLICE_TYPE_I] = (int)((double)((bitrate * intra_period) / framerate) /
+                                                 (double)(inum + BRC_PWEIGHT * pnum + BRC_BWEIGHT * bnum));
+    brc->target_frame_size[SLICE_TYPE_P] = BRC_PWEIGHT * brc->target_frame_size[SLICE_TYPE_I];
+    brc->target_frame_size[SLICE_TYPE_B] = BRC_BWEIGHT * brc->target_frame_size[SLICE_TYPE_I];
+
+    brc->gop_nums[SLICE_TYPE_I] = inum;
+    brc->gop_nums[SLICE_TYPE_P] = pnum;
+    brc->gop_nums[SLICE_TYPE_B] = bnum;
+
+    bpf = brc->target_bits_per_frame = bitrate / framerate;
+
+    if (params->mode != VA_RC_VBR || max_bitrate < bitrate)
+        max_bitrate = bitrate;
+
+    brc->bits_per_frame = max_bitrate / framerate;
+
+    brc->hrd.buffer_size = params->buffer_size;
+    brc->hrd.current_buffer_fullness =
+        (params->initial_buffer_fullness < brc->hrd.buffer_size) ?
+        params->initial_buffer_fullness : brc->hrd.buffer_size / 2.;
+    brc->hrd.target_buffer_fullness = (double)brc->hrd.buffer_size / 2.;
+    brc->hrd.buffer_capacity = (double)brc->hrd.buffer_size / qp1_size;
+    brc->hrd.violation_noted = 0;
+
+    if ((bpf > qp51_size) && (bpf < qp1_size))
+        qp = 51 - 50 * (bpf - qp51_size) / (qp1_size - qp51_size);
+    else if (bpf >= qp1_size)
+        qp = 1;
+    else
+        qp = 51;
+
+    BRC_CLIP(qp, I965_BRC_MIN_QP, I965_BRC_MAX_QP);
+    brc->qp[SLICE_TYPE_I] = qp;
+    brc->qp[SLICE_TYPE_P] = qp;
+    brc->qp[SLICE_TYPE_B] = qp;
+}
+
+int
+i965_brc_params_changed(const struct i965_brc *brc,
+                        const struct i965_brc_params *params)
+{
+    const struct i965_brc_params *saved = &brc->params;
+
+    return (!brc->initialized ||
+            saved->mode != params->mode ||
+            saved->bits_per_second != params->bits_per_second ||
+            saved->max_bits_per_second != params->max_bits_per_second ||
+            saved->window_frames != params->window_frames ||
+            saved->buffer_size != params->buffer_size ||
+            saved->frame_rate != params->frame_rate ||
+            saved->intra_period != params->intra_period ||
+            saved->ip_period != params->ip_period ||
+            saved->idr_period != params->idr_period ||
+            saved->width_in_mbs != params->width_in_mbs ||
+            saved->height_in_mbs != params->height_in_mbs);
+}
+
+/* the slice type whose QP, targets and cost model fit the frame being coded */
+static int
+i965_brc_model_type(const struct i965_brc *brc, int slice_type)
+{
+    return brc->scene_change ? SLICE_TYPE_I : slice_type;
+}
+
+int
+i965_brc_get_qp(const struct i965_brc *brc, int slice_type)
+{
+    if (!brc->initialized)
+        return I965_BRC_DEFAULT_QP;
+
+    return brc->qp[i965_brc_model_type(brc, slice_type)];
+}
+
+static i965_brc_status
+i965_brc_update_hrd(struct i965_brc *brc, int frame_bits)
+{
+    double prev_bf = brc->hrd.current_buffer_fullness;
+
+    brc->hrd.current_buffer_fullness -= frame_bits;
+
+    if (brc->hrd.buffer_size > 0 && brc->hrd.current_buffer_fullness <= 0.) {
+        brc->hrd.current_buffer_fullness = prev_bf;
+        return BRC_UNDERFLOW;
+    }
+
+    brc->hrd.current_buffer_fullness += brc->bits_per_frame;
+    if (brc->hrd.buffer_size > 0 && brc->hrd.current_buffer_fullness > brc->hrd.buffer_size) {
+        if (brc->params.mode == VA_RC_VBR)
+            brc->hrd.current_buffer_fullness = brc->hrd.buffer_size;
+        else {
+            brc->hrd.current_buffer_fullness = prev_bf;
+            return BRC_OVERFLOW;
+        }
+    }
+    return BRC_NO_HRD_VIOLATION;
+}
+
+/*
+ * The coded size roughly halves for every 6 QP steps, so this is the QP
+ * increase expected to bring a frame of from_bits down to to_bits.
+ */
+static int
+i965_brc_qp_distance(double from_bits, double to_bits)
+{
+    if (from_bits < 1.)
+        from_bits = 1.;
+
+    if (to_bits < 1.)
+        to_bits = 1.;
+
+    return (int)ceil(6. * log2(from_bits / to_bits));
+}
+
+static double
+i965_brc_qp_scale(double qp)
+{
+    return exp2(-qp / 6.);
+}
+
+/*
+ * The budget of a VBR frame: the target of its slice type scaled by how
+ * its cost compares to the average of the window, less a share of the
+ * bits spent above the targets so far
+ */
+static double
+i965_brc_vbr_budget(struct i965_brc *brc, int slice_type, double cost)
+{
+    double target = brc->target_frame_size[slice_type];
+    double budget;
+
+    if (!brc->window_count[slice_type])
+        return 0.;
+
+    budget = target * pow(cost / brc->window_cost[slice_type], BRC_VBR_COMPLEXITY_EXP);
+    budget -= brc->window_debt / brc->params.window_frames;
+
+    if (budget < target * 0.25)
+        budget = target * 0.25;
+
+    return budget;
+}
+
+static void
+i965_brc_vbr_update(struct i965_brc *brc, int slice_type, int frame_bits)
+{
+    unsigned int window = brc->params.window_frames;
+    unsigned int n;
+
+    if (brc->params.mode != VA_RC_VBR || !window)
+        return;
+
+    brc->window_debt += frame_bits - brc->target_frame_size[slice_type];
+    brc->window_debt -= brc->window_debt / window;
+
+    if (brc->frame_cost <= 0.)
+        return;
+
+    n = MIN(brc->window_count[slice_type] + 1, window);
+    brc->window_cost[slice_type] += (brc->frame_cost - brc->window_cost[slice_type]) / n;
+    brc->window_count[slice_type] = n;
+}
+
+void
+i965_brc_row_qp(struct i965_brc *brc, int slice_type,
+                const unsigned int *row_cost, int num_rows,
+                signed char *row_delta)
+{
+    int qp = i965_brc_get_qp(brc, slice_type);
+    double cost = 0., predicted, upper, lower, delta = 0., error = 0.;
+    int i, qp_sum = 0;
+
+    for (i = 0; i < num_rows; i++)
+        cost += row_cost[i];
+
+    brc->frame_cost = cost;
+    brc->frame_qp = qp;
+    brc->frame_budget = 0.;
+
+    if (num_rows <= 0)
+        return;
+
+    memset(row_delta, 0, num_rows);
+
+    if (!brc->initialized || cost <= 0.)
+        return;
+
+    slice_type = i965_brc_model_type(brc, slice_type);
+
+    if (brc->params.mode == VA_RC_VBR && brc->params.window_frames)
+        brc->frame_budget = i965_brc_vbr_budget(brc, slice_type, cost);
+
+    if (brc->cost_model[slice_type] <= 0.)
+        return;
+
+    predicted = brc->cost_model[slice_type] * cost * i965_brc_qp_scale(qp);
+
+    /* move the frame towards its budget, as fast as the QP may change */
+    if (brc->frame_budget > 0.) {
+        delta = 6. * log2(predicted / brc->frame_budget);
+
+        if (delta > BRC_QP_MAX_CHANGE)
+            delta = BRC_QP_MAX_CHANGE;
+        else if (delta < -BRC_QP_MAX_CHANGE)
+            delta = -BRC_QP_MAX_CHANGE;
+
+        predicted *= i965_brc_qp_scale(delta);
+    }
+
+    /* but keep it within the HRD buffer */
+    if (brc->hrd.buffer_size > 0) {
+        upper = brc->hrd.current_buffer_fullness * (1. - BRC_REENCODE_MARGIN);
+        lower = (brc->hrd.current_buffer_fullness + brc->bits_per_frame - brc->hrd.buffer_size) *
+            (1. + BRC_REENCODE_MARGIN);
+
+        if (predicted > upper)
+            delta += 6. * log2(predicted / MAX(upper, 1.));
+        else if (brc->params.mode != VA_RC_VBR && lower > 0. && predicted < lower)
+            delta -= 6. * log2(lower / MAX(predicted, 1.));
+    }
+
+    if (delta == 0.)
+        return;
+
+    if (delta > I965_BRC_MAX_ROW_DELTA)
+        delta = I965_BRC_MAX_ROW_DELTA;
+    else if (delta < -I965_BRC_MAX_ROW_DELTA)
+        delta = -I965_BRC_MAX_ROW_DELTA;
+
+    /* spread the fractional part of the offset over the rows */
+    for (i = 0; i < num_rows; i++) {
+        int row_qp;
+
+        error += delta;
+        row_qp = qp + (int)floor(error + 0.5);
+        error -= row_qp - qp;
+
+        BRC_CLIP(row_qp, I965_BRC_MIN_QP, I965_BRC_MAX_QP);
+        row_delta[i] = row_qp - qp;
+        qp_sum += row_qp;
+    }
+
+    brc->frame_qp = (double)qp_sum / num_rows;
+    brc->stats.num_row_qp_frames++;
+}
+
+/* Learn the coded size per unit of VME cost from the last pass */
+static void
+i965_brc_update_cost_model(struct i965_brc *brc, int slicetype, int frame_bits)
+{
+    double model;
+
+    if (brc->frame_cost <= 0.)
+        return;
+
+    model = frame_bits / (brc->frame_cost * i965_brc_qp_scale(brc->frame_qp));
+
+    if (brc->cost_model[slicetype] > 0.)
+        model = (brc->cost_model[slicetype] + model) / 2.;
+
+    brc->cost_model[slicetype] = model;
+}
+
+/* Keep a frame whose HRD violation can't be repaired in the buffer model */
+static void
+i965_brc_force_hrd(struct i965_brc *brc, int frame_bits)
+{
+    brc->hrd.current_buffer_fullness -= frame_bits;
+
+    if (brc->hrd.current_buffer_fullness < 0.)
+        brc->hrd.current_buffer_fullness = 0.;
+
+    brc->hrd.current_buffer_fullness += brc->bits_per_frame;
+
+    if (brc->hrd.current_buffer_fullness > brc->hrd.buffer_size)
+        brc->hrd.current_buffer_fullness = brc->hrd.buffer_size;
+}
+
+i965_brc_status
+i965_brc_postpack(struct i965_brc *brc, int slicetype, int frame_bits)
+{
+    i965_brc_status sts = BRC_NO_HRD_VIOLATION;
+    int qpi = brc->qp[SLICE_TYPE_I];
+    int qpp = brc->qp[SLICE_TYPE_P];
+    int qpb = brc->qp[SLICE_TYPE_B];
+    int qp; // quantizer of previously encoded slice of current type
+    int qpn; // predicted quantizer for next frame of current type in integer format
+    double qpf; // predicted quantizer for next frame of current type in float format
+    double delta_qp; // QP correction
+    double prev_bf = brc->hrd.current_buffer_fullness;
+    int target_frame_size, frame_size_next;
+    /* Notes:
+     *  x - how far we are from HRD buffer borders
+     *  y - how far we are from target HRD buffer fullness
+     */
+    double x, y;
+    double frame_size_alpha;
+
+    /* the first frame of a scene is an I frame as far as the rate control goes */
+    slicetype = i965_brc_model_type(brc, slicetype);
+
+    brc->num_passes++;
+    qp = brc->qp[slicetype];
+
+    i965_brc_update_cost_model(brc, slicetype, frame_bits);
+
+    target_frame_size = brc->target_frame_size[slicetype];
+    if (brc->frame_budget > 0.)
+        target_frame_size = brc->frame_budget;
+    if (brc->hrd.buffer_capacity < 5)
+        frame_size_alpha = 0;
+    else
+        frame_size_alpha = (double)brc->gop_nums[slicetype];
+    if (frame_size_alpha > 30) frame_size_alpha = 30;
+    frame_size_next = target_frame_size + (double)(target_frame_size - frame_bits) /
+        (double)(frame_size_alpha + 1.);
+
+    /* frame_size_next: avoiding negative number and too small value */
+    if ((double)frame_size_next < (double)(target_frame_size * 0.25))
+        frame_size_next = (int)((double)target_frame_size * 0.25);
+
+    qpf = (double)qp * target_frame_size / frame_size_next;
+    qpn = (int)(qpf + 0.5);
+
+    if (qpn == qp) {
+        /* setting qpn we round qpf making mistakes: now we are trying to compensate this */
+        brc->qpf_rounding_accumulator += qpf - qpn;
+        if (brc->qpf_rounding_accumulator > 1.0) {
+            qpn++;
+            brc->qpf_rounding_accumulator = 0.;
+        } else if (brc->qpf_rounding_accumulator < -1.0) {
+            qpn--;
+            brc->qpf_rounding_accumulator = 0.;
+        }
+    }
+    /* making sure that QP is not changing too fast */
+    if ((qpn - qp) > BRC_QP_MAX_CHANGE) qpn = qp + BRC_QP_MAX_CHANGE;
+    else if ((qpn - qp) < -BRC_QP_MAX_CHANGE) qpn = qp - BRC_QP_MAX_CHANGE;
+    /* making sure that with QP predictions we did do not leave QPs range */
+    BRC_CLIP(qpn, I965_BRC_MIN_QP, I965_BRC_MAX_QP);
+
+    /* checking wthether HRD compliance is still met */
+    sts = i965_brc_update_hrd(brc, frame_bits);
+
+    /* calculating QP delta as some function*/
+    if (brc->hrd.buffer_size > 0) {
+        x = brc->hrd.target_buffer_fullness - brc->hrd.current_buffer_fullness;
+        if (x > 0) {
+            x /= brc->hrd.target_buffer_fullness;
+            y = brc->hrd.current_buffer_fullness;
+        }
+        else {
+            x /= (brc->hrd.buffer_size - brc->hrd.target_buffer_fullness);
+            y = brc->hrd.buffer_size - brc->hrd.current_buffer_fullness;
+        }
+        if (y < 0.01) y = 0.01;
+        if (x > 1) x = 1;
+        else if (x < -1) x = -1;
+        /* a VBR buffer fills at the peak rate, only an emptying one matters */
+        if (brc->params.mode == VA_RC_VBR && x < 0) x = 0;
+
+        delta_qp = BRC_QP_MAX_CHANGE * exp(-1 / y) * sin(BRC_PI_0_5 * x);
+        qpn = (int)(qpn + delta_qp + 0.5);
+    }
+
+    /* making sure that with QP predictions we did do not leave QPs range */
+    BRC_CLIP(qpn, I965_BRC_MIN_QP, I965_BRC_MAX_QP);
+
+    if (sts == BRC_NO_HRD_VIOLATION) { // no HRD violation
+        /* correcting QPs of slices of other types */
+        if (slicetype == SLICE_TYPE_P) {
+            if (abs(qpn + BRC_P_B_QP_DIFF - qpb) > 2)
+                brc->qp[SLICE_TYPE_B] += (qpn + BRC_P_B_QP_DIFF - qpb) >> 1;
+            if (abs(qpn - BRC_I_P_QP_DIFF - qpi) > 2)
+                brc->qp[SLICE_TYPE_I] += (qpn - BRC_I_P_QP_DIFF - qpi) >> 1;
+        } else if (slicetype == SLICE_TYPE_I) {
+            if (abs(qpn + BRC_I_B_QP_DIFF - qpb) > 4)
+                brc->qp[SLICE_TYPE_B] += (qpn + BRC_I_B_QP_DIFF - qpb) >> 2;
+            if (abs(qpn + BRC_I_P_QP_DIFF - qpp) > 2)
+                brc->qp[SLICE_TYPE_P] += (qpn + BRC_I_P_QP_DIFF - qpp) >> 2;
+        } else { // SLICE_TYPE_B
+            if (abs(qpn - BRC_P_B_QP_DIFF - qpp) > 2)
+                brc->qp[SLICE_TYPE_P] += (qpn - BRC_P_B_QP_DIFF - qpp) >> 1;
+            if (abs(qpn - BRC_I_B_QP_DIFF - qpi) > 4)
+                brc->qp[SLICE_TYPE_I] += (qpn - BRC_I_B_QP_DIFF - qpi) >> 2;
+        }
+        BRC_CLIP(brc->qp[SLICE_TYPE_I], I965_BRC_MIN_QP, I965_BRC_MAX_QP);
+        BRC_CLIP(brc->qp[SLICE_TYPE_P], I965_BRC_MIN_QP, I965_BRC_MAX_QP);
+        BRC_CLIP(brc->qp[SLICE_TYPE_B], I965_BRC_MIN_QP, I965_BRC_MAX_QP);
+    } else if (sts == BRC_UNDERFLOW) { // underflow
+        /*
+         * Go straight to the QP expected to fit the frame in the buffer
+         * instead of spending a PAK pass per QP step
+         */
+        int step = i965_brc_qp_distance(frame_bits, prev_bf * (1. - BRC_REENCODE_MARGIN));
+
+        if (qpn < qp + step) qpn = qp + step;
+        if (qpn <= qp) qpn = qp + 1;
+        if (qpn > I965_BRC_MAX_QP)
+            qpn = I965_BRC_MAX_QP;
+        if (qp >= I965_BRC_MAX_QP)
+            sts = BRC_UNDERFLOW_WITH_MAX_QP; //underflow with maxQP
+        else if (brc->num_passes >= I965_BRC_MAX_PASSES)
+            sts = BRC_MAX_PASSES_SPENT;
+    } else if (sts == BRC_OVERFLOW) {
+        /* the smallest frame that keeps the buffer below its size */
+        int step = i965_brc_qp_distance((prev_bf + brc->bits_per_frame - brc->hrd.buffer_size) * (1. + BRC_REENCODE_MARGIN),
+                                        frame_bits);
+
+        if (qpn > qp - step) qpn = qp - step;
+        if (qpn >= qp) qpn = qp - 1;
+        if (qpn < I965_BRC_MIN_QP)
+            qpn = I965_BRC_MIN_QP;
+        if (qp <= I965_BRC_MIN_QP)
+            sts = BRC_OVERFLOW_WITH_MIN_QP; // bit stuffing to be done
+        else if (brc->num_passes >= I965_BRC_MAX_PASSES)
+            sts = BRC_MAX_PASSES_SPENT;
+    }
+
+    brc->qp[slicetype] = qpn;
+
+    if (sts == BRC_UNDERFLOW || sts == BRC_OVERFLOW)
+        return sts;
+
+    /* the frame is final */
+    if (sts != BRC_NO_HRD_VIOLATION) {
+        i965_brc_force_hrd(brc, frame_bits);
+        brc->stats.num_violations++;
+    }
+
+    brc->stats.num_frames++;
+    brc->stats.num_reencodes += brc->num_passes - 1;
+    brc->stats.passes[MIN(brc->num_passes, I965_BRC_MAX_PASSES) - 1]++;
+    brc->stats.total_bits += frame_bits;
+    brc->num_passes = 0;
+
+    i965_brc_vbr_update(brc, slicetype, frame_bits);
+    brc->frame_cost = 0.;
+    brc->frame_budget = 0.;
+    brc->scene_change = 0;
+
+    return sts;
+}
+
+void
+i965_brc_scene_change(struct i965_brc *brc)
+{
+    int i;
+
+    brc->scene_change = 1;
+    brc->stats.num_scene_changes++;
+
+    for (i = 0; i < 3; i++)
+        brc->window_count[i] = MIN(brc->window_count[i], 1);
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_BRC_H
+#define I965_BRC_H
+
+/*
+ * Frame level rate control for the AVC encoders. The state only depends
+ * on the sequence parameters and on the size of each coded frame, so the
+ * same code can be driven from recorded frame size traces on the CPU.
+ */
+
+#define I965_BRC_MIN_QP                 1
+#define I965_BRC_MAX_QP                 51
+#define I965_BRC_DEFAULT_QP             26
+
+/* PAK passes for one frame before its HRD violation is given up on */
+#define I965_BRC_MAX_PASSES             4
+
+/* Largest QP offset applied to a MB row by i965_brc_row_qp() */
+#define I965_BRC_MAX_ROW_DELTA          12
+
+/* Longest complexity window of the VBR mode, in frames */
+#define I965_BRC_MAX_WINDOW             300
+
+typedef enum _i965_brc_status
+{
+    BRC_NO_HRD_VIOLATION = 0,
+    BRC_UNDERFLOW = 1,
+    BRC_OVERFLOW = 2,
+    BRC_UNDERFLOW_WITH_MAX_QP = 3,
+    BRC_OVERFLOW_WITH_MIN_QP = 4,
+    BRC_MAX_PASSES_SPENT = 5,
+} i965_brc_status;
+
+/*
+ * For VA_RC_VBR, bits_per_second is the average rate and the HRD buffer,
+ * if any, fills at max_bits_per_second. The budget of each frame follows
+ * its VME cost relative to the frames of the complexity window, the rate
+ * converging to bits_per_second over the window; without an HRD buffer
+ * this is an average VBR.
+ */
+struct i965_brc_params
+{
+    unsigned int mode;                  /* VA_RC_CBR or VA_RC_VBR */
+    double bits_per_second;
+    double max_bits_per_second;         /* 0 for bits_per_second */
+    unsigned int window_frames;         /* 0 for no complexity window */
+    double frame_rate;
+    unsigned int intra_period;
+    unsigned int ip_period;
+    unsigned int idr_period;
+    unsigned int width_in_mbs;
+    unsigned int height_in_mbs;
+    unsigned int buffer_size;           /* HRD buffer in bits, 0 if none */
+    unsigned int initial_buffer_fullness;
+};
+
+struct i965_brc
+{
+    struct i965_brc_params params;
+    int initialized;
+
+    int qp[3];                          /* indexed by SLICE_TYPE_P/B/I */
+    int gop_nums[3];
+    int target_frame_size[3];
+    double bits_per_frame;              /* the HRD buffer fill per frame */
+    double target_bits_per_frame;
+    double qpf_rounding_accumulator;
+
+    struct {
+        double current_buffer_fullness;
+        double target_buffer_fullness;
+        double buffer_capacity;
+        unsigned int buffer_size;
+        unsigned int violation_noted;
+    } hrd;
+
+    /* PAK passes spent on the current frame */
+    unsigned int num_passes;
+
+    /*
+     * Coded bits per unit of VME cost at QP 0 for each slice type, learnt
+     * from the coded frames, and the cost and mean QP of the frame that is
+     * being coded with row QP offsets
+     */
+    double cost_model[3];
+    double frame_cost;
+    double frame_qp;
+
+    /*
+     * VBR: moving average of the VME cost of each slice type over the
+     * window, the bits spent above the targets, decaying over the window,
+     * and the budget planned for the frame being coded
+     */
+    double window_cost[3];
+    unsigned int window_count[3];
+    double window_debt;
+    double frame_budget;
+
+    /* the frame being coded starts a new scene, see i965_brc_scene_change() */
+    int scene_change;
+
+    struct {
+        unsigned int num_frames;
+        unsigned int num_reencodes;
+        unsigned int num_violations;
+        unsigned int num_row_qp_frames;
+        unsigned int num_scene_changes;
+        unsigned int passes[I965_BRC_MAX_PASSES];
+        double total_bits;
+    } stats;
+};
+
+void
+i965_brc_init(struct i965_brc *brc, const struct i965_brc_params *params);
+
+/* Whether the parameters differ from those brc was initialized with */
+int
+i965_brc_params_changed(const struct i965_brc *brc,
+                        const struct i965_brc_params *params);
+
+int
+i965_brc_get_qp(const struct i965_brc *brc, int slice_type);
+
+/*
+ * Account for a coded frame of frame_bits bits. On BRC_UNDERFLOW or
+ * BRC_OVERFLOW the frame should be coded again with the updated QP. The
+ * other statuses are final for the frame: BRC_*_WITH_M*_QP when the QP
+ * can't move any further, BRC_MAX_PASSES_SPENT when the HRD buffer is
+ * still violated after I965_BRC_MAX_PASSES passes but the QP could have
+ * been corrected further.
+ */
+i965_brc_status
+i965_brc_postpack(struct i965_brc *brc, int slice_type, int frame_bits);
+
+/*
+ * Predict the size of the next frame from the VME cost of each of its
+ * num_rows MB rows and fill row_delta with the QP offset of each row so
+ * that the frame is expected to fit in the HRD buffer without another
+ * pass, and to meet its budget with a VBR complexity window. The offsets
+ * are all 0 until a frame of that type has been coded.
+ */
+void
+i965_brc_row_qp(struct i965_brc *brc, int slice_type,
+                const unsigned int *row_cost, int num_rows,
+                signed char *row_delta);
+
+/*
+ * The next frame starts a new scene. Whatever its slice type, it is
+ * mostly intra coded, so it gets the QP, the budget and the size
+ * prediction of an I frame and only updates those, which keeps the QP of
+ * its own type from jumping over the following frames. The VBR window
+ * forgets most of the previous scene.
+ */
+void
+i965_brc_scene_change(struct i965_brc *brc);
+
+#endif /* I965_BRC_H */
@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Recycles the storage behind VA buffers. vaCreateBuffer()/vaDestroyBuffer()
+ * are called several times per picture, so the buffer_store headers, the
+ * CPU payloads of parameter buffers and the BOs of data buffers are kept
+ * in size-classed free lists instead of going back to the allocator.
+ */
+
+#include "sysdeps.h"
+
+#ifdef HAVE_DRM_INTEL_USERPTR
+# include <unistd.h>
+#endif
+
+#include "intel_driver.h"
+#include "i965_drv_video.h"
+#include "i965_buffer_pool.h"
+
+static int
+i965_buffer_pool_size_class(unsigned int size, int min_shift, int num_classes)
+{
+    int size_class = 0;
+
+    while (size_class < num_classes &&
+           (1U << (min_shift + size_class)) < size)
+        size_class++;
+
+    return size_class < num_classes ? size_class : -1;
+}
+
+static void *
+i965_buffer_pool_get_buffer(struct i965_buffer_pool *pool, int size_class)
+{
+    void *buffer;
+
+    _i965LockMutex(&pool->mutex);
+    buffer = pool->free_buffers[size_class];
+
+    if (buffer) {
+        pool->free_buffers[size_class] = *(void **)buffer;
+        pool->cached_size -= 1 << (I965_BUFFER_POOL_CPU_MIN_SHIFT + size_class);
+        pool->buffer_stats.hits++;
+    } else
+        pool->buffer_stats.misses++;
+    _i965UnlockMutex(&pool->mutex);
+
+    if (!buffer)
+        buffer = malloc(1 << (I965_BUFFER_POOL_CPU_MIN_SHIFT + size_class));
+
+    return buffer;
+}
+
+static dri_bo *
+i965_buffer_pool_get_bo(struct i965_buffer_pool *pool, int kind, int size_class)
+{
+    struct i965_buffer_pool_bo_class *bo_class = &pool->bo_classes[kind][size_class];
+    unsigned int size = 1 << (I965_BUFFER_POOL_BO_MIN_SHIFT + size_class);
+    dri_bo *bo = NULL;
+    int i;
+
+    _i965LockMutex(&pool->mutex);
+
+    /* Don't hand out a BO the GPU is still reading from */
+    for (i = bo_class->num_bos - 1; i >= 0; i--) {
+        if (!drm_intel_bo_busy(bo_class->bo[i])) {
+            bo = bo_class->bo[i];
+            bo_class->bo[i] = bo_class->bo[--bo_class->num_bos];
+            pool->cached_size -= size;
+            break;
+        }
+    }
+
+    if (bo)
+        pool->bo_stats.hits++;
+    else
+        pool->bo_stats.misses++;
+
+    _i965UnlockMutex(&pool->mutex);
+
+    if (!bo)
+        return dri_bo_alloc(pool->bufmgr, "Buffer", size, 64);
+
+    if (kind == I965_BUFFER_POOL_CODED) {
+        /* The end of the coded data is searched for, so the stale bitstream must go */
+        dri_bo_map(bo, 1);
+        memset(bo->virtual, 0, size);
+        dri_bo_unmap(bo);
+    }
+
+    return bo;
+}
+
+void
+i965_buffer_pool_init(struct i965_buffer_pool *pool, dri_bufmgr *bufmgr, size_t max_size)
+{
+    memset(pool, 0, sizeof(*pool));
+    _i965InitMutex(&pool->mutex);
+    pool->bufmgr = bufmgr;
+    pool->max_size = max_size;
+}
+
+void
+i965_buffer_pool_terminate(struct i965_buffer_pool *pool)
+{
+    struct buffer_store *buffer_store;
+    int i, j, k;
+
+    if (g_intel_debug_option_flags & VA_INTEL_DEBUG_OPTION_STATS) {
+        fprintf(stderr,
+                "buffer pool: store %u/%u, buffer %u/%u, bo %u/%u (hits/misses)\n",
+                pool->store_stats.hits, pool->store_stats.misses,
+                pool->buffer_stats.hits, pool->buffer_stats.misses,
+                pool->bo_stats.hits, pool->bo_stats.misses);
+    }
+
+    while ((buffer_store = pool->free_stores) != NULL) {
+        pool->free_stores = buffer_store->next_free;
+        free(buffer_store);
+    }
+
+    for (i = 0; i < I965_BUFFER_POOL_CPU_CLASSES; i++) {
+        void *buffer;
+
+        while ((buffer = pool->free_buffers[i]) != NULL) {
+            pool->free_buffers[i] = *(void **)buffer;
+            free(buffer);
+        }
+    }
+
+    for (i = 0; i < I965_BUFFER_POOL_KINDS; i++) {
+        for (j = 0; j < I965_BUFFER_POOL_BO_CLASSES; j++) {
+            struct i965_buffer_pool_bo_class *bo_class = &pool->bo_classes[i][j];
+
+            for (k = 0; k < bo_class->num_bos; k++)
+                dri_bo_unreference(bo_class->bo[k]);
+
+            bo_class->num_bos = 0;
+        }
+    }
+
+    pool->cached_size = 0;
+    _i965DestroyMutex(&pool->mutex);
+}
+
+struct buffer_store *
+i965_buffer_pool_create_store(struct i965_buffer_pool *pool, int kind, unsigned int size)
+{
+    struct buffer_store *buffer_store;
+    int size_class = -1;
+
+    _i965LockMutex(&pool->mutex);
+    buffer_store = pool->free_stores;
+
+    if (buffer_store) {
+        pool->free_stores = buffer_store->next_free;
+        pool->cached_size -= sizeof(*buffer_store);
+        pool->store_stats.hits++;
+    } else
+        pool->store_stats.misses++;
+    _i965UnlockMutex(&pool->mutex);
+
+    if (!buffer_store) {
+        buffer_store = malloc(sizeof(*buffer_store));
+
+        if (!buffer_store)
+            return NULL;
+    }
+
+    memset(buffer_store, 0, sizeof(*buffer_store));
+    buffer_store->ref_count = 1;
+    buffer_store->pool = pool;
+    buffer_store->pool_kind = kind;
+
+    if (kind == I965_BUFFER_POOL_CPU) {
+        size_class = i965_buffer_pool_size_class(size,
+                                                 I965_BUFFER_POOL_CPU_MIN_SHIFT,
+                                                 I965_BUFFER_POOL_CPU_CLASSES);
+
+        if (size_class >= 0)
+            buffer_store->buffer = i965_buffer_pool_get_buffer(pool, size_class);
+        else
+            buffer_store->buffer = malloc(size);
+
+        if (!buffer_store->buffer)
+            goto error;
+    } else if (kind != I965_BUFFER_POOL_NONE) {
+        size_class = i965_buffer_pool_size_class(size,
+                                                 I965_BUFFER_POOL_BO_MIN_SHIFT,
+                                                 I965_BUFFER_POOL_BO_CLASSES);
+
+        if (size_class >= 0)
+            buffer_store->bo = i965_buffer_pool_get_bo(pool, kind, size_class);
+        else
+            buffer_store->bo = dri_bo_alloc(pool->bufmgr, "Buffer", size, 64);
+
+        if (!buffer_store->bo)
+            goto error;
+    }
+
+    buffer_store->pool_class = size_class;
+
+    return buffer_store;
+
+error:
+    buffer_store->pool_class = -1;
+    buffer_store->ref_count = 0;
+    i965_buffer_pool_release_store(buffer_store);
+
+    return NULL;
+}
+
+void
+i965_buffer_pool_release_store(struct buffer_store *buffer_store)
+{
+    struct i965_buffer_pool *pool = buffer_store->pool;
+    int kind = buffer_store->pool_kind;
+    int size_class = buffer_store->pool_class;
+    unsigned char *buffer = buffer_store->buffer;
+    dri_bo *bo = buffer_store->bo;
+
+    assert(buffer_store->ref_count == 0);
+
+    buffer_store->buffer = NULL;
+    buffer_store->bo = NULL;
+
+    _i965LockMutex(&pool->mutex);
+
+    if (buffer && size_class >= 0) {
+        unsigned int size = 1 << (I965_BUFFER_POOL_CPU_MIN_SHIFT + size_class);
+
+        if (pool->cached_size + size <= pool->max_size) {
+            *(void **)buffer = pool->free_buffers[size_class];
+            pool->free_buffers[size_class] = buffer;
+            pool->cached_size += size;
+            buffer = NULL;
+        }
+    }
+
+    /* a surface may still wait on a fenced BO, recycling it would make it wait on unrelated work */
+    if (bo && kind != I965_BUFFER_POOL_NONE && size_class >= 0 && !buffer_store->fenced) {
+        struct i965_buffer_pool_bo_class *bo_class = &pool->bo_classes[kind][size_class];
+        unsigned int size = 1 << (I965_BUFFER_POOL_BO_MIN_SHIFT + size_class);
+
+        if (bo_class->num_bos < I965_BUFFER_POOL_BO_DEPTH &&
+            pool->cached_size + size <= pool->max_size) {
+            bo_class->bo[bo_class->num_bos++] = bo;
+            pool->cached_size += size;
+            bo = NULL;
+        }
+    }
+
+    if (pool->cached_size + sizeof(*buffer_store) <= pool->max_size) {
+        buffer_store->next_free = pool->free_stores;
+        pool->free_stores = buffer_store;
+        pool->cached_size += sizeof(*buffer_store);
+        buffer_store = NULL;
+    }
+
+    _i965UnlockMutex(&pool->mutex);
+
+    dri_bo_unreference(bo);
+    free(buffer);
+    free(buffer_store);
+}
+
+int
+i965_buffer_pool_has_userptr(VAEntrypoint entrypoint)
+{
+#ifdef HAVE_DRM_INTEL_USERPTR
+    return entrypoint == VAEntrypointVLD;
+#else
+    return 0;
+#endif
+}
+
+/* Returns NULL if the caller has to copy the data */
+static struct buffer_store *
+i965_buffer_pool_create_userptr_store(struct i965_buffer_pool *pool,
+                                      void *data,
+                                      unsigned int size)
+{
+#ifdef HAVE_DRM_INTEL_USERPTR
+    struct buffer_store *buffer_store;
+    long page_size = sysconf(_SC_PAGESIZE);
+    dri_bo *bo;
+
+    if (!data || page_size <= 0 || ((uintptr_t)data & (page_size - 1)))
+        return NULL;
+
+    /* The tail of the last page belongs to the caller's mapping too */
+    bo = drm_intel_bo_alloc_userptr(pool->bufmgr,
+                                    "Buffer (userptr)",
+                                    data,
+                                    I915_TILING_NONE,
+                                    0,
+                                    ALIGN(size, page_size),
+                                    0);
+
+    if (!bo)
+        return NULL;
+
+    buffer_store = i965_buffer_pool_create_store(pool, I965_BUFFER_POOL_NONE, 0);
+
+    if (!buffer_store) {
+        dri_bo_unreference(bo);
+        return NULL;
+    }
+
+    buffer_store->bo = bo;
+
+    return buffer_store;
+#else
+    return NULL;
+#endif
+}
+
+struct buffer_store *
+i965_buffer_pool_create_slice_data_store(struct i965_buffer_pool *pool,
+                                         void *data,
+                                         unsigned int size,
+                                         int userptr)
+{
+    struct buffer_store *buffer_store = NULL;
+
+    if (userptr)
+        buffer_store = i965_buffer_pool_create_userptr_store(pool, data, size);
+
+    if (buffer_store)
+        return buffer_store;
+
+    buffer_store = i965_buffer_pool_create_store(pool, I965_BUFFER_POOL_SLICE_DATA, size);
+
+    if (buffer_store && data)
+        dri_bo_subdata(buffer_store->bo, 0, size, data);
+
+    return buffer_store;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_BUFFER_POOL_H
+#define I965_BUFFER_POOL_H
+
+#include <intel_bufmgr.h>
+#include <va/va.h>
+
+#include "i965_mutext.h"
+
+/* Which kind of storage backs a buffer_store */
+#define I965_BUFFER_POOL_NONE           0       /* external BO, not recycled */
+#define I965_BUFFER_POOL_CPU            1
+#define I965_BUFFER_POOL_SLICE_DATA     2
+#define I965_BUFFER_POOL_IMAGE          3
+#define I965_BUFFER_POOL_CODED          4
+#define I965_BUFFER_POOL_PROBABILITY    5
+#define I965_BUFFER_POOL_KINDS          6
+
+/* CPU payloads are recycled from 64 bytes up to 1M */
+#define I965_BUFFER_POOL_CPU_MIN_SHIFT  6
+#define I965_BUFFER_POOL_CPU_CLASSES    15
+
+/* BOs are recycled from 4K up to 64M */
+#define I965_BUFFER_POOL_BO_MIN_SHIFT   12
+#define I965_BUFFER_POOL_BO_CLASSES     15
+#define I965_BUFFER_POOL_BO_DEPTH       8
+
+/* The default upper bound of the memory cached by the pool, in MB */
+#define I965_BUFFER_POOL_DEFAULT_SIZE   64
+
+struct buffer_store;
+
+struct i965_buffer_pool_stats
+{
+    unsigned int hits;
+    unsigned int misses;
+};
+
+struct i965_buffer_pool_bo_class
+{
+    int num_bos;
+    dri_bo *bo[I965_BUFFER_POOL_BO_DEPTH];
+};
+
+struct i965_buffer_pool
+{
+    _I965Mutex mutex;
+    dri_bufmgr *bufmgr;
+
+    size_t max_size;            /* 0 disables recycling */
+    size_t cached_size;
+
+    struct buffer_store *free_stores;
+    void *free_buffers[I965_BUFFER_POOL_CPU_CLASSES];
+    struct i965_buffer_pool_bo_class bo_classes[I965_BUFFER_POOL_KINDS][I965_BUFFER_POOL_BO_CLASSES];
+
+    struct i965_buffer_pool_stats store_stats;
+    struct i965_buffer_pool_stats buffer_stats;
+    struct i965_buffer_pool_stats bo_stats;
+};
+
+void
+i965_buffer_pool_init(struct i965_buffer_pool *pool, dri_bufmgr *bufmgr, size_t max_size);
+
+void
+i965_buffer_pool_terminate(struct i965_buffer_pool *pool);
+
+/*
+ * Returns a buffer_store with ref_count set to 1 and backed by a CPU
+ * buffer (I965_BUFFER_POOL_CPU) or a BO of at least size bytes, or just
+ * the bare header for I965_BUFFER_POOL_NONE. Returns NULL on error.
+ */
+struct buffer_store *
+i965_buffer_pool_create_store(struct i965_buffer_pool *pool, int kind, unsigned int size);
+
+/*
+ * Gives the storage of a buffer_store whose ref_count dropped to 0 back
+ * to its pool.
+ */
+void
+i965_buffer_pool_release_store(struct buffer_store *buffer_store);
+
+/*
+ * Returns whether the configs of entrypoint may set
+ * I965_CONFIG_ATTRIB_SLICE_DATA_USERPTR: decoding only, with a libdrm able
+ * to wrap user memory in a BO.
+ */
+int
+i965_buffer_pool_has_userptr(VAEntrypoint entrypoint);
+
+/*
+ * Returns a buffer_store for size bytes of slice data. With userptr set,
+ * page aligned data is wrapped in a BO instead of being copied; unaligned
+ * data, or data the kernel refuses to wrap, is copied into a pooled BO.
+ * Returns NULL on error.
+ */
+struct buffer_store *
+i965_buffer_pool_create_slice_data_store(struct i965_buffer_pool *pool,
+                                         void *data,
+                                         unsigned int size,
+                                         int userptr);
+
+#endif /* I965_BUFFER_POOL_H */
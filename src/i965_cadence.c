@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <string.h>
+
+#include "i965_cadence.h"
+
+/*
+ * In a 3:2 cycle whose first field repeats at position 0, e.g. the frames
+ * [A1 A2] [A1' B2] [B1 C2] [C1 C2'] [D1 D2] with position 0 at [A1' B2],
+ * the second field repeats at position 2 and each field pairs with the
+ * neighbouring field of the same film frame.
+ */
+static const int first_field_pairing[I965_CADENCE_CYCLE] = {
+    I965_CADENCE_FIELD_WEAVE_PREV,
+    I965_CADENCE_FIELD_WEAVE_PREV,
+    I965_CADENCE_FIELD_WEAVE_NEXT,
+    I965_CADENCE_FIELD_WEAVE_NEXT,
+    I965_CADENCE_FIELD_WEAVE_NEXT,
+};
+
+static const int second_field_pairing[I965_CADENCE_CYCLE] = {
+    I965_CADENCE_FIELD_WEAVE_NEXT,
+    I965_CADENCE_FIELD_WEAVE_NEXT,
+    I965_CADENCE_FIELD_WEAVE_PREV,
+    I965_CADENCE_FIELD_WEAVE_PREV,
+    I965_CADENCE_FIELD_WEAVE_PREV,
+};
+
+void
+i965_cadence_detector_init(struct i965_cadence_detector *detector)
+{
+    memset(detector, 0, sizeof(*detector));
+    detector->phase = -1;
+}
+
+/*
+ * Finds the frame of the window with the smallest difference and the
+ * second smallest difference. Returns whether the smallest one stands out
+ * as a repeated field.
+ */
+static int
+i965_cadence_find_repeat(const unsigned int diffs[I965_CADENCE_CYCLE],
+                         int *min_index,
+                         unsigned int *next_min)
+{
+    unsigned int min = diffs[0];
+    int i;
+
+    *min_index = 0;
+    *next_min = ~0U;
+
+    for (i = 1; i < I965_CADENCE_CYCLE; i++) {
+        if (diffs[i] < min) {
+            *next_min = min;
+            min = diffs[i];
+            *min_index = i;
+        } else if (diffs[i] < *next_min) {
+            *next_min = diffs[i];
+        }
+    }
+
+    return (*next_min >= I965_CADENCE_MIN_DIFF &&
+            (unsigned long long)min * I965_CADENCE_REPEAT_RATIO <= *next_min);
+}
+
+int
+i965_cadence_detector_update(struct i965_cadence_detector *detector,
+                             const struct i965_cadence_stats *stats)
+{
+    unsigned int first_diffs[I965_CADENCE_CYCLE], second_diffs[I965_CADENCE_CYCLE];
+    unsigned int first_next_min, second_next_min;
+    int first_index, second_index;
+    int first_repeat, second_repeat;
+    unsigned int oldest;
+    int i;
+
+    detector->history[detector->num_frames % I965_CADENCE_CYCLE] = *stats;
+    detector->num_frames++;
+
+    if (detector->num_frames < I965_CADENCE_CYCLE)
+        return detector->locked;
+
+    /* the window of the last frames, oldest first */
+    oldest = detector->num_frames - I965_CADENCE_CYCLE;
+
+    for (i = 0; i < I965_CADENCE_CYCLE; i++) {
+        const struct i965_cadence_stats *frame = &detector->history[(oldest + i) % I965_CADENCE_CYCLE];
+
+        first_diffs[i] = frame->first_diff;
+        second_diffs[i] = frame->second_diff;
+    }
+
+    first_repeat = i965_cadence_find_repeat(first_diffs, &first_index, &first_next_min);
+    second_repeat = i965_cadence_find_repeat(second_diffs, &second_index, &second_next_min);
+
+    /* still pictures tell nothing, keep the current state */
+    if (first_next_min < I965_CADENCE_MIN_DIFF &&
+        second_next_min < I965_CADENCE_MIN_DIFF)
+        return detector->locked;
+
+    if (first_repeat && second_repeat &&
+        (second_index - first_index + I965_CADENCE_CYCLE) % I965_CADENCE_CYCLE == 2) {
+        int phase = (oldest + first_index) % I965_CADENCE_CYCLE;
+
+        if (phase == detector->phase) {
+            if (detector->phase_frames < I965_CADENCE_LOCK_FRAMES)
+                detector->phase_frames++;
+        } else {
+            detector->phase = phase;
+            detector->phase_frames = 1;
+        }
+    } else {
+        /* video, or a broken cadence after an edit */
+        detector->phase = -1;
+        detector->phase_frames = 0;
+    }
+
+    detector->locked = (detector->phase >= 0 &&
+                        detector->phase_frames >= I965_CADENCE_LOCK_FRAMES);
+
+    return detector->locked;
+}
+
+void
+i965_cadence_detector_fields(const struct i965_cadence_detector *detector,
+                             struct i965_cadence_fields *fields)
+{
+    int pos;
+
+    if (!detector->locked) {
+        fields->first_field = I965_CADENCE_FIELD_DEINTERLACE;
+        fields->prev_second_field = I965_CADENCE_FIELD_DEINTERLACE;
+
+        return;
+    }
+
+    /* position of the next frame in the cycle */
+    pos = (detector->num_frames + I965_CADENCE_CYCLE - detector->phase) % I965_CADENCE_CYCLE;
+
+    fields->first_field = first_field_pairing[pos];
+    fields->prev_second_field = second_field_pairing[(pos + I965_CADENCE_CYCLE - 1) % I965_CADENCE_CYCLE];
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef I965_CADENCE_H
+#define I965_CADENCE_H
+
+/*
+ * 3:2 pulldown detection for the motion adaptive deinterlacing, from the
+ * field differences the VEBOX writes to its statistics surface. Once the
+ * cadence is locked, each field is told which neighbouring field of the
+ * same film frame it is woven with, so telecined content comes out as
+ * full resolution progressive frames instead of being deinterlaced.
+ *
+ * All the fields are in temporal order: "first" is the top field of a top
+ * field first stream and the bottom field of a bottom field first one.
+ */
+
+/* The frames of a 3:2 cycle, four film frames over ten fields */
+#define I965_CADENCE_CYCLE              5
+
+/* Consecutive frames agreeing on the phase before the cadence is locked */
+#define I965_CADENCE_LOCK_FRAMES        10
+
+/* A repeated field differs at least that many times less than the other fields */
+#define I965_CADENCE_REPEAT_RATIO       4
+
+/* Below this difference the fields are too still to tell a repeat from motion */
+#define I965_CADENCE_MIN_DIFF           64
+
+/* How a field is made into a progressive frame */
+#define I965_CADENCE_FIELD_DEINTERLACE  0
+#define I965_CADENCE_FIELD_WEAVE_NEXT   1   /* with the following field */
+#define I965_CADENCE_FIELD_WEAVE_PREV   2   /* with the preceding field */
+
+/* The field differences of one frame */
+struct i965_cadence_stats
+{
+    unsigned int first_diff;    /* first field against the first field of the previous frame */
+    unsigned int second_diff;   /* second field against the second field of the previous frame */
+};
+
+struct i965_cadence_detector
+{
+    struct i965_cadence_stats history[I965_CADENCE_CYCLE];
+    unsigned int num_frames;    /* frames seen, history[num_frames % I965_CADENCE_CYCLE] is the oldest */
+
+    int phase;                  /* frame index modulo the cycle of a repeated first field, -1 if none */
+    int phase_frames;           /* consecutive frames agreeing on phase */
+    int locked;
+};
+
+/* Decisions on the fields of the next frame */
+struct i965_cadence_fields
+{
+    int first_field;            /* I965_CADENCE_FIELD_xxx of the first field of the frame */
+    int prev_second_field;      /* I965_CADENCE_FIELD_xxx of the second field of the previous frame */
+};
+
+void
+i965_cadence_detector_init(struct i965_cadence_detector *detector);
+
+/* Adds the statistics of the last frame. Returns locked. */
+int
+i965_cadence_detector_update(struct i965_cadence_detector *detector,
+                             const struct i965_cadence_stats *stats);
+
+/*
+ * Decides how the fields of the frame following the last one added are
+ * paired; all of them are deinterlaced unless the cadence is locked.
+ */
+void
+i965_cadence_detector_fields(const struct i965_cadence_detector *detector,
+                             struct i965_cadence_fields *fields);
+
+#endif /* I965_CADENCE_H */
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <string.h>
+
+#include "i965_context_pool.h"
+
+void
+i965_context_pool_init(struct i965_context_pool *pool, int max_contexts)
+{
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    if (max_contexts < 1)
+        max_contexts = 1;
+    else if (max_contexts > I965_CONTEXT_POOL_MAX_CONTEXTS)
+        max_contexts = I965_CONTEXT_POOL_MAX_CONTEXTS;
+
+    pool->max_contexts = max_contexts;
+}
+
+void
+i965_context_pool_terminate(struct i965_context_pool *pool)
+{
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+void *
+i965_context_pool_get(struct i965_context_pool *pool,
+                      i965_context_create_func create, void *data)
+{
+    void *context = NULL;
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    while (pool->num_idle == 0 && pool->num_contexts >= pool->max_contexts)
+        pthread_cond_wait(&pool->cond, &pool->mutex);
+
+    if (pool->num_idle) {
+        context = pool->idle[--pool->num_idle];
+        pthread_mutex_unlock(&pool->mutex);
+
+        return context;
+    }
+
+    /* count the context in, it is created unlocked */
+    pool->num_contexts++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    context = create(data);
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (context) {
+        /* creations may complete in any order, take the first free entry */
+        for (i = 0; pool->contexts[i]; i++)
+            ;
+
+        pool->contexts[i] = context;
+    } else {
+        pool->num_contexts--;
+        pthread_cond_signal(&pool->cond);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    return context;
+}
+
+void
+i965_context_pool_put(struct i965_context_pool *pool, void *context)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->idle[pool->num_idle++] = context;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
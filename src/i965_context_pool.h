@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef I965_CONTEXT_POOL_H
+#define I965_CONTEXT_POOL_H
+
+#include <pthread.h>
+
+#define I965_CONTEXT_POOL_MAX_CONTEXTS  8
+
+/* Creates a context for the pool, NULL on failure */
+typedef void *(*i965_context_create_func)(void *data);
+
+/*
+ * A bounded set of contexts, such as the post processing contexts, shared
+ * by the threads of the driver. A thread takes an idle context, or creates
+ * one while fewer than max_contexts exist, and waits for one to be given
+ * back otherwise. The last context given back is handed out first, so a
+ * single threaded user keeps getting the same one.
+ */
+struct i965_context_pool
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int max_contexts;
+    int num_contexts;
+    int num_idle;
+    void *contexts[I965_CONTEXT_POOL_MAX_CONTEXTS];
+    void *idle[I965_CONTEXT_POOL_MAX_CONTEXTS];
+};
+
+/* max_contexts is clamped to [1, I965_CONTEXT_POOL_MAX_CONTEXTS] */
+void
+i965_context_pool_init(struct i965_context_pool *pool, int max_contexts);
+
+/*
+ * The contexts are the owner's to free beforehand: the non NULL entries of
+ * contexts[], which are all idle once the users are done
+ */
+void
+i965_context_pool_terminate(struct i965_context_pool *pool);
+
+/*
+ * Returns an idle context or one made by create(data), which runs without
+ * the pool locked, or NULL if create fails
+ */
+void *
+i965_context_pool_get(struct i965_context_pool *pool,
+                      i965_context_create_func create, void *data);
+
+void
+i965_context_pool_put(struct i965_context_pool *pool, void *context);
+
+#endif /* I965_CONTEXT_POOL_H */
@@ -23,12 +23,12 @@
 
 #include "sysdeps.h"
 #include <limits.h>
-#include <alloca.h>
 
 #include "intel_batchbuffer.h"
 #include "intel_media.h"
 #include "i965_drv_video.h"
 #include "i965_decoder_utils.h"
+#include "i965_bitstream_scan.h"
 #include "i965_defines.h"
 
 /* Set reference surface if backing store exists */
@@ -282,9 +282,11 @@ avc_get_picture_id(struct object_surface *obj_surface)
        The VA objects are maintained in heaps so that any released VA
        surface will become free again for future allocation. This means
        that holes in there are filled in for subsequent allocations.
-       So, this ultimately means that we could just use the Heap ID of
-       the VA surface as the resulting picture ID (16 bits) */
-    pic_id = 1 + (obj_surface->base.id & OBJECT_HEAP_ID_MASK);
+       So, this ultimately means that we could just use the Heap index of
+       the VA surface as the resulting picture ID (16 bits). The generation
+       bits of the ID change whenever the surface is recycled, so they are
+       left out */
+    pic_id = 1 + (obj_surface->base.id & OBJECT_HEAP_INDEX_MASK);
     return (pic_id <= 0xffff) ? pic_id : -1;
 }
 
@@ -332,9 +334,8 @@ avc_get_first_mb_bit_offset_with_epb(
 {
     unsigned int in_slice_data_bit_offset = slice_param->slice_data_bit_offset;
     unsigned int out_slice_data_bit_offset;
-    unsigned int i, j, n, buf_size, data_size, header_size;
-    uint8_t *buf;
-    int ret;
+    unsigned int i, j, n, epb, buf_size, data_size, header_size;
+    const uint8_t *buf;
 
     header_size = slice_param->slice_data_bit_offset / 8;
     data_size   = slice_param->slice_data_size - slice_param->slice_data_offset;
@@ -343,18 +344,24 @@ avc_get_first_mb_bit_offset_with_epb(
     if (buf_size > data_size)
         buf_size = data_size;
 
-    buf = alloca(buf_size);
-    ret = dri_bo_get_subdata(
-        slice_data_bo, slice_param->slice_data_offset,
-        buf_size, buf
-    );
-    assert(ret == 0);
+    /* Scan the slice data in place rather than reading a copy of it */
+    dri_bo_map(slice_data_bo, 0);
+    assert(slice_data_bo->virtual);
+    buf = (const uint8_t *)slice_data_bo->virtual + slice_param->slice_data_offset;
+
+    /* i walks the escaped bytes, j the header bytes they hold */
+    for (i = 2, j = 2, n = 0; i < buf_size && j < header_size; n++) {
+        epb = i + i965_bitstream_find_epb(buf + i - 2, buf_size - i + 2);
 
-    for (i = 2, j = 2, n = 0; i < buf_size && j < header_size; i++, j++) {
-        if (buf[i] == 0x03 && buf[i - 1] == 0x00 && buf[i - 2] == 0x00)
-            i += 2, j++, n++;
+        if (epb >= buf_size || j + (epb - i) >= header_size)
+            break;
+
+        j += epb - i + 2;
+        i = epb + 3;
     }
 
+    dri_bo_unmap(slice_data_bo);
+
     out_slice_data_bit_offset = in_slice_data_bit_offset + n * 8;
 
     if (mode_flag == ENTROPY_CABAC)
@@ -362,6 +369,46 @@ avc_get_first_mb_bit_offset_with_epb(
     return out_slice_data_bit_offset;
 }
 
+/* Get first macroblock bit offset for BSD, with EPB count (VC-1 advanced profile) */
+int
+vc1_get_macroblock_bit_offset(
+    const uint8_t *buf,
+    unsigned int   buf_size,
+    int            in_slice_data_bit_offset,
+    int            profile
+)
+{
+    unsigned int header_size = in_slice_data_bit_offset / 8;
+    unsigned int i, j, epb;
+
+    if (profile != 3)
+        return in_slice_data_bit_offset;
+
+    /* i walks the header bytes, j the escaped bytes holding them */
+    for (i = 0, j = 0; i < header_size; ) {
+        epb = j + i965_bitstream_find_epb(buf + j, buf_size - j);
+
+        if (epb >= buf_size || i + (epb - j) >= header_size) {
+            j += header_size - i;
+            break;
+        }
+
+        i += epb - j;
+        j = epb;
+
+        /* 00 00 03 is only an escape when followed by 00, 01, 02 or 03 */
+        if (j + 3 < buf_size && buf[j + 3] < 4) {
+            i += 2;
+            j += 3;
+        } else {
+            i++;
+            j++;
+        }
+    }
+
+    return 8 * j + in_slice_data_bit_offset % 8;
+}
+
 static inline uint8_t
 get_ref_idx_state_1(const VAPictureH264 *va_pic, unsigned int frame_store_id)
 {
@@ -74,6 +74,14 @@ avc_get_first_mb_bit_offset_with_epb(
     unsigned int                mode_flag
 );
 
+int
+vc1_get_macroblock_bit_offset(
+    const uint8_t *buf,
+    unsigned int   buf_size,
+    int            in_slice_data_bit_offset,
+    int            profile
+);
+
 void
 gen5_fill_avc_ref_idx_state(
     uint8_t             state[32],
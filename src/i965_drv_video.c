@@ -29,6 +29,8 @@
 
 #include "sysdeps.h"
 
+#include <unistd.h>
+
 #ifdef HAVE_VA_X11
 # include "i965_output_dri.h"
 #endif
@@ -44,6 +46,9 @@
 #include "i965_drv_video.h"
 #include "i965_decoder.h"
 #include "i965_encoder.h"
+#include "i965_tiling.h"
+#include "i965_image_convert.h"
+#include "i965_bitstream_scan.h"
 
 #define CONFIG_ID_OFFSET                0x01000000
 #define CONTEXT_ID_OFFSET               0x02000000
@@ -636,6 +641,15 @@ i965_GetConfigAttributes(VADriverContextP ctx,
     /* Other attributes don't seem to be defined */
     /* What to do if we don't know the attribute? */
     for (i = 0; i < num_attribs; i++) {
+        if (attrib_list[i].type == I965_CONFIG_ATTRIB_SLICE_DATA_USERPTR) {
+            if (i965_buffer_pool_has_userptr(entrypoint))
+                attrib_list[i].value = 1;
+            else
+                attrib_list[i].value = VA_ATTRIB_NOT_SUPPORTED;
+
+            continue;
+        }
+
         switch (attrib_list[i].type) {
         case VAConfigAttribRTFormat:
             attrib_list[i].value = i965_get_default_chroma_formats(ctx,
@@ -648,7 +662,7 @@ i965_GetConfigAttributes(VADriverContextP ctx,
 
                 if (profile != VAProfileMPEG2Main &&
                     profile != VAProfileMPEG2Simple)
-                    attrib_list[i].value |= VA_RC_CBR;
+                    attrib_list[i].value |= VA_RC_CBR | VA_RC_VBR;
                 break;
             }
 
@@ -746,6 +760,7 @@ i965_CreateConfig(VADriverContextP ctx,
     int configID;
     int i;
     VAStatus vaStatus;
+    int support_userptr = i965_buffer_pool_has_userptr(entrypoint);
 
     vaStatus = i965_validate_config(ctx, profile, entrypoint);
 
@@ -766,6 +781,13 @@ i965_CreateConfig(VADriverContextP ctx,
     obj_config->num_attribs = 0;
 
     for (i = 0; i < num_attribs; i++) {
+        if (attrib_list[i].type == I965_CONFIG_ATTRIB_SLICE_DATA_USERPTR &&
+            attrib_list[i].value &&
+            !support_userptr) {
+            vaStatus = VA_STATUS_ERROR_ATTR_NOT_SUPPORTED;
+            break;
+        }
+
         vaStatus = i965_ensure_config_attribute(obj_config, &attrib_list[i]);
         if (vaStatus != VA_STATUS_SUCCESS)
             break;
@@ -840,6 +862,8 @@ i965_destroy_surface_storage(struct object_surface *obj_surface)
 
     dri_bo_unreference(obj_surface->bo);
     obj_surface->bo = NULL;
+    dri_bo_unreference(obj_surface->fence_bo);
+    obj_surface->fence_bo = NULL;
 
     if (obj_surface->free_private_data != NULL) {
         obj_surface->free_private_data(&obj_surface->private_data);
@@ -1592,13 +1616,8 @@ i965_release_buffer_store(struct buffer_store **ptr)
     assert(!(buffer_store->bo && buffer_store->buffer));
     buffer_store->ref_count--;
     
-    if (buffer_store->ref_count == 0) {
-        dri_bo_unreference(buffer_store->bo);
-        free(buffer_store->buffer);
-        buffer_store->bo = NULL;
-        buffer_store->buffer = NULL;
-        free(buffer_store);
-    }
+    if (buffer_store->ref_count == 0)
+        i965_buffer_pool_release_store(buffer_store);
 
     *ptr = NULL;
 }
@@ -1616,6 +1635,7 @@ i965_destroy_context(struct object_heap *heap, struct object_base *obj)
 
     if (obj_context->codec_type == CODEC_PROC) {
         i965_release_buffer_store(&obj_context->codec_state.proc.pipeline_param);
+        i965_release_buffer_store(&obj_context->codec_state.proc.output_ladder);
 
     } else if (obj_context->codec_type == CODEC_ENC) {
         assert(obj_context->codec_state.encode.num_slice_params <= obj_context->codec_state.encode.max_slice_params);
@@ -1640,6 +1660,8 @@ i965_destroy_context(struct object_heap *heap, struct object_base *obj)
         for (i = 0; i < ARRAY_ELEMS(obj_context->codec_state.encode.misc_param); i++)
             i965_release_buffer_store(&obj_context->codec_state.encode.misc_param[i]);
 
+        i965_release_buffer_store(&obj_context->codec_state.encode.qp_map_param);
+
         for (i = 0; i < obj_context->codec_state.encode.num_slice_params_ext; i++)
             i965_release_buffer_store(&obj_context->codec_state.encode.slice_params_ext[i]);
 
@@ -1876,6 +1898,26 @@ i965_destroy_buffer(struct object_heap *heap, struct object_base *obj)
     object_heap_free(heap, obj);
 }
 
+/*
+ * Whether the slice data buffers of the context wrap the user memory, as
+ * asked by I965_CONFIG_ATTRIB_SLICE_DATA_USERPTR.
+ */
+static int
+i965_context_has_slice_data_userptr(VADriverContextP ctx, VAContextID context)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct object_context *obj_context = CONTEXT(context);
+    VAConfigAttrib *attrib;
+
+    if (!obj_context || !obj_context->obj_config)
+        return 0;
+
+    attrib = i965_lookup_config_attribute(obj_context->obj_config,
+                                          I965_CONFIG_ATTRIB_SLICE_DATA_USERPTR);
+
+    return attrib && attrib->value;
+}
+
 static VAStatus
 i965_create_buffer_internal(VADriverContextP ctx,
                             VAContextID context,
@@ -1919,6 +1961,10 @@ i965_create_buffer_internal(VADriverContextP ctx,
         break;
 
     default:
+        /* the driver private ones */
+        if (type == I965_BUFFER_TYPE_PROC_OUTPUT_LADDER)
+            break;
+
         return VA_STATUS_ERROR_UNSUPPORTED_BUFFERTYPE;
     }
 
@@ -1939,24 +1985,39 @@ i965_create_buffer_internal(VADriverContextP ctx,
     obj_buffer->size_element = size;
     obj_buffer->type = type;
     obj_buffer->buffer_store = NULL;
-    buffer_store = calloc(1, sizeof(struct buffer_store));
-    assert(buffer_store);
-    buffer_store->ref_count = 1;
 
     if (store_bo != NULL) {
+        buffer_store = i965_buffer_pool_create_store(&i965->buffer_pool,
+                                                     I965_BUFFER_POOL_NONE,
+                                                     0);
+        assert(buffer_store);
         buffer_store->bo = store_bo;
         dri_bo_reference(buffer_store->bo);
         
         if (data)
             dri_bo_subdata(buffer_store->bo, 0, size * num_elements, data);
-    } else if (type == VASliceDataBufferType || 
-               type == VAImageBufferType || 
+    } else if (type == VASliceDataBufferType) {
+        buffer_store = i965_buffer_pool_create_slice_data_store(&i965->buffer_pool,
+                                                                data,
+                                                                size * num_elements,
+                                                                i965_context_has_slice_data_userptr(ctx, context));
+        assert(buffer_store);
+    } else if (type == VAImageBufferType || 
                type == VAEncCodedBufferType ||
                type == VAProbabilityBufferType) {
-        buffer_store->bo = dri_bo_alloc(i965->intel.bufmgr, 
-                                        "Buffer", 
-                                        size * num_elements, 64);
-        assert(buffer_store->bo);
+        int kind;
+
+        if (type == VAImageBufferType)
+            kind = I965_BUFFER_POOL_IMAGE;
+        else if (type == VAEncCodedBufferType)
+            kind = I965_BUFFER_POOL_CODED;
+        else
+            kind = I965_BUFFER_POOL_PROBABILITY;
+
+        buffer_store = i965_buffer_pool_create_store(&i965->buffer_pool,
+                                                     kind,
+                                                     size * num_elements);
+        assert(buffer_store);
 
         if (type == VAEncCodedBufferType) {
             struct i965_coded_buffer_segment *coded_buffer_segment;
@@ -1970,6 +2031,9 @@ i965_create_buffer_internal(VADriverContextP ctx,
             coded_buffer_segment->base.next = NULL;
             coded_buffer_segment->mapped = 0;
             coded_buffer_segment->codec = 0;
+            coded_buffer_segment->coded_size = I965_CODED_SIZE_UNKNOWN;
+            coded_buffer_segment->num_slices = 0;
+            coded_buffer_segment->status = 0;
             dri_bo_unmap(buffer_store->bo);
         } else if (data) {
             dri_bo_subdata(buffer_store->bo, 0, size * num_elements, data);
@@ -1982,8 +2046,10 @@ i965_create_buffer_internal(VADriverContextP ctx,
             msize = ALIGN(size, 4);
         }
 
-        buffer_store->buffer = malloc(msize * num_elements);
-        assert(buffer_store->buffer);
+        buffer_store = i965_buffer_pool_create_store(&i965->buffer_pool,
+                                                     I965_BUFFER_POOL_CPU,
+                                                     msize * num_elements);
+        assert(buffer_store);
 
         if (data)
             memcpy(buffer_store->buffer, data, size * num_elements);
@@ -2034,6 +2100,47 @@ i965_BufferSetNumElements(VADriverContextP ctx,
     return vaStatus;
 }
 
+/*
+ * Chain one segment per slice after base using the slice ends the PAK
+ * stored, leaving a single segment if any of them is missing.
+ */
+static void
+i965_coded_buffer_split_slices(struct i965_coded_buffer_segment *coded_buffer_segment)
+{
+    VACodedBufferSegment *segment = &coded_buffer_segment->base;
+    unsigned int num_slices = coded_buffer_segment->num_slices;
+    unsigned int size = segment->size;
+    unsigned int start, i;
+
+    if (num_slices < 2 || num_slices > I965_CODED_BUFFER_MAX_SLICES)
+        return;
+
+    for (i = 0, start = 0; i < num_slices; i++) {
+        if (coded_buffer_segment->slice_end[i] == I965_CODED_SIZE_UNKNOWN ||
+            coded_buffer_segment->slice_end[i] < start)
+            return;
+
+        start = coded_buffer_segment->slice_end[i];
+    }
+
+    /* the end of the last slice counts the frame delimiter too */
+    if (start != size + I965_CODED_DELIMITER_SIZE)
+        return;
+
+    segment->size = coded_buffer_segment->slice_end[0];
+
+    for (i = 1; i < num_slices; i++) {
+        VACodedBufferSegment *next = &coded_buffer_segment->slices[i - 1];
+
+        memset(next, 0, sizeof(*next));
+        next->buf = (unsigned char *)coded_buffer_segment->base.buf + coded_buffer_segment->slice_end[i - 1];
+        next->size = (i == num_slices - 1 ? size : coded_buffer_segment->slice_end[i]) -
+            coded_buffer_segment->slice_end[i - 1];
+        segment->next = next;
+        segment = next;
+    }
+}
+
 VAStatus 
 i965_MapBuffer(VADriverContextP ctx,
                VABufferID buf_id,       /* in */
@@ -2061,46 +2168,60 @@ i965_MapBuffer(VADriverContextP ctx,
         *pbuf = obj_buffer->buffer_store->bo->virtual;
 
         if (obj_buffer->type == VAEncCodedBufferType) {
-            int i;
+            unsigned int size;
             unsigned char *buffer = NULL;
             struct i965_coded_buffer_segment *coded_buffer_segment = (struct i965_coded_buffer_segment *)(obj_buffer->buffer_store->bo->virtual);
 
             if (!coded_buffer_segment->mapped) {
-                unsigned char delimiter0, delimiter1, delimiter2, delimiter3, delimiter4;
+                static const uint8_t h264_delimiter[I965_CODED_DELIMITER_SIZE] = {
+                    H264_DELIMITER0, H264_DELIMITER1, H264_DELIMITER2, H264_DELIMITER3, H264_DELIMITER4
+                };
+                static const uint8_t mpeg2_delimiter[I965_CODED_DELIMITER_SIZE] = {
+                    MPEG2_DELIMITER0, MPEG2_DELIMITER1, MPEG2_DELIMITER2, MPEG2_DELIMITER3, MPEG2_DELIMITER4
+                };
+                const uint8_t *delimiter;
+                unsigned int max_size = obj_buffer->size_element - I965_CODEDBUFFER_HEADER_SIZE - 3 - 0x1000;
+                unsigned int coded_size = coded_buffer_segment->coded_size;
 
                 coded_buffer_segment->base.buf = buffer = (unsigned char *)(obj_buffer->buffer_store->bo->virtual) + I965_CODEDBUFFER_HEADER_SIZE;
+                coded_buffer_segment->base.next = NULL;
+                coded_buffer_segment->base.status = coded_buffer_segment->status;
 
                 if (coded_buffer_segment->codec == CODEC_H264 ||
                     coded_buffer_segment->codec == CODEC_H264_MVC) {
-                    delimiter0 = H264_DELIMITER0;
-                    delimiter1 = H264_DELIMITER1;
-                    delimiter2 = H264_DELIMITER2;
-                    delimiter3 = H264_DELIMITER3;
-                    delimiter4 = H264_DELIMITER4;
+                    delimiter = h264_delimiter;
                 } else if (coded_buffer_segment->codec == CODEC_MPEG2) {
-                    delimiter0 = MPEG2_DELIMITER0;
-                    delimiter1 = MPEG2_DELIMITER1;
-                    delimiter2 = MPEG2_DELIMITER2;
-                    delimiter3 = MPEG2_DELIMITER3;
-                    delimiter4 = MPEG2_DELIMITER4;
+                    delimiter = mpeg2_delimiter;
                 } else {
                     ASSERT_RET(0, VA_STATUS_ERROR_UNSUPPORTED_PROFILE);
                 }
 
-                for (i = 0; i < obj_buffer->size_element - I965_CODEDBUFFER_HEADER_SIZE - 3 - 0x1000; i++) {
-                    if ((buffer[i] == delimiter0) &&
-                        (buffer[i + 1] == delimiter1) &&
-                        (buffer[i + 2] == delimiter2) &&
-                        (buffer[i + 3] == delimiter3) &&
-                        (buffer[i + 4] == delimiter4))
-                        break;
-                }
-
-                if (i == obj_buffer->size_element - I965_CODEDBUFFER_HEADER_SIZE - 3 - 0x1000) {
+                /*
+                 * The PAK stored its byte count, delimiter included, at the end
+                 * of the frame. A count read from the wrong VDBOX or left over
+                 * from another frame doesn't end on the delimiter: look for the
+                 * delimiter following the coded data then, as without a count.
+                 */
+                if (coded_size != I965_CODED_SIZE_UNKNOWN &&
+                    coded_size >= I965_CODED_DELIMITER_SIZE &&
+                    coded_size <= max_size + 4 &&
+                    !memcmp(buffer + coded_size - I965_CODED_DELIMITER_SIZE,
+                            delimiter, I965_CODED_DELIMITER_SIZE))
+                    size = coded_size - I965_CODED_DELIMITER_SIZE;
+                else
+                    size = i965_bitstream_find_pattern(buffer, max_size + 4,
+                                                       delimiter, I965_CODED_DELIMITER_SIZE);
+
+                if (size >= max_size) {
+                    size = max_size;
                     coded_buffer_segment->base.status |= VA_CODED_BUF_STATUS_SLICE_OVERFLOW_MASK;
                 }
 
-                coded_buffer_segment->base.size = i;
+                coded_buffer_segment->base.size = size;
+
+                if (i965->coded_slice_segments)
+                    i965_coded_buffer_split_slices(coded_buffer_segment);
+
                 coded_buffer_segment->mapped = 1;
             } else {
                 assert(coded_buffer_segment->base.buf);
@@ -2226,6 +2347,7 @@ i965_BeginPicture(VADriverContextP ctx,
 
     if (obj_context->codec_type == CODEC_PROC) {
         obj_context->codec_state.proc.current_render_target = render_target;
+        i965_release_buffer_store(&obj_context->codec_state.proc.output_ladder);
     } else if (obj_context->codec_type == CODEC_ENC) {
         i965_release_buffer_store(&obj_context->codec_state.encode.pic_param);
 
@@ -2449,6 +2571,22 @@ i965_encoder_render_misc_parameter_buffer(VADriverContextP ctx,
 
     param = (VAEncMiscParameterBuffer *)obj_buffer->buffer_store->buffer;
 
+    if (param->type == I965_ENC_MISC_PARAMETER_TYPE_QP_MAP) {
+        I965EncMiscParameterQpMap *qp_map = (I965EncMiscParameterQpMap *)param->data;
+        size_t size = obj_buffer->size_element * obj_buffer->num_elements;
+        size_t min_size = sizeof(*param) + sizeof(*qp_map);
+
+        if (size < min_size ||
+            size - min_size < qp_map->qp_map_size ||
+            qp_map->num_roi > I965_ENC_QP_MAP_MAX_ROI)
+            return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+        i965_release_buffer_store(&encode->qp_map_param);
+        i965_reference_buffer_store(&encode->qp_map_param, obj_buffer->buffer_store);
+
+        return VA_STATUS_SUCCESS;
+    }
+
     if (param->type >= ARRAY_ELEMS(encode->misc_param))
         return VA_STATUS_ERROR_INVALID_PARAMETER;
 
@@ -2655,6 +2793,7 @@ i965_encoder_render_picture(VADriverContextP ctx,
 
 #define DEF_RENDER_PROC_SINGLE_BUFFER_FUNC(name, member) DEF_RENDER_SINGLE_BUFFER_FUNC(proc, name, member)
 DEF_RENDER_PROC_SINGLE_BUFFER_FUNC(pipeline_parameter, pipeline_param)    
+DEF_RENDER_PROC_SINGLE_BUFFER_FUNC(output_ladder, output_ladder)
 
 static VAStatus 
 i965_proc_render_picture(VADriverContextP ctx,
@@ -2681,7 +2820,14 @@ i965_proc_render_picture(VADriverContextP ctx,
             break;
 
         default:
-            vaStatus = VA_STATUS_ERROR_UNSUPPORTED_BUFFERTYPE;
+            if (obj_buffer->type == I965_BUFFER_TYPE_PROC_OUTPUT_LADDER) {
+                if (obj_buffer->size_element * obj_buffer->num_elements < sizeof(I965ProcOutputLadder))
+                    vaStatus = VA_STATUS_ERROR_INVALID_BUFFER;
+                else
+                    vaStatus = I965_RENDER_PROC_BUFFER(output_ladder);
+            } else
+                vaStatus = VA_STATUS_ERROR_UNSUPPORTED_BUFFERTYPE;
+
             break;
         }
     }
@@ -2720,12 +2866,103 @@ i965_RenderPicture(VADriverContextP ctx,
     return vaStatus;
 }
 
+/*
+ * Records the BO that retires last for the picture just submitted: the
+ * coded buffer for encoding, the render target otherwise.
+ */
+static void
+i965_set_surface_fence(VADriverContextP ctx, struct object_context *obj_context)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx); 
+    struct object_surface *obj_surface;
+    dri_bo *bo;
+
+    if (obj_context->codec_type == CODEC_PROC) {
+        obj_surface = SURFACE(obj_context->codec_state.proc.current_render_target);
+        bo = obj_surface ? obj_surface->bo : NULL;
+    } else if (obj_context->codec_type == CODEC_ENC) {
+        struct object_buffer *obj_buffer = obj_context->codec_state.encode.coded_buf_object;
+
+        obj_surface = SURFACE(obj_context->codec_state.encode.current_render_target);
+        bo = (obj_buffer && obj_buffer->buffer_store) ? obj_buffer->buffer_store->bo : NULL;
+
+        if (obj_surface && bo)
+            obj_buffer->buffer_store->fenced = 1;
+    } else {
+        obj_surface = SURFACE(obj_context->codec_state.decode.current_render_target);
+        bo = obj_surface ? obj_surface->bo : NULL;
+    }
+
+    if (!obj_surface)
+        return;
+
+    if (bo)
+        dri_bo_reference(bo);
+
+    dri_bo_unreference(obj_surface->fence_bo);
+    obj_surface->fence_bo = bo;
+
+    /* the outputs of a ladder are written by the same submission */
+    if (obj_context->codec_type == CODEC_PROC &&
+        obj_context->codec_state.proc.output_ladder) {
+        I965ProcOutputLadder *ladder =
+            (I965ProcOutputLadder *)obj_context->codec_state.proc.output_ladder->buffer;
+        unsigned int i;
+
+        for (i = 0; i < MIN(ladder->num_outputs, I965_PROC_LADDER_MAX_OUTPUTS); i++) {
+            obj_surface = SURFACE(ladder->outputs[i]);
+
+            if (!obj_surface || !obj_surface->bo)
+                continue;
+
+            dri_bo_reference(obj_surface->bo);
+            dri_bo_unreference(obj_surface->fence_bo);
+            obj_surface->fence_bo = obj_surface->bo;
+        }
+    }
+
+    /* and so is the second output of the field rate deinterlacing */
+    if (obj_context->codec_type == CODEC_PROC &&
+        obj_context->codec_state.proc.pipeline_param) {
+        VAProcPipelineParameterBuffer *pipeline_param =
+            (VAProcPipelineParameterBuffer *)obj_context->codec_state.proc.pipeline_param->buffer;
+        unsigned int i;
+
+        for (i = 0; pipeline_param->filters && i < pipeline_param->num_filters; i++) {
+            struct object_buffer *obj_buffer = BUFFER(pipeline_param->filters[i]);
+            I965ProcFilterParameterBufferDeinterlacing *di_param;
+
+            if (!obj_buffer ||
+                !obj_buffer->buffer_store ||
+                !obj_buffer->buffer_store->buffer ||
+                obj_buffer->size_element * obj_buffer->num_elements < sizeof(*di_param))
+                continue;
+
+            di_param = (I965ProcFilterParameterBufferDeinterlacing *)obj_buffer->buffer_store->buffer;
+
+            if (di_param->base.type != VAProcFilterDeinterlacing ||
+                !(di_param->base.flags & I965_DEINTERLACING_FIELD_RATE))
+                continue;
+
+            obj_surface = SURFACE(di_param->second_output);
+
+            if (!obj_surface || !obj_surface->bo)
+                continue;
+
+            dri_bo_reference(obj_surface->bo);
+            dri_bo_unreference(obj_surface->fence_bo);
+            obj_surface->fence_bo = obj_surface->bo;
+        }
+    }
+}
+
 VAStatus 
 i965_EndPicture(VADriverContextP ctx, VAContextID context)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx); 
     struct object_context *obj_context = CONTEXT(context);
     struct object_config *obj_config;
+    VAStatus vaStatus;
 
     ASSERT_RET(obj_context, VA_STATUS_ERROR_INVALID_CONTEXT);
     obj_config = obj_context->obj_config;
@@ -2779,7 +3016,86 @@ i965_EndPicture(VADriverContextP ctx, VAContextID context)
     }
 
     ASSERT_RET(obj_context->hw_context->run, VA_STATUS_ERROR_OPERATION_FAILED);
-    return obj_context->hw_context->run(ctx, obj_config->profile, &obj_context->codec_state, obj_context->hw_context);
+    vaStatus = obj_context->hw_context->run(ctx, obj_config->profile, &obj_context->codec_state, obj_context->hw_context);
+
+    if (vaStatus == VA_STATUS_SUCCESS)
+        i965_set_surface_fence(ctx, obj_context);
+
+    return vaStatus;
+}
+
+#ifdef VA_STATUS_ERROR_TIMEDOUT
+#define I965_STATUS_TIMEDOUT    VA_STATUS_ERROR_TIMEDOUT
+#else
+#define I965_STATUS_TIMEDOUT    VA_STATUS_ERROR_SURFACE_BUSY
+#endif
+
+static dri_bo *
+i965_surface_fence(struct object_surface *obj_surface)
+{
+    return obj_surface->fence_bo ? obj_surface->fence_bo : obj_surface->bo;
+}
+
+VAStatus
+i965_SyncSurfaceTimeout(VADriverContextP ctx,
+                        VASurfaceID render_target,
+                        int64_t timeout_ns)
+{
+    return i965_SyncSurfaces(ctx, &render_target, 1, 1, timeout_ns, NULL);
+}
+
+VAStatus
+i965_SyncSurfaces(VADriverContextP ctx,
+                  VASurfaceID *surface_list,
+                  int num_surfaces,
+                  int wait_all,
+                  int64_t timeout_ns,
+                  int *index)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx); 
+    dri_bo **bos;
+    int i, ret;
+
+    ASSERT_RET(surface_list && num_surfaces > 0, VA_STATUS_ERROR_INVALID_PARAMETER);
+
+    bos = malloc(num_surfaces * sizeof(*bos));
+
+    if (!bos)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    for (i = 0; i < num_surfaces; i++) {
+        struct object_surface *obj_surface = SURFACE(surface_list[i]);
+
+        if (!obj_surface) {
+            free(bos);
+            return VA_STATUS_ERROR_INVALID_SURFACE;
+        }
+
+        bos[i] = i965_surface_fence(obj_surface);
+    }
+
+    ret = i965_fence_wait(bos, num_surfaces, wait_all, timeout_ns, index);
+    free(bos);
+
+    return ret ? I965_STATUS_TIMEDOUT : VA_STATUS_SUCCESS;
+}
+
+VAStatus
+i965_NotifySurface(VADriverContextP ctx,
+                   VASurfaceID render_target,
+                   int fd)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx); 
+    struct object_surface *obj_surface = SURFACE(render_target);
+
+    ASSERT_RET(obj_surface, VA_STATUS_ERROR_INVALID_SURFACE);
+
+    if (i965_fence_notifier_add(&i965->fence_notifier,
+                                i965_surface_fence(obj_surface),
+                                fd))
+        return VA_STATUS_ERROR_OPERATION_FAILED;
+
+    return VA_STATUS_SUCCESS;
 }
 
 VAStatus 
@@ -2791,8 +3107,8 @@ i965_SyncSurface(VADriverContextP ctx,
 
     ASSERT_RET(obj_surface, VA_STATUS_ERROR_INVALID_SURFACE);
 
-    if(obj_surface->bo)
-        drm_intel_bo_wait_rendering(obj_surface->bo);
+    if (i965_surface_fence(obj_surface))
+        drm_intel_bo_wait_rendering(i965_surface_fence(obj_surface));
 
     return VA_STATUS_SUCCESS;
 }
@@ -2807,8 +3123,8 @@ i965_QuerySurfaceStatus(VADriverContextP ctx,
 
     ASSERT_RET(obj_surface, VA_STATUS_ERROR_INVALID_SURFACE);
 
-    if (obj_surface->bo) {
-        if (drm_intel_bo_busy(obj_surface->bo)){
+    if (i965_surface_fence(obj_surface)) {
+        if (drm_intel_bo_busy(i965_surface_fence(obj_surface))){
             *status = VASurfaceRendering;
         }
         else {
@@ -3674,22 +3990,80 @@ get_sampling_from_fourcc(unsigned int fourcc)
         return -1;
 }
 
+/* Large pictures are copied in bands by the copy worker pool */
 static inline void
-memcpy_pic(uint8_t *dst, unsigned int dst_stride,
+memcpy_pic(struct i965_driver_data *i965,
+           uint8_t *dst, unsigned int dst_stride,
            const uint8_t *src, unsigned int src_stride,
            unsigned int len, unsigned int height)
 {
-    unsigned int i;
+    i965_worker_pool_memcpy_pic(&i965->copy_pool,
+                                dst, dst_stride,
+                                src, src_stride,
+                                len, height);
+}
 
-    for (i = 0; i < height; i++) {
-        memcpy(dst, src, len);
-        dst += dst_stride;
-        src += src_stride;
-    }
+struct tiled_pic_job
+{
+    uint8_t *linear;
+    unsigned int linear_pitch;
+    uint8_t *tiled;
+    unsigned int tiled_pitch;
+    uint32_t tiling;
+    uint32_t swizzle;
+    unsigned int x;
+    unsigned int y;
+    unsigned int width;
+    int detile;
+};
+
+static void
+tiled_pic_band(void *data, unsigned int first, unsigned int last)
+{
+    const struct tiled_pic_job *job = data;
+    uint8_t *linear = job->linear + first * job->linear_pitch;
+
+    if (job->detile)
+        i965_tiled_to_linear(linear, job->linear_pitch,
+                             job->tiled, job->tiled_pitch,
+                             job->tiling, job->swizzle,
+                             job->x, job->y + first,
+                             job->width, last - first);
+    else
+        i965_linear_to_tiled(job->tiled, job->tiled_pitch,
+                             job->tiling, job->swizzle,
+                             job->x, job->y + first,
+                             linear, job->linear_pitch,
+                             job->width, last - first);
+}
+
+static void
+tiled_pic(struct i965_driver_data *i965,
+          uint8_t *linear, unsigned int linear_pitch,
+          uint8_t *tiled, unsigned int tiled_pitch,
+          uint32_t tiling, uint32_t swizzle,
+          unsigned int x, unsigned int y,
+          unsigned int width, unsigned int height,
+          int detile)
+{
+    struct tiled_pic_job job;
+
+    job.linear = linear;
+    job.linear_pitch = linear_pitch;
+    job.tiled = tiled;
+    job.tiled_pitch = tiled_pitch;
+    job.tiling = tiling;
+    job.swizzle = swizzle;
+    job.x = x;
+    job.y = y;
+    job.width = width;
+    job.detile = detile;
+    i965_worker_pool_run(&i965->copy_pool, tiled_pic_band, &job, height, width);
 }
 
 static VAStatus
-get_image_i420(struct object_image *obj_image, uint8_t *image_data,
+get_image_i420(struct i965_driver_data *i965,
+               struct object_image *obj_image, uint8_t *image_data,
                struct object_surface *obj_surface,
                const VARectangle *rect)
 {
@@ -3726,21 +4100,21 @@ get_image_i420(struct object_image *obj_image, uint8_t *image_data,
     /* Y plane */
     dst[Y] += rect->y * obj_image->image.pitches[Y] + rect->x;
     src[0] += rect->y * obj_surface->width + rect->x;
-    memcpy_pic(dst[Y], obj_image->image.pitches[Y],
+    memcpy_pic(i965, dst[Y], obj_image->image.pitches[Y],
                src[0], obj_surface->width,
                rect->width, rect->height);
 
     /* U plane */
     dst[U] += (rect->y / 2) * obj_image->image.pitches[U] + rect->x / 2;
     src[1] += (rect->y / 2) * obj_surface->width / 2 + rect->x / 2;
-    memcpy_pic(dst[U], obj_image->image.pitches[U],
+    memcpy_pic(i965, dst[U], obj_image->image.pitches[U],
                src[1], obj_surface->width / 2,
                rect->width / 2, rect->height / 2);
 
     /* V plane */
     dst[V] += (rect->y / 2) * obj_image->image.pitches[V] + rect->x / 2;
     src[2] += (rect->y / 2) * obj_surface->width / 2 + rect->x / 2;
-    memcpy_pic(dst[V], obj_image->image.pitches[V],
+    memcpy_pic(i965, dst[V], obj_image->image.pitches[V],
                src[2], obj_surface->width / 2,
                rect->width / 2, rect->height / 2);
 
@@ -3753,12 +4127,14 @@ get_image_i420(struct object_image *obj_image, uint8_t *image_data,
 }
 
 static VAStatus
-get_image_nv12(struct object_image *obj_image, uint8_t *image_data,
+get_image_nv12(struct i965_driver_data *i965,
+               struct object_image *obj_image, uint8_t *image_data,
                struct object_surface *obj_surface,
                const VARectangle *rect)
 {
     uint8_t *dst[2], *src[2];
     unsigned int tiling, swizzle;
+    int use_gtt;
     VAStatus va_status = VA_STATUS_SUCCESS;
 
     if (!obj_surface->bo)
@@ -3766,8 +4142,9 @@ get_image_nv12(struct object_image *obj_image, uint8_t *image_data,
 
     assert(obj_surface->fourcc);
     dri_bo_get_tiling(obj_surface->bo, &tiling, &swizzle);
+    use_gtt = !i965_tiling_supported(tiling, swizzle, obj_surface->width);
 
-    if (tiling != I915_TILING_NONE)
+    if (use_gtt)
         drm_intel_gem_bo_map_gtt(obj_surface->bo);
     else
         dri_bo_map(obj_surface->bo, 0);
@@ -3781,30 +4158,51 @@ get_image_nv12(struct object_image *obj_image, uint8_t *image_data,
     dst[1] = image_data + obj_image->image.offsets[1];
     src[1] = src[0] + obj_surface->width * obj_surface->height;
 
+    if (!use_gtt) {
+        /* The UV plane is addressed as the rows following the Y plane */
+        dst[0] += rect->y * obj_image->image.pitches[0] + rect->x;
+        tiled_pic(i965,
+                  dst[0], obj_image->image.pitches[0],
+                  src[0], obj_surface->width,
+                  tiling, swizzle,
+                  rect->x, rect->y,
+                  rect->width, rect->height, 1);
+
+        dst[1] += (rect->y / 2) * obj_image->image.pitches[1] + (rect->x & -2);
+        tiled_pic(i965,
+                  dst[1], obj_image->image.pitches[1],
+                  src[0], obj_surface->width,
+                  tiling, swizzle,
+                  rect->x & -2, obj_surface->height + rect->y / 2,
+                  rect->width, rect->height / 2, 1);
+
+        dri_bo_unmap(obj_surface->bo);
+
+        return va_status;
+    }
+
     /* Y plane */
     dst[0] += rect->y * obj_image->image.pitches[0] + rect->x;
     src[0] += rect->y * obj_surface->width + rect->x;
-    memcpy_pic(dst[0], obj_image->image.pitches[0],
+    memcpy_pic(i965, dst[0], obj_image->image.pitches[0],
                src[0], obj_surface->width,
                rect->width, rect->height);
 
     /* UV plane */
     dst[1] += (rect->y / 2) * obj_image->image.pitches[1] + (rect->x & -2);
     src[1] += (rect->y / 2) * obj_surface->width + (rect->x & -2);
-    memcpy_pic(dst[1], obj_image->image.pitches[1],
+    memcpy_pic(i965, dst[1], obj_image->image.pitches[1],
                src[1], obj_surface->width,
                rect->width, rect->height / 2);
 
-    if (tiling != I915_TILING_NONE)
-        drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
-    else
-        dri_bo_unmap(obj_surface->bo);
+    drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
 
     return va_status;
 }
 
 static VAStatus
-get_image_yuy2(struct object_image *obj_image, uint8_t *image_data,
+get_image_yuy2(struct i965_driver_data *i965,
+               struct object_image *obj_image, uint8_t *image_data,
                struct object_surface *obj_surface,
                const VARectangle *rect)
 {
@@ -3833,7 +4231,7 @@ get_image_yuy2(struct object_image *obj_image, uint8_t *image_data,
     /* Y plane */
     dst += rect->y * obj_image->image.pitches[0] + rect->x*2;
     src += rect->y * obj_surface->width + rect->x*2;
-    memcpy_pic(dst, obj_image->image.pitches[0],
+    memcpy_pic(i965, dst, obj_image->image.pitches[0],
                src, obj_surface->width*2,
                rect->width*2, rect->height);
 
@@ -3845,6 +4243,69 @@ get_image_yuy2(struct object_image *obj_image, uint8_t *image_data,
     return va_status;
 }
 
+/* Converts the surface into an image of a different format in one pass */
+static VAStatus
+get_image_convert(struct object_image *obj_image, uint8_t *image_data,
+                  struct object_surface *obj_surface,
+                  const VARectangle *rect)
+{
+    const VAImage * const image = &obj_image->image;
+    struct i965_image_layout src, dst;
+    unsigned int tiling, swizzle;
+    int use_gtt, ret;
+
+    if (!obj_surface->bo)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    dri_bo_get_tiling(obj_surface->bo, &tiling, &swizzle);
+    use_gtt = !i965_tiling_supported(tiling, swizzle, obj_surface->width);
+
+    if (use_gtt)
+        drm_intel_gem_bo_map_gtt(obj_surface->bo);
+    else
+        dri_bo_map(obj_surface->bo, 0);
+
+    if (!obj_surface->bo->virtual)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    src.fourcc = obj_surface->fourcc;
+    src.base = obj_surface->bo->virtual;
+    src.offsets[0] = 0;
+    src.offsets[1] = obj_surface->y_cb_offset * obj_surface->width;
+    src.offsets[2] = obj_surface->y_cr_offset * obj_surface->width;
+    src.pitches[0] = obj_surface->width;
+    src.pitches[1] = obj_surface->cb_cr_pitch;
+    src.pitches[2] = obj_surface->cb_cr_pitch;
+    src.tiling = use_gtt ? I915_TILING_NONE : tiling;
+    src.swizzle = swizzle;
+    i965_image_layout_move(&src, rect->x, rect->y);
+
+    /* The second plane of a YV12 image is Cr */
+    dst.fourcc = image->format.fourcc;
+    dst.base = image_data;
+    dst.offsets[0] = image->offsets[0];
+    dst.offsets[1] = image->offsets[image->format.fourcc == VA_FOURCC_YV12 ? 2 : 1];
+    dst.offsets[2] = image->offsets[image->format.fourcc == VA_FOURCC_YV12 ? 1 : 2];
+    dst.pitches[0] = image->pitches[0];
+    dst.pitches[1] = image->pitches[image->format.fourcc == VA_FOURCC_YV12 ? 2 : 1];
+    dst.pitches[2] = image->pitches[image->format.fourcc == VA_FOURCC_YV12 ? 1 : 2];
+    dst.tiling = I915_TILING_NONE;
+    dst.swizzle = I915_BIT_6_SWIZZLE_NONE;
+    i965_image_layout_move(&dst, rect->x, rect->y);
+
+    /* Surfaces carry no colorimetry, assume BT.709 for HD content */
+    ret = i965_image_convert(&src, &dst,
+                             rect->width, rect->height,
+                             obj_surface->orig_height > 576 ? I965_CSC_BT709 : I965_CSC_BT601);
+
+    if (use_gtt)
+        drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
+    else
+        dri_bo_unmap(obj_surface->bo);
+
+    return ret ? VA_STATUS_ERROR_ALLOCATION_FAILED : VA_STATUS_SUCCESS;
+}
+
 static VAStatus 
 i965_sw_getimage(VADriverContextP ctx,
                  VASurfaceID surface,
@@ -3875,7 +4336,8 @@ i965_sw_getimage(VADriverContextP ctx,
         y + height > obj_image->image.height)
         return VA_STATUS_ERROR_INVALID_PARAMETER;
 
-    if (obj_surface->fourcc != obj_image->image.format.fourcc)
+    if (obj_surface->fourcc != obj_image->image.format.fourcc &&
+        !i965_image_convert_supported(obj_surface->fourcc, obj_image->image.format.fourcc))
         return VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
 
     void *image_data = NULL;
@@ -3890,23 +4352,30 @@ i965_sw_getimage(VADriverContextP ctx,
     rect.width = width;
     rect.height = height;
 
+    if (obj_surface->fourcc != obj_image->image.format.fourcc) {
+        va_status = get_image_convert(obj_image, image_data, obj_surface, &rect);
+        i965_UnmapBuffer(ctx, obj_image->image.buf);
+
+        return va_status;
+    }
+
     switch (obj_image->image.format.fourcc) {
     case VA_FOURCC_YV12:
     case VA_FOURCC_I420:
         /* I420 is native format for MPEG-2 decoded surfaces */
         if (render_state->interleaved_uv)
             goto operation_failed;
-        get_image_i420(obj_image, image_data, obj_surface, &rect);
+        get_image_i420(i965, obj_image, image_data, obj_surface, &rect);
         break;
     case VA_FOURCC_NV12:
         /* NV12 is native format for H.264 decoded surfaces */
         if (!render_state->interleaved_uv)
             goto operation_failed;
-        get_image_nv12(obj_image, image_data, obj_surface, &rect);
+        get_image_nv12(i965, obj_image, image_data, obj_surface, &rect);
         break;
     case VA_FOURCC_YUY2:
         /* YUY2 is the format supported by overlay plane */
-        get_image_yuy2(obj_image, image_data, obj_surface, &rect);
+        get_image_yuy2(i965, obj_image, image_data, obj_surface, &rect);
         break;
     default:
     operation_failed:
@@ -3992,7 +4461,7 @@ i965_GetImage(VADriverContextP ctx,
     struct i965_driver_data * const i965 = i965_driver_data(ctx);
     VAStatus va_status = VA_STATUS_SUCCESS;
 
-    if (HAS_ACCELERATED_GETIMAGE(i965))
+    if (HAS_ACCELERATED_GETIMAGE(i965) && !i965->sw_getimage)
         va_status = i965_hw_getimage(ctx,
                                      surface,
                                      x, y,
@@ -4009,7 +4478,8 @@ i965_GetImage(VADriverContextP ctx,
 }
 
 static VAStatus
-put_image_i420(struct object_surface *obj_surface,
+put_image_i420(struct i965_driver_data *i965,
+               struct object_surface *obj_surface,
                const VARectangle *dst_rect,
                struct object_image *obj_image, uint8_t *image_data,
                const VARectangle *src_rect)
@@ -4048,21 +4518,21 @@ put_image_i420(struct object_surface *obj_surface,
     /* Y plane */
     dst[0] += dst_rect->y * obj_surface->width + dst_rect->x;
     src[Y] += src_rect->y * obj_image->image.pitches[Y] + src_rect->x;
-    memcpy_pic(dst[0], obj_surface->width,
+    memcpy_pic(i965, dst[0], obj_surface->width,
                src[Y], obj_image->image.pitches[Y],
                src_rect->width, src_rect->height);
 
     /* U plane */
     dst[1] += (dst_rect->y / 2) * obj_surface->width / 2 + dst_rect->x / 2;
     src[U] += (src_rect->y / 2) * obj_image->image.pitches[U] + src_rect->x / 2;
-    memcpy_pic(dst[1], obj_surface->width / 2,
+    memcpy_pic(i965, dst[1], obj_surface->width / 2,
                src[U], obj_image->image.pitches[U],
                src_rect->width / 2, src_rect->height / 2);
 
     /* V plane */
     dst[2] += (dst_rect->y / 2) * obj_surface->width / 2 + dst_rect->x / 2;
     src[V] += (src_rect->y / 2) * obj_image->image.pitches[V] + src_rect->x / 2;
-    memcpy_pic(dst[2], obj_surface->width / 2,
+    memcpy_pic(i965, dst[2], obj_surface->width / 2,
                src[V], obj_image->image.pitches[V],
                src_rect->width / 2, src_rect->height / 2);
 
@@ -4075,13 +4545,15 @@ put_image_i420(struct object_surface *obj_surface,
 }
 
 static VAStatus
-put_image_nv12(struct object_surface *obj_surface,
+put_image_nv12(struct i965_driver_data *i965,
+               struct object_surface *obj_surface,
                const VARectangle *dst_rect,
                struct object_image *obj_image, uint8_t *image_data,
                const VARectangle *src_rect)
 {
     uint8_t *dst[2], *src[2];
     unsigned int tiling, swizzle;
+    int use_gtt;
     VAStatus va_status = VA_STATUS_SUCCESS;
 
     if (!obj_surface->bo)
@@ -4091,11 +4563,12 @@ put_image_nv12(struct object_surface *obj_surface,
     ASSERT_RET(dst_rect->width == src_rect->width, VA_STATUS_ERROR_UNIMPLEMENTED);
     ASSERT_RET(dst_rect->height == src_rect->height, VA_STATUS_ERROR_UNIMPLEMENTED);
     dri_bo_get_tiling(obj_surface->bo, &tiling, &swizzle);
+    use_gtt = !i965_tiling_supported(tiling, swizzle, obj_surface->width);
 
-    if (tiling != I915_TILING_NONE)
+    if (use_gtt)
         drm_intel_gem_bo_map_gtt(obj_surface->bo);
     else
-        dri_bo_map(obj_surface->bo, 0);
+        dri_bo_map(obj_surface->bo, 1);
 
     if (!obj_surface->bo->virtual)
         return VA_STATUS_ERROR_INVALID_SURFACE;
@@ -4106,30 +4579,50 @@ put_image_nv12(struct object_surface *obj_surface,
     dst[1] = dst[0] + obj_surface->width * obj_surface->height;
     src[1] = image_data + obj_image->image.offsets[1];
 
+    if (!use_gtt) {
+        src[0] += src_rect->y * obj_image->image.pitches[0] + src_rect->x;
+        tiled_pic(i965,
+                  src[0], obj_image->image.pitches[0],
+                  dst[0], obj_surface->width,
+                  tiling, swizzle,
+                  dst_rect->x, dst_rect->y,
+                  src_rect->width, src_rect->height, 0);
+
+        src[1] += (src_rect->y / 2) * obj_image->image.pitches[1] + (src_rect->x & -2);
+        tiled_pic(i965,
+                  src[1], obj_image->image.pitches[1],
+                  dst[0], obj_surface->width,
+                  tiling, swizzle,
+                  dst_rect->x & -2, obj_surface->height + dst_rect->y / 2,
+                  src_rect->width, src_rect->height / 2, 0);
+
+        dri_bo_unmap(obj_surface->bo);
+
+        return va_status;
+    }
+
     /* Y plane */
     dst[0] += dst_rect->y * obj_surface->width + dst_rect->x;
     src[0] += src_rect->y * obj_image->image.pitches[0] + src_rect->x;
-    memcpy_pic(dst[0], obj_surface->width,
+    memcpy_pic(i965, dst[0], obj_surface->width,
                src[0], obj_image->image.pitches[0],
                src_rect->width, src_rect->height);
 
     /* UV plane */
     dst[1] += (dst_rect->y / 2) * obj_surface->width + (dst_rect->x & -2);
     src[1] += (src_rect->y / 2) * obj_image->image.pitches[1] + (src_rect->x & -2);
-    memcpy_pic(dst[1], obj_surface->width,
+    memcpy_pic(i965, dst[1], obj_surface->width,
                src[1], obj_image->image.pitches[1],
                src_rect->width, src_rect->height / 2);
 
-    if (tiling != I915_TILING_NONE)
-        drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
-    else
-        dri_bo_unmap(obj_surface->bo);
+    drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
 
     return va_status;
 }
 
 static VAStatus
-put_image_yuy2(struct object_surface *obj_surface,
+put_image_yuy2(struct i965_driver_data *i965,
+               struct object_surface *obj_surface,
                const VARectangle *dst_rect,
                struct object_image *obj_image, uint8_t *image_data,
                const VARectangle *src_rect)
@@ -4159,7 +4652,7 @@ put_image_yuy2(struct object_surface *obj_surface,
     /* YUYV packed plane */
     dst += dst_rect->y * obj_surface->width + dst_rect->x*2;
     src += src_rect->y * obj_image->image.pitches[0] + src_rect->x*2;
-    memcpy_pic(dst, obj_surface->width*2,
+    memcpy_pic(i965, dst, obj_surface->width*2,
                src, obj_image->image.pitches[0],
                src_rect->width*2, src_rect->height);
 
@@ -4245,13 +4738,13 @@ i965_sw_putimage(VADriverContextP ctx,
     switch (obj_image->image.format.fourcc) {
     case VA_FOURCC_YV12:
     case VA_FOURCC_I420:
-        va_status = put_image_i420(obj_surface, &dest_rect, obj_image, image_data, &src_rect);
+        va_status = put_image_i420(i965, obj_surface, &dest_rect, obj_image, image_data, &src_rect);
         break;
     case VA_FOURCC_NV12:
-        va_status = put_image_nv12(obj_surface, &dest_rect, obj_image, image_data, &src_rect);
+        va_status = put_image_nv12(i965, obj_surface, &dest_rect, obj_image, image_data, &src_rect);
         break;
     case VA_FOURCC_YUY2:
-        va_status = put_image_yuy2(obj_surface, &dest_rect, obj_image, image_data, &src_rect);
+        va_status = put_image_yuy2(i965, obj_surface, &dest_rect, obj_image, image_data, &src_rect);
         break;
     default:
         va_status = VA_STATUS_ERROR_OPERATION_FAILED;
@@ -5390,6 +5883,11 @@ static bool
 i965_driver_data_init(VADriverContextP ctx)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx); 
+    int buffer_pool_size = I965_BUFFER_POOL_DEFAULT_SIZE;
+    int surface_cache_size = I965_SURFACE_CACHE_DEFAULT_SIZE;
+    int pp_contexts = I965_DEFAULT_PP_CONTEXTS;
+    int copy_threads;
+    char *env_str = NULL;
 
     i965->codec_info = i965_get_codec_info(i965->intel.device_id);
 
@@ -5409,9 +5907,11 @@ i965_driver_data_init(VADriverContextP ctx)
                          sizeof(struct object_surface),
                          SURFACE_ID_OFFSET))
         goto err_surface_heap;
-    if (object_heap_init(&i965->buffer_heap,
-                         sizeof(struct object_buffer),
-                         BUFFER_ID_OFFSET))
+    /* Buffers are created and destroyed for every picture */
+    if (object_heap_init_with_increment(&i965->buffer_heap,
+                                        sizeof(struct object_buffer),
+                                        BUFFER_ID_OFFSET,
+                                        64))
         goto err_buffer_heap;
     if (object_heap_init(&i965->image_heap,
                          sizeof(struct object_image),
@@ -5422,10 +5922,56 @@ i965_driver_data_init(VADriverContextP ctx)
                          SUBPIC_ID_OFFSET))
         goto err_subpic_heap;
 
+    if ((env_str = getenv("VA_INTEL_BUFFER_POOL_SIZE")))
+        buffer_pool_size = atoi(env_str);
+
+    if ((env_str = getenv("VA_INTEL_PP_CONTEXTS")))
+        pp_contexts = MAX(1, MIN(atoi(env_str), I965_MAX_PP_CONTEXTS));
+
+    if ((env_str = getenv("VA_INTEL_SURFACE_CACHE_SIZE")))
+        surface_cache_size = atoi(env_str);
+
+    if ((env_str = getenv("VA_INTEL_SW_GETIMAGE")))
+        i965->sw_getimage = !!atoi(env_str);
+
+    if ((env_str = getenv("VA_INTEL_CODED_SLICE_SEGMENTS")))
+        i965->coded_slice_segments = !!atoi(env_str);
+
+    i965->brc_row_qp = 1;
+
+    if ((env_str = getenv("VA_INTEL_BRC_ROW_QP")))
+        i965->brc_row_qp = !!atoi(env_str);
+
+    if ((env_str = getenv("VA_INTEL_SCENE_CHANGE")))
+        i965->scene_change = !!atoi(env_str);
+
+    if ((env_str = getenv("VA_INTEL_CADENCE_DETECT")))
+        i965->cadence_detect = !!atoi(env_str);
+
+    i965_vme_cost_table_init(&i965->vme_cost_table);
+
+    if ((env_str = getenv("VA_INTEL_VME_COST_TABLE")))
+        i965_vme_cost_table_load(&i965->vme_cost_table, env_str);
+
+    if ((env_str = getenv("VA_INTEL_COPY_THREADS")))
+        copy_threads = atoi(env_str);
+    else
+        copy_threads = MIN(sysconf(_SC_NPROCESSORS_ONLN) - 1, I965_WORKER_POOL_DEFAULT_THREADS);
+
+    i965_worker_pool_init(&i965->copy_pool,
+                          copy_threads,
+                          getenv("VA_INTEL_COPY_CPUS"));
+
+    i965_buffer_pool_init(&i965->buffer_pool,
+                          i965->intel.bufmgr,
+                          (size_t)buffer_pool_size << 20);
+    i965_fence_notifier_init(&i965->fence_notifier);
+    i965_surface_cache_init(&i965->surface_cache,
+                            (size_t)surface_cache_size << 20);
+
     i965->batch = intel_batchbuffer_new(&i965->intel, I915_EXEC_RENDER, 0);
-    i965->pp_batch = intel_batchbuffer_new(&i965->intel, I915_EXEC_RENDER, 0);
     _i965InitMutex(&i965->render_mutex);
-    _i965InitMutex(&i965->pp_mutex);
+    i965_context_pool_init(&i965->pp_pool, pp_contexts);
 
     return true;
 
@@ -5449,21 +5995,24 @@ i965_driver_data_terminate(VADriverContextP ctx)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx); 
 
-    _i965DestroyMutex(&i965->pp_mutex);
+    i965_fence_notifier_terminate(&i965->fence_notifier);
+    i965_worker_pool_terminate(&i965->copy_pool);
+
+    i965_context_pool_terminate(&i965->pp_pool);
     _i965DestroyMutex(&i965->render_mutex);
 
     if (i965->batch)
         intel_batchbuffer_free(i965->batch);
 
-    if (i965->pp_batch)
-        intel_batchbuffer_free(i965->pp_batch);
-
     i965_destroy_heap(&i965->subpic_heap, i965_destroy_subpic);
     i965_destroy_heap(&i965->image_heap, i965_destroy_image);
     i965_destroy_heap(&i965->buffer_heap, i965_destroy_buffer);
+    i965_surface_cache_terminate(ctx);
     i965_destroy_heap(&i965->surface_heap, i965_destroy_surface);
     i965_destroy_heap(&i965->context_heap, i965_destroy_context);
     i965_destroy_heap(&i965->config_heap, i965_destroy_config);
+
+    i965_buffer_pool_terminate(&i965->buffer_pool);
 }
 
 struct {
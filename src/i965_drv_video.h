@@ -41,6 +41,12 @@
 #include "object_heap.h"
 #include "intel_driver.h"
 #include "i965_fourcc.h"
+#include "i965_buffer_pool.h"
+#include "i965_worker_pool.h"
+#include "i965_context_pool.h"
+#include "i965_fence.h"
+#include "i965_vme_cost.h"
+#include "i965_surface_cache.h"
 
 #define I965_MAX_PROFILES                       20
 #define I965_MAX_ENTRYPOINTS                    5
@@ -88,6 +94,14 @@ struct buffer_store
     dri_bo *bo;
     int ref_count;
     int num_elements;
+
+    /* see i965_buffer_pool.c */
+    struct i965_buffer_pool *pool;
+    int pool_kind;
+    int pool_class;
+    struct buffer_store *next_free;
+    /* the BO is the fence of a surface, so it can't be recycled */
+    int fenced;
 };
     
 struct object_config 
@@ -183,6 +197,8 @@ struct encode_state
     int last_packed_header_type;
 
     struct buffer_store *misc_param[16];
+    /* the I965_ENC_MISC_PARAMETER_TYPE_QP_MAP parameter, if any */
+    struct buffer_store *qp_map_param;
 
     VASurfaceID current_render_target;
     struct object_surface *input_yuv_object;
@@ -195,6 +211,7 @@ struct proc_state
 {
     struct codec_state_base base;
     struct buffer_store *pipeline_param;
+    struct buffer_store *output_ladder;
 
     VASurfaceID current_render_target;
 };
@@ -272,6 +289,8 @@ struct object_surface
     uint32_t user_disable_tiling : 1;
     uint32_t user_h_stride_set   : 1;
     uint32_t user_v_stride_set   : 1;
+    /* retires when the last picture rendered to the surface is complete */
+    dri_bo *fence_bo;
 };
 
 struct object_buffer 
@@ -362,6 +381,10 @@ struct hw_codec_info
 
 #include "i965_render.h"
 
+/* Post processing contexts used at the same time, see i965_pp_context_get() */
+#define I965_MAX_PP_CONTEXTS            I965_CONTEXT_POOL_MAX_CONTEXTS
+#define I965_DEFAULT_PP_CONTEXTS        4
+
 struct i965_driver_data 
 {
     struct intel_driver_data intel;
@@ -372,13 +395,30 @@ struct i965_driver_data
     struct object_heap image_heap;
     struct object_heap subpic_heap;
     const struct hw_codec_info *codec_info;
+    struct i965_buffer_pool buffer_pool;
+    struct i965_fence_notifier fence_notifier;
+    /* use the software vaGetImage() path even with accelerated GetImage */
+    int sw_getimage;
+    /* helper threads of the CPU image copies and software PAK batches */
+    struct i965_worker_pool copy_pool;
+    /* return one VACodedBufferSegment per slice from vaMapBuffer() */
+    int coded_slice_segments;
+    /* per MB row QP offsets in the software PAK paths of CBR/VBR encoding */
+    int brc_row_qp;
+    /* the VME mode and MV costs of every slice type and QP */
+    struct i965_vme_cost_table vme_cost_table;
+    /* detect the scene changes in the VME output of the AVC encoders */
+    int scene_change;
+    /* 3:2 pulldown detection of the VEBOX motion adaptive deinterlacing */
+    int cadence_detect;
+    /* the intermediate surfaces of post processing and the other internal users */
+    struct i965_surface_cache surface_cache;
 
     _I965Mutex render_mutex;
-    _I965Mutex pp_mutex;
     struct intel_batchbuffer *batch;
-    struct intel_batchbuffer *pp_batch;
     struct i965_render_state render_state;
-    void *pp_context;
+    /* the post processing contexts of the threads without a VPP context */
+    struct i965_context_pool pp_pool;   /* struct i965_post_processing_context */
     char va_vendor[256];
  
     VADisplayAttribute *display_attributes;
@@ -450,13 +490,45 @@ va_enc_packed_type_to_idx(int packed_type);
 #define MPEG2_DELIMITER3        0x00
 #define MPEG2_DELIMITER4        0xb0
 
+/* The delimiter follows the last slice, the PAK byte counts include it */
+#define I965_CODED_DELIMITER_SIZE       5
+
+#define I965_CODED_BUFFER_MAX_SLICES    16
+#define I965_CODED_SIZE_UNKNOWN         0xffffffff
+
 struct i965_coded_buffer_segment
 {
     VACodedBufferSegment base;
     unsigned char mapped;
     unsigned char codec;
+
+    /*
+     * Byte counts stored by the PAK at the end of the frame and of each
+     * slice, I965_CODED_SIZE_UNKNOWN until the GPU has written them
+     */
+    uint32_t coded_size;
+    uint32_t num_slices;
+    uint32_t slice_end[I965_CODED_BUFFER_MAX_SLICES];
+
+    /* I965_CODED_BUF_STATUS_* bits of the frame, set by the encoder */
+    uint32_t status;
+
+    /* the segments following base when the slices are returned apart */
+    VACodedBufferSegment slices[I965_CODED_BUFFER_MAX_SLICES - 1];
 };
 
+/*
+ * Driver specific bits of VACodedBufferSegment.status, with the scene
+ * change detection: the frame starts a new scene and had better be coded
+ * as an I or IDR frame, and the number of B frames suggested between the
+ * anchor frames for the motion of the scene. They use bits libva leaves
+ * reserved, 0x8000 is VA_CODED_BUF_STATUS_BAD_BITSTREAM and 0x1f000000
+ * holds the number of passes and the single NALU flag.
+ */
+#define I965_CODED_BUF_STATUS_SCENE_CHANGE      0x2000
+#define I965_CODED_BUF_STATUS_B_FRAMES_MASK     0x60000000
+#define I965_CODED_BUF_STATUS_B_FRAMES_SHIFT    29
+
 #define I965_CODEDBUFFER_HEADER_SIZE   ALIGN(sizeof(struct i965_coded_buffer_segment), 64)
 
 extern VAStatus i965_MapBuffer(VADriverContextP ctx,
@@ -465,6 +537,31 @@ extern VAStatus i965_MapBuffer(VADriverContextP ctx,
 
 extern VAStatus i965_UnmapBuffer(VADriverContextP ctx, VABufferID buf_id);
 
+/*
+ * Extensions to vaSyncSurface(), exported by the driver. A VA application
+ * reaches the VADriverContextP through ((VADisplayContextP)dpy)->pDriverContext.
+ * A negative timeout waits forever.
+ */
+VAStatus DLL_EXPORT
+i965_SyncSurfaceTimeout(VADriverContextP ctx,
+                        VASurfaceID render_target,
+                        int64_t timeout_ns);
+
+/* Waits for one (wait_all = 0) or all of the surfaces, *index is the first ready one */
+VAStatus DLL_EXPORT
+i965_SyncSurfaces(VADriverContextP ctx,
+                  VASurfaceID *surface_list,
+                  int num_surfaces,
+                  int wait_all,
+                  int64_t timeout_ns,
+                  int *index);
+
+/* Writes an 8-byte 1 to fd (e.g. an eventfd) once the surface is ready */
+VAStatus DLL_EXPORT
+i965_NotifySurface(VADriverContextP ctx,
+                   VASurfaceID render_target,
+                   int fd);
+
 extern VAStatus i965_DestroySurfaces(VADriverContextP ctx,
                      VASurfaceID *surface_list,
                      int num_surfaces);
@@ -476,6 +573,80 @@ extern VAStatus i965_CreateSurfaces(VADriverContextP ctx,
                     int num_surfaces,
                     VASurfaceID *surfaces);
 
+/*
+ * Driver private config attribute for decoding. When it is set to a non-zero
+ * value, a VASliceDataBufferType buffer created from page aligned memory is
+ * wrapped as a BO (userptr) instead of being copied. The GPU reads the memory
+ * after vaEndPicture() returns, so it must stay valid and unchanged until
+ * the target surface of the picture is synced, even if the buffer is
+ * destroyed before. The driver silently falls back to a copy when the
+ * memory can't be wrapped. Only the VLD entrypoint supports it.
+ */
+#define I965_CONFIG_ATTRIB_SLICE_DATA_USERPTR   ((VAConfigAttribType)0x10001)
+
+/*
+ * Driver private VAEncMiscParameterBuffer type of the AVC encoders, whose
+ * data is an I965EncMiscParameterQpMap giving a QP offset to each MB. The
+ * offsets apply to the frames that follow until the parameter is sent
+ * again, one with neither rectangles nor map clears them. Only the
+ * encoders that build the PAK objects on the CPU apply them; the rate
+ * control accounts for them.
+ */
+#define I965_ENC_MISC_PARAMETER_TYPE_QP_MAP     ((VAEncMiscParameterType)0x10001)
+
+#define I965_ENC_QP_MAP_MAX_ROI                 16
+
+typedef struct _I965EncMiscParameterQpMap
+{
+    /*
+     * Regions of interest in pixels, extended to whole MBs. The offset of
+     * a rectangle replaces that of the map and of the earlier rectangles.
+     */
+    unsigned int num_roi;
+    VARectangle roi[I965_ENC_QP_MAP_MAX_ROI];
+    signed char roi_qp_delta[I965_ENC_QP_MAP_MAX_ROI];
+
+    /* 0 or the offset of each MB of the frame, in raster order */
+    unsigned int qp_map_size;
+    signed char qp_map[];
+} I965EncMiscParameterQpMap;
+
+/*
+ * Driver private buffer type of the video processing, whose data is an
+ * I965ProcOutputLadder. Rendered with the pipeline parameter, it adds the
+ * outputs the processed picture is also scaled to, in the same submission
+ * as the render target. It applies to the current picture only.
+ */
+#define I965_BUFFER_TYPE_PROC_OUTPUT_LADDER     ((VABufferType)0x10001)
+
+#define I965_PROC_LADDER_MAX_OUTPUTS            8
+
+typedef struct _I965ProcOutputLadder
+{
+    unsigned int num_outputs;
+    VASurfaceID outputs[I965_PROC_LADDER_MAX_OUTPUTS];
+    /* the region of each output, the whole surface if the width or height is 0 */
+    VARectangle output_regions[I965_PROC_LADDER_MAX_OUTPUTS];
+} I965ProcOutputLadder;
+
+/*
+ * Driver private flag of the motion adaptive and motion compensated
+ * deinterlacing, whose filter parameter buffer is then an
+ * I965ProcFilterParameterBufferDeinterlacing. Each input frame is rendered
+ * once and the VEBOX writes the two field rate frames in the same pass: the
+ * frame of the second field of the previous input frame to the render target
+ * and the frame of the first field of the current input frame to
+ * second_output. Both outputs get the first field of the first input frame.
+ * second_output has the size and the fourcc of the render target.
+ */
+#define I965_DEINTERLACING_FIELD_RATE           0x80000000
+
+typedef struct _I965ProcFilterParameterBufferDeinterlacing
+{
+    VAProcFilterParameterBufferDeinterlacing base;
+    VASurfaceID second_output;
+} I965ProcFilterParameterBufferDeinterlacing;
+
 #define I965_SURFACE_MEM_NATIVE             0
 #define I965_SURFACE_MEM_GEM_FLINK          1
 #define I965_SURFACE_MEM_DRM_PRIME          2
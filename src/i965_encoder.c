@@ -44,6 +44,69 @@ extern Bool gen6_mfc_context_init(VADriverContextP ctx, struct intel_encoder_con
 extern Bool gen6_vme_context_init(VADriverContextP ctx, struct intel_encoder_context *encoder_context);
 extern Bool gen7_mfc_context_init(VADriverContextP ctx, struct intel_encoder_context *encoder_context);
 
+static void
+intel_encoder_input_pool_release(VADriverContextP ctx,
+                                 struct intel_encoder_context *encoder_context)
+{
+    int i;
+
+    for (i = 0; i < I965_ENCODER_INPUT_SURFACES; i++) {
+        if (encoder_context->input_pool.surface_id[i] != VA_INVALID_SURFACE) {
+            i965_surface_cache_put(ctx, &encoder_context->input_pool.surface_id[i], 1);
+            encoder_context->input_pool.surface_id[i] = VA_INVALID_SURFACE;
+        }
+    }
+
+    encoder_context->input_pool.width = 0;
+    encoder_context->input_pool.height = 0;
+    encoder_context->input_pool.next = 0;
+}
+
+/* The next conversion surface for an input frame of width x height */
+static VAStatus
+intel_encoder_input_pool_get(VADriverContextP ctx,
+                             struct intel_encoder_context *encoder_context,
+                             int width, int height,
+                             VASurfaceID *surface_id)
+{
+    VASurfaceID *pool_id;
+    VAStatus status;
+
+    if (encoder_context->input_pool.width != width ||
+        encoder_context->input_pool.height != height) {
+        intel_encoder_input_pool_release(ctx, encoder_context);
+        encoder_context->input_pool.width = width;
+        encoder_context->input_pool.height = height;
+    }
+
+    pool_id = &encoder_context->input_pool.surface_id[encoder_context->input_pool.next];
+
+    if (*pool_id == VA_INVALID_SURFACE) {
+        status = i965_surface_cache_get(ctx,
+                                        width,
+                                        height,
+                                        VA_FOURCC_NV12,
+                                        SUBSAMPLE_YUV420,
+                                        1,
+                                        pool_id);
+        assert(status == VA_STATUS_SUCCESS);
+
+        if (status != VA_STATUS_SUCCESS) {
+            *pool_id = VA_INVALID_SURFACE;
+            return status;
+        }
+    }
+
+    encoder_context->input_pool.next = (encoder_context->input_pool.next + 1) % I965_ENCODER_INPUT_SURFACES;
+    *surface_id = *pool_id;
+
+    return VA_STATUS_SUCCESS;
+}
+
+/*
+ * MFX only reads Y tiled sources, so any other input, linear NV12
+ * included, is converted to a Y tiled NV12 surface of the pool
+ */
 static VAStatus
 intel_encoder_check_yuv_surface(VADriverContextP ctx,
                                 VAProfile profile,
@@ -56,13 +119,7 @@ intel_encoder_check_yuv_surface(VADriverContextP ctx,
     VAStatus status;
     VARectangle rect;
 
-    /* releae the temporary surface */
-    if (encoder_context->is_tmp_id) {
-        i965_DestroySurfaces(ctx, &encoder_context->input_yuv_surface, 1);
-        encode_state->input_yuv_object = NULL;
-    }
-
-    encoder_context->is_tmp_id = 0;
+    encode_state->input_yuv_object = NULL;
     obj_surface = SURFACE(encode_state->current_render_target);
     assert(obj_surface && obj_surface->bo);
 
@@ -90,13 +147,11 @@ intel_encoder_check_yuv_surface(VADriverContextP ctx,
     src_surface.type = I965_SURFACE_TYPE_SURFACE;
     src_surface.flags = I965_SURFACE_FLAG_FRAME;
     
-    status = i965_CreateSurfaces(ctx,
-                                 obj_surface->orig_width,
-                                 obj_surface->orig_height,
-                                 VA_RT_FORMAT_YUV420,
-                                 1,
-                                 &encoder_context->input_yuv_surface);
-    assert(status == VA_STATUS_SUCCESS);
+    status = intel_encoder_input_pool_get(ctx,
+                                          encoder_context,
+                                          obj_surface->orig_width,
+                                          obj_surface->orig_height,
+                                          &encoder_context->input_yuv_surface);
 
     if (status != VA_STATUS_SUCCESS)
         return status;
@@ -104,7 +159,6 @@ intel_encoder_check_yuv_surface(VADriverContextP ctx,
     obj_surface = SURFACE(encoder_context->input_yuv_surface);
     encode_state->input_yuv_object = obj_surface;
     assert(obj_surface);
-    i965_check_alloc_surface_bo(ctx, obj_surface, 1, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
     
     dst_surface.base = (struct object_base *)obj_surface;
     dst_surface.type = I965_SURFACE_TYPE_SURFACE;
@@ -117,8 +171,6 @@ intel_encoder_check_yuv_surface(VADriverContextP ctx,
                                    &rect);
     assert(status == VA_STATUS_SUCCESS);
 
-    encoder_context->is_tmp_id = 1;
-
     return VA_STATUS_SUCCESS;
 }
 
@@ -281,6 +333,22 @@ intel_encoder_sanity_check_input(VADriverContextP ctx,
 out:    
     return vaStatus;
 }
+
+/* Has vaMapBuffer() search for the end of the coded data */
+static void
+intel_encoder_drop_coded_size(struct encode_state *encode_state)
+{
+    struct object_buffer *obj_buffer = encode_state->coded_buf_object;
+    struct i965_coded_buffer_segment *coded_buffer_segment;
+    dri_bo *bo = obj_buffer->buffer_store->bo;
+
+    /* waits for the PAK stores */
+    dri_bo_map(bo, 1);
+    coded_buffer_segment = (struct i965_coded_buffer_segment *)bo->virtual;
+    coded_buffer_segment->coded_size = I965_CODED_SIZE_UNKNOWN;
+    memset(coded_buffer_segment->slice_end, 0xff, sizeof(coded_buffer_segment->slice_end));
+    dri_bo_unmap(bo);
+}
  
 static VAStatus
 intel_encoder_end_picture(VADriverContextP ctx, 
@@ -290,6 +358,7 @@ intel_encoder_end_picture(VADriverContextP ctx,
 {
     struct intel_encoder_context *encoder_context = (struct intel_encoder_context *)hw_context;
     struct encode_state *encode_state = &codec_state->encode;
+    int bsd_ring = encoder_context->base.batch->bsd_ring;
     VAStatus vaStatus;
 
     vaStatus = intel_encoder_sanity_check_input(ctx, profile, encode_state, encoder_context);
@@ -303,6 +372,14 @@ intel_encoder_end_picture(VADriverContextP ctx,
 
     if (vaStatus == VA_STATUS_SUCCESS)
         encoder_context->mfc_pipeline(ctx, profile, encode_state, encoder_context);
+
+    /*
+     * The kernel rejected the VDBOX selection and ran the frame on the one
+     * it picked, the byte counts stored by the PAK may come from the other
+     */
+    if (encoder_context->base.batch->bsd_ring != bsd_ring)
+        intel_encoder_drop_coded_size(encode_state);
+
     return VA_STATUS_SUCCESS;
 }
 
@@ -311,8 +388,10 @@ intel_encoder_context_destroy(void *hw_context)
 {
     struct intel_encoder_context *encoder_context = (struct intel_encoder_context *)hw_context;
 
+    intel_encoder_input_pool_release(encoder_context->driver_context, encoder_context);
     encoder_context->mfc_context_destroy(encoder_context->mfc_context);
     encoder_context->vme_context_destroy(encoder_context->vme_context);
+    intel_driver_put_bsd_ring(encoder_context->base.batch->intel, encoder_context->base.batch->bsd_ring);
     intel_batchbuffer_free(encoder_context->base.batch);
     free(encoder_context);
 }
@@ -332,10 +411,15 @@ intel_enc_hw_context_init(VADriverContextP ctx,
     encoder_context->base.destroy = intel_encoder_context_destroy;
     encoder_context->base.run = intel_encoder_end_picture;
     encoder_context->base.batch = intel_batchbuffer_new(intel, I915_EXEC_RENDER, 0);
+    /* spread the PAK of the contexts over the VDBOXes of the GT3 parts */
+    encoder_context->base.batch->bsd_ring = intel_driver_get_bsd_ring(intel);
+    encoder_context->driver_context = ctx;
     encoder_context->input_yuv_surface = VA_INVALID_SURFACE;
-    encoder_context->is_tmp_id = 0;
     encoder_context->rate_control_mode = VA_RC_NONE;
 
+    for (i = 0; i < I965_ENCODER_INPUT_SURFACES; i++)
+        encoder_context->input_pool.surface_id[i] = VA_INVALID_SURFACE;
+
     switch (obj_config->profile) {
     case VAProfileMPEG2Simple:
     case VAProfileMPEG2Main:
@@ -364,9 +448,9 @@ intel_enc_hw_context_init(VADriverContextP ctx,
             encoder_context->rate_control_mode = obj_config->attrib_list[i].value;
 
             if (encoder_context->codec == CODEC_MPEG2 &&
-                encoder_context->rate_control_mode & VA_RC_CBR) {
-                WARN_ONCE("Don't support CBR for MPEG-2 encoding\n");
-                encoder_context->rate_control_mode &= ~VA_RC_CBR;
+                encoder_context->rate_control_mode & (VA_RC_CBR | VA_RC_VBR)) {
+                WARN_ONCE("Don't support CBR/VBR for MPEG-2 encoding\n");
+                encoder_context->rate_control_mode &= ~(VA_RC_CBR | VA_RC_VBR);
             }
 
             break;
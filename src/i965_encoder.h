@@ -36,12 +36,25 @@
 #include "i965_structs.h"
 #include "i965_drv_video.h"
 
+/*
+ * Conversion surfaces of the input frames which aren't Y tiled NV12, used
+ * in turn so that a frame can be converted while the previous one is
+ * still being encoded
+ */
+#define I965_ENCODER_INPUT_SURFACES     2
+
 struct intel_encoder_context
 {
     struct hw_context base;
+    VADriverContextP driver_context;
     int codec;
     VASurfaceID input_yuv_surface;
-    int is_tmp_id;
+    struct {
+        VASurfaceID surface_id[I965_ENCODER_INPUT_SURFACES];
+        int width;
+        int height;
+        int next;
+    } input_pool;
     unsigned int rate_control_mode;
     void *vme_context;
     void *mfc_context;
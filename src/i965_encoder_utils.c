@@ -24,6 +24,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include <va/va.h>
@@ -199,6 +200,210 @@ static void nal_header(avc_bitstream *bs, int nal_ref_idc, int nal_unit_type)
     avc_bitstream_put_ui(bs, nal_unit_type, 5);
 }
 
+static int
+avc_ref_pic_is_valid(VAPictureH264 *pic)
+{
+    return !(pic->flags & VA_PICTURE_H264_INVALID) &&
+        pic->picture_id != VA_INVALID_SURFACE;
+}
+
+static int
+avc_ref_pic_is_long_term(VAPictureH264 *pic)
+{
+    return !!(pic->flags & VA_PICTURE_H264_LONG_TERM_REFERENCE);
+}
+
+/* FrameNumWrap of a short term reference frame, which is also its PicNum */
+static int
+avc_ref_pic_num(VAEncSequenceParameterBufferH264 *sps_param,
+                VAEncPictureParameterBufferH264 *pic_param,
+                VAPictureH264 *pic)
+{
+    int max_frame_num = 1 << (sps_param->seq_fields.bits.log2_max_frame_num_minus4 + 4);
+    int pic_num = pic->frame_idx;
+
+    if (pic_num > pic_param->frame_num)
+        pic_num -= max_frame_num;
+
+    return pic_num;
+}
+
+/*
+ * The sort key of a reference in the initial lists, smaller first:
+ * P slices order the short term references by descending PicNum, B slices
+ * put those before the current picture in L0 (after it in L1) by
+ * descending POC and then the others by ascending POC. The long term
+ * references always follow by ascending LongTermPicNum.
+ */
+static int
+avc_ref_pic_sort_key(VAEncSequenceParameterBufferH264 *sps_param,
+                     VAEncPictureParameterBufferH264 *pic_param,
+                     VAPictureH264 *pic,
+                     int is_b_slice,
+                     int list_index)
+{
+    int curr_poc = pic_param->CurrPic.TopFieldOrderCnt;
+    int poc = pic->TopFieldOrderCnt;
+
+    if (avc_ref_pic_is_long_term(pic))
+        return (1 << 24) + pic->frame_idx;
+
+    if (!is_b_slice)
+        return -avc_ref_pic_num(sps_param, pic_param, pic);
+
+    if (list_index == 1) {
+        curr_poc = -curr_poc;
+        poc = -poc;
+    }
+
+    if (poc < curr_poc)
+        return curr_poc - poc;
+    else
+        return (1 << 20) + poc - curr_poc;
+}
+
+int
+intel_avc_init_ref_pic_list(VAEncSequenceParameterBufferH264 *sps_param,
+                            VAEncPictureParameterBufferH264 *pic_param,
+                            int slice_type,
+                            int list_index,
+                            VAPictureH264 *ref_list)
+{
+    int is_b_slice = IS_B_SLICE(slice_type);
+    int keys[16];
+    int i, j, num_refs = 0;
+
+    if (IS_I_SLICE(slice_type) || (list_index == 1 && !is_b_slice))
+        return 0;
+
+    for (i = 0; i < 16; i++) {
+        VAPictureH264 *pic = &pic_param->ReferenceFrames[i];
+        int key;
+
+        if (!avc_ref_pic_is_valid(pic))
+            break;
+
+        key = avc_ref_pic_sort_key(sps_param, pic_param, pic, is_b_slice, list_index);
+
+        for (j = num_refs; j > 0 && keys[j - 1] > key; j--) {
+            keys[j] = keys[j - 1];
+            ref_list[j] = ref_list[j - 1];
+        }
+
+        keys[j] = key;
+        ref_list[j] = *pic;
+        num_refs++;
+    }
+
+    /* 8.2.4.2.3: L1 must differ from L0 when it has more than one entry */
+    if (list_index == 1 && num_refs > 1) {
+        VAPictureH264 ref_list0[16];
+        int num_refs0 = intel_avc_init_ref_pic_list(sps_param, pic_param, slice_type, 0, ref_list0);
+
+        for (i = 0; i < num_refs; i++) {
+            if (i >= num_refs0 ||
+                ref_list[i].picture_id != ref_list0[i].picture_id)
+                break;
+        }
+
+        if (i == num_refs) {
+            VAPictureH264 tmp = ref_list[0];
+
+            ref_list[0] = ref_list[1];
+            ref_list[1] = tmp;
+        }
+    }
+
+    return num_refs;
+}
+
+int
+intel_avc_enc_ref_pic_list(VAEncSequenceParameterBufferH264 *sps_param,
+                           VAEncPictureParameterBufferH264 *pic_param,
+                           VAEncSliceParameterBufferH264 *slice_param,
+                           int list_index,
+                           VAPictureH264 *ref_list)
+{
+    VAPictureH264 *app_list = list_index ? slice_param->RefPicList1 : slice_param->RefPicList0;
+    int num_active, num_refs, i;
+
+    if (slice_param->num_ref_idx_active_override_flag)
+        num_active = 1 + (list_index ? slice_param->num_ref_idx_l1_active_minus1 : slice_param->num_ref_idx_l0_active_minus1);
+    else
+        num_active = 1 + (list_index ? pic_param->num_ref_idx_l1_active_minus1 : pic_param->num_ref_idx_l0_active_minus1);
+
+    num_refs = intel_avc_init_ref_pic_list(sps_param, pic_param, slice_param->slice_type, list_index, ref_list);
+
+    if (num_refs == 0)
+        return 0;
+
+    for (i = 0; i < num_active; i++) {
+        if (!avc_ref_pic_is_valid(&app_list[i]))
+            break;
+    }
+
+    if (i == num_active) {
+        memcpy(ref_list, app_list, num_active * sizeof(*ref_list));
+        return num_active;
+    }
+
+    return num_refs < num_active ? num_refs : num_active;
+}
+
+/* 7.3.3.1: move the references of the driver's list to their ref_idx one by one */
+static void
+ref_pic_list_modification(avc_bitstream *bs,
+                          VAEncSequenceParameterBufferH264 *sps_param,
+                          VAEncPictureParameterBufferH264 *pic_param,
+                          VAEncSliceParameterBufferH264 *slice_param,
+                          int list_index)
+{
+    VAPictureH264 init_list[16], ref_list[32];
+    int num_init, num_refs, pic_num_pred, i;
+
+    num_init = intel_avc_init_ref_pic_list(sps_param, pic_param, slice_param->slice_type, list_index, init_list);
+    num_refs = intel_avc_enc_ref_pic_list(sps_param, pic_param, slice_param, list_index, ref_list);
+
+    for (i = 0; i < num_refs; i++) {
+        if (i >= num_init ||
+            ref_list[i].picture_id != init_list[i].picture_id)
+            break;
+    }
+
+    if (i == num_refs) {
+        avc_bitstream_put_ui(bs, 0, 1);         /* ref_pic_list_modification_flag_lX: 0 */
+        return;
+    }
+
+    avc_bitstream_put_ui(bs, 1, 1);             /* ref_pic_list_modification_flag_lX: 1 */
+    pic_num_pred = pic_param->frame_num;
+
+    for (i = 0; i < num_refs; i++) {
+        if (avc_ref_pic_is_long_term(&ref_list[i])) {
+            avc_bitstream_put_ue(bs, 2);        /* modification_of_pic_nums_idc: long term */
+            avc_bitstream_put_ue(bs, ref_list[i].frame_idx);
+        } else {
+            int pic_num = avc_ref_pic_num(sps_param, pic_param, &ref_list[i]);
+
+            /* a repeated entry wraps around by MaxPicNum to itself */
+            if (pic_num == pic_num_pred) {
+                avc_bitstream_put_ue(bs, 0);    /* modification_of_pic_nums_idc: subtract */
+                avc_bitstream_put_ue(bs, (1 << (sps_param->seq_fields.bits.log2_max_frame_num_minus4 + 4)) - 1);
+            } else if (pic_num < pic_num_pred) {
+                avc_bitstream_put_ue(bs, 0);    /* modification_of_pic_nums_idc: subtract */
+                avc_bitstream_put_ue(bs, pic_num_pred - pic_num - 1);
+            } else {
+                avc_bitstream_put_ue(bs, 1);    /* modification_of_pic_nums_idc: add */
+                avc_bitstream_put_ue(bs, pic_num - pic_num_pred - 1);
+            }
+
+            pic_num_pred = pic_num;
+        }
+    }
+
+    avc_bitstream_put_ue(bs, 3);                /* modification_of_pic_nums_idc: end */
+}
+
 static void 
 slice_header(avc_bitstream *bs,
              VAEncSequenceParameterBufferH264 *sps_param,
@@ -238,8 +443,7 @@ slice_header(avc_bitstream *bs,
         if (slice_param->num_ref_idx_active_override_flag)
             avc_bitstream_put_ue(bs, slice_param->num_ref_idx_l0_active_minus1);
 
-        /* ref_pic_list_reordering */
-        avc_bitstream_put_ui(bs, 0, 1);            /* ref_pic_list_reordering_flag_l0: 0 */
+        ref_pic_list_modification(bs, sps_param, pic_param, slice_param, 0);
     } else if (IS_B_SLICE(slice_param->slice_type)) {
         avc_bitstream_put_ui(bs, slice_param->direct_spatial_mv_pred_flag, 1);            /* direct_spatial_mv_pred: 1 */
 
@@ -250,9 +454,8 @@ slice_header(avc_bitstream *bs,
             avc_bitstream_put_ue(bs, slice_param->num_ref_idx_l1_active_minus1);
         }
 
-        /* ref_pic_list_reordering */
-        avc_bitstream_put_ui(bs, 0, 1);            /* ref_pic_list_reordering_flag_l0: 0 */
-        avc_bitstream_put_ui(bs, 0, 1);            /* ref_pic_list_reordering_flag_l1: 0 */
+        ref_pic_list_modification(bs, sps_param, pic_param, slice_param, 0);
+        ref_pic_list_modification(bs, sps_param, pic_param, slice_param, 1);
     } 
 
     if ((pic_param->pic_fields.bits.weighted_pred_flag && 
@@ -6,6 +6,29 @@ build_avc_slice_header(VAEncSequenceParameterBufferH264 *sps_param,
                        VAEncPictureParameterBufferH264 *pic_param,
                        VAEncSliceParameterBufferH264 *slice_param,
                        unsigned char **slice_header_buffer);
+/*
+ * The initial RefPicList0/1 of a frame (H.264 8.2.4.2) built from the DPB
+ * in pic_param->ReferenceFrames, returns the number of entries (at most 16).
+ */
+int
+intel_avc_init_ref_pic_list(VAEncSequenceParameterBufferH264 *sps_param,
+                            VAEncPictureParameterBufferH264 *pic_param,
+                            int slice_type,
+                            int list_index,
+                            VAPictureH264 *ref_list);
+
+/*
+ * The reference list a slice is encoded with: the application's
+ * RefPicList0/1 if all of its active entries are valid, the initial list
+ * otherwise. ref_list must hold 32 entries, returns the number of entries.
+ */
+int
+intel_avc_enc_ref_pic_list(VAEncSequenceParameterBufferH264 *sps_param,
+                           VAEncPictureParameterBufferH264 *pic_param,
+                           VAEncSliceParameterBufferH264 *slice_param,
+                           int list_index,
+                           VAPictureH264 *ref_list);
+
 int 
 build_avc_sei_buffering_period(int cpb_removal_length,
                                unsigned int init_cpb_removal_delay, 
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "i965_fence.h"
+
+/* How long a wait for any BO blocks on a single one before polling the others */
+#define I965_FENCE_POLL_NS      1000000
+
+struct i965_fence_waiter
+{
+    dri_bo *bo;
+    int fd;
+    struct i965_fence_waiter *next;
+};
+
+static int64_t
+i965_fence_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int
+i965_fence_wait(dri_bo **bos, int num_bos, int wait_all, int64_t timeout_ns, int *index)
+{
+    int64_t deadline = timeout_ns >= 0 ? i965_fence_now() + timeout_ns : -1;
+    int64_t remaining = timeout_ns;
+    int i;
+
+    if (wait_all) {
+        for (i = 0; i < num_bos; i++) {
+            if (!bos[i])
+                continue;
+
+            if (deadline >= 0) {
+                remaining = deadline - i965_fence_now();
+
+                if (remaining < 0)
+                    remaining = 0;
+            }
+
+            if (drm_intel_gem_bo_wait(bos[i], remaining))
+                return -1;
+        }
+
+        return 0;
+    }
+
+    for (;;) {
+        int busy = -1;
+        int64_t slice = I965_FENCE_POLL_NS;
+
+        for (i = 0; i < num_bos; i++) {
+            if (!bos[i] || !drm_intel_bo_busy(bos[i])) {
+                if (index)
+                    *index = i;
+
+                return 0;
+            }
+
+            if (busy < 0)
+                busy = i;
+        }
+
+        if (busy < 0)
+            return -1;  /* empty list */
+
+        if (deadline >= 0) {
+            remaining = deadline - i965_fence_now();
+
+            if (remaining <= 0)
+                return -1;
+
+            if (remaining < slice)
+                slice = remaining;
+        }
+
+        /* With a single BO there is nothing else to poll for */
+        if (num_bos == 1)
+            slice = remaining;
+
+        drm_intel_gem_bo_wait(bos[busy], slice);
+    }
+}
+
+static void
+i965_fence_signal(int fd)
+{
+    uint64_t value = 1;
+
+    if (write(fd, &value, sizeof(value)) != sizeof(value))
+        fprintf(stderr, "failed to signal fence fd %d\n", fd);
+}
+
+static void *
+i965_fence_notifier_thread(void *data)
+{
+    struct i965_fence_notifier *notifier = data;
+
+    pthread_mutex_lock(&notifier->mutex);
+
+    while (!notifier->quit) {
+        struct i965_fence_waiter **p = &notifier->waiters;
+        dri_bo *busy_bo = NULL;
+
+        if (!notifier->waiters) {
+            pthread_cond_wait(&notifier->cond, &notifier->mutex);
+            continue;
+        }
+
+        while (*p) {
+            struct i965_fence_waiter *waiter = *p;
+
+            if (drm_intel_bo_busy(waiter->bo)) {
+                busy_bo = waiter->bo;
+                p = &waiter->next;
+                continue;
+            }
+
+            i965_fence_signal(waiter->fd);
+            *p = waiter->next;
+            dri_bo_unreference(waiter->bo);
+            free(waiter);
+        }
+
+        if (busy_bo) {
+            dri_bo_reference(busy_bo);
+            pthread_mutex_unlock(&notifier->mutex);
+            drm_intel_gem_bo_wait(busy_bo, I965_FENCE_POLL_NS);
+            dri_bo_unreference(busy_bo);
+            pthread_mutex_lock(&notifier->mutex);
+        }
+    }
+
+    pthread_mutex_unlock(&notifier->mutex);
+
+    return NULL;
+}
+
+void
+i965_fence_notifier_init(struct i965_fence_notifier *notifier)
+{
+    memset(notifier, 0, sizeof(*notifier));
+    pthread_mutex_init(&notifier->mutex, NULL);
+    pthread_cond_init(&notifier->cond, NULL);
+}
+
+void
+i965_fence_notifier_terminate(struct i965_fence_notifier *notifier)
+{
+    struct i965_fence_waiter *waiter;
+
+    pthread_mutex_lock(&notifier->mutex);
+    notifier->quit = 1;
+    pthread_cond_signal(&notifier->cond);
+    pthread_mutex_unlock(&notifier->mutex);
+
+    if (notifier->thread_started)
+        pthread_join(notifier->thread, NULL);
+
+    while ((waiter = notifier->waiters) != NULL) {
+        notifier->waiters = waiter->next;
+        dri_bo_unreference(waiter->bo);
+        free(waiter);
+    }
+
+    pthread_cond_destroy(&notifier->cond);
+    pthread_mutex_destroy(&notifier->mutex);
+}
+
+int
+i965_fence_notifier_add(struct i965_fence_notifier *notifier, dri_bo *bo, int fd)
+{
+    struct i965_fence_waiter *waiter;
+
+    if (fd < 0)
+        return -1;
+
+    if (!bo || !drm_intel_bo_busy(bo)) {
+        i965_fence_signal(fd);
+        return 0;
+    }
+
+    waiter = malloc(sizeof(*waiter));
+
+    if (!waiter)
+        return -1;
+
+    dri_bo_reference(bo);
+    waiter->bo = bo;
+    waiter->fd = fd;
+
+    pthread_mutex_lock(&notifier->mutex);
+
+    if (!notifier->thread_started) {
+        if (pthread_create(&notifier->thread, NULL, i965_fence_notifier_thread, notifier)) {
+            pthread_mutex_unlock(&notifier->mutex);
+            dri_bo_unreference(bo);
+            free(waiter);
+            return -1;
+        }
+
+        notifier->thread_started = 1;
+    }
+
+    waiter->next = notifier->waiters;
+    notifier->waiters = waiter;
+    pthread_cond_signal(&notifier->cond);
+    pthread_mutex_unlock(&notifier->mutex);
+
+    return 0;
+}
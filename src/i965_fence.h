@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_FENCE_H
+#define I965_FENCE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <intel_bufmgr.h>
+
+struct i965_fence_waiter;
+
+/*
+ * Signals file descriptors (typically eventfds) once BOs retire, from a
+ * helper thread started on demand.
+ */
+struct i965_fence_notifier
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int thread_started;
+    int quit;
+    struct i965_fence_waiter *waiters;
+};
+
+/*
+ * Waits for the GPU to be done with one (wait_all = 0) or all of the BOs,
+ * NULL BOs count as retired. A negative timeout waits forever.
+ * Returns 0 and sets *index to a retired BO when waiting for any, returns
+ * -1 on timeout.
+ */
+int
+i965_fence_wait(dri_bo **bos, int num_bos, int wait_all, int64_t timeout_ns, int *index);
+
+void
+i965_fence_notifier_init(struct i965_fence_notifier *notifier);
+
+void
+i965_fence_notifier_terminate(struct i965_fence_notifier *notifier);
+
+/*
+ * Writes an 8-byte 1 to fd once bo retires.
+ * Returns 0 on success, -1 on error
+ */
+int
+i965_fence_notifier_add(struct i965_fence_notifier *notifier, dri_bo *bo, int fd);
+
+#endif /* I965_FENCE_H */
@@ -0,0 +1,629 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <va/va.h>
+#include <i915_drm.h>
+
+#include "i965_fourcc.h"
+#include "i965_image_convert.h"
+#include "i965_tiling.h"
+
+#if defined(__SSE2__)
+#define I965_CONVERT_SSE2       1
+#include <emmintrin.h>
+#endif
+
+enum i965_convert_layout
+{
+    CONVERT_NONE = 0,
+    CONVERT_PLANAR_420,         /* I420, YV12, IMC1, IMC3 */
+    CONVERT_NV12,
+    CONVERT_P010,
+    CONVERT_PACKED_YUYV,
+    CONVERT_PACKED_UYVY,
+    CONVERT_RGBX,
+    CONVERT_BGRX,
+};
+
+/* Limited range YUV to RGB coefficients in 8.8 fixed point */
+struct i965_csc_coefs
+{
+    int16_t y, rv, gu, gv, bu;
+};
+
+static const struct i965_csc_coefs i965_csc_coefs[] = {
+    [I965_CSC_BT601] = { 298, 409, -100, -208, 516 },
+    [I965_CSC_BT709] = { 298, 459, -55, -136, 541 },
+};
+
+/*
+ * One pair of rows split into 8 bit planes. Sources with per-row chroma
+ * (4:2:2) set u[1]/v[1] apart from u[0]/v[0].
+ */
+struct i965_convert_rows
+{
+    const uint8_t *y[2];
+    const uint8_t *u[2];
+    const uint8_t *v[2];
+};
+
+struct i965_convert_lines
+{
+    uint8_t *fetch;             /* detiled source row */
+    uint8_t *y[2];
+    uint8_t *u[2];
+    uint8_t *v[2];
+    uint8_t *chroma;            /* averaged 4:2:0 chroma row */
+};
+
+static int
+i965_convert_src_layout(uint32_t fourcc)
+{
+    switch (fourcc) {
+    case VA_FOURCC_I420:
+    case VA_FOURCC_IYUV:
+    case VA_FOURCC_YV12:
+    case VA_FOURCC_IMC1:
+    case VA_FOURCC_IMC3:
+        return CONVERT_PLANAR_420;
+
+    case VA_FOURCC_NV12:
+        return CONVERT_NV12;
+
+#ifdef VA_FOURCC_P010
+    case VA_FOURCC_P010:
+        return CONVERT_P010;
+#endif
+
+    case VA_FOURCC_YUY2:
+        return CONVERT_PACKED_YUYV;
+
+    case VA_FOURCC_UYVY:
+        return CONVERT_PACKED_UYVY;
+
+    default:
+        return CONVERT_NONE;
+    }
+}
+
+static int
+i965_convert_dst_layout(uint32_t fourcc)
+{
+    switch (fourcc) {
+    case VA_FOURCC_I420:
+    case VA_FOURCC_IYUV:
+    case VA_FOURCC_YV12:
+        return CONVERT_PLANAR_420;
+
+    case VA_FOURCC_NV12:
+        return CONVERT_NV12;
+
+    case VA_FOURCC_YUY2:
+        return CONVERT_PACKED_YUYV;
+
+    case VA_FOURCC_UYVY:
+        return CONVERT_PACKED_UYVY;
+
+    case VA_FOURCC_RGBX:
+    case VA_FOURCC_RGBA:
+        return CONVERT_RGBX;
+
+    case VA_FOURCC_BGRX:
+    case VA_FOURCC_BGRA:
+        return CONVERT_BGRX;
+
+    default:
+        return CONVERT_NONE;
+    }
+}
+
+int
+i965_image_convert_supported(uint32_t src_fourcc, uint32_t dst_fourcc)
+{
+    return (i965_convert_src_layout(src_fourcc) != CONVERT_NONE &&
+            i965_convert_dst_layout(dst_fourcc) != CONVERT_NONE);
+}
+
+void
+i965_image_layout_move(struct i965_image_layout *layout,
+                       unsigned int x, unsigned int y)
+{
+    int layout_type = i965_convert_src_layout(layout->fourcc);
+
+    if (layout_type == CONVERT_NONE)
+        layout_type = i965_convert_dst_layout(layout->fourcc);
+
+    switch (layout_type) {
+    case CONVERT_PLANAR_420:
+        layout->offsets[0] += y * layout->pitches[0] + x;
+        layout->offsets[1] += (y / 2) * layout->pitches[1] + x / 2;
+        layout->offsets[2] += (y / 2) * layout->pitches[2] + x / 2;
+        break;
+
+    case CONVERT_NV12:
+        layout->offsets[0] += y * layout->pitches[0] + x;
+        layout->offsets[1] += (y / 2) * layout->pitches[1] + (x & -2);
+        break;
+
+    case CONVERT_P010:
+        layout->offsets[0] += y * layout->pitches[0] + x * 2;
+        layout->offsets[1] += (y / 2) * layout->pitches[1] + (x & -2) * 2;
+        break;
+
+    case CONVERT_PACKED_YUYV:
+    case CONVERT_PACKED_UYVY:
+        layout->offsets[0] += y * layout->pitches[0] + (x & -2) * 2;
+        break;
+
+    case CONVERT_RGBX:
+    case CONVERT_BGRX:
+        layout->offsets[0] += y * layout->pitches[0] + x * 4;
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* Returns len bytes of the source at offset, detiling them if needed */
+static const uint8_t *
+i965_convert_fetch(const struct i965_image_layout *src, unsigned int offset,
+                   unsigned int len, uint8_t *line)
+{
+    unsigned int pitch = src->pitches[0];
+
+    if (src->tiling == I915_TILING_NONE)
+        return src->base + offset;
+
+    i965_tiled_to_linear(line, len,
+                         src->base, pitch,
+                         src->tiling, src->swizzle,
+                         offset % pitch, offset / pitch,
+                         len, 1);
+
+    return line;
+}
+
+static void
+deinterleave_uv(uint8_t *u, uint8_t *v, const uint8_t *uv, unsigned int n)
+{
+    unsigned int i = 0;
+
+#ifdef I965_CONVERT_SSE2
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(uv + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(uv + 2 * i + 16));
+        __m128i lo = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+        __m128i hi = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+
+        _mm_storeu_si128((__m128i *)(u + i), lo);
+        _mm_storeu_si128((__m128i *)(v + i), hi);
+    }
+#endif
+
+    for (; i < n; i++) {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+
+static void
+interleave_uv(uint8_t *uv, const uint8_t *u, const uint8_t *v, unsigned int n)
+{
+    unsigned int i = 0;
+
+#ifdef I965_CONVERT_SSE2
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(u + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(v + i));
+
+        _mm_storeu_si128((__m128i *)(uv + 2 * i), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(uv + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+    }
+#endif
+
+    for (; i < n; i++) {
+        uv[2 * i] = u[i];
+        uv[2 * i + 1] = v[i];
+    }
+}
+
+/* Rounds up like PAVGB */
+static void
+average_rows(uint8_t *dst, const uint8_t *a, const uint8_t *b, unsigned int n)
+{
+    unsigned int i = 0;
+
+#ifdef I965_CONVERT_SSE2
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_avg_epu8(x, y));
+    }
+#endif
+
+    for (; i < n; i++)
+        dst[i] = (a[i] + b[i] + 1) >> 1;
+}
+
+/* Takes the 8 most significant bits of little endian 16 bit samples */
+static void
+narrow_16to8(uint8_t *dst, const uint8_t *src, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+        dst[i] = src[2 * i + 1];
+}
+
+static void
+unpack_packed422(uint8_t *y, uint8_t *u, uint8_t *v,
+                 const uint8_t *src, unsigned int width, int uyvy)
+{
+    unsigned int i;
+    int y_off = uyvy ? 1 : 0;
+    int c_off = uyvy ? 0 : 1;
+
+    for (i = 0; i < width / 2; i++) {
+        y[2 * i] = src[4 * i + y_off];
+        y[2 * i + 1] = src[4 * i + y_off + 2];
+        u[i] = src[4 * i + c_off];
+        v[i] = src[4 * i + c_off + 2];
+    }
+
+    if (width & 1) {
+        y[2 * i] = src[4 * i + y_off];
+        u[i] = src[4 * i + c_off];
+        v[i] = src[4 * i + c_off + 2];
+    }
+}
+
+static void
+pack_packed422(uint8_t *dst, const uint8_t *y, const uint8_t *u,
+               const uint8_t *v, unsigned int width, int uyvy)
+{
+    unsigned int i = 0;
+
+#ifdef I965_CONVERT_SSE2
+    for (; i + 16 <= width; i += 16) {
+        __m128i yy = _mm_loadu_si128((const __m128i *)(y + i));
+        __m128i uu = _mm_loadl_epi64((const __m128i *)(u + i / 2));
+        __m128i vv = _mm_loadl_epi64((const __m128i *)(v + i / 2));
+        __m128i uv = _mm_unpacklo_epi8(uu, vv);
+
+        if (uyvy) {
+            _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(uv, yy));
+            _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(uv, yy));
+        } else {
+            _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(yy, uv));
+            _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(yy, uv));
+        }
+    }
+#endif
+
+    for (; i + 2 <= width; i += 2) {
+        uint8_t *p = dst + 2 * i;
+
+        if (uyvy) {
+            p[0] = u[i / 2];
+            p[1] = y[i];
+            p[2] = v[i / 2];
+            p[3] = y[i + 1];
+        } else {
+            p[0] = y[i];
+            p[1] = u[i / 2];
+            p[2] = y[i + 1];
+            p[3] = v[i / 2];
+        }
+    }
+
+    if (i < width) {
+        uint8_t *p = dst + 2 * i;
+
+        if (uyvy) {
+            p[0] = u[i / 2];
+            p[1] = y[i];
+        } else {
+            p[0] = y[i];
+            p[1] = u[i / 2];
+        }
+    }
+}
+
+static inline uint8_t
+clamp_u8(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static void
+yuv_to_rgbx(uint8_t *dst, const uint8_t *y, const uint8_t *u,
+            const uint8_t *v, unsigned int width,
+            const struct i965_csc_coefs *k, int bgr)
+{
+    unsigned int i = 0;
+
+#ifdef I965_CONVERT_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ff = _mm_set1_epi8((char)0xff);
+    const __m128i y_bias = _mm_set1_epi16(16);
+    const __m128i c_bias = _mm_set1_epi16(128);
+    /* (Y, Cr), (Y, Cb) and (Cr, 1) pairs for PMADDWD, rounding folded in */
+    const __m128i k_r = _mm_set_epi16(k->rv, k->y, k->rv, k->y, k->rv, k->y, k->rv, k->y);
+    const __m128i k_g = _mm_set_epi16(k->gu, k->y, k->gu, k->y, k->gu, k->y, k->gu, k->y);
+    const __m128i k_gv = _mm_set_epi16(128, k->gv, 128, k->gv, 128, k->gv, 128, k->gv);
+    const __m128i k_b = _mm_set_epi16(k->bu, k->y, k->bu, k->y, k->bu, k->y, k->bu, k->y);
+    const __m128i round = _mm_set1_epi32(128);
+    const __m128i one = _mm_set1_epi16(1);
+
+    for (; i + 8 <= width; i += 8) {
+        __m128i yy = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(y + i)), zero), y_bias);
+        __m128i uu, vv;
+        __m128i r[2], g[2], b[2];
+        __m128i rr, gg, bb, rg, bx;
+        int u4, v4, h;
+
+        memcpy(&u4, u + i / 2, sizeof(u4));
+        memcpy(&v4, v + i / 2, sizeof(v4));
+        uu = _mm_cvtsi32_si128(u4);
+        vv = _mm_cvtsi32_si128(v4);
+
+        /* Replicate every chroma sample horizontally */
+        uu = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_unpacklo_epi8(uu, uu), zero), c_bias);
+        vv = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_unpacklo_epi8(vv, vv), zero), c_bias);
+
+        for (h = 0; h < 2; h++) {
+            __m128i yv = h ? _mm_unpackhi_epi16(yy, vv) : _mm_unpacklo_epi16(yy, vv);
+            __m128i yu = h ? _mm_unpackhi_epi16(yy, uu) : _mm_unpacklo_epi16(yy, uu);
+            __m128i v1 = h ? _mm_unpackhi_epi16(vv, one) : _mm_unpacklo_epi16(vv, one);
+
+            r[h] = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yv, k_r), round), 8);
+            g[h] = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu, k_g), _mm_madd_epi16(v1, k_gv)), 8);
+            b[h] = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu, k_b), round), 8);
+        }
+
+        rr = _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), zero);
+        gg = _mm_packus_epi16(_mm_packs_epi32(g[0], g[1]), zero);
+        bb = _mm_packus_epi16(_mm_packs_epi32(b[0], b[1]), zero);
+
+        if (bgr) {
+            __m128i t = rr;
+
+            rr = bb;
+            bb = t;
+        }
+
+        rg = _mm_unpacklo_epi8(rr, gg);
+        bx = _mm_unpacklo_epi8(bb, ff);
+        _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_unpacklo_epi16(rg, bx));
+        _mm_storeu_si128((__m128i *)(dst + 4 * i + 16), _mm_unpackhi_epi16(rg, bx));
+    }
+#endif
+
+    for (; i < width; i++) {
+        int c = y[i] - 16;
+        int d = u[i / 2] - 128;
+        int e = v[i / 2] - 128;
+        uint8_t r = clamp_u8((k->y * c + k->rv * e + 128) >> 8);
+        uint8_t g = clamp_u8((k->y * c + k->gu * d + k->gv * e + 128) >> 8);
+        uint8_t b = clamp_u8((k->y * c + k->bu * d + 128) >> 8);
+        uint8_t *p = dst + 4 * i;
+
+        p[0] = bgr ? b : r;
+        p[1] = g;
+        p[2] = bgr ? r : b;
+        p[3] = 0xff;
+    }
+}
+
+/* Splits rows [row, row + num_rows) of the source into 8 bit planes */
+static void
+i965_convert_unpack(const struct i965_image_layout *src, int layout,
+                    unsigned int row, unsigned int num_rows,
+                    unsigned int width, struct i965_convert_lines *lines,
+                    struct i965_convert_rows *rows)
+{
+    unsigned int cw = (width + 1) / 2;
+    const uint8_t *p;
+    unsigned int i;
+
+    for (i = 0; i < num_rows; i++) {
+        unsigned int offset = src->offsets[0] + (row + i) * src->pitches[0];
+
+        switch (layout) {
+        case CONVERT_PACKED_YUYV:
+        case CONVERT_PACKED_UYVY:
+            p = i965_convert_fetch(src, offset, 4 * cw, lines->fetch);
+            unpack_packed422(lines->y[i], lines->u[i], lines->v[i], p, width,
+                             layout == CONVERT_PACKED_UYVY);
+            rows->y[i] = lines->y[i];
+            rows->u[i] = lines->u[i];
+            rows->v[i] = lines->v[i];
+            break;
+
+        case CONVERT_P010:
+            p = i965_convert_fetch(src, offset, 2 * width, lines->fetch);
+            narrow_16to8(lines->y[i], p, width);
+            rows->y[i] = lines->y[i];
+            break;
+
+        default:
+            if (src->tiling == I915_TILING_NONE) {
+                rows->y[i] = src->base + offset;
+            } else {
+                rows->y[i] = i965_convert_fetch(src, offset, width, lines->y[i]);
+            }
+
+            break;
+        }
+    }
+
+    switch (layout) {
+    case CONVERT_PLANAR_420:
+        p = i965_convert_fetch(src, src->offsets[1] + (row / 2) * src->pitches[1], cw, lines->u[0]);
+        rows->u[0] = rows->u[1] = p;
+        p = i965_convert_fetch(src, src->offsets[2] + (row / 2) * src->pitches[2], cw, lines->v[0]);
+        rows->v[0] = rows->v[1] = p;
+        break;
+
+    case CONVERT_NV12:
+        p = i965_convert_fetch(src, src->offsets[1] + (row / 2) * src->pitches[1], 2 * cw, lines->fetch);
+        deinterleave_uv(lines->u[0], lines->v[0], p, cw);
+        rows->u[0] = rows->u[1] = lines->u[0];
+        rows->v[0] = rows->v[1] = lines->v[0];
+        break;
+
+    case CONVERT_P010:
+        p = i965_convert_fetch(src, src->offsets[1] + (row / 2) * src->pitches[1], 4 * cw, lines->fetch);
+        narrow_16to8(lines->chroma, p, 2 * cw);
+        deinterleave_uv(lines->u[0], lines->v[0], lines->chroma, cw);
+        rows->u[0] = rows->u[1] = lines->u[0];
+        rows->v[0] = rows->v[1] = lines->v[0];
+        break;
+
+    default:
+        break;
+    }
+
+    if (num_rows == 1) {
+        rows->y[1] = rows->y[0];
+        rows->u[1] = rows->u[0];
+        rows->v[1] = rows->v[0];
+    }
+}
+
+/* Returns the 4:2:0 chroma row of a row pair, averaging per-row chroma */
+static const uint8_t *
+i965_convert_chroma_420(const uint8_t * const c[2], uint8_t *line, unsigned int n)
+{
+    if (c[0] == c[1])
+        return c[0];
+
+    average_rows(line, c[0], c[1], n);
+
+    return line;
+}
+
+static void
+i965_convert_pack(const struct i965_image_layout *dst, int layout,
+                  unsigned int row, unsigned int num_rows,
+                  unsigned int width, struct i965_convert_lines *lines,
+                  const struct i965_convert_rows *rows,
+                  const struct i965_csc_coefs *coefs)
+{
+    unsigned int cw = (width + 1) / 2;
+    const uint8_t *u, *v;
+    unsigned int i;
+
+    for (i = 0; i < num_rows; i++) {
+        uint8_t *p = dst->base + dst->offsets[0] + (row + i) * dst->pitches[0];
+
+        switch (layout) {
+        case CONVERT_PACKED_YUYV:
+        case CONVERT_PACKED_UYVY:
+            pack_packed422(p, rows->y[i], rows->u[i], rows->v[i], width,
+                           layout == CONVERT_PACKED_UYVY);
+            break;
+
+        case CONVERT_RGBX:
+        case CONVERT_BGRX:
+            yuv_to_rgbx(p, rows->y[i], rows->u[i], rows->v[i], width,
+                        coefs, layout == CONVERT_BGRX);
+            break;
+
+        default:
+            memcpy(p, rows->y[i], width);
+            break;
+        }
+    }
+
+    switch (layout) {
+    case CONVERT_PLANAR_420:
+        /* Both lines are free again once the luma rows are written */
+        u = i965_convert_chroma_420(rows->u, lines->chroma, cw);
+        memcpy(dst->base + dst->offsets[1] + (row / 2) * dst->pitches[1], u, cw);
+        v = i965_convert_chroma_420(rows->v, lines->chroma, cw);
+        memcpy(dst->base + dst->offsets[2] + (row / 2) * dst->pitches[2], v, cw);
+        break;
+
+    case CONVERT_NV12:
+        u = i965_convert_chroma_420(rows->u, lines->chroma, cw);
+        v = i965_convert_chroma_420(rows->v, lines->chroma + cw, cw);
+        interleave_uv(dst->base + dst->offsets[1] + (row / 2) * dst->pitches[1], u, v, cw);
+        break;
+
+    default:
+        break;
+    }
+}
+
+int
+i965_image_convert(const struct i965_image_layout *src,
+                   const struct i965_image_layout *dst,
+                   unsigned int width, unsigned int height,
+                   int matrix)
+{
+    int src_layout = i965_convert_src_layout(src->fourcc);
+    int dst_layout = i965_convert_dst_layout(dst->fourcc);
+    const struct i965_csc_coefs *coefs = &i965_csc_coefs[matrix == I965_CSC_BT709 ? I965_CSC_BT709 : I965_CSC_BT601];
+    struct i965_convert_lines lines;
+    struct i965_convert_rows rows;
+    unsigned int line_size = (width + 1 + 31) & ~31;
+    unsigned int row;
+    uint8_t *mem;
+
+    if (src_layout == CONVERT_NONE || dst_layout == CONVERT_NONE)
+        return -1;
+
+    /* fetch takes up to 4 lines (P010 chroma), followed by 7 plane lines */
+    mem = malloc(line_size * (4 + 7));
+
+    if (!mem)
+        return -1;
+
+    lines.fetch = mem;
+    lines.y[0] = mem + 4 * line_size;
+    lines.y[1] = lines.y[0] + line_size;
+    lines.u[0] = lines.y[1] + line_size;
+    lines.u[1] = lines.u[0] + line_size;
+    lines.v[0] = lines.u[1] + line_size;
+    lines.v[1] = lines.v[0] + line_size;
+    lines.chroma = lines.v[1] + line_size;
+
+    for (row = 0; row < height; row += 2) {
+        unsigned int num_rows = height - row > 1 ? 2 : 1;
+
+        i965_convert_unpack(src, src_layout, row, num_rows, width, &lines, &rows);
+        i965_convert_pack(dst, dst_layout, row, num_rows, width, &lines, &rows, coefs);
+    }
+
+    free(mem);
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_IMAGE_CONVERT_H
+#define I965_IMAGE_CONVERT_H
+
+#include <stdint.h>
+
+#define I965_CSC_BT601          0
+#define I965_CSC_BT709          1
+
+/*
+ * Describes a rectangle of an image in memory. offsets[] point at the
+ * rectangle origin of the luma (or packed) plane and of the Cb and Cr
+ * planes; semi-planar formats only use offsets[1] for the CbCr plane.
+ * A tiled base is addressed as a surface of pitches[0] bytes per row.
+ */
+struct i965_image_layout
+{
+    uint32_t fourcc;
+    uint8_t *base;
+    unsigned int offsets[3];
+    unsigned int pitches[3];
+    uint32_t tiling;
+    uint32_t swizzle;
+};
+
+int
+i965_image_convert_supported(uint32_t src_fourcc, uint32_t dst_fourcc);
+
+/* Moves offsets[] from the plane origins to pixel (x, y), x and y even */
+void
+i965_image_layout_move(struct i965_image_layout *layout,
+                       unsigned int x, unsigned int y);
+
+/*
+ * Converts width x height pixels from src to the linear dst in a single
+ * pass, two rows at a time. matrix selects the YUV to RGB coefficients
+ * (limited range) for RGB destinations.
+ * Returns 0 on success, -1 if the formats are unsupported or on memory
+ * allocation failure.
+ */
+int
+i965_image_convert(const struct i965_image_layout *src,
+                   const struct i965_image_layout *dst,
+                   unsigned int width, unsigned int height,
+                   int matrix);
+
+#endif /* I965_IMAGE_CONVERT_H */
@@ -4486,6 +4486,20 @@ gen6_pp_object_walker(VADriverContextP ctx,
 
     dri_bo_unmap(command_buffer);
 
+    if (pp_context->batched) {
+        /* MI_BATCH_BUFFER_END of a second level batch returns to the batch */
+        BEGIN_BATCH(batch, 2);
+        OUT_BATCH(batch, MI_BATCH_BUFFER_START | (1 << 22) | (1 << 8));
+        OUT_RELOC(batch, command_buffer,
+                  I915_GEM_DOMAIN_COMMAND, 0,
+                  0);
+        ADVANCE_BATCH(batch);
+
+        dri_bo_unreference(command_buffer);
+
+        return;
+    }
+
     BEGIN_BATCH(batch, 2);
     OUT_BATCH(batch, MI_BATCH_BUFFER_START | (1 << 8));
     OUT_RELOC(batch, command_buffer,
@@ -4687,6 +4701,54 @@ i965_vpp_clear_surface(VADriverContextP ctx,
     intel_batchbuffer_end_atomic(batch);
 }
 
+/* Creates a post processing context with its own batch for the pool */
+static void *
+i965_pp_context_create(void *data)
+{
+    VADriverContextP ctx = data;
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct i965_post_processing_context *pp_context;
+    struct intel_batchbuffer *batch;
+
+    pp_context = calloc(1, sizeof(*pp_context));
+    batch = intel_batchbuffer_new(&i965->intel, I915_EXEC_RENDER, 0);
+
+    if (!pp_context || !batch) {
+        free(pp_context);
+
+        if (batch)
+            intel_batchbuffer_free(batch);
+
+        return NULL;
+    }
+
+    i965->codec_info->post_processing_context_init(ctx, pp_context, batch);
+
+    return pp_context;
+}
+
+/*
+ * Takes a post processing context from the pool of the driver, so the
+ * GetImage/PutImage, encoder and rendering conversions of different
+ * threads don't serialize on a single context. A single threaded user
+ * keeps getting the same context, and the DNDI history it leaves there.
+ */
+static struct i965_post_processing_context *
+i965_pp_context_get(VADriverContextP ctx)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+
+    return i965_context_pool_get(&i965->pp_pool, i965_pp_context_create, ctx);
+}
+
+static void
+i965_pp_context_put(VADriverContextP ctx, struct i965_post_processing_context *pp_context)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+
+    i965_context_pool_put(&i965->pp_pool, pp_context);
+}
+
 VAStatus
 i965_scaling_processing(
     VADriverContextP   ctx,
@@ -4703,10 +4765,14 @@ i965_scaling_processing(
     assert(dst_surface_obj->fourcc == VA_FOURCC_NV12);
 
     if (HAS_VPP(i965) && (flags & I965_PP_FLAG_AVS)) {
+        struct i965_post_processing_context *pp_context;
         struct i965_surface src_surface;
         struct i965_surface dst_surface;
 
-         _i965LockMutex(&i965->pp_mutex);
+         pp_context = i965_pp_context_get(ctx);
+
+         if (!pp_context)
+             return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
          src_surface.base = (struct object_base *)src_surface_obj;
          src_surface.type = I965_SURFACE_TYPE_SURFACE;
@@ -4715,7 +4781,7 @@ i965_scaling_processing(
          dst_surface.type = I965_SURFACE_TYPE_SURFACE;
          dst_surface.flags = I965_SURFACE_FLAG_FRAME;
 
-         va_status = i965_post_processing_internal(ctx, i965->pp_context,
+         va_status = i965_post_processing_internal(ctx, pp_context,
                                                    &src_surface,
                                                    src_rect,
                                                    &dst_surface,
@@ -4723,7 +4789,7 @@ i965_scaling_processing(
                                                    PP_NV12_AVS,
                                                    NULL);
 
-         _i965UnlockMutex(&i965->pp_mutex);
+         i965_pp_context_put(ctx, pp_context);
     }
 
     return va_status;
@@ -4746,6 +4812,7 @@ i965_post_processing(
     *has_done_scaling = 0;
 
     if (HAS_VPP(i965)) {
+        struct i965_post_processing_context *pp_context;
         VAStatus status;
         struct i965_surface src_surface;
         struct i965_surface dst_surface;
@@ -4754,7 +4821,10 @@ i965_post_processing(
         if (obj_surface->fourcc != VA_FOURCC_NV12)
             return out_surface_id;
 
-        _i965LockMutex(&i965->pp_mutex);
+        pp_context = i965_pp_context_get(ctx);
+
+        if (!pp_context)
+            return out_surface_id;
 
         if (flags & I965_PP_FLAG_MCDI) {
             src_surface.base = (struct object_base *)obj_surface;
@@ -4762,23 +4832,23 @@ i965_post_processing(
             src_surface.flags = (flags & I965_PP_FLAG_TOP_FIELD) ? 
                 I965_SURFACE_FLAG_TOP_FIELD_FIRST : I965_SURFACE_FLAG_BOTTOME_FIELD_FIRST;
 
-            status = i965_CreateSurfaces(ctx,
-                                         obj_surface->orig_width,
-                                         obj_surface->orig_height,
-                                         VA_RT_FORMAT_YUV420,
-                                         1,
-                                         &out_surface_id);
+            status = i965_surface_cache_get(ctx,
+                                            obj_surface->orig_width,
+                                            obj_surface->orig_height,
+                                            VA_FOURCC_NV12,
+                                            SUBSAMPLE_YUV420,
+                                            0,
+                                            &out_surface_id);
             assert(status == VA_STATUS_SUCCESS);
             obj_surface = SURFACE(out_surface_id);
             assert(obj_surface);
-            i965_check_alloc_surface_bo(ctx, obj_surface, 0, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
-            i965_vpp_clear_surface(ctx, i965->pp_context, obj_surface, 0); 
+            i965_vpp_clear_surface(ctx, pp_context, obj_surface, 0); 
 
             dst_surface.base = (struct object_base *)obj_surface;
             dst_surface.type = I965_SURFACE_TYPE_SURFACE;
             dst_surface.flags = I965_SURFACE_FLAG_FRAME;
 
-            i965_post_processing_internal(ctx, i965->pp_context,
+            i965_post_processing_internal(ctx, pp_context,
                                           &src_surface,
                                           src_rect,
                                           &dst_surface,
@@ -4798,23 +4868,23 @@ i965_post_processing(
             src_surface.type = I965_SURFACE_TYPE_SURFACE;
             src_surface.flags = I965_SURFACE_FLAG_FRAME;
 
-            status = i965_CreateSurfaces(ctx,
-                                         dest_region->width,
-                                         dest_region->height,
-                                         VA_RT_FORMAT_YUV420,
-                                         1,
-                                         &out_surface_id);
+            status = i965_surface_cache_get(ctx,
+                                            dest_region->width,
+                                            dest_region->height,
+                                            VA_FOURCC_NV12,
+                                            SUBSAMPLE_YUV420,
+                                            0,
+                                            &out_surface_id);
             assert(status == VA_STATUS_SUCCESS);
             obj_surface = SURFACE(out_surface_id);
             assert(obj_surface);
-            i965_check_alloc_surface_bo(ctx, obj_surface, 0, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
-            i965_vpp_clear_surface(ctx, i965->pp_context, obj_surface, 0); 
+            i965_vpp_clear_surface(ctx, pp_context, obj_surface, 0); 
 
             dst_surface.base = (struct object_base *)obj_surface;
             dst_surface.type = I965_SURFACE_TYPE_SURFACE;
             dst_surface.flags = I965_SURFACE_FLAG_FRAME;
 
-            i965_post_processing_internal(ctx, i965->pp_context,
+            i965_post_processing_internal(ctx, pp_context,
                                           &src_surface,
                                           src_rect,
                                           &dst_surface,
@@ -4823,12 +4893,12 @@ i965_post_processing(
                                           NULL);
 
             if (tmp_id != VA_INVALID_ID)
-                i965_DestroySurfaces(ctx, &tmp_id, 1);
+                i965_surface_cache_put(ctx, &tmp_id, 1);
                 
             *has_done_scaling = 1;
         }
 
-        _i965UnlockMutex(&i965->pp_mutex);
+        i965_pp_context_put(ctx, pp_context);
     }
 
     return out_surface_id;
@@ -4836,6 +4906,7 @@ i965_post_processing(
 
 static VAStatus
 i965_image_pl2_processing(VADriverContextP ctx,
+                          struct i965_post_processing_context *pp_context,
                           const struct i965_surface *src_surface,
                           const VARectangle *src_rect,
                           struct i965_surface *dst_surface,
@@ -4843,8 +4914,10 @@ i965_image_pl2_processing(VADriverContextP ctx,
 
 static VAStatus
 i965_image_plx_nv12_plx_processing(VADriverContextP ctx,
+                                   struct i965_post_processing_context *pp_context,
                                    VAStatus (*i965_image_plx_nv12_processing)(
                                        VADriverContextP,
+                                       struct i965_post_processing_context *,
                                        const struct i965_surface *,
                                        const VARectangle *,
                                        struct i965_surface *,
@@ -4862,22 +4935,23 @@ i965_image_plx_nv12_plx_processing(VADriverContextP ctx,
     int width, height;
 
     pp_get_surface_size(ctx, dst_surface, &width, &height);
-    status = i965_CreateSurfaces(ctx,
-                                 width,
-                                 height,
-                                 VA_RT_FORMAT_YUV420,
-                                 1,
-                                 &tmp_surface_id);
+    status = i965_surface_cache_get(ctx,
+                                    width,
+                                    height,
+                                    VA_FOURCC_NV12,
+                                    SUBSAMPLE_YUV420,
+                                    0,
+                                    &tmp_surface_id);
     assert(status == VA_STATUS_SUCCESS);
     obj_surface = SURFACE(tmp_surface_id);
     assert(obj_surface);
-    i965_check_alloc_surface_bo(ctx, obj_surface, 0, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
 
     tmp_surface.base = (struct object_base *)obj_surface;
     tmp_surface.type = I965_SURFACE_TYPE_SURFACE;
     tmp_surface.flags = I965_SURFACE_FLAG_FRAME;
 
     status = i965_image_plx_nv12_processing(ctx,
+                                            pp_context,
                                             src_surface,
                                             src_rect,
                                             &tmp_surface,
@@ -4885,14 +4959,15 @@ i965_image_plx_nv12_plx_processing(VADriverContextP ctx,
 
     if (status == VA_STATUS_SUCCESS)
         status = i965_image_pl2_processing(ctx,
+                                           pp_context,
                                            &tmp_surface,
                                            dst_rect,
                                            dst_surface,
                                            dst_rect);
 
-    i965_DestroySurfaces(ctx,
-                         &tmp_surface_id,
-                         1);
+    i965_surface_cache_put(ctx,
+                           &tmp_surface_id,
+                           1);
 
     return status;
 }
@@ -4900,19 +4975,18 @@ i965_image_plx_nv12_plx_processing(VADriverContextP ctx,
 
 static VAStatus
 i965_image_pl1_rgbx_processing(VADriverContextP ctx,
+                               struct i965_post_processing_context *pp_context,
                                const struct i965_surface *src_surface,
                                const VARectangle *src_rect,
                                struct i965_surface *dst_surface,
                                const VARectangle *dst_rect)
 {
-    struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
     int fourcc = pp_get_surface_fourcc(ctx, dst_surface);
     VAStatus vaStatus;
 
     switch (fourcc) {
     case VA_FOURCC_NV12:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -4924,6 +4998,7 @@ i965_image_pl1_rgbx_processing(VADriverContextP ctx,
 
     default:
         vaStatus = i965_image_plx_nv12_plx_processing(ctx,
+                                                      pp_context,
                                                       i965_image_pl1_rgbx_processing,
                                                       src_surface,
                                                       src_rect,
@@ -4937,19 +5012,18 @@ i965_image_pl1_rgbx_processing(VADriverContextP ctx,
 
 static VAStatus
 i965_image_pl3_processing(VADriverContextP ctx,
+                          struct i965_post_processing_context *pp_context,
                           const struct i965_surface *src_surface,
                           const VARectangle *src_rect,
                           struct i965_surface *dst_surface,
                           const VARectangle *dst_rect)
 {
-    struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
     int fourcc = pp_get_surface_fourcc(ctx, dst_surface);
     VAStatus vaStatus = VA_STATUS_ERROR_UNIMPLEMENTED;
 
     switch (fourcc) {
     case VA_FOURCC_NV12:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -4963,7 +5037,7 @@ i965_image_pl3_processing(VADriverContextP ctx,
     case VA_FOURCC_IMC3:
     case VA_FOURCC_YV12:
     case VA_FOURCC_I420:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -4975,7 +5049,7 @@ i965_image_pl3_processing(VADriverContextP ctx,
 
     case VA_FOURCC_YUY2:
     case VA_FOURCC_UYVY:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -4987,6 +5061,7 @@ i965_image_pl3_processing(VADriverContextP ctx,
 
     default:
         vaStatus = i965_image_plx_nv12_plx_processing(ctx,
+                                                      pp_context,
                                                       i965_image_pl3_processing,
                                                       src_surface,
                                                       src_rect,
@@ -5000,19 +5075,18 @@ i965_image_pl3_processing(VADriverContextP ctx,
 
 static VAStatus
 i965_image_pl2_processing(VADriverContextP ctx,
+                          struct i965_post_processing_context *pp_context,
                           const struct i965_surface *src_surface,
                           const VARectangle *src_rect,
                           struct i965_surface *dst_surface,
                           const VARectangle *dst_rect)
 {
-    struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
     int fourcc = pp_get_surface_fourcc(ctx, dst_surface);
     VAStatus vaStatus = VA_STATUS_ERROR_UNIMPLEMENTED;
 
     switch (fourcc) {
     case VA_FOURCC_NV12:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5025,7 +5099,7 @@ i965_image_pl2_processing(VADriverContextP ctx,
     case VA_FOURCC_IMC3:
     case VA_FOURCC_YV12:
     case VA_FOURCC_I420:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5036,7 +5110,7 @@ i965_image_pl2_processing(VADriverContextP ctx,
 
     case VA_FOURCC_YUY2:
     case VA_FOURCC_UYVY:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5049,7 +5123,7 @@ i965_image_pl2_processing(VADriverContextP ctx,
     case VA_FOURCC_BGRA:
     case VA_FOURCC_RGBX:
     case VA_FOURCC_RGBA:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5069,19 +5143,18 @@ i965_image_pl2_processing(VADriverContextP ctx,
 
 static VAStatus
 i965_image_pl1_processing(VADriverContextP ctx,
+                          struct i965_post_processing_context *pp_context,
                           const struct i965_surface *src_surface,
                           const VARectangle *src_rect,
                           struct i965_surface *dst_surface,
                           const VARectangle *dst_rect)
 {
-    struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
     int fourcc = pp_get_surface_fourcc(ctx, dst_surface);
     VAStatus vaStatus;
 
     switch (fourcc) {
     case VA_FOURCC_NV12:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5092,7 +5165,7 @@ i965_image_pl1_processing(VADriverContextP ctx,
         break;
 
     case VA_FOURCC_YV12:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5104,7 +5177,7 @@ i965_image_pl1_processing(VADriverContextP ctx,
 
     case VA_FOURCC_YUY2:
     case VA_FOURCC_UYVY:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5116,6 +5189,7 @@ i965_image_pl1_processing(VADriverContextP ctx,
 
     default:
         vaStatus = i965_image_plx_nv12_plx_processing(ctx,
+                                                      pp_context,
                                                       i965_image_pl1_processing,
                                                       src_surface,
                                                       src_rect,
@@ -5127,6 +5201,71 @@ i965_image_pl1_processing(VADriverContextP ctx,
     return vaStatus;
 }
 
+static VAStatus
+i965_image_processing_internal(VADriverContextP ctx,
+                               struct i965_post_processing_context *pp_context,
+                               const struct i965_surface *src_surface,
+                               const VARectangle *src_rect,
+                               struct i965_surface *dst_surface,
+                               const VARectangle *dst_rect)
+{
+    int fourcc = pp_get_surface_fourcc(ctx, src_surface);
+    VAStatus status;
+
+    switch (fourcc) {
+    case VA_FOURCC_YV12:
+    case VA_FOURCC_I420:
+    case VA_FOURCC_IMC1:
+    case VA_FOURCC_IMC3:
+    case VA_FOURCC_422H:
+    case VA_FOURCC_422V:
+    case VA_FOURCC_411P:
+    case VA_FOURCC_444P:
+    case VA_FOURCC_YV16:
+        status = i965_image_pl3_processing(ctx,
+                                           pp_context,
+                                           src_surface,
+                                           src_rect,
+                                           dst_surface,
+                                           dst_rect);
+        break;
+
+    case  VA_FOURCC_NV12:
+        status = i965_image_pl2_processing(ctx,
+                                           pp_context,
+                                           src_surface,
+                                           src_rect,
+                                           dst_surface,
+                                           dst_rect);
+        break;
+    case VA_FOURCC_YUY2:
+    case VA_FOURCC_UYVY:
+        status = i965_image_pl1_processing(ctx,
+                                           pp_context,
+                                           src_surface,
+                                           src_rect,
+                                           dst_surface,
+                                           dst_rect);
+        break;
+    case VA_FOURCC_BGRA:
+    case VA_FOURCC_BGRX:
+    case VA_FOURCC_RGBA:
+    case VA_FOURCC_RGBX:
+        status = i965_image_pl1_rgbx_processing(ctx,
+                                                pp_context,
+                                                src_surface,
+                                                src_rect,
+                                                dst_surface,
+                                                dst_rect);
+        break;
+    default:
+        status = VA_STATUS_ERROR_UNIMPLEMENTED;
+        break;
+    }
+
+    return status;
+}
+
 VAStatus
 i965_image_processing(VADriverContextP ctx,
                       const struct i965_surface *src_surface,
@@ -5135,61 +5274,23 @@ i965_image_processing(VADriverContextP ctx,
                       const VARectangle *dst_rect)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct i965_post_processing_context *pp_context;
     VAStatus status = VA_STATUS_ERROR_UNIMPLEMENTED;
 
     if (HAS_VPP(i965)) {
-        int fourcc = pp_get_surface_fourcc(ctx, src_surface);
+        pp_context = i965_pp_context_get(ctx);
 
-        _i965LockMutex(&i965->pp_mutex);
+        if (!pp_context)
+            return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
-        switch (fourcc) {
-        case VA_FOURCC_YV12:
-        case VA_FOURCC_I420:
-        case VA_FOURCC_IMC1:
-        case VA_FOURCC_IMC3:
-        case VA_FOURCC_422H:
-        case VA_FOURCC_422V:
-        case VA_FOURCC_411P:
-        case VA_FOURCC_444P:
-        case VA_FOURCC_YV16:
-            status = i965_image_pl3_processing(ctx,
-                                               src_surface,
-                                               src_rect,
-                                               dst_surface,
-                                               dst_rect);
-            break;
+        status = i965_image_processing_internal(ctx,
+                                                pp_context,
+                                                src_surface,
+                                                src_rect,
+                                                dst_surface,
+                                                dst_rect);
 
-        case  VA_FOURCC_NV12:
-            status = i965_image_pl2_processing(ctx,
-                                               src_surface,
-                                               src_rect,
-                                               dst_surface,
-                                               dst_rect);
-            break;
-        case VA_FOURCC_YUY2:
-        case VA_FOURCC_UYVY:
-            status = i965_image_pl1_processing(ctx,
-                                               src_surface,
-                                               src_rect,
-                                               dst_surface,
-                                               dst_rect);
-            break;
-        case VA_FOURCC_BGRA:
-        case VA_FOURCC_BGRX:
-        case VA_FOURCC_RGBA:
-        case VA_FOURCC_RGBX:
-            status = i965_image_pl1_rgbx_processing(ctx,
-                                               src_surface,
-                                               src_rect,
-                                               dst_surface,
-                                               dst_rect);
-            break;
-        default:
-            status = VA_STATUS_ERROR_UNIMPLEMENTED;
-            break;
-        }
-        
-        _i965UnlockMutex(&i965->pp_mutex);
+        i965_pp_context_put(ctx, pp_context);
     }
 
     return status;
@@ -5245,14 +5346,23 @@ void
 i965_post_processing_terminate(VADriverContextP ctx)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
+    struct i965_context_pool *pool = &i965->pp_pool;
+    int i;
 
-    if (pp_context) {
-        pp_context->finalize(pp_context);
-        free(pp_context);
+    for (i = 0; i < I965_CONTEXT_POOL_MAX_CONTEXTS; i++) {
+        struct i965_post_processing_context *pp_context = pool->contexts[i];
+
+        if (pp_context) {
+            pp_context->finalize(pp_context);
+            intel_batchbuffer_free(pp_context->batch);
+            free(pp_context);
+        }
+
+        pool->contexts[i] = NULL;
     }
 
-    i965->pp_context = NULL;
+    pool->num_contexts = 0;
+    pool->num_idle = 0;
 }
 
 #define VPP_CURBE_ALLOCATION_SIZE	32
@@ -5337,14 +5447,14 @@ bool
 i965_post_processing_init(VADriverContextP ctx)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
+    struct i965_post_processing_context *pp_context;
 
-    if (HAS_VPP(i965)) {
-        if (pp_context == NULL) {
-            pp_context = calloc(1, sizeof(*pp_context));
-            i965->codec_info->post_processing_context_init(ctx, pp_context, i965->pp_batch);
-            i965->pp_context = pp_context;
-        }
+    /* the first context is set up front, the others when threads compete */
+    if (HAS_VPP(i965) && i965->pp_pool.num_contexts == 0) {
+        pp_context = i965_pp_context_get(ctx);
+
+        if (pp_context)
+            i965_pp_context_put(ctx, pp_context);
     }
 
     return true;
@@ -5364,6 +5474,189 @@ static const int proc_frame_to_pp_frame[3] = {
     I965_SURFACE_FLAG_BOTTOME_FIELD_FIRST
 };
 
+/*
+ * Scales the processed NV12 picture to an output, through an NV12 surface
+ * converted at the end when the output has another format
+ */
+static VAStatus
+i965_proc_picture_output(VADriverContextP ctx,
+                         struct i965_proc_context *proc_context,
+                         VAProcPipelineParameterBuffer *pipeline_param,
+                         struct i965_surface *src,
+                         VARectangle *src_rect,
+                         struct object_surface *obj_surface,
+                         VARectangle *dst_rect,
+                         int tiled,
+                         int clear,
+                         VASurfaceID *tmp_surfaces,
+                         int *num_tmp_surfaces)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct i965_surface src_surface = *src, dst_surface;
+    VAStatus status;
+    int csc_needed = 0;
+
+    if (obj_surface->fourcc && obj_surface->fourcc !=  VA_FOURCC_NV12){
+        VASurfaceID out_surface_id = VA_INVALID_ID;
+        struct object_surface *csc_surface;
+
+        csc_needed = 1;
+        status = i965_surface_cache_get(ctx,
+                                        obj_surface->orig_width,
+                                        obj_surface->orig_height,
+                                        VA_FOURCC_NV12,
+                                        SUBSAMPLE_YUV420,
+                                        tiled,
+                                        &out_surface_id);
+
+        if (status != VA_STATUS_SUCCESS)
+            return status;
+
+        tmp_surfaces[(*num_tmp_surfaces)++] = out_surface_id;
+        csc_surface = SURFACE(out_surface_id);
+        assert(csc_surface);
+        dst_surface.base = (struct object_base *)csc_surface;
+    } else {
+        i965_check_alloc_surface_bo(ctx, obj_surface, tiled, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
+        dst_surface.base = (struct object_base *)obj_surface;
+    }
+
+    dst_surface.type = I965_SURFACE_TYPE_SURFACE;
+    dst_surface.flags = I965_SURFACE_FLAG_FRAME;
+
+    if (clear)
+        i965_vpp_clear_surface(ctx, &proc_context->pp_context, obj_surface, pipeline_param->output_background_color); 
+
+    // load/save doesn't support different origin offset for src and dst surface
+    if (src_rect->width == dst_rect->width &&
+        src_rect->height == dst_rect->height &&
+        src_rect->x == dst_rect->x &&
+        src_rect->y == dst_rect->y) {
+        i965_post_processing_internal(ctx, &proc_context->pp_context,
+                                      &src_surface,
+                                      src_rect,
+                                      &dst_surface,
+                                      dst_rect,
+                                      PP_NV12_LOAD_SAVE_N12,
+                                      NULL);
+    } else {
+
+        i965_post_processing_internal(ctx, &proc_context->pp_context,
+                                      &src_surface,
+                                      src_rect,
+                                      &dst_surface,
+                                      dst_rect,
+                                      (pipeline_param->filter_flags & VA_FILTER_SCALING_MASK) == VA_FILTER_SCALING_NL_ANAMORPHIC ?
+                                      PP_NV12_AVS : PP_NV12_SCALING,
+                                      NULL);
+    }
+
+    if (csc_needed) {
+        src_surface.base = dst_surface.base;
+        src_surface.type = dst_surface.type;
+        src_surface.flags = dst_surface.flags;
+        dst_surface.base = (struct object_base *)obj_surface;
+        dst_surface.type = I965_SURFACE_TYPE_SURFACE;
+        i965_image_processing_internal(ctx, &proc_context->pp_context,
+                                       &src_surface, dst_rect, &dst_surface, dst_rect);
+    }
+
+    return VA_STATUS_SUCCESS;
+}
+
+/* Scales the processed NV12 picture to each output of the ladder */
+static VAStatus
+i965_proc_picture_ladder_outputs(VADriverContextP ctx,
+                                 struct i965_proc_context *proc_context,
+                                 VAProcPipelineParameterBuffer *pipeline_param,
+                                 struct i965_surface *src,
+                                 VARectangle *src_rect,
+                                 I965ProcOutputLadder *ladder,
+                                 int tiled,
+                                 VASurfaceID *tmp_surfaces,
+                                 int *num_tmp_surfaces)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct object_surface *obj_surface;
+    VARectangle dst_rect;
+    VAStatus status;
+    int i;
+
+    for (i = 0; i < MIN(ladder->num_outputs, I965_PROC_LADDER_MAX_OUTPUTS); i++) {
+        VARectangle *region = &ladder->output_regions[i];
+        int clear = 0;
+
+        obj_surface = SURFACE(ladder->outputs[i]);
+
+        if (!obj_surface)
+            return VA_STATUS_ERROR_INVALID_SURFACE;
+
+        if (region->width && region->height) {
+            dst_rect = *region;
+            clear = (region->x || region->y ||
+                     region->width < obj_surface->orig_width ||
+                     region->height < obj_surface->orig_height);
+        } else {
+            dst_rect.x = 0;
+            dst_rect.y = 0;
+            dst_rect.width = obj_surface->orig_width;
+            dst_rect.height = obj_surface->orig_height;
+        }
+
+        status = i965_proc_picture_output(ctx, proc_context, pipeline_param,
+                                          src, src_rect,
+                                          obj_surface, &dst_rect,
+                                          tiled, clear,
+                                          tmp_surfaces, num_tmp_surfaces);
+
+        if (status != VA_STATUS_SUCCESS)
+            return status;
+    }
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+i965_proc_picture_ladder(VADriverContextP ctx,
+                         struct hw_context *hw_context,
+                         VAProcPipelineParameterBuffer *pipeline_param,
+                         struct object_surface *obj_src_surf,
+                         VARectangle *src_rect,
+                         I965ProcOutputLadder *ladder)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct i965_proc_context *proc_context = (struct i965_proc_context *)hw_context;
+    struct i965_surface src_surface;
+    VASurfaceID tmp_surfaces[I965_PROC_LADDER_MAX_OUTPUTS];
+    int num_tmp_surfaces = 0;
+    unsigned int tiling = 0, swizzle = 0;
+    VAStatus status;
+
+    dri_bo_get_tiling(obj_src_surf->bo, &tiling, &swizzle);
+
+    src_surface.base = (struct object_base *)obj_src_surf;
+    src_surface.type = I965_SURFACE_TYPE_SURFACE;
+    src_surface.flags = I965_SURFACE_FLAG_FRAME;
+
+    if (IS_HASWELL(i965->intel.device_info) || IS_GEN8(i965->intel.device_info))
+        proc_context->pp_context.batched = 1;
+
+    status = i965_proc_picture_ladder_outputs(ctx, proc_context, pipeline_param,
+                                              &src_surface, src_rect, ladder,
+                                              !!tiling,
+                                              tmp_surfaces, &num_tmp_surfaces);
+
+    proc_context->pp_context.batched = 0;
+    intel_batchbuffer_flush(hw_context->batch);
+
+    if (num_tmp_surfaces)
+        i965_surface_cache_put(ctx,
+                               tmp_surfaces,
+                               num_tmp_surfaces);
+
+    return status;
+}
+
 VAStatus 
 i965_proc_picture(VADriverContextP ctx, 
                   VAProfile profile, 
@@ -5379,10 +5672,11 @@ i965_proc_picture(VADriverContextP ctx,
     VARectangle src_rect, dst_rect;
     VAStatus status;
     int i;
-    VASurfaceID tmp_surfaces[VAProcFilterCount + 4];
+    VASurfaceID tmp_surfaces[VAProcFilterCount + 4 + I965_PROC_LADDER_MAX_OUTPUTS];
     int num_tmp_surfaces = 0;
     unsigned int tiling = 0, swizzle = 0;
     int in_width, in_height;
+    I965ProcOutputLadder *ladder;
 
     if (pipeline_param->surface == VA_INVALID_ID ||
         proc_state->current_render_target == VA_INVALID_ID) {
@@ -5425,17 +5719,17 @@ i965_proc_picture(VADriverContextP ctx,
         src_rect.width = in_width;
         src_rect.height = in_height;
 
-        status = i965_CreateSurfaces(ctx,
-                                     in_width,
-                                     in_height,
-                                     VA_RT_FORMAT_YUV420,
-                                     1,
-                                     &out_surface_id);
+        status = i965_surface_cache_get(ctx,
+                                        in_width,
+                                        in_height,
+                                        VA_FOURCC_NV12,
+                                        SUBSAMPLE_YUV420,
+                                        !!tiling,
+                                        &out_surface_id);
         assert(status == VA_STATUS_SUCCESS);
         tmp_surfaces[num_tmp_surfaces++] = out_surface_id;
         obj_surface = SURFACE(out_surface_id);
         assert(obj_surface);
-        i965_check_alloc_surface_bo(ctx, obj_surface, !!tiling, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
 
         dst_surface.base = (struct object_base *)obj_surface;
         dst_surface.type = I965_SURFACE_TYPE_SURFACE;
@@ -5445,11 +5739,12 @@ i965_proc_picture(VADriverContextP ctx,
         dst_rect.width = in_width;
         dst_rect.height = in_height;
 
-        status = i965_image_processing(ctx,
-                                       &src_surface,
-                                       &src_rect,
-                                       &dst_surface,
-                                       &dst_rect);
+        status = i965_image_processing_internal(ctx,
+                                                &proc_context->pp_context,
+                                                &src_surface,
+                                                &src_rect,
+                                                &dst_surface,
+                                                &dst_rect);
         assert(status == VA_STATUS_SUCCESS);
 
         src_surface.base = (struct object_base *)obj_surface;
@@ -5503,17 +5798,17 @@ i965_proc_picture(VADriverContextP ctx,
 
         if (kernel_index != PP_NULL &&
             proc_context->pp_context.pp_modules[kernel_index].kernel.bo != NULL) {
-            status = i965_CreateSurfaces(ctx,
-                                         in_width,
-                                         in_height,
-                                         VA_RT_FORMAT_YUV420,
-                                         1,
-                                         &out_surface_id);
+            status = i965_surface_cache_get(ctx,
+                                            in_width,
+                                            in_height,
+                                            VA_FOURCC_NV12,
+                                            SUBSAMPLE_YUV420,
+                                            !!tiling,
+                                            &out_surface_id);
             assert(status == VA_STATUS_SUCCESS);
             tmp_surfaces[num_tmp_surfaces++] = out_surface_id;
             obj_surface = SURFACE(out_surface_id);
             assert(obj_surface);
-            i965_check_alloc_surface_bo(ctx, obj_surface, !!tiling, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
             dst_surface.base = (struct object_base *)obj_surface;
             dst_surface.type = I965_SURFACE_TYPE_SURFACE;
             status = i965_post_processing_internal(ctx, &proc_context->pp_context,
@@ -5540,67 +5835,37 @@ i965_proc_picture(VADriverContextP ctx,
         goto error;
     }
 
-    int csc_needed = 0;
-    if (obj_surface->fourcc && obj_surface->fourcc !=  VA_FOURCC_NV12){
-        csc_needed = 1;
-        out_surface_id = VA_INVALID_ID;
-        status = i965_CreateSurfaces(ctx,
-                                     obj_surface->orig_width,
-                                     obj_surface->orig_height,
-                                     VA_RT_FORMAT_YUV420, 
-                                     1,
-                                     &out_surface_id);
-        assert(status == VA_STATUS_SUCCESS);
-        tmp_surfaces[num_tmp_surfaces++] = out_surface_id;
-        struct object_surface *csc_surface = SURFACE(out_surface_id);
-        assert(csc_surface);
-        i965_check_alloc_surface_bo(ctx, csc_surface, !!tiling, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
-        dst_surface.base = (struct object_base *)csc_surface;
-    } else {
-        i965_check_alloc_surface_bo(ctx, obj_surface, !!tiling, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
-        dst_surface.base = (struct object_base *)obj_surface;
-    }
+    ladder = proc_state->output_ladder ?
+        (I965ProcOutputLadder *)proc_state->output_ladder->buffer : NULL;
 
-    dst_surface.type = I965_SURFACE_TYPE_SURFACE;
-    i965_vpp_clear_surface(ctx, &proc_context->pp_context, obj_surface, pipeline_param->output_background_color); 
+    /* all the outputs in one submission where the walkers can be second level batches */
+    if (ladder &&
+        (IS_HASWELL(i965->intel.device_info) || IS_GEN8(i965->intel.device_info)))
+        proc_context->pp_context.batched = 1;
 
-    // load/save doesn't support different origin offset for src and dst surface
-    if (src_rect.width == dst_rect.width &&
-        src_rect.height == dst_rect.height &&
-        src_rect.x == dst_rect.x &&
-        src_rect.y == dst_rect.y) {
-        i965_post_processing_internal(ctx, &proc_context->pp_context,
-                                      &src_surface,
-                                      &src_rect,
-                                      &dst_surface,
-                                      &dst_rect,
-                                      PP_NV12_LOAD_SAVE_N12,
-                                      NULL);
-    } else {
+    status = i965_proc_picture_output(ctx, proc_context, pipeline_param,
+                                      &src_surface, &src_rect,
+                                      obj_surface, &dst_rect,
+                                      !!tiling, 1,
+                                      tmp_surfaces, &num_tmp_surfaces);
 
-        i965_post_processing_internal(ctx, &proc_context->pp_context,
-                                      &src_surface,
-                                      &src_rect,
-                                      &dst_surface,
-                                      &dst_rect,
-                                      (pipeline_param->filter_flags & VA_FILTER_SCALING_MASK) == VA_FILTER_SCALING_NL_ANAMORPHIC ?
-                                      PP_NV12_AVS : PP_NV12_SCALING,
-                                      NULL);
-    }
+    if (ladder && status == VA_STATUS_SUCCESS)
+        status = i965_proc_picture_ladder_outputs(ctx, proc_context, pipeline_param,
+                                                  &src_surface, &src_rect, ladder,
+                                                  !!tiling,
+                                                  tmp_surfaces, &num_tmp_surfaces);
 
-    if (csc_needed) {
-        src_surface.base = dst_surface.base;
-        src_surface.type = dst_surface.type;
-        src_surface.flags = dst_surface.flags;
-        dst_surface.base = (struct object_base *)obj_surface;
-        dst_surface.type = I965_SURFACE_TYPE_SURFACE;
-        i965_image_processing(ctx, &src_surface, &dst_rect, &dst_surface, &dst_rect);
+    proc_context->pp_context.batched = 0;
+
+    if (status != VA_STATUS_SUCCESS) {
+        intel_batchbuffer_flush(hw_context->batch);
+        goto error;
     }
-    
+
     if (num_tmp_surfaces)
-        i965_DestroySurfaces(ctx,
-                             tmp_surfaces,
-                             num_tmp_surfaces);
+        i965_surface_cache_put(ctx,
+                               tmp_surfaces,
+                               num_tmp_surfaces);
 
     intel_batchbuffer_flush(hw_context->batch);
 
@@ -5608,9 +5873,9 @@ i965_proc_picture(VADriverContextP ctx,
 
 error:
     if (num_tmp_surfaces)
-        i965_DestroySurfaces(ctx,
-                             tmp_surfaces,
-                             num_tmp_surfaces);
+        i965_surface_cache_put(ctx,
+                               tmp_surfaces,
+                               num_tmp_surfaces);
 
     return status;
 }
@@ -500,6 +500,12 @@ struct i965_post_processing_context
 
     struct intel_batchbuffer *batch;
 
+    /*
+     * Set while the outputs of a ladder are emitted, the walkers are then
+     * second level batches and the caller flushes the batch once for all
+     */
+    int batched;
+
     unsigned int block_horizontal_mask_left:16;
     unsigned int block_horizontal_mask_right:16;
     unsigned int block_vertical_mask_bottom:8;
@@ -583,4 +589,18 @@ i965_proc_picture(VADriverContextP ctx,
                   union codec_state *codec_state,
                   struct hw_context *hw_context);
 
+struct _I965ProcOutputLadder;
+
+/*
+ * Scales the NV12 picture in src_rect of obj_src_surf to the outputs of the
+ * ladder in a single batch flush, for the callers that filtered it already
+ */
+VAStatus
+i965_proc_picture_ladder(VADriverContextP ctx,
+                         struct hw_context *hw_context,
+                         VAProcPipelineParameterBuffer *pipeline_param,
+                         struct object_surface *obj_src_surf,
+                         VARectangle *src_rect,
+                         struct _I965ProcOutputLadder *ladder);
+
 #endif /* __I965_POST_PROCESSING_H__ */
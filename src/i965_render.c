@@ -3117,7 +3117,7 @@ intel_render_put_surface(
     render_state->render_put_surface(ctx, obj_surface, src_rect, dst_rect, flags);
 
     if (out_surface_id != VA_INVALID_ID)
-        i965_DestroySurfaces(ctx, &out_surface_id, 1);
+        i965_surface_cache_put(ctx, &out_surface_id, 1);
 }
 
 void
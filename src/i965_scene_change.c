@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <string.h>
+
+#include "i965_defines.h"
+#include "i965_scene_change.h"
+
+/* a frame with that share of MBs better coded as intra starts a new scene */
+#define SCENE_INTRA_FRACTION            0.6
+
+/*
+ * so does a P frame whose inter to intra distortion ratio is at least
+ * SCENE_CUT_MOTION and SCENE_MOTION_JUMP times the average of the scene,
+ * which catches the cuts to content that is still partly predictable
+ */
+#define SCENE_CUT_MOTION                0.7
+#define SCENE_MOTION_JUMP               2.5
+
+/* P frames in the moving average of the ratio */
+#define SCENE_MOTION_FRAMES             8
+
+/* the ratio below which 1, 2 and 3 B frames are suggested */
+static const double scene_b_frames_motion[I965_SCENE_MAX_B_FRAMES] = {
+    0.5, 0.35, 0.2
+};
+
+void
+i965_scene_detector_init(struct i965_scene_detector *detector)
+{
+    memset(detector, 0, sizeof(*detector));
+}
+
+int
+i965_scene_detector_update(struct i965_scene_detector *detector, int slice_type,
+                           const struct i965_scene_stats *stats)
+{
+    double motion, intra_fraction;
+    unsigned int n;
+    int i;
+
+    detector->scene_change = 0;
+
+    if (slice_type == SLICE_TYPE_I ||
+        !stats || !stats->num_mbs || stats->intra_cost <= 0.)
+        return 0;
+
+    motion = stats->inter_cost / stats->intra_cost;
+    intra_fraction = (double)stats->num_intra_mbs / stats->num_mbs;
+
+    if (intra_fraction >= SCENE_INTRA_FRACTION ||
+        (slice_type == SLICE_TYPE_P && detector->num_frames &&
+         motion >= SCENE_CUT_MOTION &&
+         motion > SCENE_MOTION_JUMP * detector->motion)) {
+        /* the average restarts with the new scene */
+        detector->scene_change = 1;
+        detector->motion = 0.;
+        detector->num_frames = 0;
+        return 1;
+    }
+
+    /* B frames are predicted from both sides, only the P frames measure the motion */
+    if (slice_type != SLICE_TYPE_P)
+        return 0;
+
+    if (motion > 1.)
+        motion = 1.;
+
+    n = detector->num_frames + 1;
+
+    if (n > SCENE_MOTION_FRAMES)
+        n = SCENE_MOTION_FRAMES;
+
+    detector->motion += (motion - detector->motion) / n;
+    detector->num_frames = n;
+
+    for (i = 0; i < I965_SCENE_MAX_B_FRAMES; i++) {
+        if (detector->motion >= scene_b_frames_motion[i])
+            break;
+    }
+
+    detector->num_b_frames = i;
+
+    return 0;
+}
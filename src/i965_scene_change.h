@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef I965_SCENE_CHANGE_H
+#define I965_SCENE_CHANGE_H
+
+/*
+ * Scene change detection for the AVC encoders, from the intra and inter
+ * distortions the VME has already computed for each MB of the frame. The
+ * application keeps choosing the slice types, the decisions are returned
+ * to it in the status of the coded buffer segment.
+ */
+
+/* Most B frames ever suggested between two anchor frames */
+#define I965_SCENE_MAX_B_FRAMES         3
+
+/* The VME distortions of one P or B frame */
+struct i965_scene_stats
+{
+    unsigned int num_mbs;
+    unsigned int num_intra_mbs;         /* MBs with a lower intra distortion */
+    double intra_cost;
+    double inter_cost;
+};
+
+struct i965_scene_detector
+{
+    /* moving average of inter_cost / intra_cost over the P frames of the scene */
+    double motion;
+    unsigned int num_frames;
+
+    /* decisions on the last frame, num_b_frames is 0 until a P frame is seen */
+    int scene_change;
+    int num_b_frames;
+};
+
+void
+i965_scene_detector_init(struct i965_scene_detector *detector);
+
+/*
+ * Decide whether the frame starts a new scene and update the number of B
+ * frames suggested for the motion of the scene. I frames only restart
+ * the scene, stats may be NULL for them. Returns scene_change.
+ */
+int
+i965_scene_detector_update(struct i965_scene_detector *detector, int slice_type,
+                           const struct i965_scene_stats *stats);
+
+#endif /* I965_SCENE_CHANGE_H */
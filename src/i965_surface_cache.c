@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Recycles the intermediate surfaces of the driver. Post processing
+ * creates and destroys its temporary NV12 surfaces on every call, which
+ * costs a BO allocation and the page faults of first touching it each
+ * frame, so they are parked here and handed out again to the next caller
+ * that asks for the same kind of surface.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "intel_driver.h"
+#include "i965_drv_video.h"
+#include "i965_surface_cache.h"
+
+static int
+i965_surface_cache_entry_match(struct i965_surface_cache_entry *entry,
+                               int width,
+                               int height,
+                               unsigned int fourcc,
+                               unsigned int subsampling,
+                               int tiled)
+{
+    return (entry->width == width &&
+            entry->height == height &&
+            entry->fourcc == fourcc &&
+            entry->subsampling == subsampling &&
+            entry->tiled == tiled);
+}
+
+static void
+i965_surface_cache_remove(struct i965_surface_cache *cache, int index)
+{
+    cache->cached_size -= cache->entries[index].size;
+    cache->entries[index] = cache->entries[--cache->num_entries];
+}
+
+void
+i965_surface_cache_init(struct i965_surface_cache *cache, size_t max_size)
+{
+    memset(cache, 0, sizeof(*cache));
+    _i965InitMutex(&cache->mutex);
+    cache->max_size = max_size;
+}
+
+void
+i965_surface_cache_terminate(VADriverContextP ctx)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct i965_surface_cache *cache = &i965->surface_cache;
+    unsigned int requests = cache->stats.hits + cache->stats.misses;
+    int i;
+
+    if (g_intel_debug_option_flags & VA_INTEL_DEBUG_OPTION_STATS) {
+        fprintf(stderr,
+                "surface cache: %u/%u (hits/misses, %u%% hit rate), %u evictions\n",
+                cache->stats.hits, cache->stats.misses,
+                requests ? cache->stats.hits * 100 / requests : 0,
+                cache->stats.evictions);
+    }
+
+    for (i = 0; i < cache->num_entries; i++)
+        i965_DestroySurfaces(ctx, &cache->entries[i].surface_id, 1);
+
+    cache->num_entries = 0;
+    cache->cached_size = 0;
+    _i965DestroyMutex(&cache->mutex);
+}
+
+VAStatus
+i965_surface_cache_get(VADriverContextP ctx,
+                       int width,
+                       int height,
+                       unsigned int fourcc,
+                       unsigned int subsampling,
+                       int tiled,
+                       VASurfaceID *surface_id)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct i965_surface_cache *cache = &i965->surface_cache;
+    struct object_surface *obj_surface;
+    VASurfaceID id = VA_INVALID_SURFACE;
+    VAStatus status;
+    int i, found = -1;
+
+    tiled = !!tiled;
+
+    _i965LockMutex(&cache->mutex);
+
+    /* the most recently used one, whose pages are likely still resident */
+    for (i = 0; i < cache->num_entries; i++) {
+        if (i965_surface_cache_entry_match(&cache->entries[i], width, height, fourcc, subsampling, tiled) &&
+            (found < 0 || cache->entries[i].last_used > cache->entries[found].last_used))
+            found = i;
+    }
+
+    if (found >= 0) {
+        id = cache->entries[found].surface_id;
+        i965_surface_cache_remove(cache, found);
+        cache->stats.hits++;
+    } else
+        cache->stats.misses++;
+
+    _i965UnlockMutex(&cache->mutex);
+
+    if (id != VA_INVALID_SURFACE) {
+        *surface_id = id;
+        return VA_STATUS_SUCCESS;
+    }
+
+    status = i965_CreateSurfaces(ctx,
+                                 width,
+                                 height,
+                                 VA_RT_FORMAT_YUV420,
+                                 1,
+                                 &id);
+
+    if (status != VA_STATUS_SUCCESS)
+        return status;
+
+    obj_surface = SURFACE(id);
+    assert(obj_surface);
+    status = i965_check_alloc_surface_bo(ctx, obj_surface, tiled, fourcc, subsampling);
+
+    if (status != VA_STATUS_SUCCESS || !obj_surface->bo) {
+        i965_DestroySurfaces(ctx, &id, 1);
+        return status != VA_STATUS_SUCCESS ? status : VA_STATUS_ERROR_ALLOCATION_FAILED;
+    }
+
+    *surface_id = id;
+
+    return VA_STATUS_SUCCESS;
+}
+
+void
+i965_surface_cache_put(VADriverContextP ctx,
+                       VASurfaceID *surface_list,
+                       int num_surfaces)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct i965_surface_cache *cache = &i965->surface_cache;
+    VASurfaceID evicted[I965_SURFACE_CACHE_MAX_ENTRIES + 1];
+    int i, j, num_evicted;
+
+    for (i = 0; i < num_surfaces; i++) {
+        struct object_surface *obj_surface = SURFACE(surface_list[i]);
+        struct i965_surface_cache_entry *entry;
+        unsigned int tiling = I915_TILING_NONE, swizzle;
+
+        if (!obj_surface)
+            continue;
+
+        num_evicted = 0;
+
+        if (!obj_surface->bo ||
+            (size_t)obj_surface->size > cache->max_size) {
+            evicted[num_evicted++] = surface_list[i];
+        } else {
+            dri_bo_get_tiling(obj_surface->bo, &tiling, &swizzle);
+
+            _i965LockMutex(&cache->mutex);
+
+            while (cache->num_entries == I965_SURFACE_CACHE_MAX_ENTRIES ||
+                   cache->cached_size + obj_surface->size > cache->max_size) {
+                int lru = 0;
+
+                for (j = 1; j < cache->num_entries; j++) {
+                    if (cache->entries[j].last_used < cache->entries[lru].last_used)
+                        lru = j;
+                }
+
+                evicted[num_evicted++] = cache->entries[lru].surface_id;
+                i965_surface_cache_remove(cache, lru);
+                cache->stats.evictions++;
+            }
+
+            entry = &cache->entries[cache->num_entries++];
+            entry->surface_id = surface_list[i];
+            entry->width = obj_surface->orig_width;
+            entry->height = obj_surface->orig_height;
+            entry->fourcc = obj_surface->fourcc;
+            entry->subsampling = obj_surface->subsampling;
+            entry->tiled = (tiling != I915_TILING_NONE);
+            entry->size = obj_surface->size;
+            entry->last_used = ++cache->clock;
+            cache->cached_size += entry->size;
+
+            _i965UnlockMutex(&cache->mutex);
+        }
+
+        if (num_evicted)
+            i965_DestroySurfaces(ctx, evicted, num_evicted);
+    }
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef I965_SURFACE_CACHE_H
+#define I965_SURFACE_CACHE_H
+
+#include <va/va.h>
+#include <va/va_backend.h>
+
+#include "i965_mutext.h"
+
+/* The idle surfaces kept for reuse */
+#define I965_SURFACE_CACHE_MAX_ENTRIES  32
+
+/* The default upper bound of the memory held by idle surfaces, in MB */
+#define I965_SURFACE_CACHE_DEFAULT_SIZE 128
+
+struct i965_surface_cache_stats
+{
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+};
+
+struct i965_surface_cache_entry
+{
+    VASurfaceID surface_id;
+    int width;
+    int height;
+    unsigned int fourcc;
+    unsigned int subsampling;
+    int tiled;
+    int size;
+    unsigned int last_used;     /* cache clock when put back, for the LRU eviction */
+};
+
+/*
+ * Keeps the intermediate surfaces of the post processing, VEBOX, GPE and
+ * decoder workaround paths once they are done with, keyed by their size,
+ * fourcc, subsampling and tiling, so the next frame reuses them instead
+ * of allocating and faulting in new BOs. The least recently used idle
+ * surfaces are destroyed when the entries or the memory budget run out.
+ */
+struct i965_surface_cache
+{
+    _I965Mutex mutex;
+
+    size_t max_size;            /* 0 disables caching */
+    size_t cached_size;
+    unsigned int clock;
+
+    int num_entries;
+    struct i965_surface_cache_entry entries[I965_SURFACE_CACHE_MAX_ENTRIES];
+
+    struct i965_surface_cache_stats stats;
+};
+
+void
+i965_surface_cache_init(struct i965_surface_cache *cache, size_t max_size);
+
+/* Destroys the idle surfaces, must run before the surface heap goes away */
+void
+i965_surface_cache_terminate(VADriverContextP ctx);
+
+/*
+ * Returns in *surface_id a width x height surface backed by a BO of the
+ * given fourcc, subsampling and tiling, either an idle one of the cache
+ * or a new one. The content is undefined.
+ */
+VAStatus
+i965_surface_cache_get(VADriverContextP ctx,
+                       int width,
+                       int height,
+                       unsigned int fourcc,
+                       unsigned int subsampling,
+                       int tiled,
+                       VASurfaceID *surface_id);
+
+/*
+ * Gives surfaces obtained from i965_surface_cache_get() back to the
+ * cache, in place of i965_DestroySurfaces(). The GPU may still be using
+ * them: the next user's batches are ordered after the pending ones by
+ * the kernel.
+ */
+void
+i965_surface_cache_put(VADriverContextP ctx,
+                       VASurfaceID *surface_list,
+                       int num_surfaces);
+
+#endif /* I965_SURFACE_CACHE_H */
@@ -0,0 +1,473 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <i915_drm.h>
+
+#include "i965_tiling.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define I965_TILING_SIMD        1
+#include <immintrin.h>
+#endif
+
+/* A Y tile is 128B x 32 rows made of 16B wide columns stored one after the other */
+#define Y_TILE_WIDTH            128
+#define Y_TILE_HEIGHT           32
+#define Y_COLUMN_WIDTH          16
+#define Y_COLUMN_SIZE           (Y_COLUMN_WIDTH * Y_TILE_HEIGHT)
+
+/* An X tile is 512B x 8 rows stored row after row */
+#define X_TILE_WIDTH            512
+#define X_TILE_HEIGHT           8
+
+#define TILE_SIZE               4096
+
+/* Bit 6 swizzling works on 64B halves of 128B */
+#define SWIZZLE_CHUNK           64
+
+/*
+ * Copies rows [first_row, first_row + rows) of a 16B wide Y tile column.
+ * swz is XORed into the byte offset of every row in the column.
+ */
+typedef void (*i965_ycolumn_func)(uint8_t *linear, unsigned int linear_pitch,
+                                  uint8_t *column, unsigned int first_row,
+                                  unsigned int rows, unsigned int swz,
+                                  int detile);
+
+/* Copies an aligned 64B chunk, tiled is the 64B aligned side */
+typedef void (*i965_chunk_func)(uint8_t *linear, uint8_t *tiled, int detile);
+
+struct i965_tiling_kernels
+{
+    i965_ycolumn_func ycolumn;
+    i965_chunk_func chunk;
+};
+
+static inline unsigned int
+i965_swizzle_bit(unsigned int offset, uint32_t swizzle)
+{
+    switch (swizzle) {
+    case I915_BIT_6_SWIZZLE_9:
+        return (offset >> 3) & SWIZZLE_CHUNK;
+
+    case I915_BIT_6_SWIZZLE_9_10:
+        return ((offset >> 3) ^ (offset >> 4)) & SWIZZLE_CHUNK;
+
+    default:
+        return 0;
+    }
+}
+
+static void
+ycolumn_c(uint8_t *linear, unsigned int linear_pitch,
+          uint8_t *column, unsigned int first_row,
+          unsigned int rows, unsigned int swz,
+          int detile)
+{
+    unsigned int i;
+
+    for (i = first_row; i < first_row + rows; i++) {
+        uint8_t *tiled = column + ((i * Y_COLUMN_WIDTH) ^ swz);
+
+        if (detile)
+            memcpy(linear, tiled, Y_COLUMN_WIDTH);
+        else
+            memcpy(tiled, linear, Y_COLUMN_WIDTH);
+
+        linear += linear_pitch;
+    }
+}
+
+static void
+chunk_c(uint8_t *linear, uint8_t *tiled, int detile)
+{
+    if (detile)
+        memcpy(linear, tiled, SWIZZLE_CHUNK);
+    else
+        memcpy(tiled, linear, SWIZZLE_CHUNK);
+}
+
+#ifdef I965_TILING_SIMD
+
+/*
+ * MOVNTDQA only streams from WC memory, on the cached CPU mapping it is
+ * a plain aligned load but it keeps the kernels usable on GTT mappings.
+ */
+__attribute__((target("sse4.1"))) static void
+ycolumn_sse41(uint8_t *linear, unsigned int linear_pitch,
+              uint8_t *column, unsigned int first_row,
+              unsigned int rows, unsigned int swz,
+              int detile)
+{
+    unsigned int i;
+
+    if (detile) {
+        for (i = first_row; i < first_row + rows; i++) {
+            __m128i *tiled = (__m128i *)(column + ((i * Y_COLUMN_WIDTH) ^ swz));
+
+            _mm_storeu_si128((__m128i *)linear, _mm_stream_load_si128(tiled));
+            linear += linear_pitch;
+        }
+    } else {
+        for (i = first_row; i < first_row + rows; i++) {
+            __m128i *tiled = (__m128i *)(column + ((i * Y_COLUMN_WIDTH) ^ swz));
+
+            _mm_store_si128(tiled, _mm_loadu_si128((__m128i *)linear));
+            linear += linear_pitch;
+        }
+    }
+}
+
+__attribute__((target("sse4.1"))) static void
+chunk_sse41(uint8_t *linear, uint8_t *tiled, int detile)
+{
+    __m128i *t = (__m128i *)tiled;
+    __m128i *l = (__m128i *)linear;
+
+    if (detile) {
+        __m128i a = _mm_stream_load_si128(t + 0);
+        __m128i b = _mm_stream_load_si128(t + 1);
+        __m128i c = _mm_stream_load_si128(t + 2);
+        __m128i d = _mm_stream_load_si128(t + 3);
+
+        _mm_storeu_si128(l + 0, a);
+        _mm_storeu_si128(l + 1, b);
+        _mm_storeu_si128(l + 2, c);
+        _mm_storeu_si128(l + 3, d);
+    } else {
+        _mm_store_si128(t + 0, _mm_loadu_si128(l + 0));
+        _mm_store_si128(t + 1, _mm_loadu_si128(l + 1));
+        _mm_store_si128(t + 2, _mm_loadu_si128(l + 2));
+        _mm_store_si128(t + 3, _mm_loadu_si128(l + 3));
+    }
+}
+
+/*
+ * The 16B rows of a column are stored back to back, so an even row and the
+ * next one fill an aligned 32B block that swizzling keeps in one piece and
+ * they are moved with a single 256 bit access.
+ */
+__attribute__((target("avx2"))) static void
+ycolumn_avx2(uint8_t *linear, unsigned int linear_pitch,
+             uint8_t *column, unsigned int first_row,
+             unsigned int rows, unsigned int swz,
+             int detile)
+{
+    unsigned int i = first_row, end = first_row + rows;
+
+    if (i & 1) {
+        ycolumn_sse41(linear, linear_pitch, column, i, 1, swz, detile);
+        linear += linear_pitch;
+        i++;
+    }
+
+    for (; i + 1 < end; i += 2) {
+        __m256i *tiled = (__m256i *)(column + ((i * Y_COLUMN_WIDTH) ^ swz));
+
+        if (detile) {
+            __m256i v = _mm256_stream_load_si256(tiled);
+
+            _mm_storeu_si128((__m128i *)linear, _mm256_castsi256_si128(v));
+            _mm_storeu_si128((__m128i *)(linear + linear_pitch), _mm256_extracti128_si256(v, 1));
+        } else {
+            __m256i v = _mm256_castsi128_si256(_mm_loadu_si128((__m128i *)linear));
+
+            v = _mm256_inserti128_si256(v, _mm_loadu_si128((__m128i *)(linear + linear_pitch)), 1);
+            _mm256_store_si256(tiled, v);
+        }
+
+        linear += 2 * linear_pitch;
+    }
+
+    if (i < end)
+        ycolumn_sse41(linear, linear_pitch, column, i, 1, swz, detile);
+}
+
+__attribute__((target("avx2"))) static void
+chunk_avx2(uint8_t *linear, uint8_t *tiled, int detile)
+{
+    __m256i *t = (__m256i *)tiled;
+    __m256i *l = (__m256i *)linear;
+
+    if (detile) {
+        __m256i a = _mm256_stream_load_si256(t + 0);
+        __m256i b = _mm256_stream_load_si256(t + 1);
+
+        _mm256_storeu_si256(l + 0, a);
+        _mm256_storeu_si256(l + 1, b);
+    } else {
+        _mm256_store_si256(t + 0, _mm256_loadu_si256(l + 0));
+        _mm256_store_si256(t + 1, _mm256_loadu_si256(l + 1));
+    }
+}
+
+#endif /* I965_TILING_SIMD */
+
+static const struct i965_tiling_kernels kernels_c = { ycolumn_c, chunk_c };
+#ifdef I965_TILING_SIMD
+static const struct i965_tiling_kernels kernels_sse41 = { ycolumn_sse41, chunk_sse41 };
+static const struct i965_tiling_kernels kernels_avx2 = { ycolumn_avx2, chunk_avx2 };
+#endif
+
+static const struct i965_tiling_kernels *i965_tiling_kernels = NULL;
+
+static const struct i965_tiling_kernels *
+i965_tiling_get_kernels(void)
+{
+    /* Racing threads all store the same value */
+    if (!i965_tiling_kernels) {
+#ifdef I965_TILING_SIMD
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+            i965_tiling_kernels = &kernels_avx2;
+        else if (__builtin_cpu_supports("sse4.1"))
+            i965_tiling_kernels = &kernels_sse41;
+        else
+#endif
+            i965_tiling_kernels = &kernels_c;
+    }
+
+    return i965_tiling_kernels;
+}
+
+int
+i965_tiling_set_kernels(int kernels)
+{
+    switch (kernels) {
+    case I965_TILING_KERNELS_C:
+        i965_tiling_kernels = &kernels_c;
+        return 1;
+
+#ifdef I965_TILING_SIMD
+    case I965_TILING_KERNELS_SSE41:
+        __builtin_cpu_init();
+
+        if (!__builtin_cpu_supports("sse4.1"))
+            return 0;
+
+        i965_tiling_kernels = &kernels_sse41;
+        return 1;
+
+    case I965_TILING_KERNELS_AVX2:
+        __builtin_cpu_init();
+
+        if (!__builtin_cpu_supports("avx2"))
+            return 0;
+
+        i965_tiling_kernels = &kernels_avx2;
+        return 1;
+#endif
+
+    default:
+        return 0;
+    }
+}
+
+int
+i965_tiling_supported(uint32_t tiling, uint32_t swizzle, unsigned int tiled_pitch)
+{
+    if (swizzle != I915_BIT_6_SWIZZLE_NONE &&
+        swizzle != I915_BIT_6_SWIZZLE_9 &&
+        swizzle != I915_BIT_6_SWIZZLE_9_10)
+        return 0;
+
+    switch (tiling) {
+    case I915_TILING_NONE:
+        return 1;
+
+    case I915_TILING_X:
+        return (tiled_pitch % X_TILE_WIDTH) == 0;
+
+    case I915_TILING_Y:
+        return (tiled_pitch % Y_TILE_WIDTH) == 0;
+
+    default:
+        return 0;
+    }
+}
+
+static void
+i965_tiling_copy_y(uint8_t *linear, unsigned int linear_pitch,
+                   uint8_t *tiled, unsigned int tiled_pitch,
+                   uint32_t swizzle,
+                   unsigned int x, unsigned int y,
+                   unsigned int width, unsigned int height,
+                   int detile)
+{
+    const struct i965_tiling_kernels *kernels = i965_tiling_get_kernels();
+    unsigned int tiles_per_row = tiled_pitch / Y_TILE_WIDTH;
+    unsigned int ty, c;
+
+    for (ty = y / Y_TILE_HEIGHT; ty * Y_TILE_HEIGHT < y + height; ty++) {
+        unsigned int row0 = ty * Y_TILE_HEIGHT;
+        unsigned int row1 = row0 + Y_TILE_HEIGHT;
+
+        if (row0 < y)
+            row0 = y;
+
+        if (row1 > y + height)
+            row1 = y + height;
+
+        for (c = x / Y_COLUMN_WIDTH; c * Y_COLUMN_WIDTH < x + width; c++) {
+            unsigned int cx0 = c * Y_COLUMN_WIDTH;
+            unsigned int cx1 = cx0 + Y_COLUMN_WIDTH;
+            unsigned int offset = (ty * tiles_per_row + c / (Y_TILE_WIDTH / Y_COLUMN_WIDTH)) * TILE_SIZE +
+                (c % (Y_TILE_WIDTH / Y_COLUMN_WIDTH)) * Y_COLUMN_SIZE;
+            unsigned int swz = i965_swizzle_bit(offset, swizzle);
+            uint8_t *column = tiled + offset;
+            uint8_t *lin;
+            unsigned int i;
+
+            if (cx0 < x)
+                cx0 = x;
+
+            if (cx1 > x + width)
+                cx1 = x + width;
+
+            lin = linear + (row0 - y) * linear_pitch + (cx0 - x);
+
+            if (cx1 - cx0 == Y_COLUMN_WIDTH) {
+                kernels->ycolumn(lin, linear_pitch, column,
+                                 row0 % Y_TILE_HEIGHT, row1 - row0,
+                                 swz, detile);
+                continue;
+            }
+
+            for (i = row0 % Y_TILE_HEIGHT; i < row0 % Y_TILE_HEIGHT + row1 - row0; i++) {
+                uint8_t *t = column + ((i * Y_COLUMN_WIDTH) ^ swz) + cx0 % Y_COLUMN_WIDTH;
+
+                if (detile)
+                    memcpy(lin, t, cx1 - cx0);
+                else
+                    memcpy(t, lin, cx1 - cx0);
+
+                lin += linear_pitch;
+            }
+        }
+    }
+}
+
+static void
+i965_tiling_copy_x(uint8_t *linear, unsigned int linear_pitch,
+                   uint8_t *tiled, unsigned int tiled_pitch,
+                   uint32_t swizzle,
+                   unsigned int x, unsigned int y,
+                   unsigned int width, unsigned int height,
+                   int detile)
+{
+    const struct i965_tiling_kernels *kernels = i965_tiling_get_kernels();
+    unsigned int tiles_per_row = tiled_pitch / X_TILE_WIDTH;
+    unsigned int r;
+
+    for (r = y; r < y + height; r++) {
+        unsigned int row_offset = (r / X_TILE_HEIGHT) * tiles_per_row * TILE_SIZE +
+            (r % X_TILE_HEIGHT) * X_TILE_WIDTH;
+        uint8_t *lin = linear + (r - y) * linear_pitch;
+        unsigned int xs = x;
+
+        while (xs < x + width) {
+            unsigned int offset = row_offset + (xs / X_TILE_WIDTH) * TILE_SIZE;
+            unsigned int swz = i965_swizzle_bit(offset, swizzle);
+            unsigned int n = SWIZZLE_CHUNK - xs % SWIZZLE_CHUNK;
+            uint8_t *t;
+
+            if (n > x + width - xs)
+                n = x + width - xs;
+
+            t = tiled + offset + (((xs % X_TILE_WIDTH) & ~(SWIZZLE_CHUNK - 1)) ^ swz) + xs % SWIZZLE_CHUNK;
+
+            if (n == SWIZZLE_CHUNK)
+                kernels->chunk(lin, t, detile);
+            else if (detile)
+                memcpy(lin, t, n);
+            else
+                memcpy(t, lin, n);
+
+            lin += n;
+            xs += n;
+        }
+    }
+}
+
+static void
+i965_tiling_copy(uint8_t *linear, unsigned int linear_pitch,
+                 uint8_t *tiled, unsigned int tiled_pitch,
+                 uint32_t tiling, uint32_t swizzle,
+                 unsigned int x, unsigned int y,
+                 unsigned int width, unsigned int height,
+                 int detile)
+{
+    unsigned int i;
+
+    switch (tiling) {
+    case I915_TILING_Y:
+        i965_tiling_copy_y(linear, linear_pitch, tiled, tiled_pitch, swizzle,
+                           x, y, width, height, detile);
+        break;
+
+    case I915_TILING_X:
+        i965_tiling_copy_x(linear, linear_pitch, tiled, tiled_pitch, swizzle,
+                           x, y, width, height, detile);
+        break;
+
+    default:
+        tiled += y * tiled_pitch + x;
+
+        for (i = 0; i < height; i++) {
+            if (detile)
+                memcpy(linear, tiled, width);
+            else
+                memcpy(tiled, linear, width);
+
+            linear += linear_pitch;
+            tiled += tiled_pitch;
+        }
+
+        break;
+    }
+}
+
+void
+i965_tiled_to_linear(uint8_t *dst, unsigned int dst_pitch,
+                     const uint8_t *tiled, unsigned int tiled_pitch,
+                     uint32_t tiling, uint32_t swizzle,
+                     unsigned int x, unsigned int y,
+                     unsigned int width, unsigned int height)
+{
+    i965_tiling_copy(dst, dst_pitch, (uint8_t *)tiled, tiled_pitch, tiling, swizzle,
+                     x, y, width, height, 1);
+}
+
+void
+i965_linear_to_tiled(uint8_t *tiled, unsigned int tiled_pitch,
+                     uint32_t tiling, uint32_t swizzle,
+                     unsigned int x, unsigned int y,
+                     const uint8_t *src, unsigned int src_pitch,
+                     unsigned int width, unsigned int height)
+{
+    i965_tiling_copy((uint8_t *)src, src_pitch, tiled, tiled_pitch, tiling, swizzle,
+                     x, y, width, height, 0);
+}
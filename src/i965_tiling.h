@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_TILING_H
+#define I965_TILING_H
+
+#include <stdint.h>
+
+/*
+ * CPU (de)tiling of X/Y tiled BOs mapped with dri_bo_map(). This avoids
+ * reading through the uncached GTT aperture, which is very slow, and
+ * handles the bit 6 swizzling the kernel reports for the BO.
+ *
+ * x and width are in bytes, y and height in rows of the tiled surface.
+ */
+
+#define I965_TILING_KERNELS_C           0
+#define I965_TILING_KERNELS_SSE41       1
+#define I965_TILING_KERNELS_AVX2        2
+
+/*
+ * Forces the copy kernels, for the tests and benchmarks. By default the
+ * best ones the CPU supports are used. Returns 0 if the CPU lacks them.
+ */
+int
+i965_tiling_set_kernels(int kernels);
+
+/* Returns whether the tiling/swizzle/pitch combination can be handled */
+int
+i965_tiling_supported(uint32_t tiling, uint32_t swizzle, unsigned int tiled_pitch);
+
+void
+i965_tiled_to_linear(uint8_t *dst, unsigned int dst_pitch,
+                     const uint8_t *tiled, unsigned int tiled_pitch,
+                     uint32_t tiling, uint32_t swizzle,
+                     unsigned int x, unsigned int y,
+                     unsigned int width, unsigned int height);
+
+void
+i965_linear_to_tiled(uint8_t *tiled, unsigned int tiled_pitch,
+                     uint32_t tiling, uint32_t swizzle,
+                     unsigned int x, unsigned int y,
+                     const uint8_t *src, unsigned int src_pitch,
+                     unsigned int width, unsigned int height);
+
+#endif /* I965_TILING_H */
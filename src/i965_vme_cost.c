@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "i965_defines.h"
+#include "i965_vme_cost.h"
+#include "gen6_vme.h"
+
+#ifndef HAVE_LOG2F
+#define log2f(x) (logf(x)/(float)M_LN2)
+#endif
+
+/*
+ * The LUT uses the pair of 4-bit units: (shift, base) structure.
+ * 2^K * X = value . 
+ * So it is necessary to convert one cost into the nearest LUT format.
+ * The derivation is:
+ * 2^K *x = 2^n * (1 + deltaX)
+ *    k + log2(x) = n + log2(1 + deltaX)
+ *    log2(x) = n - k + log2(1 + deltaX)
+ *    As X is in the range of [1, 15]
+ *      4 > n - k + log2(1 + deltaX) >= 0 
+ *      =>    n + log2(1 + deltaX)  >= k > n - 4  + log2(1 + deltaX)
+ *    Then we can derive the corresponding K and get the nearest LUT format.
+ */
+static int
+intel_format_lutvalue(int value, int max)
+{
+    int ret;
+    int logvalue, temp1, temp2;
+
+    if (value <= 0)
+        return 0;
+
+    logvalue = (int)(log2f((float)value));
+    if (logvalue < 4) {
+        ret = value;
+    } else {
+        int error, temp_value, base, j, temp_err;
+        error = value;
+        j = logvalue - 4 + 1;
+        ret = -1;
+        for(; j <= logvalue; j++) {
+            if (j == 0) {
+                base = value >> j;
+            } else {
+                base = (value + (1 << (j - 1)) - 1) >> j;
+            }
+            if (base >= 16)
+                continue;
+
+            temp_value = base << j;
+            temp_err = abs(value - temp_value);
+            if (temp_err < error) {
+                error = temp_err;
+                ret = (j << 4) | base;
+                if (temp_err == 0)
+                    break;
+            }
+        }
+    }
+    temp1 = (ret & 0xf) << ((ret & 0xf0) >> 4);
+    temp2 = (max & 0xf) << ((max & 0xf0) >> 4);
+    if (temp1 > temp2)
+        ret = max;
+    return ret;
+}
+
+static float
+intel_lambda_qp(int qp)
+{
+    float value, lambdaf;
+    value = qp;
+    value = value / 6 - 2;
+    if (value < 0)
+        value = 0;
+    lambdaf = roundf(powf(2, value));
+    return lambdaf;
+}
+
+/* the costs of the 8 MV magnitude classes */
+static void
+intel_vme_mv_cost(uint8_t *vme_state_message, float lambda)
+{
+    int m_cost, j, mv_count;
+    float m_costf;
+
+    vme_state_message[MODE_INTER_MV0] = 0;
+    for (j = 1; j < 3; j++) {
+        m_costf = (log2f((float)(j + 1)) + 1.718f) * lambda;
+        m_cost = (int)m_costf;
+        vme_state_message[MODE_INTER_MV0 + j] = intel_format_lutvalue(m_cost, 0x6f);
+    }
+    mv_count = 3;
+    for (j = 4; j <= 64; j *= 2) {
+        m_costf = (log2f((float)(j + 1)) + 1.718f) * lambda;
+        m_cost = (int)m_costf;
+        vme_state_message[MODE_INTER_MV0 + mv_count] = intel_format_lutvalue(m_cost, 0x6f);
+        mv_count++;
+    }
+}
+
+static void
+intel_vme_avc_cost(uint8_t *vme_state_message, int slice_type, int qp)
+{
+    int m_cost;
+    float lambda, m_costf;
+
+    lambda = intel_lambda_qp(qp);
+
+    /*
+     * The whole row is copied over the VME state message, so these two are
+     * set too: the reference ID cost is raised afterwards from the active
+     * references by intel_avc_vme_reference_state(), no cost is put on the
+     * chroma intra modes.
+     */
+    vme_state_message[MODE_REFID_COST] = 0;
+    vme_state_message[MODE_CHROMA_INTRA] = 0;
+
+    if (slice_type == SLICE_TYPE_I) {
+        vme_state_message[MODE_INTRA_16X16] = 0;
+        m_cost = lambda * 4;
+        vme_state_message[MODE_INTRA_8X8] = intel_format_lutvalue(m_cost, 0x8f);
+        m_cost = lambda * 16; 
+        vme_state_message[MODE_INTRA_4X4] = intel_format_lutvalue(m_cost, 0x8f);
+        m_cost = lambda * 3;
+        vme_state_message[MODE_INTRA_NONPRED] = intel_format_lutvalue(m_cost, 0x6f);
+        return;
+    }
+
+    intel_vme_mv_cost(vme_state_message, lambda);
+
+    if (qp <= 25) {
+        vme_state_message[MODE_INTRA_16X16] = 0x4a;
+        vme_state_message[MODE_INTRA_8X8] = 0x4a;
+        vme_state_message[MODE_INTRA_4X4] = 0x4a;
+        vme_state_message[MODE_INTRA_NONPRED] = 0x4a;
+        vme_state_message[MODE_INTER_16X16] = 0x4a;
+        vme_state_message[MODE_INTER_16X8] = 0x4a;
+        vme_state_message[MODE_INTER_8X8] = 0x4a;
+        vme_state_message[MODE_INTER_8X4] = 0x4a;
+        vme_state_message[MODE_INTER_4X4] = 0x4a;
+        vme_state_message[MODE_INTER_BWD] = 0x2a;
+        return;
+    }
+
+    /*
+     * Quirk kept for bit-exact mode decisions: the per frame code this table
+     * replaced computed lambda * 10 for intra 16x16 but formatted the stale
+     * m_cost left by its MV loop, that of the largest MV class.
+     */
+    m_cost = (int)((log2f(65.f) + 1.718f) * lambda);
+    vme_state_message[MODE_INTRA_16X16] = intel_format_lutvalue(m_cost, 0x8f);
+    m_cost = lambda * 14;
+    vme_state_message[MODE_INTRA_8X8] = intel_format_lutvalue(m_cost, 0x8f);
+    m_cost = lambda * 24; 
+    vme_state_message[MODE_INTRA_4X4] = intel_format_lutvalue(m_cost, 0x8f);
+    m_costf = lambda * 3.5;
+    m_cost = m_costf;
+    vme_state_message[MODE_INTRA_NONPRED] = intel_format_lutvalue(m_cost, 0x6f);
+    if (slice_type == SLICE_TYPE_P) {
+        m_costf = lambda * 2.5;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_16X16] = intel_format_lutvalue(m_cost, 0x8f);
+        m_costf = lambda * 4;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_16X8] = intel_format_lutvalue(m_cost, 0x8f);
+        m_costf = lambda * 1.5;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_8X8] = intel_format_lutvalue(m_cost, 0x6f);
+        m_costf = lambda * 3;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_8X4] = intel_format_lutvalue(m_cost, 0x6f);
+        m_costf = lambda * 5;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_4X4] = intel_format_lutvalue(m_cost, 0x6f);
+        /* BWD is not used in P-frame */
+        vme_state_message[MODE_INTER_BWD] = 0;
+    } else {
+        m_costf = lambda * 2.5;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_16X16] = intel_format_lutvalue(m_cost, 0x8f);
+        m_costf = lambda * 5.5;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_16X8] = intel_format_lutvalue(m_cost, 0x8f);
+        m_costf = lambda * 3.5;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_8X8] = intel_format_lutvalue(m_cost, 0x6f);
+        m_costf = lambda * 5.0;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_8X4] = intel_format_lutvalue(m_cost, 0x6f);
+        m_costf = lambda * 6.5;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_4X4] = intel_format_lutvalue(m_cost, 0x6f);
+        m_costf = lambda * 1.5;
+        m_cost = m_costf;
+        vme_state_message[MODE_INTER_BWD] = intel_format_lutvalue(m_cost, 0x6f);
+    }
+}
+
+static void
+intel_vme_mpeg2_cost(uint8_t *vme_state_message, int qp)
+{
+    int m_cost;
+    float lambda;
+
+    lambda = intel_lambda_qp(qp);
+    /* No Intra prediction. So it is zero */
+    vme_state_message[MODE_INTRA_8X8] = 0;
+    vme_state_message[MODE_INTRA_4X4] = 0;
+    intel_vme_mv_cost(vme_state_message, lambda);
+    m_cost = lambda;
+    /* It can only perform the 16x16 search. So mode cost can be ignored for
+     * the other mode. for example: 16x8/8x8
+     */
+    vme_state_message[MODE_INTRA_16X16] = intel_format_lutvalue(m_cost, 0x8f);
+    vme_state_message[MODE_INTER_16X16] = intel_format_lutvalue(m_cost, 0x8f);
+			
+    vme_state_message[MODE_INTER_16X8] = 0;
+    vme_state_message[MODE_INTER_8X8] = 0;
+    vme_state_message[MODE_INTER_8X4] = 0;
+    vme_state_message[MODE_INTER_4X4] = 0;
+    vme_state_message[MODE_INTER_BWD] = intel_format_lutvalue(m_cost, 0x6f);
+}
+
+void
+i965_vme_cost_table_init(struct i965_vme_cost_table *table)
+{
+    int slice_type, qp;
+
+    memset(table, 0, sizeof(*table));
+
+    for (qp = 0; qp < I965_VME_COST_QP_NUM; qp++) {
+        for (slice_type = SLICE_TYPE_P; slice_type <= SLICE_TYPE_I; slice_type++)
+            intel_vme_avc_cost(table->avc[slice_type][qp], slice_type, qp);
+
+        intel_vme_mpeg2_cost(table->mpeg2[qp], qp);
+    }
+}
+
+uint8_t
+i965_vme_cost_refid(int qp, int ref_idx, int num_ref_idx_active)
+{
+    int bits;
+
+    if (num_ref_idx_active <= 1)
+        return 0;
+
+    if (num_ref_idx_active == 2) {
+        bits = 1;
+    } else {
+        /* ue(v) */
+        bits = 2 * (int)log2f((float)(ref_idx + 1)) + 1;
+    }
+
+    return intel_format_lutvalue((int)(bits * intel_lambda_qp(qp)), 0x6f);
+}
+
+int
+i965_vme_cost_table_load(struct i965_vme_cost_table *table, const char *path)
+{
+    struct i965_vme_cost_table loaded;
+    char line[512];
+    int line_num = 0, rows = 0;
+    FILE *fp;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Failed to open the VME cost table %s\n", path);
+        return -1;
+    }
+
+    loaded = *table;
+
+    while (fgets(line, sizeof(line), fp)) {
+        uint8_t *row;
+        char *p = line, *end;
+        long qp, cost;
+        int i;
+
+        line_num++;
+
+        while (isspace((unsigned char)*p))
+            p++;
+
+        if (*p == '\0' || *p == '#')
+            continue;
+
+        switch (toupper((unsigned char)*p)) {
+        case 'I': row = loaded.avc[SLICE_TYPE_I][0]; break;
+        case 'P': row = loaded.avc[SLICE_TYPE_P][0]; break;
+        case 'B': row = loaded.avc[SLICE_TYPE_B][0]; break;
+        case 'M': row = loaded.mpeg2[0]; break;
+        default: goto error;
+        }
+
+        qp = strtol(p + 1, &end, 10);
+        if (end == p + 1 || qp < 0 || qp >= I965_VME_COST_QP_NUM)
+            goto error;
+
+        row += qp * I965_VME_COST_NUM;
+
+        for (i = 0; i < I965_VME_COST_NUM; i++) {
+            p = end;
+            cost = strtol(p, &end, 0);
+            if (end == p || cost < 0 || cost > 0xff)
+                goto error;
+
+            row[i] = cost;
+        }
+
+        rows++;
+    }
+
+    fclose(fp);
+    *table = loaded;
+
+    return rows;
+
+error:
+    fprintf(stderr, "Invalid VME cost table %s at line %d\n", path, line_num);
+    fclose(fp);
+
+    return -1;
+}
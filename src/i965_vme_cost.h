@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_VME_COST_H
+#define I965_VME_COST_H
+
+#include <stdint.h>
+
+/* the QP range of the tables, wide enough for the MPEG-2 quantiser_scale_code */
+#define I965_VME_COST_QP_NUM            52
+
+/* MODE_INTRA_NONPRED to MODE_INTER_MV7 of the VME state message */
+#define I965_VME_COST_NUM               20
+
+/*
+ * The mode and MV costs of the VME state message depend only on the slice
+ * type and the QP, so they are all formatted once when the driver loads
+ * and each frame just copies its row.
+ */
+struct i965_vme_cost_table
+{
+    /* by SLICE_TYPE_P/B/I and QP */
+    uint8_t avc[3][I965_VME_COST_QP_NUM][I965_VME_COST_NUM];
+
+    /* P and B pictures, by quantiser_scale_code */
+    uint8_t mpeg2[I965_VME_COST_QP_NUM][I965_VME_COST_NUM];
+};
+
+void
+i965_vme_cost_table_init(struct i965_vme_cost_table *table);
+
+/*
+ * The MODE_REFID_COST of a macroblock predicted from ref_idx when
+ * num_ref_idx_active references are active in its list, that is the
+ * te(v) length of ref_idx weighted by the lambda of the QP.
+ */
+uint8_t
+i965_vme_cost_refid(int qp, int ref_idx, int num_ref_idx_active);
+
+/*
+ * Override rows of the table from a text file, one row per line:
+ *
+ *   <I|P|B|M> <qp> <cost 0> ... <cost 19>
+ *
+ * where M is an MPEG-2 row and the costs are the LUT encoded bytes of the
+ * VME state message, in decimal or 0x prefixed hexadecimal. Empty lines
+ * and those starting with # are skipped. Returns the number of rows read
+ * or -1 if the file can't be parsed, in which case the table is unchanged.
+ */
+int
+i965_vme_cost_table_load(struct i965_vme_cost_table *table, const char *path);
+
+#endif /* I965_VME_COST_H */
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "i965_worker_pool.h"
+
+static void
+i965_worker_pool_parse_cpus(struct i965_worker_pool *pool, const char *cpus)
+{
+    const char *p = cpus;
+
+    while (*p && pool->num_cpus < I965_WORKER_POOL_MAX_THREADS) {
+        char *end;
+        long first, last;
+
+        first = strtol(p, &end, 10);
+
+        if (end == p || first < 0)
+            break;
+
+        last = first;
+        p = end;
+
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+
+            if (end == p + 1 || last < first)
+                break;
+
+            p = end;
+        }
+
+        for (; first <= last && pool->num_cpus < I965_WORKER_POOL_MAX_THREADS; first++)
+            pool->cpus[pool->num_cpus++] = first;
+
+        if (*p != ',')
+            break;
+
+        p++;
+    }
+}
+
+/* Takes bands of the current job until none is left, with mutex held */
+static void
+i965_worker_pool_work(struct i965_worker_pool *pool)
+{
+    while (pool->next_band < pool->num_bands) {
+        unsigned int band = pool->next_band++;
+        unsigned int first = band * pool->band_rows;
+        unsigned int last = first + pool->band_rows;
+
+        if (last > pool->num_rows)
+            last = pool->num_rows;
+
+        pthread_mutex_unlock(&pool->mutex);
+        pool->func(pool->data, first, last);
+        pthread_mutex_lock(&pool->mutex);
+
+        if (++pool->bands_done == pool->num_bands)
+            pthread_cond_signal(&pool->done_cond);
+    }
+}
+
+struct i965_worker_start
+{
+    struct i965_worker_pool *pool;
+    int cpu;
+    unsigned int generation;
+};
+
+static void *
+i965_worker_pool_thread(void *arg)
+{
+    struct i965_worker_pool *pool = ((struct i965_worker_start *)arg)->pool;
+    int cpu = ((struct i965_worker_start *)arg)->cpu;
+    unsigned int generation = ((struct i965_worker_start *)arg)->generation;
+
+    free(arg);
+
+#ifdef CPU_SET
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+
+        if (sched_setaffinity(0, sizeof(set), &set))
+            fprintf(stderr, "failed to pin copy worker to CPU %d\n", cpu);
+    }
+#endif
+
+    pthread_mutex_lock(&pool->mutex);
+
+    while (!pool->quit) {
+        if (pool->generation == generation) {
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+            continue;
+        }
+
+        generation = pool->generation;
+        i965_worker_pool_work(pool);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+/* Called with mutex held, returns the number of threads running */
+static int
+i965_worker_pool_start(struct i965_worker_pool *pool)
+{
+    int i;
+
+    pool->threads_started = 0;
+
+    for (i = 0; i < pool->num_threads; i++) {
+        struct i965_worker_start *start = malloc(sizeof(*start));
+
+        if (!start)
+            break;
+
+        start->pool = pool;
+        start->cpu = pool->num_cpus ? pool->cpus[i % pool->num_cpus] : -1;
+        /* so the job about to be posted is not missed */
+        start->generation = pool->generation;
+
+        if (pthread_create(&pool->threads[i], NULL, i965_worker_pool_thread, start)) {
+            free(start);
+            break;
+        }
+
+        pool->threads_started++;
+    }
+
+    /* Never try again, run with whatever could be started */
+    pool->num_threads = pool->threads_started;
+
+    return pool->threads_started;
+}
+
+void
+i965_worker_pool_init(struct i965_worker_pool *pool, int num_threads, const char *cpus)
+{
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->job_mutex, NULL);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    if (num_threads < 0)
+        num_threads = 0;
+
+    if (num_threads > I965_WORKER_POOL_MAX_THREADS)
+        num_threads = I965_WORKER_POOL_MAX_THREADS;
+
+    pool->num_threads = num_threads;
+    pool->threads_started = -1;
+
+    if (cpus)
+        i965_worker_pool_parse_cpus(pool, cpus);
+}
+
+void
+i965_worker_pool_terminate(struct i965_worker_pool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->threads_started; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_mutex_destroy(&pool->job_mutex);
+}
+
+void
+i965_worker_pool_run(struct i965_worker_pool *pool,
+                     i965_band_func func, void *data,
+                     unsigned int num_rows, unsigned int row_bytes)
+{
+    unsigned long total = (unsigned long)num_rows * row_bytes;
+
+    if (total < I965_WORKER_POOL_MIN_BYTES) {
+        func(data, 0, num_rows);
+        return;
+    }
+
+    i965_worker_pool_run_bands(pool, func, data, num_rows,
+                               total / I965_WORKER_POOL_BAND_BYTES);
+}
+
+void
+i965_worker_pool_run_bands(struct i965_worker_pool *pool,
+                           i965_band_func func, void *data,
+                           unsigned int num_rows, unsigned int num_bands)
+{
+    if (!pool->num_threads ||
+        num_bands < 2 || num_rows < 2 ||
+        pthread_mutex_trylock(&pool->job_mutex)) {
+        func(data, 0, num_rows);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->threads_started < 0 && !i965_worker_pool_start(pool)) {
+        pthread_mutex_unlock(&pool->mutex);
+        pthread_mutex_unlock(&pool->job_mutex);
+        func(data, 0, num_rows);
+        return;
+    }
+
+    if (num_bands > (unsigned int)pool->num_threads + 1)
+        num_bands = pool->num_threads + 1;
+
+    pool->func = func;
+    pool->data = data;
+    pool->num_rows = num_rows;
+    pool->band_rows = (num_rows + num_bands - 1) / num_bands;
+    pool->num_bands = (num_rows + pool->band_rows - 1) / pool->band_rows;
+    pool->next_band = 0;
+    pool->bands_done = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    i965_worker_pool_work(pool);
+
+    while (pool->bands_done < pool->num_bands)
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_mutex_unlock(&pool->job_mutex);
+}
+
+struct memcpy_pic_job
+{
+    uint8_t *dst;
+    unsigned int dst_stride;
+    const uint8_t *src;
+    unsigned int src_stride;
+    unsigned int len;
+};
+
+static void
+memcpy_pic_band(void *data, unsigned int first, unsigned int last)
+{
+    const struct memcpy_pic_job *job = data;
+    uint8_t *dst = job->dst + first * job->dst_stride;
+    const uint8_t *src = job->src + first * job->src_stride;
+    unsigned int i;
+
+    for (i = first; i < last; i++) {
+        memcpy(dst, src, job->len);
+        dst += job->dst_stride;
+        src += job->src_stride;
+    }
+}
+
+void
+i965_worker_pool_memcpy_pic(struct i965_worker_pool *pool,
+                            uint8_t *dst, unsigned int dst_stride,
+                            const uint8_t *src, unsigned int src_stride,
+                            unsigned int len, unsigned int height)
+{
+    struct memcpy_pic_job job;
+
+    job.dst = dst;
+    job.dst_stride = dst_stride;
+    job.src = src;
+    job.src_stride = src_stride;
+    job.len = len;
+    i965_worker_pool_run(pool, memcpy_pic_band, &job, height, len);
+}
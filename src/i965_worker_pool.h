@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_WORKER_POOL_H
+#define I965_WORKER_POOL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define I965_WORKER_POOL_MAX_THREADS    16
+
+/* Helper threads used when VA_INTEL_COPY_THREADS is not set */
+#define I965_WORKER_POOL_DEFAULT_THREADS 3
+
+/* Jobs smaller than this run on the calling thread only */
+#define I965_WORKER_POOL_MIN_BYTES      (2 << 20)
+
+/* Smallest amount of work handed to a single band */
+#define I965_WORKER_POOL_BAND_BYTES     (512 << 10)
+
+/* Processes rows [first, last) of a job */
+typedef void (*i965_band_func)(void *data, unsigned int first, unsigned int last);
+
+/*
+ * Splits CPU copies of large planes, or other row based CPU work, into
+ * horizontal bands processed by a few helper threads together with the
+ * calling thread. The threads are started on first use and optionally
+ * pinned to a set of CPUs.
+ */
+struct i965_worker_pool
+{
+    pthread_mutex_t job_mutex;  /* serializes jobs */
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    pthread_t threads[I965_WORKER_POOL_MAX_THREADS];
+    int num_threads;
+    int threads_started;
+    int quit;
+    int cpus[I965_WORKER_POOL_MAX_THREADS];
+    int num_cpus;
+
+    /* current job */
+    unsigned int generation;
+    i965_band_func func;
+    void *data;
+    unsigned int num_rows;
+    unsigned int band_rows;
+    unsigned int num_bands;
+    unsigned int next_band;
+    unsigned int bands_done;
+};
+
+/*
+ * num_threads helper threads (0 disables the pool), cpus is a list such
+ * as "0,2,4-7" the helpers are pinned to in turn, or NULL
+ */
+void
+i965_worker_pool_init(struct i965_worker_pool *pool, int num_threads, const char *cpus);
+
+void
+i965_worker_pool_terminate(struct i965_worker_pool *pool);
+
+/*
+ * Runs func over num_rows rows of row_bytes bytes each and returns once
+ * all of them are processed. Small jobs, or jobs submitted while another
+ * one is in flight, run on the calling thread.
+ */
+void
+i965_worker_pool_run(struct i965_worker_pool *pool,
+                     i965_band_func func, void *data,
+                     unsigned int num_rows, unsigned int row_bytes);
+
+/*
+ * Same as i965_worker_pool_run() for work that isn't measured in bytes:
+ * the caller picks the number of bands, which is capped to the number of
+ * threads. Less than 2 bands run on the calling thread.
+ */
+void
+i965_worker_pool_run_bands(struct i965_worker_pool *pool,
+                           i965_band_func func, void *data,
+                           unsigned int num_rows, unsigned int num_bands);
+
+/* Copies height rows of len bytes, in bands if the picture is large */
+void
+i965_worker_pool_memcpy_pic(struct i965_worker_pool *pool,
+                            uint8_t *dst, unsigned int dst_stride,
+                            const uint8_t *src, unsigned int src_stride,
+                            unsigned int len, unsigned int height);
+
+#endif /* I965_WORKER_POOL_H */
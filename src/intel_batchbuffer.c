@@ -28,15 +28,43 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
 
 #include "intel_batchbuffer.h"
 
 #define MAX_BATCH_SIZE		0x400000
 
+/*
+ * Returns the BO in the current slot of the ring. The previous BO of the
+ * slot is recycled once the GPU has retired it, so the next batch can be
+ * built while the GPU still executes the last ones. A busy BO is replaced
+ * by a new one rather than waited for.
+ */
+static dri_bo *
+intel_batchbuffer_ring_get(struct intel_batchbuffer *batch, int batch_size)
+{
+    struct intel_driver_data *intel = batch->intel; 
+    dri_bo *bo = batch->ring[batch->ring_index];
+
+    if (bo && (bo->size < batch_size || drm_intel_bo_busy(bo))) {
+        dri_bo_unreference(bo);
+        bo = NULL;
+    }
+
+    if (!bo) {
+        bo = dri_bo_alloc(intel->bufmgr, 
+                          "batch buffer",
+                          batch_size,
+                          0x1000);
+        batch->ring[batch->ring_index] = bo;
+    }
+
+    return bo;
+}
+
 static void 
 intel_batchbuffer_reset(struct intel_batchbuffer *batch, int buffer_size)
 {
-    struct intel_driver_data *intel = batch->intel; 
     int batch_size = buffer_size;
 
     assert(batch->flag == I915_EXEC_RENDER ||
@@ -44,12 +72,13 @@ intel_batchbuffer_reset(struct intel_batchbuffer *batch, int buffer_size)
            batch->flag == I915_EXEC_BSD ||
            batch->flag == I915_EXEC_VEBOX);
 
-    dri_bo_unreference(batch->buffer);
-    batch->buffer = dri_bo_alloc(intel->bufmgr, 
-                                 "batch buffer",
-                                 batch_size,
-                                 0x1000);
+    if (batch->buffer)
+        batch->ring_index = (batch->ring_index + 1) % INTEL_BATCHBUFFER_RING_SIZE;
+
+    batch->buffer = intel_batchbuffer_ring_get(batch, batch_size);
     assert(batch->buffer);
+
+    /* Cheap for a recycled BO, libdrm keeps its CPU mapping around */
     dri_bo_map(batch->buffer, 1);
     assert(batch->buffer->virtual);
     batch->map = batch->buffer->virtual;
@@ -103,12 +132,16 @@ intel_batchbuffer_new(struct intel_driver_data *intel, int flag, int buffer_size
 
 void intel_batchbuffer_free(struct intel_batchbuffer *batch)
 {
+    int i;
+
     if (batch->map) {
         dri_bo_unmap(batch->buffer);
         batch->map = NULL;
     }
 
-    dri_bo_unreference(batch->buffer);
+    for (i = 0; i < INTEL_BATCHBUFFER_RING_SIZE; i++)
+        dri_bo_unreference(batch->ring[i]);
+
     dri_bo_unreference(batch->wa_render_bo);
     free(batch);
 }
@@ -131,7 +164,26 @@ intel_batchbuffer_flush(struct intel_batchbuffer *batch)
     batch->ptr += 4;
     dri_bo_unmap(batch->buffer);
     used = batch->ptr - batch->map;
-    batch->run(batch->buffer, used, 0, 0, 0, batch->flag);
+
+    if (batch->flag == I915_EXEC_BSD && batch->bsd_ring != I915_EXEC_BSD_DEFAULT) {
+        /*
+         * A kernel without the VDBOX selection rejects it. The batch then
+         * runs on whichever VDBOX the kernel picks, the encoder drops the
+         * byte counts of the frame as they may come from the other one.
+         */
+        if (batch->run(batch->buffer, used, 0, 0, 0, batch->flag | batch->bsd_ring) == -EINVAL) {
+            intel_driver_disable_bsd_ring_select(batch->intel, batch->bsd_ring);
+            batch->bsd_ring = I915_EXEC_BSD_DEFAULT;
+            batch->run(batch->buffer, used, 0, 0, 0, batch->flag);
+        }
+    } else
+        batch->run(batch->buffer, used, 0, 0, 0, batch->flag);
+
+    /*
+     * The kernel keeps the targets alive until the batch retires, drop the
+     * relocations so the BO can be filled again from scratch.
+     */
+    drm_intel_gem_bo_clear_relocs(batch->buffer, 0);
     intel_batchbuffer_reset(batch, batch->size);
 }
 
@@ -8,16 +8,24 @@
 
 #include "intel_driver.h"
 
+/* The number of batch BOs recycled by a batchbuffer */
+#define INTEL_BATCHBUFFER_RING_SIZE     4
+
 struct intel_batchbuffer 
 {
     struct intel_driver_data *intel;
     dri_bo *buffer;
+    dri_bo *ring[INTEL_BATCHBUFFER_RING_SIZE];
+    int ring_index;
     unsigned int size;
     unsigned char *map;
     unsigned char *ptr;
     int atomic;
     int flag;
 
+    /* the I915_EXEC_BSD_RING* the BSD batches are sent to */
+    int bsd_ring;
+
     int emit_total;
     unsigned char *emit_start;
 
@@ -23,4 +23,17 @@
 #  define DLL_EXPORT
 #endif
 
+/**
+ * Atomic operations
+ */
+#if defined(__GNUC__)
+#  define atomic_load_acquire(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#  define atomic_store_release(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#  define atomic_add_relaxed(p, v)      __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#else
+#  define atomic_load_acquire(p)        (*(p))
+#  define atomic_store_release(p, v)    (*(p) = (v))
+#  define atomic_add_relaxed(p, v)      (*(p) += (v))
+#endif
+
 #endif /* _INTEL_COMPILER_H_ */
@@ -75,7 +75,7 @@ intel_driver_init(VADriverContextP ctx)
 {
     struct intel_driver_data *intel = intel_driver_data(ctx);
     struct drm_state * const drm_state = (struct drm_state *)ctx->drm_state;
-    int has_exec2 = 0, has_bsd = 0, has_blt = 0, has_vebox = 0;
+    int has_exec2 = 0, has_bsd = 0, has_blt = 0, has_vebox = 0, has_bsd2 = 0;
     char *env_str = NULL;
 
     g_intel_debug_option_flags = 0;
@@ -115,6 +115,20 @@ intel_driver_init(VADriverContextP ctx)
         intel->has_blt = has_blt;
     if (intel_driver_get_param(intel, I915_PARAM_HAS_VEBOX, &has_vebox))
         intel->has_vebox = !!has_vebox;
+    if (intel_driver_get_param(intel, I915_PARAM_HAS_BSD2, &has_bsd2))
+        intel->has_bsd2 = !!has_bsd2;
+
+    /*
+     * Without balancing the contexts are still sent to the first VDBOX: by
+     * default the kernel may run them on either, and the PAK byte counts
+     * are read from the registers of the VDBOX the context runs on
+     */
+    intel->bsd_ring_select = intel->has_bsd2;
+    intel->bsd_ring_balance = 1;
+    intel->bsd_ring_users[0] = intel->bsd_ring_users[1] = 0;
+
+    if ((env_str = getenv("VA_INTEL_BSD_RING_SELECT")) && !atoi(env_str))
+        intel->bsd_ring_balance = 0;
    
     intel_driver_get_revid(intel, &intel->revision);
     intel_memman_init(intel);
@@ -129,3 +143,48 @@ intel_driver_terminate(VADriverContextP ctx)
     intel_memman_terminate(intel);
     pthread_mutex_destroy(&intel->ctxmutex);
 }
+
+int
+intel_driver_get_bsd_ring(struct intel_driver_data *intel)
+{
+    int ring = 0;
+
+    if (!intel->has_bsd2)
+        return I915_EXEC_BSD_DEFAULT;
+
+    pthread_mutex_lock(&intel->ctxmutex);
+
+    if (!intel->bsd_ring_select) {
+        pthread_mutex_unlock(&intel->ctxmutex);
+        return I915_EXEC_BSD_DEFAULT;
+    }
+
+    if (intel->bsd_ring_balance)
+        ring = (intel->bsd_ring_users[1] < intel->bsd_ring_users[0]);
+
+    intel->bsd_ring_users[ring]++;
+    pthread_mutex_unlock(&intel->ctxmutex);
+
+    return ring ? I915_EXEC_BSD_RING2 : I915_EXEC_BSD_RING1;
+}
+
+void
+intel_driver_put_bsd_ring(struct intel_driver_data *intel, int bsd_ring)
+{
+    if (bsd_ring == I915_EXEC_BSD_DEFAULT)
+        return;
+
+    pthread_mutex_lock(&intel->ctxmutex);
+    intel->bsd_ring_users[bsd_ring == I915_EXEC_BSD_RING2]--;
+    pthread_mutex_unlock(&intel->ctxmutex);
+}
+
+void
+intel_driver_disable_bsd_ring_select(struct intel_driver_data *intel, int bsd_ring)
+{
+    intel_driver_put_bsd_ring(intel, bsd_ring);
+
+    pthread_mutex_lock(&intel->ctxmutex);
+    intel->bsd_ring_select = 0;
+    pthread_mutex_unlock(&intel->ctxmutex);
+}
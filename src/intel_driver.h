@@ -15,6 +15,19 @@
 
 #include "intel_compiler.h"
 
+/* The second VDBOX of the GT3 parts, for the libdrm headers that lack it */
+#ifndef I915_PARAM_HAS_BSD2
+#define I915_PARAM_HAS_BSD2             31
+#endif
+
+#ifndef I915_EXEC_BSD_MASK
+#define I915_EXEC_BSD_SHIFT             13
+#define I915_EXEC_BSD_MASK              (3 << I915_EXEC_BSD_SHIFT)
+#define I915_EXEC_BSD_DEFAULT           (0 << I915_EXEC_BSD_SHIFT)
+#define I915_EXEC_BSD_RING1             (1 << I915_EXEC_BSD_SHIFT)
+#define I915_EXEC_BSD_RING2             (2 << I915_EXEC_BSD_SHIFT)
+#endif
+
 #define BATCH_SIZE      0x80000
 #define BATCH_RESERVED  0x10
 
@@ -33,6 +46,8 @@
 #define MI_FLUSH_DW                             (CMD_MI | (0x26 << 23) | 0x2)
 #define   MI_FLUSH_DW_VIDEO_PIPELINE_CACHE_INVALIDATE   (0x1 << 7)
 
+#define MI_STORE_REGISTER_MEM                   (CMD_MI | (0x24 << 23))
+
 #define XY_COLOR_BLT_CMD                        (CMD_2D | (0x50 << 22) | 0x04)
 #define XY_COLOR_BLT_WRITE_ALPHA                (1 << 21)
 #define XY_COLOR_BLT_WRITE_RGB                  (1 << 20)
@@ -79,6 +94,8 @@ struct intel_batchbuffer;
 extern uint32_t g_intel_debug_option_flags;
 #define VA_INTEL_DEBUG_OPTION_ASSERT    (1 << 0)
 #define VA_INTEL_DEBUG_OPTION_BENCH     (1 << 1)
+#define VA_INTEL_DEBUG_OPTION_STATS     (1 << 2)
+#define VA_INTEL_DEBUG_OPTION_VPP       (1 << 3)
 
 #define ASSERT_RET(value, fail_ret) do {    \
         if (!(value)) {                     \
@@ -153,6 +170,17 @@ struct intel_driver_data
     unsigned int has_bsd    : 1; /* Flag: has bitstream decoder for H.264? */
     unsigned int has_blt    : 1; /* Flag: has BLT unit? */
     unsigned int has_vebox  : 1; /* Flag: has VEBOX unit */
+    unsigned int has_bsd2   : 1; /* Flag: has a second VDBOX */
+
+    /*
+     * Under ctxmutex: whether the BSD batches name the VDBOX they run on,
+     * until the kernel rejects it, whether the contexts are spread over
+     * both VDBOXes rather than all kept on the first one, and the
+     * contexts running on each VDBOX
+     */
+    int bsd_ring_select;
+    int bsd_ring_balance;
+    int bsd_ring_users[2];
 
     const struct intel_device_info *device_info;
 };
@@ -160,6 +188,21 @@ struct intel_driver_data
 bool intel_driver_init(VADriverContextP ctx);
 void intel_driver_terminate(VADriverContextP ctx);
 
+/*
+ * Returns the I915_EXEC_BSD_RING* flag of the VDBOX with the fewest
+ * contexts for a new one, of the first VDBOX when VA_INTEL_BSD_RING_SELECT
+ * is 0, or I915_EXEC_BSD_DEFAULT with a single VDBOX or when the kernel
+ * can't select it. The context gives it back with intel_driver_put_bsd_ring().
+ */
+int intel_driver_get_bsd_ring(struct intel_driver_data *intel);
+void intel_driver_put_bsd_ring(struct intel_driver_data *intel, int bsd_ring);
+
+/*
+ * Called when the kernel rejects the VDBOX selection: gives bsd_ring back
+ * and has all the later contexts use I915_EXEC_BSD_DEFAULT
+ */
+void intel_driver_disable_bsd_ring_select(struct intel_driver_data *intel, int bsd_ring);
+
 static INLINE struct intel_driver_data *
 intel_driver_data(VADriverContextP ctx)
 {
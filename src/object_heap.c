@@ -33,9 +33,33 @@
 
 #define LAST_FREE	-1
 #define ALLOCATED	-2
+#define CACHED		-3
+
+struct object_heap_retired {
+    void **bucket;
+    struct object_heap_retired *next;
+};
+
+#if defined PTHREADS
+struct object_heap_cache {
+    object_heap_p heap;
+    int count;
+    int free[OBJECT_HEAP_CACHE_SIZE];
+    struct object_heap_cache *next;
+};
+#endif
+
+static INLINE object_base_p
+object_heap_object( object_heap_p heap, void **bucket, int index )
+{
+    int bucket_index = index / heap->heap_increment;
+    int obj_index = index % heap->heap_increment;
+
+    return (object_base_p) ((char *)bucket[bucket_index] + obj_index * heap->object_size);
+}
 
 /*
- * Expands the heap
+ * Expands the heap, must be called with the heap mutex held
  * Return 0 on success, -1 on error
  */
 static int object_heap_expand( object_heap_p heap )
@@ -46,17 +70,39 @@ static int object_heap_expand( object_heap_p heap )
     int new_heap_size = heap->heap_size + heap->heap_increment;
     int bucket_index = new_heap_size / heap->heap_increment - 1;
 
+    if (new_heap_size > OBJECT_HEAP_INDEX_MASK + 1)
+        return -1;
+
     if (bucket_index >= heap->num_buckets) {
-        int new_num_buckets = heap->num_buckets + 8;
+        int new_num_buckets = heap->num_buckets ? heap->num_buckets * 2 : 8;
         void **new_bucket;
 
-        new_bucket = realloc(heap->bucket, new_num_buckets * sizeof(void *));
+        /*
+         * Lookups read the bucket array without the mutex, so the old
+         * array can't be reallocated in place. Publish a copy and keep
+         * the old one around until the heap is destroyed.
+         */
+        new_bucket = calloc(new_num_buckets, sizeof(void *));
         if (NULL == new_bucket) {
             return -1;
         }
 
+        if (heap->bucket) {
+            struct object_heap_retired *retired = malloc(sizeof(*retired));
+
+            if (NULL == retired) {
+                free(new_bucket);
+                return -1;
+            }
+
+            memcpy(new_bucket, heap->bucket, heap->num_buckets * sizeof(void *));
+            retired->bucket = heap->bucket;
+            retired->next = heap->retired;
+            heap->retired = retired;
+        }
+
         heap->num_buckets = new_num_buckets;
-        heap->bucket = new_bucket;
+        atomic_store_release(&heap->bucket, new_bucket);
     }
 
     new_heap_index = (void *) malloc( heap->heap_increment * heap->object_size );
@@ -69,32 +115,143 @@ static int object_heap_expand( object_heap_p heap )
     next_free = heap->next_free;
     for(i = new_heap_size; i-- > heap->heap_size; )
     {
-        object_base_p obj = (object_base_p) (new_heap_index + (i - heap->heap_size) * heap->object_size);
+        object_base_p obj = (object_base_p) ((char *)new_heap_index + (i - heap->heap_size) * heap->object_size);
         obj->id = i + heap->id_offset;
         obj->next_free = next_free;
         next_free = i;
     }
     heap->next_free = next_free;
-    heap->heap_size = new_heap_size;
+
+    /* Make the new bucket visible to lookups only once it is initialized */
+    atomic_store_release(&heap->heap_size, new_heap_size);
     return 0; /* Success */
 }
 
+/*
+ * Takes an object off the shared free list, must be called with the heap
+ * mutex held
+ * Returns the object index on success, returns -1 on error
+ */
+static int object_heap_pop_free( object_heap_p heap )
+{
+    object_base_p obj;
+    int index;
+
+    if ( LAST_FREE == heap->next_free )
+    {
+        if( -1 == object_heap_expand( heap ) )
+        {
+            return -1; /* Out of memory */
+        }
+    }
+    ASSERT( heap->next_free >= 0 );
+
+    index = heap->next_free;
+    obj = object_heap_object(heap, heap->bucket, index);
+    heap->next_free = obj->next_free;
+    obj->next_free = CACHED;
+
+    return index;
+}
+
+/*
+ * Puts an object back on the shared free list, must be called with the
+ * heap mutex held
+ */
+static void object_heap_push_free( object_heap_p heap, int index )
+{
+    object_base_p obj = object_heap_object(heap, heap->bucket, index);
+
+    atomic_store_release(&obj->next_free, heap->next_free);
+    heap->next_free = index;
+}
+
+#if defined PTHREADS
+static void object_heap_cache_release( void *data )
+{
+    struct object_heap_cache *cache = data;
+    struct object_heap_cache **p;
+    object_heap_p heap = cache->heap;
+
+    _i965LockMutex(&heap->mutex);
+    while (cache->count > 0)
+        object_heap_push_free(heap, cache->free[--cache->count]);
+
+    for (p = &heap->caches; *p; p = &(*p)->next) {
+        if (*p == cache) {
+            *p = cache->next;
+            break;
+        }
+    }
+    _i965UnlockMutex(&heap->mutex);
+
+    free(cache);
+}
+
+/*
+ * Returns the free list cache of the calling thread, NULL if it can't be
+ * allocated
+ */
+static struct object_heap_cache *object_heap_get_cache( object_heap_p heap )
+{
+    struct object_heap_cache *cache = pthread_getspecific(heap->cache_key);
+
+    if (cache)
+        return cache;
+
+    cache = calloc(1, sizeof(*cache));
+
+    if (NULL == cache)
+        return NULL;
+
+    cache->heap = heap;
+
+    if (pthread_setspecific(heap->cache_key, cache)) {
+        free(cache);
+        return NULL;
+    }
+
+    _i965LockMutex(&heap->mutex);
+    cache->next = heap->caches;
+    heap->caches = cache;
+    _i965UnlockMutex(&heap->mutex);
+
+    return cache;
+}
+#endif
+
 /*
  * Return 0 on success, -1 on error
  */
-int object_heap_init( object_heap_p heap, int object_size, int id_offset)
+int object_heap_init_with_increment( object_heap_p heap, int object_size, int id_offset, int heap_increment)
 {
     heap->object_size = object_size;
     heap->id_offset = id_offset & OBJECT_HEAP_OFFSET_MASK;
     heap->heap_size = 0;
-    heap->heap_increment = 16;
+    heap->heap_increment = heap_increment > 0 ? heap_increment : OBJECT_HEAP_DEFAULT_INCREMENT;
     heap->next_free = LAST_FREE;
     heap->num_buckets = 0;
     heap->bucket = NULL;
+    heap->retired = NULL;
 
     if (object_heap_expand(heap) == 0) {
         ASSERT(heap->heap_size);
         _i965InitMutex(&heap->mutex);
+
+#if defined PTHREADS
+        heap->caches = NULL;
+
+        if (pthread_key_create(&heap->cache_key, object_heap_cache_release)) {
+            _i965DestroyMutex(&heap->mutex);
+            free(heap->bucket[0]);
+            free(heap->bucket);
+            heap->bucket = NULL;
+            heap->heap_size = 0;
+
+            return -1;
+        }
+#endif
+
         return 0;
     } else {
         ASSERT(!heap->heap_size);
@@ -106,6 +263,14 @@ int object_heap_init( object_heap_p heap, int object_size, int id_offset)
     }
 }
 
+/*
+ * Return 0 on success, -1 on error
+ */
+int object_heap_init( object_heap_p heap, int object_size, int id_offset)
+{
+    return object_heap_init_with_increment(heap, object_size, id_offset, OBJECT_HEAP_DEFAULT_INCREMENT);
+}
+
 /*
  * Allocates an object
  * Returns the object ID on success, returns -1 on error
@@ -113,27 +278,41 @@ int object_heap_init( object_heap_p heap, int object_size, int id_offset)
 int object_heap_allocate( object_heap_p heap )
 {
     object_base_p obj;
-    int bucket_index, obj_index;
+    int index = -1;
 
-    _i965LockMutex(&heap->mutex);
-    if ( LAST_FREE == heap->next_free )
-    {
-        if( -1 == object_heap_expand( heap ) )
-        {
+#if defined PTHREADS
+    struct object_heap_cache *cache = object_heap_get_cache(heap);
+
+    if (cache) {
+        if (cache->count == 0) {
+            /* Refill half of the cache in one go */
+            _i965LockMutex(&heap->mutex);
+            while (cache->count < OBJECT_HEAP_CACHE_SIZE / 2) {
+                index = object_heap_pop_free(heap);
+
+                if (index < 0)
+                    break;
+
+                cache->free[cache->count++] = index;
+            }
             _i965UnlockMutex(&heap->mutex);
-            return -1; /* Out of memory */
         }
+
+        index = cache->count > 0 ? cache->free[--cache->count] : -1;
+    } else
+#endif
+    {
+        _i965LockMutex(&heap->mutex);
+        index = object_heap_pop_free(heap);
+        _i965UnlockMutex(&heap->mutex);
     }
-    ASSERT( heap->next_free >= 0 );
 
-    bucket_index = heap->next_free / heap->heap_increment;
-    obj_index = heap->next_free % heap->heap_increment;
+    if (index < 0)
+        return -1; /* Out of memory */
+
+    obj = object_heap_object(heap, atomic_load_acquire(&heap->bucket), index);
+    atomic_store_release(&obj->next_free, ALLOCATED);
 
-    obj = (object_base_p) (heap->bucket[bucket_index] + obj_index * heap->object_size);
-    heap->next_free = obj->next_free;
-    _i965UnlockMutex(&heap->mutex);
-    
-    obj->next_free = ALLOCATED;
     return obj->id;
 }
 
@@ -144,22 +323,19 @@ int object_heap_allocate( object_heap_p heap )
 object_base_p object_heap_lookup( object_heap_p heap, int id )
 {
     object_base_p obj;
-    int bucket_index, obj_index;
+    int index = id & OBJECT_HEAP_INDEX_MASK;
 
-    _i965LockMutex(&heap->mutex);
-    if ( (id < heap->id_offset) || (id > (heap->heap_size+heap->id_offset)) )
+    if ( (id & ~OBJECT_HEAP_ID_MASK) != heap->id_offset ||
+         index >= atomic_load_acquire(&heap->heap_size) )
     {
-        _i965UnlockMutex(&heap->mutex);
         return NULL;
     }
-    id &= OBJECT_HEAP_ID_MASK;
-    bucket_index = id / heap->heap_increment;
-    obj_index = id % heap->heap_increment;
-    obj = (object_base_p) (heap->bucket[bucket_index] + obj_index * heap->object_size);
-    _i965UnlockMutex(&heap->mutex);
 
-	/* Check if the object has in fact been allocated */
-	if ( obj->next_free != ALLOCATED )
+    obj = object_heap_object(heap, atomic_load_acquire(&heap->bucket), index);
+
+    /* Check if the object has in fact been allocated, and not recycled since */
+    if ( atomic_load_acquire(&obj->next_free) != ALLOCATED ||
+         atomic_load_acquire(&obj->id) != id )
     {
         return NULL;
     }
@@ -184,24 +360,19 @@ object_base_p object_heap_next( object_heap_p heap, object_heap_iterator *iter )
 {
     object_base_p obj;
     int i = *iter + 1;
-    int bucket_index, obj_index;
+    int heap_size = atomic_load_acquire(&heap->heap_size);
+    void **bucket = atomic_load_acquire(&heap->bucket);
 
-    _i965LockMutex(&heap->mutex);
-    while ( i < heap->heap_size)
+    while ( i < heap_size)
     {
-        bucket_index = i / heap->heap_increment;
-        obj_index = i % heap->heap_increment;
-
-        obj = (object_base_p) (heap->bucket[bucket_index] + obj_index * heap->object_size);
-        if (obj->next_free == ALLOCATED)
+        obj = object_heap_object(heap, bucket, i);
+        if (atomic_load_acquire(&obj->next_free) == ALLOCATED)
         {
-            _i965UnlockMutex(&heap->mutex);
             *iter = i;
             return obj;
         }
         i++;
     }
-    _i965UnlockMutex(&heap->mutex);
     *iter = i;
     return NULL;
 }
@@ -213,15 +384,42 @@ object_base_p object_heap_next( object_heap_p heap, object_heap_iterator *iter )
  */
 void object_heap_free( object_heap_p heap, object_base_p obj )
 {
+    int index, generation;
+#if defined PTHREADS
+    struct object_heap_cache *cache;
+#endif
+
     /* Don't complain about NULL pointers */
     if (NULL != obj)
     {
         /* Check if the object has in fact been allocated */
         ASSERT( obj->next_free == ALLOCATED );
-    
+
+        index = obj->id & OBJECT_HEAP_INDEX_MASK;
+        generation = (obj->id + OBJECT_HEAP_INDEX_MASK + 1) & OBJECT_HEAP_GEN_MASK;
+
+        atomic_store_release(&obj->next_free, CACHED);
+        atomic_store_release(&obj->id, heap->id_offset | generation | index);
+
+#if defined PTHREADS
+        cache = object_heap_get_cache(heap);
+
+        if (cache) {
+            if (cache->count == OBJECT_HEAP_CACHE_SIZE) {
+                /* Give half of the cache back to the other threads */
+                _i965LockMutex(&heap->mutex);
+                while (cache->count > OBJECT_HEAP_CACHE_SIZE / 2)
+                    object_heap_push_free(heap, cache->free[--cache->count]);
+                _i965UnlockMutex(&heap->mutex);
+            }
+
+            cache->free[cache->count++] = index;
+            return;
+        }
+#endif
+
         _i965LockMutex(&heap->mutex);
-        obj->next_free = heap->next_free;
-        heap->next_free = obj->id & OBJECT_HEAP_ID_MASK;
+        object_heap_push_free(heap, index);
         _i965UnlockMutex(&heap->mutex);
     }
 }
@@ -233,18 +431,26 @@ void object_heap_destroy( object_heap_p heap )
 {
     object_base_p obj;
     int i;
-    int bucket_index, obj_index;
 
     if (heap->heap_size) {
+#if defined PTHREADS
+        struct object_heap_cache *cache;
+
+        pthread_key_delete(heap->cache_key);
+
+        while ((cache = heap->caches) != NULL) {
+            heap->caches = cache->next;
+            free(cache);
+        }
+#endif
+
         _i965DestroyMutex(&heap->mutex);
 
         /* Check if heap is empty */
         for (i = 0; i < heap->heap_size; i++)
         {
             /* Check if object is not still allocated */
-            bucket_index = i / heap->heap_increment;
-            obj_index = i % heap->heap_increment;
-            obj = (object_base_p) (heap->bucket[bucket_index] + obj_index * heap->object_size);
+            obj = object_heap_object(heap, heap->bucket, i);
             ASSERT( obj->next_free != ALLOCATED );
         }
 
@@ -253,6 +459,14 @@ void object_heap_destroy( object_heap_p heap )
         }
 
         free(heap->bucket);
+
+        while (heap->retired) {
+            struct object_heap_retired *retired = heap->retired;
+
+            heap->retired = retired->next;
+            free(retired->bucket);
+            free(retired);
+        }
     }
 
     heap->bucket = NULL;
@@ -30,6 +30,21 @@
 #define OBJECT_HEAP_OFFSET_MASK		0x7F000000
 #define OBJECT_HEAP_ID_MASK			0x00FFFFFF
 
+/*
+ * The low bits of an object ID index the object in the heap, the remaining
+ * bits of OBJECT_HEAP_ID_MASK hold a generation counter that is bumped
+ * every time the object is freed, so a stale ID never resolves to an
+ * object that has been recycled.
+ */
+#define OBJECT_HEAP_INDEX_BITS          18
+#define OBJECT_HEAP_INDEX_MASK          ((1 << OBJECT_HEAP_INDEX_BITS) - 1)
+#define OBJECT_HEAP_GEN_MASK            (OBJECT_HEAP_ID_MASK & ~OBJECT_HEAP_INDEX_MASK)
+
+#define OBJECT_HEAP_DEFAULT_INCREMENT   16
+
+/* The number of free object indices cached per thread */
+#define OBJECT_HEAP_CACHE_SIZE          32
+
 typedef struct object_base *object_base_p;
 typedef struct object_heap *object_heap_p;
 
@@ -38,6 +53,9 @@ struct object_base {
     int next_free;
 };
 
+struct object_heap_cache;
+struct object_heap_retired;
+
 struct object_heap {
     int	object_size;
     int id_offset;
@@ -47,6 +65,12 @@ struct object_heap {
     _I965Mutex mutex;
     void **bucket;
     int num_buckets;
+    /* Superseded bucket arrays, kept alive for lock-free readers */
+    struct object_heap_retired *retired;
+#if defined PTHREADS
+    pthread_key_t cache_key;
+    struct object_heap_cache *caches;
+#endif
 };
 
 typedef int object_heap_iterator;
@@ -56,6 +80,13 @@ typedef int object_heap_iterator;
  */
 int object_heap_init( object_heap_p heap, int object_size, int id_offset);
 
+/*
+ * Same as object_heap_init() but the heap grows by heap_increment objects
+ * at a time.
+ * Return 0 on success, -1 on error
+ */
+int object_heap_init_with_increment( object_heap_p heap, int object_size, int id_offset, int heap_increment);
+
 /*
  * Allocates an object
  * Returns the object ID on success, returns -1 on error
@@ -63,7 +94,7 @@ int object_heap_init( object_heap_p heap, int object_size, int id_offset);
 int object_heap_allocate( object_heap_p heap );
 
 /*
- * Lookup an allocated object by object ID
+ * Lookup an allocated object by object ID, it never blocks
  * Returns a pointer to the object on success, returns NULL on error
  */
 object_base_p object_heap_lookup( object_heap_p heap, int id );
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the flushes of intel_batchbuffer.c against a mocked bufmgr and
+ * a fake batch->run. The GPU keeps a submitted batch BO busy for the next
+ * few flushes; once that is longer than the ring of recycled BOs, every
+ * flush allocates a new BO as the driver used to. The latency is the time
+ * intel_batchbuffer_flush() takes to return, ready for the next batch.
+ */
+
+#include "intel_batchbuffer.h"
+#include "mock_bufmgr.h"
+#include "test.h"
+
+#define BENCH_FLUSHES           20000
+#define BENCH_BATCH_DWORDS      2048    /* 8K of commands per batch */
+#define BENCH_ALLOC_NS          5000    /* GEM create, mmap and first faults */
+
+static unsigned int bench_gpu_ticks;
+static unsigned int bench_execs;
+
+static int
+bench_run(drm_intel_bo *bo, int used,
+          drm_clip_rect_t *cliprects, int num_cliprects,
+          int DR4, unsigned int ring_flag)
+{
+    mock_bo_set_busy(bo, bench_gpu_ticks);
+    bench_execs++;
+
+    return 0;
+}
+
+int
+main(void)
+{
+    static const struct intel_device_info device_info = { .gen = 7 };
+    struct intel_driver_data intel = { .device_info = &device_info };
+    unsigned int ticks;
+    int n, i;
+
+    mock_bufmgr.alloc_ns = BENCH_ALLOC_NS;
+
+    printf("gpu flushes  flush us  allocs/flush\n");
+
+    for (ticks = 0; ticks <= 2 * INTEL_BATCHBUFFER_RING_SIZE; ticks++) {
+        struct intel_batchbuffer *batch;
+        unsigned int num_allocs;
+        double flush_ns = 0.;
+
+        batch = intel_batchbuffer_new(&intel, I915_EXEC_BSD, 0);
+        batch->run = bench_run;
+        bench_gpu_ticks = ticks;
+        bench_execs = 0;
+        num_allocs = mock_bufmgr.num_allocs;
+
+        for (n = 0; n < BENCH_FLUSHES; n++) {
+            double start;
+
+            for (i = 0; i < BENCH_BATCH_DWORDS; i++)
+                intel_batchbuffer_emit_dword(batch, MI_NOOP);
+
+            start = test_now_ns();
+            intel_batchbuffer_flush(batch);
+            flush_ns += test_now_ns() - start;
+
+            mock_bufmgr.clock++;
+        }
+
+        printf("%10u  %8.2f  %12.2f\n",
+               ticks,
+               flush_ns / BENCH_FLUSHES / 1e3,
+               (double)(mock_bufmgr.num_allocs - num_allocs) / BENCH_FLUSHES);
+
+        intel_batchbuffer_free(batch);
+
+        if (bench_execs != BENCH_FLUSHES)
+            return EXIT_FAILURE;
+    }
+
+    return mock_bufmgr.num_bos ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the pattern searches of i965_bitstream_scan.c with the scalar,
+ * SSE2 and AVX2 kernels: looking for the next start code in a large
+ * slice, walking all the emulation prevention bytes of slices with few
+ * and many of them, and the same over many small slices. All kernels
+ * must find the same matches.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "i965_bitstream_scan.h"
+#include "test.h"
+
+/* Scanned per measurement */
+#define BENCH_BYTES             (1U << 28)
+#define BENCH_BUFFER_SIZE       (4 << 20)
+
+struct bench_case {
+    const char *name;
+    unsigned int zero_density;  /* 1 in zero_density bytes is 0 */
+    size_t slice_size;
+};
+
+static const char *kernel_names[] = { "c", "sse2", "avx2" };
+
+/*
+ * Escapes the data the way an encoder does, so that 00 00 0x with x <= 3
+ * only occurs as 00 00 03
+ */
+static void
+fill_bitstream(uint8_t *p, size_t size, unsigned int zero_density, unsigned int *seed)
+{
+    unsigned int zeros = 0;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        unsigned int r = rand_r(seed);
+        uint8_t byte = r % zero_density ? 1 + (r >> 8) % 255 : 0;
+
+        if (zeros >= 2 && byte <= 3) {
+            p[i] = 3;
+            zeros = 0;
+            continue;
+        }
+
+        p[i] = byte;
+        zeros = byte ? 0 : zeros + 1;
+    }
+}
+
+/* Returns a checksum of the matches, the same with every kernel */
+static unsigned long
+bench_scan(const uint8_t *buf, size_t size, size_t slice_size)
+{
+    unsigned long sum = 0;
+    size_t slice;
+
+    for (slice = 0; slice < size; slice += slice_size) {
+        const uint8_t *p = buf + slice;
+        size_t n = size - slice < slice_size ? size - slice : slice_size;
+        size_t pos = 0;
+
+        sum += i965_bitstream_find_start_code(p, n);
+
+        while ((pos += i965_bitstream_find_epb(p + pos, n - pos)) < n) {
+            sum += pos;
+            pos += 3;
+        }
+    }
+
+    return sum;
+}
+
+int
+main(void)
+{
+    static const struct bench_case cases[] = {
+        { "4MB slice, few EPBs", 256, BENCH_BUFFER_SIZE },
+        { "4MB slice, many EPBs", 4, BENCH_BUFFER_SIZE },
+        { "1KB slices, few EPBs", 256, 1024 },
+        { "1KB slices, many EPBs", 4, 1024 },
+        { "64B slices", 256, 64 },
+    };
+    uint8_t *buf = malloc(BENCH_BUFFER_SIZE);
+    unsigned int iterations = BENCH_BYTES / BENCH_BUFFER_SIZE;
+    unsigned int c, k, n;
+
+    printf("case                   kernel  GB/s\n");
+
+    for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        unsigned long reference = 0;
+        unsigned int seed = 1;
+
+        fill_bitstream(buf, BENCH_BUFFER_SIZE, cases[c].zero_density, &seed);
+
+        for (k = I965_BITSTREAM_SCAN_C; k <= I965_BITSTREAM_SCAN_AVX2; k++) {
+            unsigned long sum = 0;
+            double start;
+
+            if (!i965_bitstream_scan_set_kernel(k))
+                continue;
+
+            start = test_now_ns();
+
+            for (n = 0; n < iterations; n++)
+                sum = bench_scan(buf, BENCH_BUFFER_SIZE, cases[c].slice_size);
+
+            if (k == I965_BITSTREAM_SCAN_C)
+                reference = sum;
+
+            CHECK(sum == reference);
+
+            printf("%-21s  %-6s  %5.2f\n", cases[c].name, kernel_names[k],
+                   (double)iterations * BENCH_BUFFER_SIZE / (test_now_ns() - start));
+        }
+    }
+
+    free(buf);
+
+    return test_result("bench_bitstream_scan");
+}
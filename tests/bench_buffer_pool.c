@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the buffer pool of i965_buffer_pool.c on the buffers a decoder
+ * creates and destroys for each picture, against a mocked bufmgr whose
+ * allocations cost as much as the GEM ioctls. The GPU reads the slice data
+ * of a picture during the two pictures that follow. A pool of size 0 is
+ * the allocator the driver used to call for every buffer.
+ */
+
+#include "i965_drv_video.h"
+#include "i965_buffer_pool.h"
+#include "mock_bufmgr.h"
+#include "test.h"
+
+#define BENCH_PICTURES          5000
+#define BENCH_SLICES            8
+#define BENCH_ALLOC_NS          3000    /* GEM create and mmap */
+#define BENCH_GPU_TICKS         2       /* pictures the slice data stays busy */
+
+uint32_t g_intel_debug_option_flags;
+
+static void
+bench_release(struct buffer_store *buffer_store)
+{
+    buffer_store->ref_count = 0;
+    i965_buffer_pool_release_store(buffer_store);
+}
+
+static void
+bench_picture(struct i965_buffer_pool *pool, unsigned int *seed)
+{
+    struct buffer_store *pic_param, *iq_matrix;
+    struct buffer_store *slice_params[BENCH_SLICES], *slice_datas[BENCH_SLICES];
+    int i;
+
+    pic_param = i965_buffer_pool_create_store(pool, I965_BUFFER_POOL_CPU, 1024);
+    iq_matrix = i965_buffer_pool_create_store(pool, I965_BUFFER_POOL_CPU, 1024);
+
+    for (i = 0; i < BENCH_SLICES; i++) {
+        slice_params[i] = i965_buffer_pool_create_store(pool, I965_BUFFER_POOL_CPU, 1600);
+        /* from 16K to 256K of slice data */
+        slice_datas[i] = i965_buffer_pool_create_store(pool,
+                                                       I965_BUFFER_POOL_SLICE_DATA,
+                                                       16384 + rand_r(seed) % 245760);
+    }
+
+    for (i = 0; i < BENCH_SLICES; i++) {
+        mock_bo_set_busy(slice_datas[i]->bo, BENCH_GPU_TICKS);
+        bench_release(slice_params[i]);
+        bench_release(slice_datas[i]);
+    }
+
+    bench_release(pic_param);
+    bench_release(iq_matrix);
+    mock_bufmgr.clock++;
+}
+
+int
+main(void)
+{
+    static const size_t pool_sizes[] = { 0, 4 << 20, I965_BUFFER_POOL_DEFAULT_SIZE << 20 };
+    int s, n;
+
+    mock_bufmgr.alloc_ns = BENCH_ALLOC_NS;
+
+    printf("pool MB  us/picture  store hit/miss  buffer hit/miss    bo hit/miss  bo allocs\n");
+
+    for (s = 0; s < sizeof(pool_sizes) / sizeof(pool_sizes[0]); s++) {
+        struct i965_buffer_pool pool;
+        unsigned int seed = 1, num_allocs = mock_bufmgr.num_allocs;
+        double start, elapsed;
+
+        i965_buffer_pool_init(&pool, NULL, pool_sizes[s]);
+        start = test_now_ns();
+
+        for (n = 0; n < BENCH_PICTURES; n++)
+            bench_picture(&pool, &seed);
+
+        elapsed = test_now_ns() - start;
+
+        printf("%7zu  %10.2f  %7u/%-6u  %8u/%-6u  %7u/%-6u  %9u\n",
+               pool_sizes[s] >> 20,
+               elapsed / BENCH_PICTURES / 1e3,
+               pool.store_stats.hits, pool.store_stats.misses,
+               pool.buffer_stats.hits, pool.buffer_stats.misses,
+               pool.bo_stats.hits, pool.bo_stats.misses,
+               mock_bufmgr.num_allocs - num_allocs);
+
+        i965_buffer_pool_terminate(&pool);
+    }
+
+    /* everything went back to the bufmgr */
+    return mock_bufmgr.num_bos ? EXIT_FAILURE : EXIT_SUCCESS;
+}
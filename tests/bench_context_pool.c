@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the post processing context pool from 1 to 8 threads with
+ * mocked conversions: each one builds its batch on the CPU and then
+ * blocks on the GPU while holding its context, as a conversion that
+ * waits for a busy ring or for its result does. A pool of one context
+ * is the single global context the driver used to have.
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include "i965_context_pool.h"
+#include "test.h"
+
+#define BENCH_CONVERSIONS       2000
+#define BENCH_BUILD_NS          20000   /* CPU time to build a batch */
+#define BENCH_EXEC_NS           200000  /* time blocked on the GPU */
+
+struct bench_context
+{
+    unsigned long batches;
+};
+
+static struct i965_context_pool pool;
+
+static void *
+bench_create(void *data)
+{
+    return calloc(1, sizeof(struct bench_context));
+}
+
+static void
+bench_spin(double ns)
+{
+    double end = test_now_ns() + ns;
+
+    while (test_now_ns() < end)
+        ;
+}
+
+/* The mocked conversion: batch building, then execution on the GPU */
+static void
+bench_exec(struct bench_context *context)
+{
+    struct timespec exec = { 0, BENCH_EXEC_NS };
+
+    bench_spin(BENCH_BUILD_NS);
+    context->batches++;
+    nanosleep(&exec, NULL);
+}
+
+static void *
+bench_thread(void *arg)
+{
+    double *wait_ns = arg;
+    int n;
+
+    for (n = 0; n < BENCH_CONVERSIONS; n++) {
+        double start = test_now_ns();
+        struct bench_context *context = i965_context_pool_get(&pool, bench_create, NULL);
+
+        *wait_ns += test_now_ns() - start;
+        bench_exec(context);
+        i965_context_pool_put(&pool, context);
+    }
+
+    return NULL;
+}
+
+int
+main(void)
+{
+    static const int pool_sizes[] = { 1, 2, 4, 8 };
+    pthread_t threads[8];
+    double wait_ns[8];
+    int num_threads, s, i;
+
+    printf("contexts  threads  conversions/s  wait us/conversion\n");
+
+    for (s = 0; s < sizeof(pool_sizes) / sizeof(pool_sizes[0]); s++) {
+        for (num_threads = 1; num_threads <= 8; num_threads *= 2) {
+            double start, elapsed, wait = 0.;
+
+            i965_context_pool_init(&pool, pool_sizes[s]);
+            start = test_now_ns();
+
+            for (i = 0; i < num_threads; i++) {
+                wait_ns[i] = 0.;
+                pthread_create(&threads[i], NULL, bench_thread, &wait_ns[i]);
+            }
+
+            for (i = 0; i < num_threads; i++) {
+                pthread_join(threads[i], NULL);
+                wait += wait_ns[i];
+            }
+
+            elapsed = test_now_ns() - start;
+
+            for (i = 0; i < I965_CONTEXT_POOL_MAX_CONTEXTS; i++)
+                free(pool.contexts[i]);
+
+            i965_context_pool_terminate(&pool);
+
+            printf("%8d  %7d  %13.0f  %18.1f\n",
+                   pool_sizes[s], num_threads,
+                   (double)BENCH_CONVERSIONS * num_threads / elapsed * 1e9,
+                   wait / BENCH_CONVERSIONS / num_threads / 1e3);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the banded picture copies of the copy worker pool, as done by
+ * vaGetImage()/vaPutImage() on NV12 surfaces from 1080p to 8K and on
+ * planes around I965_WORKER_POOL_MIN_BYTES, below which the copies stay
+ * on the calling thread. Each copy runs with the pool disabled and with
+ * 1 to 7 helper threads, floating or pinned as with VA_INTEL_COPY_CPUS.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "i965_worker_pool.h"
+#include "test.h"
+
+/* Copied per measurement, so that the small pictures run long enough */
+#define BENCH_BYTES             (1U << 30)
+
+struct bench_picture {
+    const char *name;
+    unsigned int width;
+    unsigned int height;
+    int nv12;
+};
+
+struct bench_pool {
+    int num_threads;
+    int pinned;
+};
+
+static unsigned int
+bench_picture_size(const struct bench_picture *picture)
+{
+    unsigned int size = picture->width * picture->height;
+
+    return picture->nv12 ? size * 3 / 2 : size;
+}
+
+static double
+bench_copy(struct i965_worker_pool *pool, const struct bench_picture *picture,
+           uint8_t *dst, const uint8_t *src)
+{
+    unsigned int y_size = picture->width * picture->height;
+    unsigned int iterations = BENCH_BYTES / bench_picture_size(picture) + 1;
+    unsigned int n;
+    double start = test_now_ns();
+
+    for (n = 0; n < iterations; n++) {
+        i965_worker_pool_memcpy_pic(pool, dst, picture->width,
+                                    src, picture->width,
+                                    picture->width, picture->height);
+
+        if (picture->nv12)
+            i965_worker_pool_memcpy_pic(pool, dst + y_size, picture->width,
+                                        src + y_size, picture->width,
+                                        picture->width, picture->height / 2);
+    }
+
+    return (double)iterations * bench_picture_size(picture) / (test_now_ns() - start);
+}
+
+int
+main(void)
+{
+    static const struct bench_picture pictures[] = {
+        { "plane 1M", 1024, I965_WORKER_POOL_MIN_BYTES / 2048, 0 },
+        { "plane 2M-", 1024, I965_WORKER_POOL_MIN_BYTES / 1024 - 1, 0 },
+        { "plane 2M", 1024, I965_WORKER_POOL_MIN_BYTES / 1024, 0 },
+        { "plane 4M", 1024, I965_WORKER_POOL_MIN_BYTES / 512, 0 },
+        { "1080p", 1920, 1088, 1 },
+        { "4K", 3840, 2160, 1 },
+        { "8K", 7680, 4320, 1 },
+    };
+    static const struct bench_pool pools[] = {
+        { 0, 0 },
+        { 1, 0 },
+        { 3, 0 },
+        { 7, 0 },
+        { 3, 1 },
+        { 7, 1 },
+    };
+    char cpus[32];
+    unsigned int i, p;
+
+    snprintf(cpus, sizeof(cpus), "0-%ld", sysconf(_SC_NPROCESSORS_ONLN) - 1);
+
+    printf("picture    threads  pinned  GB/s\n");
+
+    for (i = 0; i < sizeof(pictures) / sizeof(pictures[0]); i++) {
+        unsigned int size = bench_picture_size(&pictures[i]);
+        uint8_t *src = malloc(size);
+        uint8_t *dst = malloc(size);
+        unsigned int seed = 1, j;
+
+        for (j = 0; j < size; j++)
+            src[j] = rand_r(&seed);
+
+        for (p = 0; p < sizeof(pools) / sizeof(pools[0]); p++) {
+            struct i965_worker_pool pool;
+            double rate;
+
+            i965_worker_pool_init(&pool, pools[p].num_threads,
+                                  pools[p].pinned ? cpus : NULL);
+
+            memset(dst, 0, size);
+            rate = bench_copy(&pool, &pictures[i], dst, src);
+            CHECK(memcmp(dst, src, size) == 0);
+
+            i965_worker_pool_terminate(&pool);
+
+            printf("%-9s  %7d  %-6s  %5.2f\n",
+                   pictures[i].name, pools[p].num_threads,
+                   pools[p].pinned ? cpus : "no", rate);
+        }
+
+        free(src);
+        free(dst);
+    }
+
+    return test_result("bench_memcpy_pic");
+}
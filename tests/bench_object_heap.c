@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures object_heap lookups and allocate/free pairs from 1 to 32
+ * threads, with the mix of a transcoder: several lookups per object
+ * allocated.
+ */
+
+#include <pthread.h>
+
+#include "object_heap.h"
+#include "test.h"
+
+#define BENCH_ID_OFFSET         0x04000000
+#define BENCH_OPS               2000000
+#define BENCH_OBJECTS           64
+#define BENCH_LOOKUPS_PER_ALLOC 16
+
+struct bench_object {
+    struct object_base base;
+    int value;
+};
+
+static struct object_heap heap;
+
+static void *
+bench_thread(void *arg)
+{
+    int ids[BENCH_OBJECTS];
+    unsigned int seed = (unsigned int)(long)arg;
+    long sum = 0;
+    int i, n;
+
+    for (i = 0; i < BENCH_OBJECTS; i++)
+        ids[i] = object_heap_allocate(&heap);
+
+    for (n = 0; n < BENCH_OPS; n++) {
+        i = rand_r(&seed) % BENCH_OBJECTS;
+
+        if (n % BENCH_LOOKUPS_PER_ALLOC) {
+            sum += ((struct bench_object *)object_heap_lookup(&heap, ids[i]))->value;
+        } else {
+            object_heap_free(&heap, object_heap_lookup(&heap, ids[i]));
+            ids[i] = object_heap_allocate(&heap);
+        }
+    }
+
+    for (i = 0; i < BENCH_OBJECTS; i++)
+        object_heap_free(&heap, object_heap_lookup(&heap, ids[i]));
+
+    return (void *)sum;
+}
+
+int
+main(void)
+{
+    pthread_t threads[32];
+    int num_threads, i;
+
+    printf("threads  Mops/s  ns/op/thread\n");
+
+    for (num_threads = 1; num_threads <= 32; num_threads *= 2) {
+        double start, elapsed;
+
+        if (object_heap_init(&heap, sizeof(struct bench_object), BENCH_ID_OFFSET))
+            return EXIT_FAILURE;
+
+        start = test_now_ns();
+
+        for (i = 0; i < num_threads; i++)
+            pthread_create(&threads[i], NULL, bench_thread, (void *)(long)(i + 1));
+
+        for (i = 0; i < num_threads; i++)
+            pthread_join(threads[i], NULL);
+
+        elapsed = test_now_ns() - start;
+        object_heap_destroy(&heap);
+
+        printf("%7d  %6.1f  %12.1f\n",
+               num_threads,
+               (double)BENCH_OPS * num_threads / elapsed * 1e3,
+               elapsed / BENCH_OPS);
+    }
+
+    return EXIT_SUCCESS;
+}
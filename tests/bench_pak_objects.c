@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the generation of the gen8 software AVC PAK objects from
+ * synthetic VME output at 1080p, 4K and 8K, for I and P frames in 1 and
+ * 8 slices with the row and MB QP offsets applied, on the calling thread
+ * only and in MB bands on 3 and 7 helper threads. The banded PAK objects
+ * must be byte-identical to the single-threaded ones.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "i965_defines.h"
+#include "gen6_vme.h"
+#include "gen8_mfc_pak.h"
+#include "test.h"
+
+/* MBs generated per measurement */
+#define BENCH_MBS               (1 << 23)
+
+struct bench_frame {
+    const char *name;
+    int width_in_mbs;
+    int height_in_mbs;
+};
+
+static double
+bench_pak_objects(struct i965_worker_pool *pool, struct gen8_mfc_avc_pak_job *job,
+                  unsigned int *commands, int num_mbs)
+{
+    int iterations = BENCH_MBS / num_mbs + 1;
+    double start;
+    int n;
+
+    memset(commands, 0, num_mbs * PAK_OBJECT_IN_DWS * 4);
+    start = test_now_ns();
+
+    for (n = 0; n < iterations; n++)
+        gen8_mfc_avc_pak_objects(pool, job, num_mbs);
+
+    return (double)iterations * num_mbs / (test_now_ns() - start) * 1e3;
+}
+
+int
+main(void)
+{
+    static const struct bench_frame frames[] = {
+        { "1080p", 120, 68 },
+        { "4K", 240, 135 },
+        { "8K", 480, 270 },
+    };
+    static const int slice_types[] = { SLICE_TYPE_I, SLICE_TYPE_P };
+    static const int num_slices[] = { 1, 8 };
+    static const int num_threads[] = { 0, 3, 7 };
+    unsigned int f, t, s, p, i;
+
+    printf("frame  slice  slices  threads  Mmb/s\n");
+
+    for (f = 0; f < sizeof(frames) / sizeof(frames[0]); f++) {
+        int num_mbs = frames[f].width_in_mbs * frames[f].height_in_mbs;
+        unsigned int *commands = malloc(num_mbs * PAK_OBJECT_IN_DWS * 4);
+        unsigned int *reference = malloc(num_mbs * PAK_OBJECT_IN_DWS * 4);
+        signed char *row_qp_delta = malloc(frames[f].height_in_mbs);
+        signed char *mb_qp_delta = malloc(num_mbs);
+        unsigned int seed = 1;
+
+        for (i = 0; i < (unsigned int)frames[f].height_in_mbs; i++)
+            row_qp_delta[i] = rand_r(&seed) % 7 - 3;
+
+        for (i = 0; i < (unsigned int)num_mbs; i++)
+            mb_qp_delta[i] = rand_r(&seed) % 13 - 6;
+
+        for (t = 0; t < sizeof(slice_types) / sizeof(slice_types[0]); t++) {
+            struct gen8_mfc_avc_pak_job job;
+            unsigned int msg_size = slice_types[t] == SLICE_TYPE_I ?
+                INTRA_VME_OUTPUT_IN_BYTES * 2 : INTRA_VME_OUTPUT_IN_BYTES * 24;
+            unsigned char *msg = malloc(num_mbs * msg_size);
+
+            /* random modes, MVs and RDO costs, so intra and inter MBs mix */
+            for (i = 0; i < num_mbs * msg_size; i++)
+                msg[i] = rand_r(&seed);
+
+            job.msg_ptr = msg;
+            job.msg_size = msg_size;
+            job.ref_index_in_mb[0] = 0x01000100;
+            job.ref_index_in_mb[1] = 0x02000200;
+            job.row_qp_delta = row_qp_delta;
+            job.mb_qp_delta = mb_qp_delta;
+            job.width_in_mbs = frames[f].width_in_mbs;
+
+            for (s = 0; s < sizeof(num_slices) / sizeof(num_slices[0]); s++) {
+                int slice_mbs = (num_mbs + num_slices[s] - 1) / num_slices[s];
+
+                job.num_slices = num_slices[s];
+                job.slices = calloc(num_slices[s], sizeof(*job.slices));
+
+                for (i = 0; i < (unsigned int)num_slices[s]; i++) {
+                    job.slices[i].first_mb = i * slice_mbs;
+                    job.slices[i].num_mbs = i == num_slices[s] - 1 ?
+                        num_mbs - i * slice_mbs : slice_mbs;
+                    job.slices[i].command = commands + job.slices[i].first_mb * PAK_OBJECT_IN_DWS;
+                    job.slices[i].qp = 26 + i;
+                    job.slices[i].slice_type = slice_types[t];
+                }
+
+                for (p = 0; p < sizeof(num_threads) / sizeof(num_threads[0]); p++) {
+                    struct i965_worker_pool pool;
+                    double rate;
+
+                    i965_worker_pool_init(&pool, num_threads[p], NULL);
+                    rate = bench_pak_objects(&pool, &job, commands, num_mbs);
+                    i965_worker_pool_terminate(&pool);
+
+                    /* the first run, on the calling thread, is the reference */
+                    if (!num_threads[p])
+                        memcpy(reference, commands, num_mbs * PAK_OBJECT_IN_DWS * 4);
+
+                    CHECK(memcmp(commands, reference, num_mbs * PAK_OBJECT_IN_DWS * 4) == 0);
+
+                    printf("%-5s  %-5s  %6d  %7d  %5.1f\n",
+                           frames[f].name, slice_types[t] == SLICE_TYPE_I ? "I" : "P",
+                           num_slices[s], num_threads[p], rate);
+                }
+
+                free(job.slices);
+            }
+
+            free(msg);
+        }
+
+        free(commands);
+        free(reference);
+        free(row_qp_delta);
+        free(mb_qp_delta);
+    }
+
+    return test_result("bench_pak_objects");
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the CPU (de)tiling of i965_tiling.c on whole NV12 surfaces
+ * from 1080p to 8K, with the scalar kernels and each set of SIMD kernels
+ * the CPU supports, and checks they all give the scalar results.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <i915_drm.h>
+
+#include "i965_tiling.h"
+#include "test.h"
+
+/* Copied per measurement, so that the small surfaces run long enough */
+#define BENCH_BYTES             (1U << 30)
+
+#define ALIGN(i, n)             (((i) + (n) - 1) & ~((n) - 1))
+
+struct bench_surface {
+    const char *name;
+    unsigned int width;
+    unsigned int height;
+};
+
+static const char *kernel_names[] = { "c", "sse4.1", "avx2" };
+
+static double
+bench_copy(uint8_t *tiled, unsigned int tiled_pitch,
+           uint8_t *linear, unsigned int width, unsigned int height,
+           uint32_t tiling, int detile)
+{
+    unsigned int iterations = BENCH_BYTES / (width * height) + 1;
+    unsigned int n;
+    double start = test_now_ns();
+
+    for (n = 0; n < iterations; n++) {
+        if (detile)
+            i965_tiled_to_linear(linear, width, tiled, tiled_pitch,
+                                 tiling, I915_BIT_6_SWIZZLE_NONE,
+                                 0, 0, width, height);
+        else
+            i965_linear_to_tiled(tiled, tiled_pitch,
+                                 tiling, I915_BIT_6_SWIZZLE_NONE, 0, 0,
+                                 linear, width, width, height);
+    }
+
+    return (double)iterations * width * height / (test_now_ns() - start);
+}
+
+int
+main(void)
+{
+    static const struct bench_surface surfaces[] = {
+        { "1080p", 1920, 1088 },
+        { "4K", 3840, 2160 },
+        { "8K", 7680, 4320 },
+    };
+    static const uint32_t tilings[] = { I915_TILING_X, I915_TILING_Y };
+    unsigned int i, t, k;
+
+    printf("surface  tiling  kernels  detile GB/s  tile GB/s\n");
+
+    for (i = 0; i < sizeof(surfaces) / sizeof(surfaces[0]); i++) {
+        /* NV12: the UV plane is half the rows of the Y plane */
+        unsigned int width = surfaces[i].width;
+        unsigned int height = surfaces[i].height * 3 / 2;
+        unsigned int tiled_pitch = ALIGN(width, 512);
+        unsigned int tiled_size = tiled_pitch * ALIGN(height, 32);
+        uint8_t *tiled = aligned_alloc(4096, tiled_size);
+        uint8_t *linear = malloc(width * height);
+        uint8_t *reference = malloc(width * height);
+        unsigned int seed = 1, j;
+
+        for (j = 0; j < tiled_size; j++)
+            tiled[j] = rand_r(&seed);
+
+        for (t = 0; t < sizeof(tilings) / sizeof(tilings[0]); t++) {
+            i965_tiling_set_kernels(I965_TILING_KERNELS_C);
+            i965_tiled_to_linear(reference, width, tiled, tiled_pitch,
+                                 tilings[t], I915_BIT_6_SWIZZLE_NONE,
+                                 0, 0, width, height);
+
+            for (k = I965_TILING_KERNELS_C; k <= I965_TILING_KERNELS_AVX2; k++) {
+                double detile, tile;
+
+                if (!i965_tiling_set_kernels(k))
+                    continue;
+
+                detile = bench_copy(tiled, tiled_pitch, linear, width, height,
+                                    tilings[t], 1);
+                CHECK(memcmp(linear, reference, width * height) == 0);
+
+                /* tiling the reference back must give the same surface */
+                tile = bench_copy(tiled, tiled_pitch, reference, width, height,
+                                  tilings[t], 0);
+                i965_tiled_to_linear(linear, width, tiled, tiled_pitch,
+                                     tilings[t], I915_BIT_6_SWIZZLE_NONE,
+                                     0, 0, width, height);
+                CHECK(memcmp(linear, reference, width * height) == 0);
+
+                printf("%-7s  %-6s  %-7s  %11.2f  %9.2f\n",
+                       surfaces[i].name, tilings[t] == I915_TILING_X ? "X" : "Y",
+                       kernel_names[k], detile, tile);
+            }
+        }
+
+        free(tiled);
+        free(linear);
+        free(reference);
+    }
+
+    return test_result("bench_tiling");
+}
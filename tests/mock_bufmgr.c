@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mock_bufmgr.h"
+#include "test.h"
+
+struct mock_bufmgr mock_bufmgr;
+
+static void
+mock_bufmgr_spin(double ns)
+{
+    double end;
+
+    if (ns <= 0.)
+        return;
+
+    end = test_now_ns() + ns;
+
+    while (test_now_ns() < end)
+        ;
+}
+
+drm_intel_bo *
+drm_intel_bo_alloc(drm_intel_bufmgr *bufmgr, const char *name,
+                   unsigned long size, unsigned int alignment)
+{
+    struct mock_bo *bo = calloc(1, sizeof(*bo));
+
+    if (!bo)
+        return NULL;
+
+    bo->base.size = size;
+    bo->base.align = alignment;
+    bo->base.bufmgr = bufmgr;
+    bo->base.virtual = calloc(1, size);
+
+    if (!bo->base.virtual) {
+        free(bo);
+        return NULL;
+    }
+
+    bo->ref_count = 1;
+    mock_bufmgr_spin(mock_bufmgr.alloc_ns);
+    mock_bufmgr.num_allocs++;
+    mock_bufmgr.num_bos++;
+
+    return &bo->base;
+}
+
+drm_intel_bo *
+drm_intel_bo_alloc_userptr(drm_intel_bufmgr *bufmgr, const char *name,
+                           void *addr, uint32_t tiling_mode, uint32_t stride,
+                           unsigned long size, unsigned long flags)
+{
+    struct mock_bo *bo;
+
+    /* the kernel takes whole pages only */
+    if (mock_bufmgr.refuse_userptr || ((uintptr_t)addr & 4095) || (size & 4095))
+        return NULL;
+
+    bo = calloc(1, sizeof(*bo));
+
+    if (!bo)
+        return NULL;
+
+    bo->base.size = size;
+    bo->base.bufmgr = bufmgr;
+    bo->base.virtual = addr;
+    bo->userptr = addr;
+    bo->ref_count = 1;
+    mock_bufmgr_spin(mock_bufmgr.alloc_ns);
+    mock_bufmgr.num_userptrs++;
+    mock_bufmgr.num_bos++;
+
+    return &bo->base;
+}
+
+void
+drm_intel_bo_reference(drm_intel_bo *bo)
+{
+    mock_bo(bo)->ref_count++;
+}
+
+void
+drm_intel_bo_unreference(drm_intel_bo *bo)
+{
+    if (!bo || --mock_bo(bo)->ref_count > 0)
+        return;
+
+    if (!mock_bo(bo)->userptr)
+        free(bo->virtual);
+
+    free(bo);
+    mock_bufmgr.num_frees++;
+    mock_bufmgr.num_bos--;
+}
+
+int
+drm_intel_bo_map(drm_intel_bo *bo, int write_enable)
+{
+    return 0;
+}
+
+int
+drm_intel_bo_unmap(drm_intel_bo *bo)
+{
+    return 0;
+}
+
+int
+drm_intel_bo_subdata(drm_intel_bo *bo, unsigned long offset,
+                     unsigned long size, const void *data)
+{
+    memcpy((unsigned char *)bo->virtual + offset, data, size);
+
+    return 0;
+}
+
+int
+drm_intel_bo_busy(drm_intel_bo *bo)
+{
+    return mock_bo(bo)->busy_until > mock_bufmgr.clock;
+}
+
+void
+drm_intel_bo_wait_rendering(drm_intel_bo *bo)
+{
+    if (mock_bufmgr.clock < mock_bo(bo)->busy_until)
+        mock_bufmgr.clock = mock_bo(bo)->busy_until;
+}
+
+int
+drm_intel_bo_emit_reloc(drm_intel_bo *bo, uint32_t offset,
+                        drm_intel_bo *target_bo, uint32_t target_offset,
+                        uint32_t read_domains, uint32_t write_domain)
+{
+    return 0;
+}
+
+void
+drm_intel_gem_bo_clear_relocs(drm_intel_bo *bo, int start)
+{
+}
+
+int
+drm_intel_bo_mrb_exec(drm_intel_bo *bo, int used,
+                      struct drm_clip_rect *cliprects, int num_cliprects,
+                      int DR4, unsigned int flags)
+{
+    mock_bo_set_busy(bo, 1);
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * A CPU-only stand-in for the libdrm_intel buffer manager, linked into the
+ * tests instead of libdrm_intel. BOs are plain malloc'ed memory and the GPU
+ * is a clock: a BO is busy until the clock reaches the tick it was made
+ * busy to, by a mocked exec or by the test itself.
+ */
+
+#ifndef MOCK_BUFMGR_H
+#define MOCK_BUFMGR_H
+
+#include <intel_bufmgr.h>
+
+struct mock_bo
+{
+    drm_intel_bo base;
+    int ref_count;
+    unsigned int busy_until;    /* mock_bufmgr.clock tick the GPU is done with it */
+    void *userptr;              /* the wrapped user memory, NULL if allocated */
+};
+
+struct mock_bufmgr
+{
+    unsigned int clock;         /* advanced by the test */
+    double alloc_ns;            /* CPU time of each allocation, the GEM ioctls */
+    int refuse_userptr;         /* drm_intel_bo_alloc_userptr() fails */
+
+    unsigned int num_allocs;
+    unsigned int num_userptrs;
+    unsigned int num_frees;
+    int num_bos;                /* alive */
+};
+
+extern struct mock_bufmgr mock_bufmgr;
+
+static inline struct mock_bo *
+mock_bo(drm_intel_bo *bo)
+{
+    return (struct mock_bo *)bo;
+}
+
+/* The GPU uses bo for the next ticks */
+static inline void
+mock_bo_set_busy(drm_intel_bo *bo, unsigned int ticks)
+{
+    mock_bo(bo)->busy_until = mock_bufmgr.clock + ticks;
+}
+
+#endif /* MOCK_BUFMGR_H */
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <xf86drm.h>
+#include <i915_drm.h>
+
+#include "mock_drm.h"
+#include "intel_memman.h"
+
+struct mock_drm mock_drm = {
+    .device_info = { .gen = 8, .gt = 2 },
+};
+
+int
+drmCommandWriteRead(int fd, unsigned long drmCommandIndex, void *data, unsigned long size)
+{
+    struct drm_i915_getparam *gp = data;
+
+    if (drmCommandIndex != DRM_I915_GETPARAM ||
+        gp->param < 0 || gp->param >= MOCK_DRM_MAX_PARAMS ||
+        !mock_drm.params[gp->param])
+        return -EINVAL;
+
+    *gp->value = mock_drm.params[gp->param];
+
+    return 0;
+}
+
+const struct intel_device_info *
+i965_get_device_info(int devid)
+{
+    return &mock_drm.device_info;
+}
+
+/* The tests set up intel->bufmgr themselves, the mocked one needs none */
+Bool
+intel_memman_init(struct intel_driver_data *intel)
+{
+    return True;
+}
+
+Bool
+intel_memman_terminate(struct intel_driver_data *intel)
+{
+    return True;
+}
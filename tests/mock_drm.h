@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * A CPU-only stand-in for the DRM ioctls intel_driver_init() makes and
+ * for the parts of the driver it calls into, so that intel_driver.c can
+ * be linked into the tests with the mocked bufmgr.
+ */
+
+#ifndef MOCK_DRM_H
+#define MOCK_DRM_H
+
+#include "intel_driver.h"
+
+#define MOCK_DRM_MAX_PARAMS     64
+
+struct mock_drm
+{
+    int params[MOCK_DRM_MAX_PARAMS];    /* I915_GETPARAM values, 0 if unknown to the kernel */
+    struct intel_device_info device_info;
+};
+
+extern struct mock_drm mock_drm;
+
+#endif /* MOCK_DRM_H */
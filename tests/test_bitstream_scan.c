@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the pattern searches of i965_bitstream_scan.c, with each kernel
+ * the CPU supports, against a byte by byte search. The buffers
+ * end right before an unmapped page so that reads past the end fault.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "i965_bitstream_scan.h"
+#include "test.h"
+
+#define TEST_MAX_SIZE   4096
+
+static size_t
+reference_find(const uint8_t *buf, size_t size,
+               const uint8_t *pattern, size_t pattern_size)
+{
+    size_t i;
+
+    for (i = 0; i + pattern_size <= size; i++)
+        if (!memcmp(buf + i, pattern, pattern_size))
+            return i;
+
+    return size;
+}
+
+/* Mostly zeros, so that all the patterns occur at random places */
+static void
+fill_sparse(uint8_t *p, size_t size, unsigned int density, unsigned int *seed)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        unsigned int r = rand_r(seed);
+
+        p[i] = r % density ? 0 : (r >> 8) % 5;
+    }
+}
+
+static void
+test_buffer(const uint8_t *buf, size_t size)
+{
+    static const uint8_t start_code[] = { 0, 0, 1 };
+    static const uint8_t epb[] = { 0, 0, 3 };
+    static const uint8_t tail[] = { 0, 0, 1, 0, 2 };
+
+    CHECK(i965_bitstream_find_start_code(buf, size) ==
+          reference_find(buf, size, start_code, sizeof(start_code)));
+    CHECK(i965_bitstream_find_epb(buf, size) ==
+          reference_find(buf, size, epb, sizeof(epb)));
+    CHECK(i965_bitstream_find_pattern(buf, size, tail, sizeof(tail)) ==
+          reference_find(buf, size, tail, sizeof(tail)));
+}
+
+int
+main(void)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t map_size = (TEST_MAX_SIZE + page - 1) / page * page + page;
+    uint8_t *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    uint8_t *end;
+    unsigned int seed = 1;
+    unsigned int k, n;
+    size_t size, i;
+
+    CHECK(map != MAP_FAILED);
+
+    if (map == MAP_FAILED)
+        return test_result("bitstream_scan");
+
+    end = map + map_size - page;
+    CHECK(mprotect(end, page, PROT_NONE) == 0);
+
+    for (k = I965_BITSTREAM_SCAN_C; k <= I965_BITSTREAM_SCAN_AVX2; k++) {
+        if (!i965_bitstream_scan_set_kernel(k))
+            continue;
+
+        /* Every size and alignment around the vector block sizes */
+        for (size = 0; size <= 100 && !test_failures; size++) {
+            for (n = 0; n < 20; n++) {
+                fill_sparse(end - size, size, 2 + n % 4, &seed);
+                test_buffer(end - size, size);
+            }
+        }
+
+        /* A single pattern at every offset of a zero free buffer */
+        for (size = 3; size <= 80 && !test_failures; size++) {
+            uint8_t *buf = end - size;
+
+            for (i = 0; i + 3 <= size; i++) {
+                memset(buf, 0xff, size);
+                buf[i] = 0;
+                buf[i + 1] = 0;
+                buf[i + 2] = 1;
+                CHECK(i965_bitstream_find_start_code(buf, size) == i);
+                CHECK(i965_bitstream_find_epb(buf, size) == size);
+            }
+        }
+
+        /* Long buffers, with matches few and far between */
+        for (n = 0; n < 2000 && !test_failures; n++) {
+            size = rand_r(&seed) % TEST_MAX_SIZE;
+            fill_sparse(end - size, size, 2 + n % 64, &seed);
+            test_buffer(end - size, size);
+        }
+    }
+
+    munmap(map, map_size);
+
+    return test_result("bitstream_scan");
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Replays frame size traces through the rate control of i965_brc.c. The
+ * coded size of each MB row follows its complexity and halves every few
+ * QP steps, every 6 as the rate control assumes or slower, as with
+ * content the encoder saturates on. The tests report how close the coded
+ * rate gets to the target and how many PAK passes it takes, and check
+ * that the final statuses are consistent.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <va/va.h>
+
+#include "i965_defines.h"
+#include "i965_brc.h"
+#include "test.h"
+
+#define TEST_WIDTH_IN_MBS       120
+#define TEST_HEIGHT_IN_MBS      68
+#define TEST_NUM_FRAMES         3000
+
+/* Coded bits per unit of VME cost at QP 0 */
+#define TEST_BITS_PER_COST      64.
+
+struct test_trace
+{
+    unsigned int scene_length;          /* frames between scene cuts */
+    double calm, busy;                  /* P frame complexity of the scenes */
+    double intra_ratio;                 /* I frame complexity over P */
+    double noise;                       /* random frame to frame variation */
+    double qp_halving;                  /* QP steps that halve the coded size */
+};
+
+struct test_scenario
+{
+    const char *name;
+    struct i965_brc_params params;
+    struct test_trace trace;
+    double max_rate_error;              /* relative to bits_per_second */
+    unsigned int max_reencodes;
+};
+
+static const struct test_scenario scenarios[] = {
+    {
+        "cbr",
+        { .mode = VA_RC_CBR, .bits_per_second = 4e6, .frame_rate = 30,
+          .intra_period = 30, .ip_period = 1, .idr_period = 120,
+          .width_in_mbs = TEST_WIDTH_IN_MBS, .height_in_mbs = TEST_HEIGHT_IN_MBS,
+          .buffer_size = 4000000, .initial_buffer_fullness = 2000000 },
+        { 300, 3.2e6, 9.6e6, 4., 0.5, 6. },
+        0.05, 150,
+    },
+    {
+        "vbr",
+        { .mode = VA_RC_VBR, .bits_per_second = 4e6, .max_bits_per_second = 8e6,
+          .window_frames = 60, .frame_rate = 30,
+          .intra_period = 30, .ip_period = 1, .idr_period = 120,
+          .width_in_mbs = TEST_WIDTH_IN_MBS, .height_in_mbs = TEST_HEIGHT_IN_MBS,
+          .buffer_size = 8000000, .initial_buffer_fullness = 4000000 },
+        { 300, 3.2e6, 9.6e6, 4., 0.5, 6. },
+        0.10, 150,
+    },
+    {
+        "cbr-small-buffer",
+        { .mode = VA_RC_CBR, .bits_per_second = 2e6, .frame_rate = 30,
+          .intra_period = 60, .ip_period = 1, .idr_period = 60,
+          .width_in_mbs = TEST_WIDTH_IN_MBS, .height_in_mbs = TEST_HEIGHT_IN_MBS,
+          .buffer_size = 500000, .initial_buffer_fullness = 250000 },
+        { 45, 1e6, 16e6, 6., 0.8, 6. },
+        0.10, 1500,
+    },
+    {
+        "cbr-saturated",
+        { .mode = VA_RC_CBR, .bits_per_second = 2e6, .frame_rate = 30,
+          .intra_period = 30, .ip_period = 1, .idr_period = 120,
+          .width_in_mbs = TEST_WIDTH_IN_MBS, .height_in_mbs = TEST_HEIGHT_IN_MBS,
+          .buffer_size = 1000000, .initial_buffer_fullness = 500000 },
+        { 60, 0.2e6, 0.6e6, 4., 0.8, 15. },
+        0.05, 300,
+    },
+};
+
+static double
+trace_complexity(const struct test_trace *trace, unsigned int frame, int slice_type,
+                 unsigned int *seed)
+{
+    double c = (frame / trace->scene_length) % 2 ? trace->busy : trace->calm;
+
+    c *= 1. + trace->noise * ((rand_r(seed) % 2001) / 1000. - 1.);
+
+    if (slice_type == SLICE_TYPE_I)
+        c *= trace->intra_ratio;
+
+    return c;
+}
+
+/* The bits of a frame of complexity c coded at qp with the row offsets */
+static int
+code_frame(const struct test_trace *trace, double c, int qp, const signed char *row_delta)
+{
+    double bits = 0.;
+    int i;
+
+    for (i = 0; i < TEST_HEIGHT_IN_MBS; i++)
+        bits += c / TEST_HEIGHT_IN_MBS * exp2(-(qp + row_delta[i]) / trace->qp_halving);
+
+    return (int)bits;
+}
+
+static void
+test_scenario(const struct test_scenario *scenario)
+{
+    const struct i965_brc_params *params = &scenario->params;
+    unsigned int row_cost[TEST_HEIGHT_IN_MBS];
+    signed char row_delta[TEST_HEIGHT_IN_MBS];
+    unsigned int passes[I965_BRC_MAX_PASSES + 2] = { 0 };
+    unsigned int num_capped = 0, num_reencodes = 0;
+    unsigned int seed = 1;
+    struct i965_brc brc;
+    double rate, error;
+    unsigned int f;
+    int i;
+
+    i965_brc_init(&brc, params);
+    CHECK(!i965_brc_params_changed(&brc, params));
+
+    for (f = 0; f < TEST_NUM_FRAMES; f++) {
+        int slice_type = f % params->intra_period ? SLICE_TYPE_P : SLICE_TYPE_I;
+        double c = trace_complexity(&scenario->trace, f, slice_type, &seed);
+        i965_brc_status sts;
+        unsigned int pass = 0;
+
+        if (f % scenario->trace.scene_length == 0 && slice_type != SLICE_TYPE_I)
+            i965_brc_scene_change(&brc);
+
+        for (i = 0; i < TEST_HEIGHT_IN_MBS; i++)
+            row_cost[i] = c / TEST_HEIGHT_IN_MBS / TEST_BITS_PER_COST;
+
+        do {
+            int qp = i965_brc_get_qp(&brc, slice_type);
+
+            i965_brc_row_qp(&brc, slice_type, row_cost, TEST_HEIGHT_IN_MBS, row_delta);
+            sts = i965_brc_postpack(&brc, slice_type, code_frame(&scenario->trace, c, qp, row_delta));
+            pass++;
+
+            /* the QP limits are only reported when the QP is at the limit */
+            if (sts == BRC_UNDERFLOW_WITH_MAX_QP)
+                CHECK(qp == I965_BRC_MAX_QP);
+            else if (sts == BRC_OVERFLOW_WITH_MIN_QP)
+                CHECK(qp == I965_BRC_MIN_QP);
+        } while ((sts == BRC_UNDERFLOW || sts == BRC_OVERFLOW) && pass <= I965_BRC_MAX_PASSES);
+
+        CHECK(pass <= I965_BRC_MAX_PASSES);
+        CHECK(sts != BRC_MAX_PASSES_SPENT || pass == I965_BRC_MAX_PASSES);
+
+        passes[pass]++;
+        num_reencodes += pass - 1;
+        num_capped += sts == BRC_MAX_PASSES_SPENT;
+    }
+
+    CHECK(brc.stats.num_frames == TEST_NUM_FRAMES);
+    CHECK(brc.stats.num_reencodes == num_reencodes);
+
+    rate = brc.stats.total_bits / brc.stats.num_frames * params->frame_rate;
+    error = (rate - params->bits_per_second) / params->bits_per_second;
+
+    fprintf(stderr,
+            "%s: %.2f Mbps for %.2f Mbps (%+.1f%%), %u re-encodes over %u frames, "
+            "passes %u/%u/%u/%u, %u HRD violations, %u at the pass limit\n",
+            scenario->name, rate / 1e6, params->bits_per_second / 1e6, error * 100.,
+            num_reencodes, TEST_NUM_FRAMES,
+            passes[1], passes[2], passes[3], passes[4],
+            brc.stats.num_violations, num_capped);
+
+    CHECK(fabs(error) <= scenario->max_rate_error);
+    CHECK(num_reencodes <= scenario->max_reencodes);
+}
+
+int
+main(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        test_scenario(&scenarios[i]);
+
+    return test_result("brc_replay");
+}
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks how intel_driver.c hands out the VDBOXes to the contexts and how
+ * intel_batchbuffer_flush() sends the BSD batches to them, through a fake
+ * batch->run: the balancing over both VDBOXes, VA_INTEL_BSD_RING_SELECT=0
+ * keeping every context on the first one, and the fallback to
+ * I915_EXEC_BSD_DEFAULT when the kernel rejects the selection.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <va/va_backend.h>
+#include <va/va_drmcommon.h>
+
+#include "intel_batchbuffer.h"
+#include "mock_bufmgr.h"
+#include "mock_drm.h"
+#include "test.h"
+
+#define TEST_MAX_RUNS   8
+
+static unsigned int test_ring_flags[TEST_MAX_RUNS];
+static int test_num_runs;
+static int test_reject_ring_select;
+
+static int
+test_run(drm_intel_bo *bo, int used,
+         drm_clip_rect_t *cliprects, int num_cliprects,
+         int DR4, unsigned int ring_flag)
+{
+    if (test_num_runs < TEST_MAX_RUNS)
+        test_ring_flags[test_num_runs] = ring_flag;
+
+    test_num_runs++;
+
+    if (test_reject_ring_select && (ring_flag & I915_EXEC_BSD_MASK))
+        return -EINVAL;
+
+    return 0;
+}
+
+static int
+test_init(struct intel_driver_data *intel, int has_bsd2, const char *ring_select)
+{
+    static struct drm_state drm_state;
+    static struct VADriverContext ctx;
+
+    memset(intel, 0, sizeof(*intel));
+    drm_state.fd = -1;
+    drm_state.auth_type = VA_DRM_AUTH_DRI2;
+    ctx.pDriverData = intel;
+    ctx.drm_state = &drm_state;
+
+    mock_drm.params[I915_PARAM_CHIPSET_ID] = 0x1626;
+    mock_drm.params[I915_PARAM_HAS_BSD] = 1;
+    mock_drm.params[I915_PARAM_HAS_BSD2] = has_bsd2;
+
+    if (ring_select)
+        setenv("VA_INTEL_BSD_RING_SELECT", ring_select, 1);
+    else
+        unsetenv("VA_INTEL_BSD_RING_SELECT");
+
+    return intel_driver_init(&ctx);
+}
+
+static void
+test_terminate(struct intel_driver_data *intel)
+{
+    struct VADriverContext ctx;
+
+    ctx.pDriverData = intel;
+    intel_driver_terminate(&ctx);
+}
+
+/* Flushes one dword on batch and returns the number of execs */
+static int
+test_flush(struct intel_batchbuffer *batch)
+{
+    test_num_runs = 0;
+    intel_batchbuffer_emit_dword(batch, MI_NOOP);
+    intel_batchbuffer_flush(batch);
+
+    return test_num_runs;
+}
+
+static void
+test_balancing(void)
+{
+    struct intel_driver_data intel;
+    struct intel_batchbuffer *batch;
+    int rings[4], i;
+
+    CHECK(test_init(&intel, 1, NULL));
+    CHECK(intel.has_bsd2);
+
+    for (i = 0; i < 4; i++)
+        rings[i] = intel_driver_get_bsd_ring(&intel);
+
+    CHECK(rings[0] == I915_EXEC_BSD_RING1);
+    CHECK(rings[1] == I915_EXEC_BSD_RING2);
+    CHECK(rings[2] == I915_EXEC_BSD_RING1);
+    CHECK(rings[3] == I915_EXEC_BSD_RING2);
+    CHECK(intel.bsd_ring_users[0] == 2 && intel.bsd_ring_users[1] == 2);
+
+    /* a new context goes to the VDBOX with the fewest */
+    intel_driver_put_bsd_ring(&intel, rings[2]);
+    rings[2] = intel_driver_get_bsd_ring(&intel);
+    CHECK(rings[2] == I915_EXEC_BSD_RING1);
+
+    /* the BSD batches name their VDBOX, the others don't */
+    batch = intel_batchbuffer_new(&intel, I915_EXEC_BSD, 0);
+    batch->run = test_run;
+    batch->bsd_ring = rings[1];
+    CHECK(test_flush(batch) == 1);
+    CHECK(test_ring_flags[0] == (I915_EXEC_BSD | I915_EXEC_BSD_RING2));
+    intel_batchbuffer_free(batch);
+
+    batch = intel_batchbuffer_new(&intel, I915_EXEC_RENDER, 0);
+    batch->run = test_run;
+    batch->bsd_ring = rings[0];
+    CHECK(test_flush(batch) == 1);
+    CHECK(test_ring_flags[0] == I915_EXEC_RENDER);
+    intel_batchbuffer_free(batch);
+
+    for (i = 0; i < 4; i++)
+        intel_driver_put_bsd_ring(&intel, rings[i]);
+
+    CHECK(intel.bsd_ring_users[0] == 0 && intel.bsd_ring_users[1] == 0);
+
+    test_terminate(&intel);
+}
+
+static void
+test_ring_select_env(void)
+{
+    struct intel_driver_data intel;
+    int rings[3], i;
+
+    /* the second VDBOX stays known and unused, the contexts are pinned */
+    CHECK(test_init(&intel, 1, "0"));
+    CHECK(intel.has_bsd2);
+
+    for (i = 0; i < 3; i++) {
+        rings[i] = intel_driver_get_bsd_ring(&intel);
+        CHECK(rings[i] == I915_EXEC_BSD_RING1);
+    }
+
+    CHECK(intel.bsd_ring_users[0] == 3 && intel.bsd_ring_users[1] == 0);
+
+    for (i = 0; i < 3; i++)
+        intel_driver_put_bsd_ring(&intel, rings[i]);
+
+    CHECK(intel.bsd_ring_users[0] == 0 && intel.bsd_ring_users[1] == 0);
+    test_terminate(&intel);
+
+    CHECK(test_init(&intel, 1, "1"));
+    rings[0] = intel_driver_get_bsd_ring(&intel);
+    rings[1] = intel_driver_get_bsd_ring(&intel);
+    CHECK(rings[0] == I915_EXEC_BSD_RING1 && rings[1] == I915_EXEC_BSD_RING2);
+    intel_driver_put_bsd_ring(&intel, rings[0]);
+    intel_driver_put_bsd_ring(&intel, rings[1]);
+    test_terminate(&intel);
+}
+
+static void
+test_single_vdbox(void)
+{
+    struct intel_driver_data intel;
+    struct intel_batchbuffer *batch;
+    int ring;
+
+    CHECK(test_init(&intel, 0, NULL));
+    CHECK(!intel.has_bsd2);
+
+    ring = intel_driver_get_bsd_ring(&intel);
+    CHECK(ring == I915_EXEC_BSD_DEFAULT);
+    CHECK(intel.bsd_ring_users[0] == 0 && intel.bsd_ring_users[1] == 0);
+
+    batch = intel_batchbuffer_new(&intel, I915_EXEC_BSD, 0);
+    batch->run = test_run;
+    batch->bsd_ring = ring;
+    CHECK(test_flush(batch) == 1);
+    CHECK(test_ring_flags[0] == I915_EXEC_BSD);
+    intel_batchbuffer_free(batch);
+
+    intel_driver_put_bsd_ring(&intel, ring);
+    CHECK(intel.bsd_ring_users[0] == 0 && intel.bsd_ring_users[1] == 0);
+    test_terminate(&intel);
+}
+
+static void
+test_rejected_ring_select(void)
+{
+    struct intel_driver_data intel;
+    struct intel_batchbuffer *batches[2];
+    int i;
+
+    CHECK(test_init(&intel, 1, NULL));
+
+    for (i = 0; i < 2; i++) {
+        batches[i] = intel_batchbuffer_new(&intel, I915_EXEC_BSD, 0);
+        batches[i]->run = test_run;
+        batches[i]->bsd_ring = intel_driver_get_bsd_ring(&intel);
+    }
+
+    CHECK(batches[0]->bsd_ring == I915_EXEC_BSD_RING1);
+    CHECK(batches[1]->bsd_ring == I915_EXEC_BSD_RING2);
+
+    /* the rejected batch is sent again to the default VDBOX */
+    test_reject_ring_select = 1;
+    CHECK(test_flush(batches[0]) == 2);
+    CHECK(test_ring_flags[0] == (I915_EXEC_BSD | I915_EXEC_BSD_RING1));
+    CHECK(test_ring_flags[1] == I915_EXEC_BSD);
+    CHECK(batches[0]->bsd_ring == I915_EXEC_BSD_DEFAULT);
+
+    /* its VDBOX is given back and no new context gets one */
+    CHECK(intel.bsd_ring_users[0] == 0 && intel.bsd_ring_users[1] == 1);
+    CHECK(intel_driver_get_bsd_ring(&intel) == I915_EXEC_BSD_DEFAULT);
+    CHECK(intel.bsd_ring_users[0] == 0 && intel.bsd_ring_users[1] == 1);
+    CHECK(intel.has_bsd2);
+
+    /* the contexts that already have one fall back on their next flush */
+    CHECK(test_flush(batches[1]) == 2);
+    CHECK(test_ring_flags[0] == (I915_EXEC_BSD | I915_EXEC_BSD_RING2));
+    CHECK(test_ring_flags[1] == I915_EXEC_BSD);
+    CHECK(intel.bsd_ring_users[0] == 0 && intel.bsd_ring_users[1] == 0);
+
+    /* and are not retried */
+    CHECK(test_flush(batches[0]) == 1);
+    CHECK(test_ring_flags[0] == I915_EXEC_BSD);
+    test_reject_ring_select = 0;
+
+    /* as the encoder contexts do when destroyed */
+    for (i = 0; i < 2; i++) {
+        intel_driver_put_bsd_ring(&intel, batches[i]->bsd_ring);
+        intel_batchbuffer_free(batches[i]);
+    }
+
+    CHECK(intel.bsd_ring_users[0] == 0 && intel.bsd_ring_users[1] == 0);
+    test_terminate(&intel);
+}
+
+int
+main(void)
+{
+    test_balancing();
+    test_ring_select_env();
+    test_single_vdbox();
+    test_rejected_ring_select();
+
+    CHECK(mock_bufmgr.num_bos == 0);
+
+    return test_result("bsd_ring");
+}
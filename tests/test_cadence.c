@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Feeds the 3:2 pulldown detector of i965_cadence.c with the field
+ * differences of telecined film, then of video, and checks when it locks,
+ * how it pairs the fields while locked and that it lets go of the cadence.
+ */
+
+#include <stdlib.h>
+
+#include "i965_cadence.h"
+#include "test.h"
+
+#define FILM_FRAMES     30
+#define VIDEO_FRAMES    20
+
+/*
+ * Film frames A B C D telecined to AA AB BC CC DD: position 0 of the cycle
+ * repeats the first field of the previous frame and position 2 repeats the
+ * second field.
+ */
+static void
+film_stats(int pos, struct i965_cadence_stats *stats)
+{
+    stats->first_diff = 1000 + rand() % 300;
+    stats->second_diff = 1000 + rand() % 300;
+
+    if (pos == 0)
+        stats->first_diff = rand() % 50;
+
+    if (pos == 2)
+        stats->second_diff = rand() % 50;
+}
+
+/* The pairing of the fields of a frame at each position of the cycle */
+static const struct i965_cadence_fields film_fields[I965_CADENCE_CYCLE] = {
+    { I965_CADENCE_FIELD_WEAVE_PREV, I965_CADENCE_FIELD_WEAVE_PREV },
+    { I965_CADENCE_FIELD_WEAVE_PREV, I965_CADENCE_FIELD_WEAVE_NEXT },
+    { I965_CADENCE_FIELD_WEAVE_NEXT, I965_CADENCE_FIELD_WEAVE_NEXT },
+    { I965_CADENCE_FIELD_WEAVE_NEXT, I965_CADENCE_FIELD_WEAVE_PREV },
+    { I965_CADENCE_FIELD_WEAVE_NEXT, I965_CADENCE_FIELD_WEAVE_PREV },
+};
+
+static int
+is_deinterlaced(const struct i965_cadence_fields *fields)
+{
+    return fields->first_field == I965_CADENCE_FIELD_DEINTERLACE &&
+           fields->prev_second_field == I965_CADENCE_FIELD_DEINTERLACE;
+}
+
+/* Telecined film starting at any position of the cycle, then video */
+static void
+test_film(int offset)
+{
+    struct i965_cadence_detector detector;
+    int n, lock_frame = -1, unlock_frame = -1;
+
+    i965_cadence_detector_init(&detector);
+
+    for (n = 0; n < FILM_FRAMES + VIDEO_FRAMES; n++) {
+        struct i965_cadence_stats stats;
+        struct i965_cadence_fields fields;
+        int pos = (n + offset) % I965_CADENCE_CYCLE;
+
+        i965_cadence_detector_fields(&detector, &fields);
+
+        if (detector.locked) {
+            if (lock_frame < 0)
+                lock_frame = n;
+
+            CHECK(fields.first_field == film_fields[pos].first_field);
+            CHECK(fields.prev_second_field == film_fields[pos].prev_second_field);
+        } else {
+            if (lock_frame >= 0 && unlock_frame < 0)
+                unlock_frame = n;
+
+            CHECK(is_deinterlaced(&fields));
+        }
+
+        if (n < FILM_FRAMES)
+            film_stats(pos, &stats);
+        else
+            stats.first_diff = stats.second_diff = 1000;
+
+        CHECK(i965_cadence_detector_update(&detector, &stats) == detector.locked);
+    }
+
+    /* locks once the phase held for I965_CADENCE_LOCK_FRAMES, within two cycles */
+    CHECK(lock_frame >= I965_CADENCE_LOCK_FRAMES);
+    CHECK(lock_frame <= I965_CADENCE_LOCK_FRAMES + 2 * I965_CADENCE_CYCLE);
+
+    /* and lets go at the first missing repeat */
+    CHECK(unlock_frame > FILM_FRAMES);
+    CHECK(unlock_frame <= FILM_FRAMES + I965_CADENCE_CYCLE);
+    CHECK(!detector.locked);
+}
+
+/* Content with no repeated fields, moving or still, is never woven */
+static void
+test_no_cadence(void)
+{
+    struct i965_cadence_detector detector;
+    int n, still;
+
+    for (still = 0; still < 2; still++) {
+        i965_cadence_detector_init(&detector);
+
+        for (n = 0; n < FILM_FRAMES + VIDEO_FRAMES; n++) {
+            struct i965_cadence_stats stats;
+            struct i965_cadence_fields fields;
+
+            if (still) {
+                stats.first_diff = rand() % I965_CADENCE_MIN_DIFF;
+                stats.second_diff = rand() % I965_CADENCE_MIN_DIFF;
+            } else {
+                stats.first_diff = 1000 + rand() % 300;
+                stats.second_diff = 1000 + rand() % 300;
+            }
+
+            CHECK(i965_cadence_detector_update(&detector, &stats) == 0);
+
+            i965_cadence_detector_fields(&detector, &fields);
+            CHECK(is_deinterlaced(&fields));
+        }
+    }
+}
+
+int
+main(void)
+{
+    int offset;
+
+    srand(1);
+
+    for (offset = 0; offset < I965_CADENCE_CYCLE; offset++)
+        test_film(offset);
+
+    test_no_cadence();
+
+    return test_result("cadence");
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the context pool: a single thread keeps its context, the number
+ * of contexts stays within the limit with threads waiting for one to be
+ * given back, a failed creation gives its place back, and no context is
+ * ever used by two threads at once.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "i965_context_pool.h"
+#include "test.h"
+
+#define TEST_THREADS            8
+#define TEST_ITERATIONS         20000
+
+struct test_context
+{
+    int users;
+};
+
+static int num_created;
+static int fail_next;
+
+static void *
+test_create(void *data)
+{
+    struct test_context *context;
+
+    if (__sync_lock_test_and_set(&fail_next, 0))
+        return NULL;
+
+    context = calloc(1, sizeof(*context));
+    __sync_fetch_and_add(&num_created, 1);
+
+    return context;
+}
+
+static void
+test_free_contexts(struct i965_context_pool *pool)
+{
+    int i, n = 0;
+
+    for (i = 0; i < I965_CONTEXT_POOL_MAX_CONTEXTS; i++) {
+        n += pool->contexts[i] != NULL;
+        free(pool->contexts[i]);
+    }
+
+    CHECK(n == pool->num_contexts);
+    CHECK(pool->num_idle == pool->num_contexts);
+    i965_context_pool_terminate(pool);
+}
+
+struct test_waiter
+{
+    struct i965_context_pool *pool;
+    void *context;
+    int done;
+};
+
+static void *
+test_wait_thread(void *arg)
+{
+    struct test_waiter *waiter = arg;
+
+    waiter->context = i965_context_pool_get(waiter->pool, test_create, NULL);
+    __sync_lock_test_and_set(&waiter->done, 1);
+
+    return NULL;
+}
+
+static void
+test_limit(void)
+{
+    struct i965_context_pool pool;
+    struct test_waiter waiter = { &pool, NULL, 0 };
+    struct timespec delay = { 0, 50000000 };
+    void *contexts[3];
+    pthread_t thread;
+    int i;
+
+    num_created = 0;
+    i965_context_pool_init(&pool, 3);
+
+    for (i = 0; i < 3; i++)
+        contexts[i] = i965_context_pool_get(&pool, test_create, NULL);
+
+    CHECK(contexts[0] != contexts[1] && contexts[1] != contexts[2]);
+
+    /* a fourth user waits for one of the three */
+    pthread_create(&thread, NULL, test_wait_thread, &waiter);
+    nanosleep(&delay, NULL);
+    CHECK(!waiter.done);
+
+    i965_context_pool_put(&pool, contexts[1]);
+    pthread_join(thread, NULL);
+    CHECK(waiter.done && waiter.context == contexts[1]);
+    CHECK(num_created == 3);
+
+    i965_context_pool_put(&pool, contexts[0]);
+    i965_context_pool_put(&pool, contexts[2]);
+    i965_context_pool_put(&pool, waiter.context);
+    test_free_contexts(&pool);
+}
+
+static void
+test_reuse_and_failure(void)
+{
+    struct i965_context_pool pool;
+    void *a, *b;
+
+    num_created = 0;
+    i965_context_pool_init(&pool, 0);
+    CHECK(pool.max_contexts == 1);
+    i965_context_pool_terminate(&pool);
+
+    i965_context_pool_init(&pool, 100);
+    CHECK(pool.max_contexts == I965_CONTEXT_POOL_MAX_CONTEXTS);
+
+    /* the last context given back comes first */
+    a = i965_context_pool_get(&pool, test_create, NULL);
+    b = i965_context_pool_get(&pool, test_create, NULL);
+    i965_context_pool_put(&pool, b);
+    i965_context_pool_put(&pool, a);
+    CHECK(i965_context_pool_get(&pool, test_create, NULL) == a);
+    CHECK(i965_context_pool_get(&pool, test_create, NULL) == b);
+    CHECK(num_created == 2);
+
+    /* a failed creation doesn't count against the limit */
+    fail_next = 1;
+    CHECK(i965_context_pool_get(&pool, test_create, NULL) == NULL);
+    CHECK(pool.num_contexts == 2);
+
+    i965_context_pool_put(&pool, a);
+    i965_context_pool_put(&pool, b);
+    test_free_contexts(&pool);
+}
+
+static struct i965_context_pool stress_pool;
+static int stress_errors;
+
+static void *
+test_stress_thread(void *arg)
+{
+    int n;
+
+    for (n = 0; n < TEST_ITERATIONS; n++) {
+        struct test_context *context = i965_context_pool_get(&stress_pool, test_create, NULL);
+
+        if (!context) {
+            __sync_fetch_and_add(&stress_errors, 1);
+            continue;
+        }
+
+        if (__sync_add_and_fetch(&context->users, 1) != 1)
+            __sync_fetch_and_add(&stress_errors, 1);
+
+        if (n % 7 == 0)
+            sched_yield();
+
+        __sync_fetch_and_sub(&context->users, 1);
+        i965_context_pool_put(&stress_pool, context);
+    }
+
+    return NULL;
+}
+
+static void
+test_stress(void)
+{
+    pthread_t threads[TEST_THREADS];
+    int i;
+
+    num_created = 0;
+    i965_context_pool_init(&stress_pool, 3);
+
+    for (i = 0; i < TEST_THREADS; i++)
+        pthread_create(&threads[i], NULL, test_stress_thread, NULL);
+
+    for (i = 0; i < TEST_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    CHECK(stress_errors == 0);
+    CHECK(num_created <= 3);
+    test_free_contexts(&stress_pool);
+}
+
+int
+main(void)
+{
+    test_reuse_and_failure();
+    test_limit();
+    test_stress();
+
+    return test_result("context_pool");
+}
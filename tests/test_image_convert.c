@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks i965_image_convert(), with the SSE2 kernels when they are built
+ * in, against a pixel by pixel model of every source and destination
+ * layout, from linear and from X or Y tiled sources.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <va/va.h>
+#include <i915_drm.h>
+
+#include "i965_fourcc.h"
+#include "i965_image_convert.h"
+#include "i965_tiling.h"
+#include "test.h"
+
+#define TEST_PITCH      512
+#define TEST_ROWS       64
+#define TEST_SIZE       (TEST_PITCH * TEST_ROWS)
+#define TEST_CHROMA     (32 * TEST_PITCH)
+
+struct test_format
+{
+    uint32_t fourcc;
+    const char *name;
+};
+
+static const struct test_format src_formats[] = {
+    { VA_FOURCC_I420, "I420" },
+    { VA_FOURCC_YV12, "YV12" },
+    { VA_FOURCC_NV12, "NV12" },
+#ifdef VA_FOURCC_P010
+    { VA_FOURCC_P010, "P010" },
+#endif
+    { VA_FOURCC_YUY2, "YUY2" },
+    { VA_FOURCC_UYVY, "UYVY" },
+};
+
+static const struct test_format dst_formats[] = {
+    { VA_FOURCC_I420, "I420" },
+    { VA_FOURCC_NV12, "NV12" },
+    { VA_FOURCC_YUY2, "YUY2" },
+    { VA_FOURCC_UYVY, "UYVY" },
+    { VA_FOURCC_RGBX, "RGBX" },
+    { VA_FOURCC_BGRA, "BGRA" },
+};
+
+/* Y, U, V of pixel (x, y); the chroma of 4:2:0 sources is shared by row pairs */
+static void
+reference_fetch(const struct i965_image_layout *src, unsigned int x, unsigned int y,
+                uint8_t yuv[3])
+{
+    const uint8_t *p = src->base;
+    const uint8_t *row = p + src->offsets[0] + y * src->pitches[0];
+    const uint8_t *c = p + src->offsets[1] + (y / 2) * src->pitches[1];
+
+    switch (src->fourcc) {
+    case VA_FOURCC_NV12:
+        yuv[0] = row[x];
+        yuv[1] = c[x / 2 * 2];
+        yuv[2] = c[x / 2 * 2 + 1];
+        break;
+
+#ifdef VA_FOURCC_P010
+    case VA_FOURCC_P010:
+        yuv[0] = row[2 * x + 1];
+        yuv[1] = c[x / 2 * 4 + 1];
+        yuv[2] = c[x / 2 * 4 + 3];
+        break;
+#endif
+
+    case VA_FOURCC_YUY2:
+        yuv[0] = row[2 * x];
+        yuv[1] = row[x / 2 * 4 + 1];
+        yuv[2] = row[x / 2 * 4 + 3];
+        break;
+
+    case VA_FOURCC_UYVY:
+        yuv[0] = row[2 * x + 1];
+        yuv[1] = row[x / 2 * 4];
+        yuv[2] = row[x / 2 * 4 + 2];
+        break;
+
+    default:
+        yuv[0] = row[x];
+        yuv[1] = c[x / 2];
+        yuv[2] = p[src->offsets[2] + (y / 2) * src->pitches[2] + x / 2];
+        break;
+    }
+}
+
+/* The 4:2:0 chroma of a row pair, rounded up like the driver does */
+static uint8_t
+reference_chroma_420(const struct i965_image_layout *src, unsigned int x,
+                     unsigned int y, unsigned int height, int plane)
+{
+    uint8_t a[3], b[3];
+
+    reference_fetch(src, x, y, a);
+
+    if (y + 1 == height)
+        return a[plane];
+
+    reference_fetch(src, x, y + 1, b);
+
+    return (a[plane] + b[plane] + 1) >> 1;
+}
+
+static uint8_t
+clamp_u8(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static void
+reference_rgb(const uint8_t yuv[3], int matrix, uint8_t rgb[3])
+{
+    static const int k[2][5] = {
+        { 298, 409, -100, -208, 516 },  /* BT.601 */
+        { 298, 459, -55, -136, 541 },   /* BT.709 */
+    };
+    int c = yuv[0] - 16, d = yuv[1] - 128, e = yuv[2] - 128;
+
+    rgb[0] = clamp_u8((k[matrix][0] * c + k[matrix][1] * e + 128) >> 8);
+    rgb[1] = clamp_u8((k[matrix][0] * c + k[matrix][2] * d + k[matrix][3] * e + 128) >> 8);
+    rgb[2] = clamp_u8((k[matrix][0] * c + k[matrix][4] * d + 128) >> 8);
+}
+
+static void
+reference_convert(const struct i965_image_layout *src,
+                  const struct i965_image_layout *dst,
+                  unsigned int width, unsigned int height, int matrix)
+{
+    uint8_t *p = dst->base;
+    unsigned int x, y;
+    uint8_t yuv[3], rgb[3];
+
+    for (y = 0; y < height; y++) {
+        uint8_t *row = p + dst->offsets[0] + y * dst->pitches[0];
+
+        for (x = 0; x < width; x++) {
+            reference_fetch(src, x, y, yuv);
+
+            switch (dst->fourcc) {
+            case VA_FOURCC_YUY2:
+                row[2 * x] = yuv[0];
+                row[2 * x + 1] = yuv[1 + (x & 1)];
+                break;
+
+            case VA_FOURCC_UYVY:
+                row[2 * x + 1] = yuv[0];
+                row[2 * x] = yuv[1 + (x & 1)];
+                break;
+
+            case VA_FOURCC_RGBX:
+            case VA_FOURCC_BGRA:
+                reference_rgb(yuv, matrix, rgb);
+                row[4 * x] = rgb[dst->fourcc == VA_FOURCC_BGRA ? 2 : 0];
+                row[4 * x + 1] = rgb[1];
+                row[4 * x + 2] = rgb[dst->fourcc == VA_FOURCC_BGRA ? 0 : 2];
+                row[4 * x + 3] = 0xff;
+                break;
+
+            default:
+                row[x] = yuv[0];
+
+                if ((x & 1) || (y & 1))
+                    break;
+
+                if (dst->fourcc == VA_FOURCC_NV12) {
+                    uint8_t *c = p + dst->offsets[1] + y / 2 * dst->pitches[1] + x;
+
+                    c[0] = reference_chroma_420(src, x, y, height, 1);
+                    c[1] = reference_chroma_420(src, x, y, height, 2);
+                } else {
+                    p[dst->offsets[1] + y / 2 * dst->pitches[1] + x / 2] =
+                        reference_chroma_420(src, x, y, height, 1);
+                    p[dst->offsets[2] + y / 2 * dst->pitches[2] + x / 2] =
+                        reference_chroma_420(src, x, y, height, 2);
+                }
+
+                break;
+            }
+        }
+    }
+}
+
+/* Luma (or packed) rows from 0, chroma rows from 32, Cr half a row along */
+static void
+init_layout(struct i965_image_layout *layout, uint32_t fourcc, uint8_t *base)
+{
+    memset(layout, 0, sizeof(*layout));
+    layout->fourcc = fourcc;
+    layout->base = base;
+    layout->offsets[1] = TEST_CHROMA;
+    layout->offsets[2] = TEST_CHROMA + TEST_PITCH / 2;
+    layout->pitches[0] = layout->pitches[1] = layout->pitches[2] = TEST_PITCH;
+    layout->tiling = I915_TILING_NONE;
+    layout->swizzle = I915_BIT_6_SWIZZLE_NONE;
+}
+
+static void
+fill_random(uint8_t *p, unsigned int size, unsigned int *seed)
+{
+    unsigned int i;
+
+    for (i = 0; i < size; i++)
+        p[i] = rand_r(seed);
+}
+
+struct test_buffers
+{
+    uint8_t *linear;
+    uint8_t *tiled;
+    uint8_t *dst;
+    uint8_t *expected;
+};
+
+static void
+test_convert(struct test_buffers *b, const struct test_format *sf,
+             const struct test_format *df, uint32_t tiling,
+             unsigned int x, unsigned int y,
+             unsigned int width, unsigned int height,
+             int matrix, unsigned int *seed)
+{
+    struct i965_image_layout src, ref, dst, expected;
+    unsigned int i, errors = 0;
+
+    fill_random(b->linear, TEST_SIZE, seed);
+    init_layout(&ref, sf->fourcc, b->linear);
+    init_layout(&src, sf->fourcc, b->linear);
+
+    if (tiling != I915_TILING_NONE) {
+        i965_linear_to_tiled(b->tiled, TEST_PITCH, tiling, I915_BIT_6_SWIZZLE_NONE,
+                             0, 0, b->linear, TEST_PITCH, TEST_PITCH, TEST_ROWS);
+        src.base = b->tiled;
+        src.tiling = tiling;
+    }
+
+    i965_image_layout_move(&ref, x, y);
+    i965_image_layout_move(&src, x, y);
+
+    /* The bytes that aren't converted must be left alone */
+    fill_random(b->dst, TEST_SIZE, seed);
+    memcpy(b->expected, b->dst, TEST_SIZE);
+    init_layout(&dst, df->fourcc, b->dst);
+    init_layout(&expected, df->fourcc, b->expected);
+
+    CHECK(i965_image_convert(&src, &dst, width, height, matrix) == 0);
+    reference_convert(&ref, &expected, width, height, matrix);
+
+    for (i = 0; i < TEST_SIZE; i++)
+        errors += b->dst[i] != b->expected[i];
+
+    if (errors)
+        fprintf(stderr, "%s -> %s tiling %u at %u,%u %ux%u: %u errors\n",
+                sf->name, df->name, tiling, x, y, width, height, errors);
+
+    CHECK(errors == 0);
+}
+
+int
+main(void)
+{
+    static const uint32_t tilings[] = { I915_TILING_NONE, I915_TILING_X, I915_TILING_Y };
+    struct test_buffers b;
+    unsigned int seed = 1;
+    unsigned int s, d, t;
+
+    b.linear = malloc(TEST_SIZE);
+    b.tiled = aligned_alloc(4096, TEST_SIZE);
+    b.dst = malloc(TEST_SIZE);
+    b.expected = malloc(TEST_SIZE);
+
+    CHECK(i965_image_convert_supported(VA_FOURCC_NV12, VA_FOURCC_RGBX));
+    CHECK(!i965_image_convert_supported(VA_FOURCC_NV12, VA_FOURCC_AYUV));
+    CHECK(!i965_image_convert_supported(VA_FOURCC_AYUV, VA_FOURCC_NV12));
+
+    for (s = 0; s < sizeof(src_formats) / sizeof(src_formats[0]); s++) {
+        for (d = 0; d < sizeof(dst_formats) / sizeof(dst_formats[0]); d++) {
+            for (t = 0; t < sizeof(tilings) / sizeof(tilings[0]); t++) {
+                /* SIMD blocks with scalar tails, odd sizes and a moved origin */
+                test_convert(&b, &src_formats[s], &dst_formats[d], tilings[t],
+                             0, 0, 70, 12, I965_CSC_BT601, &seed);
+                test_convert(&b, &src_formats[s], &dst_formats[d], tilings[t],
+                             4, 2, 69, 11, I965_CSC_BT709, &seed);
+                test_convert(&b, &src_formats[s], &dst_formats[d], tilings[t],
+                             16, 6, 1, 1, I965_CSC_BT601, &seed);
+            }
+        }
+    }
+
+    free(b.linear);
+    free(b.tiled);
+    free(b.dst);
+    free(b.expected);
+
+    return test_result("image_convert");
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the generation tagged IDs of object_heap and stresses concurrent
+ * allocations, lookups and frees from several threads.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "object_heap.h"
+#include "test.h"
+
+#define TEST_ID_OFFSET          0x04000000
+#define TEST_THREADS            8
+#define TEST_ITERATIONS         100000
+#define TEST_OBJECTS_PER_THREAD 64
+
+struct test_object {
+    struct object_base base;
+    int owner;
+    int value;
+};
+
+static struct object_heap heap;
+static volatile int stop_readers;
+
+static struct test_object *
+test_lookup(int id)
+{
+    return (struct test_object *)object_heap_lookup(&heap, id);
+}
+
+static void
+test_generations(void)
+{
+    struct test_object *obj;
+    int id, new_id;
+
+    id = object_heap_allocate(&heap);
+    CHECK(id != -1);
+    CHECK((id & ~OBJECT_HEAP_ID_MASK) == TEST_ID_OFFSET);
+
+    obj = test_lookup(id);
+    CHECK(obj != NULL);
+    CHECK(obj->base.id == id);
+
+    object_heap_free(&heap, &obj->base);
+    CHECK(test_lookup(id) == NULL);
+
+    /* The slot comes back from the thread cache with another generation */
+    new_id = object_heap_allocate(&heap);
+    CHECK((new_id & OBJECT_HEAP_INDEX_MASK) == (id & OBJECT_HEAP_INDEX_MASK));
+    CHECK((new_id & OBJECT_HEAP_GEN_MASK) != (id & OBJECT_HEAP_GEN_MASK));
+    CHECK(test_lookup(id) == NULL);
+    CHECK(test_lookup(new_id) != NULL);
+
+    object_heap_free(&heap, (object_base_p)test_lookup(new_id));
+
+    /* IDs of other heaps and past the heap never resolve */
+    CHECK(object_heap_lookup(&heap, (new_id & OBJECT_HEAP_ID_MASK) | 0x08000000) == NULL);
+    CHECK(object_heap_lookup(&heap, TEST_ID_OFFSET | OBJECT_HEAP_INDEX_MASK) == NULL);
+}
+
+/* The generation wraps around within OBJECT_HEAP_GEN_MASK */
+static void
+test_generation_wrap(void)
+{
+    int i, id, first_id;
+
+    first_id = object_heap_allocate(&heap);
+    object_heap_free(&heap, object_heap_lookup(&heap, first_id));
+
+    for (i = 0; i < (OBJECT_HEAP_GEN_MASK >> OBJECT_HEAP_INDEX_BITS) + 1; i++) {
+        id = object_heap_allocate(&heap);
+        CHECK((id & ~OBJECT_HEAP_ID_MASK) == TEST_ID_OFFSET);
+        CHECK((id & OBJECT_HEAP_INDEX_MASK) == (first_id & OBJECT_HEAP_INDEX_MASK));
+        object_heap_free(&heap, object_heap_lookup(&heap, id));
+    }
+}
+
+/* The heap grows bucket by bucket and keeps the existing objects in place */
+static void
+test_growth(void)
+{
+    struct object_heap small;
+    int ids[1000];
+    object_base_p objs[1000];
+    object_heap_iterator iter;
+    object_base_p obj;
+    int i, count;
+
+    CHECK(object_heap_init_with_increment(&small, sizeof(struct test_object), TEST_ID_OFFSET, 7) == 0);
+
+    for (i = 0; i < 1000; i++) {
+        ids[i] = object_heap_allocate(&small);
+        CHECK(ids[i] != -1);
+        objs[i] = object_heap_lookup(&small, ids[i]);
+        CHECK(objs[i] != NULL);
+        ((struct test_object *)objs[i])->value = i;
+    }
+
+    for (i = 0; i < 1000; i++) {
+        CHECK(object_heap_lookup(&small, ids[i]) == objs[i]);
+        CHECK(((struct test_object *)objs[i])->value == i);
+    }
+
+    count = 0;
+    for (obj = object_heap_first(&small, &iter); obj; obj = object_heap_next(&small, &iter))
+        count++;
+    CHECK(count == 1000);
+
+    for (i = 0; i < 1000; i++)
+        object_heap_free(&small, objs[i]);
+
+    CHECK(object_heap_first(&small, &iter) == NULL);
+    object_heap_destroy(&small);
+}
+
+/* Each thread owns a set of objects it keeps recycling and checking */
+static void *
+test_worker(void *arg)
+{
+    int owner = (int)(long)arg;
+    int ids[TEST_OBJECTS_PER_THREAD];
+    int values[TEST_OBJECTS_PER_THREAD];
+    unsigned int seed = owner;
+    struct test_object *obj;
+    int i, n, old_id;
+
+    for (i = 0; i < TEST_OBJECTS_PER_THREAD; i++) {
+        ids[i] = object_heap_allocate(&heap);
+        CHECK(ids[i] != -1);
+        obj = test_lookup(ids[i]);
+        obj->owner = owner;
+        obj->value = values[i] = -1;
+    }
+
+    for (n = 0; n < TEST_ITERATIONS && !test_failures; n++) {
+        i = rand_r(&seed) % TEST_OBJECTS_PER_THREAD;
+        obj = test_lookup(ids[i]);
+        CHECK(obj && obj->owner == owner && obj->value == values[i]);
+
+        if (!obj)
+            break;
+
+        /* The freed slot sits in the cache of this thread, its old ID must be dead */
+        old_id = ids[i];
+        object_heap_free(&heap, &obj->base);
+        CHECK(test_lookup(old_id) == NULL);
+
+        ids[i] = object_heap_allocate(&heap);
+        CHECK(ids[i] != -1 && ids[i] != old_id);
+        obj = test_lookup(ids[i]);
+
+        if (!obj)
+            break;
+
+        obj->owner = owner;
+        obj->value = values[i] = n;
+    }
+
+    for (i = 0; i < TEST_OBJECTS_PER_THREAD; i++)
+        object_heap_free(&heap, object_heap_lookup(&heap, ids[i]));
+
+    return NULL;
+}
+
+/* Looks up random IDs while the heap is being recycled and grown */
+static void *
+test_reader(void *arg)
+{
+    unsigned int seed = 1234;
+
+    (void)arg;
+
+    while (!stop_readers) {
+        int id = TEST_ID_OFFSET | (rand_r(&seed) & OBJECT_HEAP_ID_MASK);
+        object_base_p obj = object_heap_lookup(&heap, id);
+
+        if (obj)
+            CHECK((obj->id & OBJECT_HEAP_INDEX_MASK) == (id & OBJECT_HEAP_INDEX_MASK));
+    }
+
+    return NULL;
+}
+
+static void
+test_stress(void)
+{
+    pthread_t workers[TEST_THREADS], reader;
+    object_heap_iterator iter;
+    int i;
+
+    stop_readers = 0;
+    pthread_create(&reader, NULL, test_reader, NULL);
+
+    for (i = 0; i < TEST_THREADS; i++)
+        pthread_create(&workers[i], NULL, test_worker, (void *)(long)(i + 1));
+
+    for (i = 0; i < TEST_THREADS; i++)
+        pthread_join(workers[i], NULL);
+
+    stop_readers = 1;
+    pthread_join(reader, NULL);
+
+    CHECK(object_heap_first(&heap, &iter) == NULL);
+}
+
+int
+main(void)
+{
+    CHECK(object_heap_init(&heap, sizeof(struct test_object), TEST_ID_OFFSET) == 0);
+
+    test_generations();
+    test_generation_wrap();
+    test_growth();
+    test_stress();
+
+    object_heap_destroy(&heap);
+
+    return test_result("object_heap");
+}
@@ -0,0 +1,538 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the AVC reference lists of i965_encoder_utils.c: the initial
+ * lists of pyramid B frames, of P frames across the FrameNum wrap and of
+ * B frames whose L1 has to be swapped, and that the
+ * ref_pic_list_modification() syntax of the slice header gets a decoder
+ * from those initial lists to the lists the driver encodes with.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <va/va.h>
+#include <va/va_enc_h264.h>
+#include <va/va_enc_mpeg2.h>
+
+#include "i965_encoder_utils.h"
+#include "test.h"
+
+#define SLICE_TYPE_P    0
+#define SLICE_TYPE_B    1
+
+#define LOG2_MAX_FRAME_NUM      4
+#define LOG2_MAX_POC_LSB        8
+
+struct test_bits {
+    const unsigned char *buffer;
+    int bit_offset;
+};
+
+static unsigned int
+test_bits_u(struct test_bits *bits, int size_in_bits)
+{
+    unsigned int val = 0;
+
+    while (size_in_bits--) {
+        int byte = bits->buffer[bits->bit_offset >> 3];
+
+        val = val << 1 | ((byte >> (7 - (bits->bit_offset & 7))) & 1);
+        bits->bit_offset++;
+    }
+
+    return val;
+}
+
+static unsigned int
+test_bits_ue(struct test_bits *bits)
+{
+    int leading_zeros = 0;
+
+    while (!test_bits_u(bits, 1))
+        leading_zeros++;
+
+    return (1 << leading_zeros) - 1 + test_bits_u(bits, leading_zeros);
+}
+
+static void
+test_ref_pic(VAPictureH264 *pic, VASurfaceID id, int frame_idx, int poc, int long_term)
+{
+    pic->picture_id = id;
+    pic->frame_idx = frame_idx;
+    pic->flags = long_term ? VA_PICTURE_H264_LONG_TERM_REFERENCE : VA_PICTURE_H264_SHORT_TERM_REFERENCE;
+    pic->TopFieldOrderCnt = poc;
+    pic->BottomFieldOrderCnt = poc;
+}
+
+static void
+test_invalid_pic(VAPictureH264 *pic)
+{
+    pic->picture_id = VA_INVALID_SURFACE;
+    pic->frame_idx = 0;
+    pic->flags = VA_PICTURE_H264_INVALID;
+    pic->TopFieldOrderCnt = 0;
+    pic->BottomFieldOrderCnt = 0;
+}
+
+/* A non-IDR frame with its DPB, the slice lists are all invalid */
+static void
+test_init_params(VAEncSequenceParameterBufferH264 *sps_param,
+                 VAEncPictureParameterBufferH264 *pic_param,
+                 VAEncSliceParameterBufferH264 *slice_param,
+                 int slice_type, int frame_num, int poc,
+                 const VAPictureH264 *refs, int num_refs)
+{
+    int i;
+
+    memset(sps_param, 0, sizeof(*sps_param));
+    sps_param->seq_fields.bits.frame_mbs_only_flag = 1;
+    sps_param->seq_fields.bits.log2_max_frame_num_minus4 = LOG2_MAX_FRAME_NUM - 4;
+    sps_param->seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4 = LOG2_MAX_POC_LSB - 4;
+
+    memset(pic_param, 0, sizeof(*pic_param));
+    test_ref_pic(&pic_param->CurrPic, 100, frame_num, poc, 0);
+    pic_param->frame_num = frame_num;
+    pic_param->pic_fields.bits.reference_pic_flag = slice_type != SLICE_TYPE_B;
+
+    for (i = 0; i < 16; i++) {
+        if (i < num_refs)
+            pic_param->ReferenceFrames[i] = refs[i];
+        else
+            test_invalid_pic(&pic_param->ReferenceFrames[i]);
+    }
+
+    memset(slice_param, 0, sizeof(*slice_param));
+    slice_param->slice_type = slice_type;
+
+    for (i = 0; i < 32; i++) {
+        test_invalid_pic(&slice_param->RefPicList0[i]);
+        test_invalid_pic(&slice_param->RefPicList1[i]);
+    }
+}
+
+/* Overrides the number of active references of both lists */
+static void
+test_set_num_active(VAEncSliceParameterBufferH264 *slice_param, int num_active0, int num_active1)
+{
+    slice_param->num_ref_idx_active_override_flag = 1;
+    slice_param->num_ref_idx_l0_active_minus1 = num_active0 - 1;
+    slice_param->num_ref_idx_l1_active_minus1 = num_active1 > 0 ? num_active1 - 1 : 0;
+}
+
+/* PicNum of a short term reference, as a decoder derives it in 8.2.4.1 */
+static int
+test_pic_num(VAEncPictureParameterBufferH264 *pic_param, const VAPictureH264 *pic)
+{
+    if (pic->flags & VA_PICTURE_H264_LONG_TERM_REFERENCE)
+        return -1 << 20;
+
+    if ((int)pic->frame_idx > pic_param->frame_num)
+        return (int)pic->frame_idx - (1 << LOG2_MAX_FRAME_NUM);
+
+    return pic->frame_idx;
+}
+
+static int
+test_long_term_pic_num(const VAPictureH264 *pic)
+{
+    if (!(pic->flags & VA_PICTURE_H264_LONG_TERM_REFERENCE))
+        return -1 << 20;
+
+    return pic->frame_idx;
+}
+
+static const VAPictureH264 *
+test_find_ref(VAEncPictureParameterBufferH264 *pic_param, int pic_num, int long_term)
+{
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        const VAPictureH264 *pic = &pic_param->ReferenceFrames[i];
+
+        if (pic->flags & VA_PICTURE_H264_INVALID)
+            break;
+
+        if (long_term ? test_long_term_pic_num(pic) == pic_num :
+            test_pic_num(pic_param, pic) == pic_num)
+            return pic;
+    }
+
+    return NULL;
+}
+
+/*
+ * Parses ref_pic_list_modification() for one list and applies it the way
+ * 8.2.4.3 does to the initial list, returns the modified list in ref_list
+ */
+static void
+test_modify_ref_list(struct test_bits *bits,
+                     VAEncPictureParameterBufferH264 *pic_param,
+                     const VAPictureH264 *init_list, int num_init,
+                     int num_active,
+                     VAPictureH264 *ref_list,
+                     int *modified)
+{
+    int max_pic_num = 1 << LOG2_MAX_FRAME_NUM;
+    int curr_pic_num = pic_param->frame_num;
+    int pic_num_pred = curr_pic_num;
+    int ref_idx = 0, i;
+
+    for (i = 0; i <= num_active; i++) {
+        if (i < num_init && i < num_active)
+            ref_list[i] = init_list[i];
+        else
+            test_invalid_pic(&ref_list[i]);
+    }
+
+    *modified = test_bits_u(bits, 1);
+
+    if (!*modified)
+        return;
+
+    for (;;) {
+        int idc = test_bits_ue(bits);
+        const VAPictureH264 *pic;
+        int pic_num, long_term, c, n;
+
+        if (idc == 3)
+            break;
+
+        CHECK(idc <= 2);
+        CHECK(ref_idx < num_active);
+
+        if (idc == 2) {
+            long_term = 1;
+            pic_num = test_bits_ue(bits);
+        } else {
+            int abs_diff_pic_num = test_bits_ue(bits) + 1;
+
+            long_term = 0;
+            CHECK(abs_diff_pic_num <= max_pic_num);
+
+            if (idc == 0) {
+                pic_num = pic_num_pred - abs_diff_pic_num;
+
+                if (pic_num < 0)
+                    pic_num += max_pic_num;
+            } else {
+                pic_num = pic_num_pred + abs_diff_pic_num;
+
+                if (pic_num >= max_pic_num)
+                    pic_num -= max_pic_num;
+            }
+
+            pic_num_pred = pic_num;
+
+            if (pic_num > curr_pic_num)
+                pic_num -= max_pic_num;
+        }
+
+        pic = test_find_ref(pic_param, pic_num, long_term);
+        CHECK(pic != NULL);
+
+        if (!pic || ref_idx >= num_active)
+            break;
+
+        for (c = num_active; c > ref_idx; c--)
+            ref_list[c] = ref_list[c - 1];
+
+        ref_list[ref_idx++] = *pic;
+
+        for (c = n = ref_idx; c <= num_active; c++) {
+            if (long_term ? test_long_term_pic_num(&ref_list[c]) != pic_num :
+                test_pic_num(pic_param, &ref_list[c]) != pic_num)
+                ref_list[n++] = ref_list[c];
+        }
+    }
+}
+
+static int
+test_num_active(VAEncPictureParameterBufferH264 *pic_param,
+                VAEncSliceParameterBufferH264 *slice_param,
+                int list_index)
+{
+    if (slice_param->num_ref_idx_active_override_flag)
+        return 1 + (list_index ? slice_param->num_ref_idx_l1_active_minus1 : slice_param->num_ref_idx_l0_active_minus1);
+
+    return 1 + (list_index ? pic_param->num_ref_idx_l1_active_minus1 : pic_param->num_ref_idx_l0_active_minus1);
+}
+
+/*
+ * Builds the slice header, checks that its modification syntax turns the
+ * initial lists into the lists the slice is encoded with, returns how many
+ * of the lists are modified
+ */
+static int
+test_slice_header(VAEncSequenceParameterBufferH264 *sps_param,
+                  VAEncPictureParameterBufferH264 *pic_param,
+                  VAEncSliceParameterBufferH264 *slice_param)
+{
+    unsigned char *header;
+    struct test_bits bits;
+    int num_lists = slice_param->slice_type == SLICE_TYPE_B ? 2 : 1;
+    int num_modified = 0, list_index, i;
+
+    build_avc_slice_header(sps_param, pic_param, slice_param, &header);
+    bits.buffer = header;
+    bits.bit_offset = 0;
+
+    CHECK(test_bits_u(&bits, 32) == 1);         /* start code */
+    test_bits_u(&bits, 8);                      /* NAL header */
+    CHECK(test_bits_ue(&bits) == 0);            /* first_mb_in_slice */
+    CHECK(test_bits_ue(&bits) == slice_param->slice_type);
+    test_bits_ue(&bits);                        /* pic_parameter_set_id */
+    CHECK(test_bits_u(&bits, LOG2_MAX_FRAME_NUM) == pic_param->frame_num);
+    CHECK(test_bits_u(&bits, LOG2_MAX_POC_LSB) == pic_param->CurrPic.TopFieldOrderCnt);
+
+    if (slice_param->slice_type == SLICE_TYPE_B)
+        test_bits_u(&bits, 1);                  /* direct_spatial_mv_pred_flag */
+
+    CHECK(test_bits_u(&bits, 1) == slice_param->num_ref_idx_active_override_flag);
+
+    if (slice_param->num_ref_idx_active_override_flag) {
+        for (list_index = 0; list_index < num_lists; list_index++)
+            CHECK(test_bits_ue(&bits) + 1 == test_num_active(pic_param, slice_param, list_index));
+    }
+
+    for (list_index = 0; list_index < num_lists; list_index++) {
+        VAPictureH264 init_list[16], enc_list[32], ref_list[33];
+        int num_active = test_num_active(pic_param, slice_param, list_index);
+        int num_init, num_enc, modified;
+
+        num_init = intel_avc_init_ref_pic_list(sps_param, pic_param, slice_param->slice_type,
+                                               list_index, init_list);
+        num_enc = intel_avc_enc_ref_pic_list(sps_param, pic_param, slice_param,
+                                             list_index, enc_list);
+        CHECK(num_enc <= num_active);
+
+        test_modify_ref_list(&bits, pic_param, init_list, num_init, num_active,
+                             ref_list, &modified);
+        num_modified += modified;
+
+        for (i = 0; i < num_enc; i++)
+            CHECK(ref_list[i].picture_id == enc_list[i].picture_id);
+    }
+
+    free(header);
+
+    return num_modified;
+}
+
+static int
+test_ref_list_is(const VAPictureH264 *ref_list, int num_refs,
+                 const VASurfaceID *ids, int num_ids)
+{
+    int i;
+
+    if (num_refs != num_ids)
+        return 0;
+
+    for (i = 0; i < num_ids; i++) {
+        if (ref_list[i].picture_id != ids[i])
+            return 0;
+    }
+
+    return 1;
+}
+
+#define CHECK_REF_LIST(ref_list, num_refs, ...)                         \
+    do {                                                                \
+        static const VASurfaceID ids[] = { __VA_ARGS__ };               \
+        CHECK(test_ref_list_is(ref_list, num_refs, ids,                 \
+                               sizeof(ids) / sizeof(ids[0])));          \
+    } while (0)
+
+/*
+ * Hierarchical B in a GOP of 8: I0 P8 B4 b2 b6 ..., each picture is named
+ * by its POC / 2 and its surface is its display order
+ */
+static void
+test_pyramid_b(void)
+{
+    VAEncSequenceParameterBufferH264 sps_param;
+    VAEncPictureParameterBufferH264 pic_param;
+    VAEncSliceParameterBufferH264 slice_param;
+    VAPictureH264 refs[3], ref_list[32];
+    int num_refs;
+
+    test_ref_pic(&refs[0], 0, 0, 0, 0);         /* I0 */
+    test_ref_pic(&refs[1], 8, 1, 16, 0);        /* P8 */
+    test_ref_pic(&refs[2], 4, 2, 8, 0);         /* B4 */
+
+    /* B4 references I0 and P8 */
+    test_init_params(&sps_param, &pic_param, &slice_param, SLICE_TYPE_B, 2, 8, refs, 2);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_B, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 0, 8);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_B, 1, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 8, 0);
+
+    /* b2: the past first in L0, the future first in L1 */
+    test_init_params(&sps_param, &pic_param, &slice_param, SLICE_TYPE_B, 3, 4, refs, 3);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_B, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 0, 4, 8);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_B, 1, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 4, 8, 0);
+
+    /* no valid application lists: the initial lists, cut to the active size */
+    test_set_num_active(&slice_param, 2, 1);
+    num_refs = intel_avc_enc_ref_pic_list(&sps_param, &pic_param, &slice_param, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 0, 4);
+    num_refs = intel_avc_enc_ref_pic_list(&sps_param, &pic_param, &slice_param, 1, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 4);
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 0);
+
+    /* application lists equal to the initial ones need no modification */
+    slice_param.RefPicList0[0] = refs[0];
+    slice_param.RefPicList0[1] = refs[2];
+    slice_param.RefPicList1[0] = refs[2];
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 0);
+
+    /* b2 predicted from P8 and I0 in L0, and I0 in L1 */
+    slice_param.RefPicList0[0] = refs[1];
+    slice_param.RefPicList0[1] = refs[0];
+    slice_param.RefPicList1[0] = refs[0];
+    num_refs = intel_avc_enc_ref_pic_list(&sps_param, &pic_param, &slice_param, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 8, 0);
+    num_refs = intel_avc_enc_ref_pic_list(&sps_param, &pic_param, &slice_param, 1, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 0);
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 2);
+
+    /* an invalid active entry makes the driver fall back to the initial list */
+    test_invalid_pic(&slice_param.RefPicList0[1]);
+    num_refs = intel_avc_enc_ref_pic_list(&sps_param, &pic_param, &slice_param, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 0, 4);
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 1);
+
+    /* b6 uses all three references in both lists */
+    test_init_params(&sps_param, &pic_param, &slice_param, SLICE_TYPE_B, 3, 12, refs, 3);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_B, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 4, 0, 8);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_B, 1, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 8, 4, 0);
+
+    test_set_num_active(&slice_param, 3, 3);
+    slice_param.RefPicList0[0] = refs[0];
+    slice_param.RefPicList0[1] = refs[1];
+    slice_param.RefPicList0[2] = refs[2];
+    slice_param.RefPicList1[0] = refs[2];
+    slice_param.RefPicList1[1] = refs[1];
+    slice_param.RefPicList1[2] = refs[0];
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 2);
+}
+
+/* P frames right after FrameNum wrapped around MaxFrameNum = 16 */
+static void
+test_frame_num_wrap(void)
+{
+    VAEncSequenceParameterBufferH264 sps_param;
+    VAEncPictureParameterBufferH264 pic_param;
+    VAEncSliceParameterBufferH264 slice_param;
+    VAPictureH264 refs[4], ref_list[32];
+    int num_refs;
+
+    test_ref_pic(&refs[0], 14, 14, 28, 0);      /* PicNum -2 */
+    test_ref_pic(&refs[1], 16, 0, 32, 0);       /* PicNum 0 */
+    test_ref_pic(&refs[2], 15, 15, 30, 0);      /* PicNum -1 */
+    test_ref_pic(&refs[3], 3, 1, 6, 1);         /* LongTermPicNum 1 */
+
+    test_init_params(&sps_param, &pic_param, &slice_param, SLICE_TYPE_P, 1, 34, refs, 4);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_P, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 16, 15, 14, 3);
+    CHECK(intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_P, 1, ref_list) == 0);
+
+    test_set_num_active(&slice_param, 4, 0);
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 0);
+
+    /* back and forth across the wrap, the long term reference first */
+    slice_param.RefPicList0[0] = refs[3];
+    slice_param.RefPicList0[1] = refs[0];
+    slice_param.RefPicList0[2] = refs[1];
+    slice_param.RefPicList0[3] = refs[2];
+    num_refs = intel_avc_enc_ref_pic_list(&sps_param, &pic_param, &slice_param, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 3, 14, 16, 15);
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 1);
+
+    /* the same reference twice */
+    test_set_num_active(&slice_param, 2, 0);
+    slice_param.RefPicList0[0] = refs[2];
+    slice_param.RefPicList0[1] = refs[2];
+    num_refs = intel_avc_enc_ref_pic_list(&sps_param, &pic_param, &slice_param, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 15, 15);
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 1);
+
+    /* the first frame after the wrap only has references before it */
+    refs[1] = refs[2];
+    test_init_params(&sps_param, &pic_param, &slice_param, SLICE_TYPE_P, 0, 32, refs, 2);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_P, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 15, 14);
+
+    test_set_num_active(&slice_param, 2, 0);
+    slice_param.RefPicList0[0] = refs[0];
+    slice_param.RefPicList0[1] = refs[1];
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 1);
+}
+
+/* B frames that only reference the past: L1 starts with L0's second entry */
+static void
+test_l1_swap(void)
+{
+    VAEncSequenceParameterBufferH264 sps_param;
+    VAEncPictureParameterBufferH264 pic_param;
+    VAEncSliceParameterBufferH264 slice_param;
+    VAPictureH264 refs[3], ref_list[32];
+    int num_refs;
+
+    test_ref_pic(&refs[0], 0, 0, 0, 0);
+    test_ref_pic(&refs[1], 1, 1, 2, 0);
+    test_ref_pic(&refs[2], 2, 2, 4, 0);
+
+    test_init_params(&sps_param, &pic_param, &slice_param, SLICE_TYPE_B, 3, 6, refs, 3);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_B, 0, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 2, 1, 0);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_B, 1, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 1, 2, 0);
+
+    /* the application asks for the same past picture in both lists */
+    test_set_num_active(&slice_param, 1, 1);
+    slice_param.RefPicList0[0] = refs[2];
+    slice_param.RefPicList1[0] = refs[2];
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 1);
+
+    /* a single reference is not swapped */
+    test_init_params(&sps_param, &pic_param, &slice_param, SLICE_TYPE_B, 1, 2, refs, 1);
+    num_refs = intel_avc_init_ref_pic_list(&sps_param, &pic_param, SLICE_TYPE_B, 1, ref_list);
+    CHECK_REF_LIST(ref_list, num_refs, 0);
+    CHECK(test_slice_header(&sps_param, &pic_param, &slice_param) == 0);
+}
+
+int
+main(void)
+{
+    test_pyramid_b();
+    test_frame_num_wrap();
+    test_l1_swap();
+
+    return test_result("ref_list");
+}
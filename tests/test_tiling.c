@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the CPU (de)tiling of i965_tiling.c, with each set of kernels
+ * the CPU supports, against a byte by byte model of the X and Y tiling
+ * and of the bit 6 swizzling.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <i915_drm.h>
+
+#include "i965_tiling.h"
+#include "test.h"
+
+#define TEST_PITCH      1024
+#define TEST_HEIGHT     96
+#define TEST_SIZE       (TEST_PITCH * TEST_HEIGHT)
+
+/* The offset of byte (x, y) in the tiled surface */
+static unsigned int
+reference_offset(uint32_t tiling, uint32_t swizzle, unsigned int x, unsigned int y)
+{
+    unsigned int offset;
+
+    switch (tiling) {
+    case I915_TILING_X:
+        offset = ((y / 8) * (TEST_PITCH / 512) + x / 512) * 4096 +
+            (y % 8) * 512 + x % 512;
+        break;
+
+    case I915_TILING_Y:
+        offset = ((y / 32) * (TEST_PITCH / 128) + x / 128) * 4096 +
+            (x % 128 / 16) * 512 + (y % 32) * 16 + x % 16;
+        break;
+
+    default:
+        return y * TEST_PITCH + x;
+    }
+
+    switch (swizzle) {
+    case I915_BIT_6_SWIZZLE_9:
+        offset ^= (offset >> 3) & 64;
+        break;
+
+    case I915_BIT_6_SWIZZLE_9_10:
+        offset ^= ((offset >> 3) ^ (offset >> 4)) & 64;
+        break;
+    }
+
+    return offset;
+}
+
+static void
+fill_random(uint8_t *p, unsigned int size, unsigned int *seed)
+{
+    unsigned int i;
+
+    for (i = 0; i < size; i++)
+        p[i] = rand_r(seed);
+}
+
+static void
+test_region(uint8_t *tiled, uint8_t *saved, uint8_t *linear,
+            uint32_t tiling, uint32_t swizzle,
+            unsigned int x, unsigned int y,
+            unsigned int width, unsigned int height,
+            unsigned int *seed)
+{
+    unsigned int linear_pitch = width + 13;
+    unsigned int i, j, errors = 0;
+
+    /* detiling */
+    fill_random(tiled, TEST_SIZE, seed);
+    memset(linear, 0, linear_pitch * height);
+    i965_tiled_to_linear(linear, linear_pitch, tiled, TEST_PITCH, tiling, swizzle,
+                         x, y, width, height);
+
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            errors += linear[j * linear_pitch + i] !=
+                tiled[reference_offset(tiling, swizzle, x + i, y + j)];
+
+    /* tiling, the bytes outside of the region must be left alone */
+    memcpy(saved, tiled, TEST_SIZE);
+    fill_random(linear, linear_pitch * height, seed);
+    i965_linear_to_tiled(tiled, TEST_PITCH, tiling, swizzle, x, y,
+                         linear, linear_pitch, width, height);
+
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++) {
+            unsigned int offset = reference_offset(tiling, swizzle, x + i, y + j);
+
+            errors += tiled[offset] != linear[j * linear_pitch + i];
+            saved[offset] = tiled[offset];
+        }
+
+    errors += memcmp(saved, tiled, TEST_SIZE) != 0;
+
+    if (errors)
+        fprintf(stderr, "tiling %u swizzle %u region %u,%u %ux%u: %u errors\n",
+                tiling, swizzle, x, y, width, height, errors);
+
+    CHECK(errors == 0);
+}
+
+int
+main(void)
+{
+    static const uint32_t tilings[] = { I915_TILING_NONE, I915_TILING_X, I915_TILING_Y };
+    static const uint32_t swizzles[] = {
+        I915_BIT_6_SWIZZLE_NONE, I915_BIT_6_SWIZZLE_9, I915_BIT_6_SWIZZLE_9_10
+    };
+    uint8_t *tiled = aligned_alloc(4096, TEST_SIZE);
+    uint8_t *saved = malloc(TEST_SIZE);
+    uint8_t *linear = malloc(TEST_SIZE * 2);
+    unsigned int seed = 1;
+    unsigned int k, t, s, n;
+
+    CHECK(i965_tiling_supported(I915_TILING_Y, I915_BIT_6_SWIZZLE_NONE, TEST_PITCH));
+    CHECK(i965_tiling_supported(I915_TILING_X, I915_BIT_6_SWIZZLE_9_10, TEST_PITCH));
+    CHECK(!i965_tiling_supported(I915_TILING_X, I915_BIT_6_SWIZZLE_NONE, 640));
+    CHECK(!i965_tiling_supported(I915_TILING_Y, I915_BIT_6_SWIZZLE_NONE, 200));
+
+    for (k = I965_TILING_KERNELS_C; k <= I965_TILING_KERNELS_AVX2; k++) {
+        if (!i965_tiling_set_kernels(k))
+            continue;
+
+        for (t = 0; t < sizeof(tilings) / sizeof(tilings[0]); t++) {
+            for (s = 0; s < sizeof(swizzles) / sizeof(swizzles[0]); s++) {
+                /* the whole surface, aligned regions and then random ones */
+                test_region(tiled, saved, linear, tilings[t], swizzles[s],
+                            0, 0, TEST_PITCH, TEST_HEIGHT, &seed);
+                test_region(tiled, saved, linear, tilings[t], swizzles[s],
+                            128, 32, 512, 32, &seed);
+                test_region(tiled, saved, linear, tilings[t], swizzles[s],
+                            16, 1, 64, 7, &seed);
+
+                for (n = 0; n < 50; n++) {
+                    unsigned int x = rand_r(&seed) % TEST_PITCH;
+                    unsigned int y = rand_r(&seed) % TEST_HEIGHT;
+                    unsigned int width = 1 + rand_r(&seed) % (TEST_PITCH - x);
+                    unsigned int height = 1 + rand_r(&seed) % (TEST_HEIGHT - y);
+
+                    test_region(tiled, saved, linear, tilings[t], swizzles[s],
+                                x, y, width, height, &seed);
+                }
+            }
+        }
+    }
+
+    free(tiled);
+    free(saved);
+    free(linear);
+
+    return test_result("tiling");
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the slice data stores of i965_buffer_pool.c against a mocked
+ * bufmgr: page aligned memory is wrapped in a userptr BO, unaligned memory
+ * or memory the kernel refuses is copied into a pooled BO, and only the
+ * decoding configs may ask for I965_CONFIG_ATTRIB_SLICE_DATA_USERPTR.
+ */
+
+#include "sysdeps.h"
+
+#include <unistd.h>
+
+#include "i965_drv_video.h"
+#include "i965_buffer_pool.h"
+#include "mock_bufmgr.h"
+#include "test.h"
+
+#define TEST_SIZE       (3 * 4096 + 100)
+
+#ifdef HAVE_DRM_INTEL_USERPTR
+#define TEST_HAS_USERPTR        1
+#else
+#define TEST_HAS_USERPTR        0
+#endif
+
+uint32_t g_intel_debug_option_flags;
+
+static struct i965_buffer_pool pool;
+
+static void
+test_release(struct buffer_store *buffer_store)
+{
+    buffer_store->ref_count = 0;
+    i965_buffer_pool_release_store(buffer_store);
+}
+
+static void
+test_entrypoints(void)
+{
+    CHECK(i965_buffer_pool_has_userptr(VAEntrypointVLD) == TEST_HAS_USERPTR);
+    CHECK(!i965_buffer_pool_has_userptr(VAEntrypointEncSlice));
+    CHECK(!i965_buffer_pool_has_userptr(VAEntrypointVideoProc));
+}
+
+/* The data is in a BO of its own, a copy the caller may reuse right away */
+static void
+test_copied(unsigned char *data, int userptr)
+{
+    unsigned int num_userptrs = mock_bufmgr.num_userptrs;
+    struct buffer_store *buffer_store;
+
+    buffer_store = i965_buffer_pool_create_slice_data_store(&pool, data, TEST_SIZE, userptr);
+    CHECK(buffer_store && buffer_store->bo);
+
+    if (!buffer_store || !buffer_store->bo)
+        return;
+
+    CHECK(!mock_bo(buffer_store->bo)->userptr);
+    CHECK(buffer_store->pool_kind == I965_BUFFER_POOL_SLICE_DATA);
+    CHECK(buffer_store->bo->size >= TEST_SIZE);
+    CHECK(mock_bufmgr.num_userptrs == num_userptrs);
+
+    if (data) {
+        CHECK(buffer_store->bo->virtual != data);
+        CHECK(!memcmp(buffer_store->bo->virtual, data, TEST_SIZE));
+    }
+
+    test_release(buffer_store);
+}
+
+/* The BO is the user memory itself, it is never recycled */
+static void
+test_wrapped(unsigned char *data)
+{
+    unsigned int num_allocs = mock_bufmgr.num_allocs;
+    int num_bos = mock_bufmgr.num_bos;
+    struct buffer_store *buffer_store;
+
+    buffer_store = i965_buffer_pool_create_slice_data_store(&pool, data, TEST_SIZE, 1);
+    CHECK(buffer_store && buffer_store->bo);
+
+    if (!buffer_store || !buffer_store->bo)
+        return;
+
+    CHECK(mock_bo(buffer_store->bo)->userptr == data);
+    CHECK(buffer_store->bo->virtual == data);
+    CHECK(buffer_store->bo->size == 4 * 4096);
+    CHECK(buffer_store->pool_kind == I965_BUFFER_POOL_NONE);
+    CHECK(mock_bufmgr.num_allocs == num_allocs);
+
+    test_release(buffer_store);
+    CHECK(mock_bufmgr.num_bos == num_bos);
+}
+
+int
+main(void)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    unsigned char *data;
+    unsigned int hits;
+    int i, changed = 0;
+
+    if (page_size != 4096 || posix_memalign((void **)&data, page_size, 8 * page_size))
+        return 77;      /* skipped */
+
+    for (i = 0; i < 8 * page_size; i++)
+        data[i] = i * 7;
+
+    i965_buffer_pool_init(&pool, NULL, I965_BUFFER_POOL_DEFAULT_SIZE << 20);
+
+    test_entrypoints();
+
+    /* the copy unless the context asked for userptr */
+    test_copied(data, 0);
+
+    if (TEST_HAS_USERPTR)
+        test_wrapped(data);
+    else
+        test_copied(data, 1);
+
+    /* the automatic fallbacks: unaligned memory, then refused memory */
+    test_copied(data + 16, 1);
+
+    mock_bufmgr.refuse_userptr = 1;
+    test_copied(data, 1);
+    mock_bufmgr.refuse_userptr = 0;
+
+    /* a buffer without data gets an empty BO */
+    test_copied(NULL, 1);
+
+    /* the copies are recycled through the pool */
+    hits = pool.bo_stats.hits;
+    test_copied(data, 0);
+    CHECK(pool.bo_stats.hits == hits + 1);
+
+    i965_buffer_pool_terminate(&pool);
+    CHECK(mock_bufmgr.num_bos == 0);
+
+    /* the user memory is left untouched */
+    for (i = 0; i < 8 * page_size; i++)
+        changed |= data[i] != (unsigned char)(i * 7);
+
+    CHECK(!changed);
+
+    free(data);
+
+    return test_result("userptr");
+}
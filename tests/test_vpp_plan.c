@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the stages the VEBOX/GPE/PP planner of gen75_vpp_plan.c picks
+ * for the filter, format and scaling combinations, without a GPU.
+ */
+
+#include <string.h>
+#include <va/va.h>
+
+#include "gen75_vpp_plan.h"
+#include "test.h"
+
+#define DN      VPP_PLAN_FILTER_DN
+#define DI      VPP_PLAN_FILTER_DI
+#define SHARP   VPP_PLAN_FILTER_SHARPENING
+
+struct test_case
+{
+    unsigned int filters;
+    unsigned int src_fourcc;
+    unsigned int dst_fourcc;
+    int scaled;
+    int num_tmp_surfaces;
+    const char *plan;
+};
+
+static const struct test_case cases[] = {
+    /* conversion and scaling only, in a single pass */
+    { 0, VA_FOURCC_NV12, VA_FOURCC_NV12, 0, 0, "PP(in->out)" },
+    { 0, VA_FOURCC_YV12, VA_FOURCC_RGBA, 1, 0, "PP(in->out)" },
+
+    /* the VEBOX writes the output when it can */
+    { DN, VA_FOURCC_NV12, VA_FOURCC_NV12, 0, 0, "VEBOX(in->out)" },
+    { DN | DI, VA_FOURCC_YV12, VA_FOURCC_YUY2, 0, 0, "VEBOX(in->out)" },
+    { DN, VA_FOURCC_NV12, VA_FOURCC_NV12, 1, 1, "VEBOX(in->tmp0) PP(tmp0->out)" },
+    { DI, VA_FOURCC_NV12, VA_FOURCC_YV12, 0, 1, "VEBOX(in->tmp0) PP(tmp0->out)" },
+
+    /* the sharpening kernel reads NV12 only */
+    { SHARP, VA_FOURCC_NV12, VA_FOURCC_NV12, 0, 0, "GPE(in->out)" },
+    { SHARP, VA_FOURCC_YV12, VA_FOURCC_NV12, 0, 1, "PP(in->tmp0) GPE(tmp0->out)" },
+    { SHARP, VA_FOURCC_NV12, VA_FOURCC_NV12, 1, 1, "GPE(in->tmp0) PP(tmp0->out)" },
+    { SHARP, VA_FOURCC_YV12, VA_FOURCC_YV12, 1, 2, "PP(in->tmp0) GPE(tmp0->tmp1) PP(tmp1->out)" },
+
+    /* all three units, the VEBOX output is NV12 already */
+    { DN | SHARP, VA_FOURCC_NV12, VA_FOURCC_NV12, 0, 1, "VEBOX(in->tmp0) GPE(tmp0->out)" },
+    { DN | SHARP, VA_FOURCC_YV12, VA_FOURCC_YV12, 1, 2, "VEBOX(in->tmp0) GPE(tmp0->tmp1) PP(tmp1->out)" },
+};
+
+static void
+test_plan(const struct test_case *c)
+{
+    struct vpp_plan_params params = {
+        c->filters, c->src_fourcc, c->dst_fourcc,
+        1920, 1080, c->scaled ? 1280 : 1920, c->scaled ? 720 : 1080,
+    };
+    struct vpp_plan plan, again;
+    char str[128];
+    int len;
+
+    CHECK(vpp_plan_build(&params, &plan) == VA_STATUS_SUCCESS);
+    len = vpp_plan_to_string(&plan, str, sizeof(str));
+
+    if (strcmp(str, c->plan) || plan.num_tmp_surfaces != c->num_tmp_surfaces)
+        fprintf(stderr, "filters %x scaled %d: \"%s\" with %d surfaces, expected \"%s\" with %d\n",
+                c->filters, c->scaled, str, plan.num_tmp_surfaces, c->plan, c->num_tmp_surfaces);
+
+    CHECK(!strcmp(str, c->plan));
+    CHECK(len == strlen(str));
+    CHECK(plan.num_tmp_surfaces == c->num_tmp_surfaces);
+    CHECK(plan.stages[plan.num_stages - 1].dst == VPP_PLAN_SURFACE_OUTPUT);
+
+    CHECK(vpp_plan_build(&params, &again) == VA_STATUS_SUCCESS);
+    CHECK(vpp_plan_compare(&plan, &again) == 0);
+}
+
+static void
+test_errors(void)
+{
+    struct vpp_plan_params params = {
+        DN, VA_FOURCC_NV12, VA_FOURCC_NV12, 1920, 1080, 1920, 1080,
+    };
+    struct vpp_plan plan, other;
+
+    params.filters = 1 << 16;
+    CHECK(vpp_plan_build(&params, &plan) == VA_STATUS_ERROR_UNSUPPORTED_FILTER);
+
+    params.filters = DN;
+    params.dst_height = 0;
+    CHECK(vpp_plan_build(&params, &plan) == VA_STATUS_ERROR_INVALID_PARAMETER);
+
+    params.dst_height = 1080;
+    params.src_fourcc = VA_FOURCC_UYVY;
+    CHECK(vpp_plan_build(&params, &plan) == VA_STATUS_ERROR_UNSUPPORTED_RT_FORMAT);
+
+    params.src_fourcc = VA_FOURCC_NV12;
+    CHECK(vpp_plan_build(&params, &plan) == VA_STATUS_SUCCESS);
+    params.filters = SHARP;
+    CHECK(vpp_plan_build(&params, &other) == VA_STATUS_SUCCESS);
+    CHECK(vpp_plan_compare(&plan, &other) != 0);
+}
+
+/* The returned length never exceeds what was written */
+static void
+test_truncation(void)
+{
+    struct vpp_plan_params params = {
+        SHARP, VA_FOURCC_YV12, VA_FOURCC_YV12, 1920, 1080, 1280, 720,
+    };
+    const char *full = "PP(in->tmp0) GPE(tmp0->tmp1) PP(tmp1->out)";
+    struct vpp_plan plan;
+    char str[64];
+    int size;
+
+    CHECK(vpp_plan_build(&params, &plan) == VA_STATUS_SUCCESS);
+    CHECK(vpp_plan_to_string(&plan, str, 0) == 0);
+
+    for (size = 1; size <= strlen(full) + 1; size++) {
+        int len;
+
+        memset(str, 'x', sizeof(str));
+        len = vpp_plan_to_string(&plan, str, size);
+
+        CHECK(len == strlen(str));
+        CHECK(len == (size <= strlen(full) ? size - 1 : strlen(full)));
+        CHECK(!strncmp(str, full, len));
+        CHECK(str[size] == 'x');
+    }
+}
+
+int
+main(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        test_plan(&cases[i]);
+
+    test_errors();
+    test_truncation();
+
+    return test_result("vpp_plan");
+}